@@ -0,0 +1,317 @@
+/* bench.c */
+// Throughput benchmarks for the lexer, parser and semantic analysis, run on
+// programs from the synthetic generator.
+//
+// Build from phase3-w25/ (test/run_tests.sh builds and runs it with the
+// same sources, so this stays in step with what the analyzer links):
+//   gcc -std=c11 -O2 -o analyzer_bench bench/*.c src/lexer/lexer.c
+//       src/lexer/float_literal.c src/parser/*.c src/semantic/*.c
+//       src/diagnostics/*.c src/runtime/runtime.c src/stats/stats.c
+//       src/allocator/allocator.c src/budget/budget.c src/trace/trace.c -pthread
+//
+// Usage: analyzer_bench [--shape=NAME] [--size=N] [--depth=N] [--width=N]
+//                       [--seed=N] [--repeat=N] [--json] [--emit] [--share]
+//                       [--jobs=N]
+//   --shape   one of the generator shapes; every shape when omitted
+//   --size    top-level statements per program
+//   --repeat  runs per phase; the fastest one is reported
+//   --json    one JSON document on stdout, for comparing between commits
+//   --emit    print the generated program instead of benchmarking it
+//   --share   hash-cons closed expressions while parsing; the node count
+//             stays that of the tree, the peak RSS shows what was saved
+//   --jobs    check if/while/repeat statements on N threads
+//
+// Each phase reports the items it produced per second (tokens, AST nodes,
+// symbols) and the peak resident set size reached while it ran. Parsing
+// includes the lexing the parser does on demand.
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "generator.h"
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+#include "../include/parallel.h"
+#include "../include/dataflow.h"
+#include "../include/diagnostics.h"
+
+typedef enum {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_SEMANTIC,
+    PHASE_COUNT
+} Phase;
+
+static const char* phase_names[PHASE_COUNT] = { "lex", "parse", "semantic" };
+static const char* phase_units[PHASE_COUNT] = { "tokens", "nodes", "symbols" };
+
+typedef struct {
+    double seconds;             // fastest run
+    long items;
+    long peak_rss_kb;           // -1 when it can't be measured
+} PhaseResult;
+
+typedef struct {
+    GeneratorOptions options;
+    size_t source_bytes;
+    int diagnostics;            // diagnostics reported during semantic analysis
+    PhaseResult phases[PHASE_COUNT];
+} BenchResult;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Start measuring peak RSS from the current RSS. Linux lets us reset the
+// high-water mark; elsewhere the reported peak is the process-wide one.
+static void reset_peak_rss(void) {
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (!file) return;
+    fputs("5", file);
+    fclose(file);
+}
+
+static long peak_rss_kb(void) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), file)) {
+            if (strncmp(line, "VmHWM:", 6) == 0) {
+                kb = strtol(line + 6, NULL, 10);
+                break;
+            }
+        }
+        fclose(file);
+        if (kb >= 0) return kb;
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+    return usage.ru_maxrss;
+}
+
+static long count_nodes(const ASTNode* node) {
+    long count = 0;
+    // Statement lists are long, nesting is not: walk `next` iteratively
+    for (; node; node = node->next) {
+        count++;
+        count += count_nodes(node->left);
+        count += count_nodes(node->right);
+        count += count_nodes(node->operand);
+    }
+    return count;
+}
+
+static long run_lex(const char* source) {
+    long tokens = 0;
+    int pos = 0;
+    lexer_reset();
+    Token token;
+    do {
+        token = get_next_token(source, &pos);
+        tokens++;
+    } while (token.type != TOKEN_EOF);
+    return tokens;
+}
+
+static int hash_consing = 0;
+static int jobs = 1;
+
+static ASTNode* run_parse(const char* source) {
+    parser_init(source);
+    return parse();
+}
+
+// Returns the number of symbols declared
+static long run_semantic(ASTNode* ast) {
+    SymbolTable* table = init_symbol_table();
+    if (!table) return 0;
+    check_program_parallel(ast, table, jobs);
+    check_definite_assignment(ast);
+    long symbols = table->symbol_count;
+    free_symbol_table(table);
+    return symbols;
+}
+
+static void run_phase(BenchResult* result, Phase phase, const char* source, int repeat) {
+    PhaseResult* out = &result->phases[phase];
+    out->seconds = -1;
+    out->items = 0;
+
+    reset_peak_rss();
+    for (int i = 0; i < repeat; i++) {
+        NodeTable nodes;
+        node_table_init(&nodes);
+        if (hash_consing) parser_set_node_table(&nodes);
+
+        // Semantic analysis caches its results in the AST, so every run
+        // gets a fresh tree; building it isn't timed
+        ASTNode* ast = phase == PHASE_SEMANTIC ? run_parse(source) : NULL;
+
+        double start = now_seconds();
+        switch (phase) {
+            case PHASE_LEX:
+                out->items = run_lex(source);
+                break;
+            case PHASE_PARSE:
+                ast = run_parse(source);
+                break;
+            case PHASE_SEMANTIC:
+                out->items = run_semantic(ast);
+                break;
+            default:
+                break;
+        }
+        double elapsed = now_seconds() - start;
+
+        if (phase == PHASE_PARSE) out->items = count_nodes(ast);
+        if (out->seconds < 0 || elapsed < out->seconds) out->seconds = elapsed;
+        free_ast(ast);
+        parser_set_node_table(NULL);
+        node_table_free(&nodes);
+    }
+    out->peak_rss_kb = peak_rss_kb();
+}
+
+static int run_benchmark(BenchResult* result, int repeat) {
+    char* source = generate_program(&result->options, &result->source_bytes);
+    if (!source) return 0;
+
+    // Collect diagnostics without printing them
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    session.enabled = 0;
+    DiagnosticSession* previous = diag_begin(&session);
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        run_phase(result, (Phase)phase, source, repeat);
+    }
+    result->diagnostics = (session.error_count + session.warning_count) / repeat;
+
+    diag_end(previous);
+    diag_session_free(&session);
+    free(source);
+    return 1;
+}
+
+static double per_second(const PhaseResult* phase) {
+    return phase->seconds > 0 ? phase->items / phase->seconds : 0;
+}
+
+static void print_text(const BenchResult* results, int count) {
+    printf("%-18s %-9s %10s %12s %10s %16s %12s\n",
+           "shape", "phase", "bytes", "items", "ms", "items/s", "peak RSS kB");
+    for (int i = 0; i < count; i++) {
+        const BenchResult* result = &results[i];
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            const PhaseResult* p = &result->phases[phase];
+            printf("%-18s %-9s %10zu %12ld %10.3f %16.0f %12ld  %s\n",
+                   generator_shape_name(result->options.shape), phase_names[phase],
+                   result->source_bytes, p->items, p->seconds * 1000.0,
+                   per_second(p), p->peak_rss_kb, phase_units[phase]);
+        }
+        if (result->diagnostics > 0) {
+            printf("%-18s warning: %d diagnostic(s) reported on generated code\n",
+                   generator_shape_name(result->options.shape), result->diagnostics);
+        }
+    }
+}
+
+static void print_json(const BenchResult* results, int count, int repeat) {
+    printf("{\"repeat\":%d,\"benchmarks\":[", repeat);
+    for (int i = 0; i < count; i++) {
+        const BenchResult* result = &results[i];
+        printf("%s{\"shape\":\"%s\",\"statements\":%d,\"depth\":%d,\"width\":%d,"
+               "\"seed\":%u,\"source_bytes\":%zu,\"diagnostics\":%d,\"phases\":[",
+               i ? "," : "", generator_shape_name(result->options.shape),
+               result->options.statements, result->options.depth,
+               result->options.width, result->options.seed,
+               result->source_bytes, result->diagnostics);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            const PhaseResult* p = &result->phases[phase];
+            printf("%s{\"phase\":\"%s\",\"unit\":\"%s\",\"items\":%ld,"
+                   "\"seconds\":%.9f,\"items_per_second\":%.1f,\"peak_rss_kb\":%ld}",
+                   phase ? "," : "", phase_names[phase], phase_units[phase],
+                   p->items, p->seconds, per_second(p), p->peak_rss_kb);
+        }
+        printf("]}");
+    }
+    printf("]}\n");
+}
+
+// Parse the value of a "--name=value" option; returns 0 if `arg` isn't one
+static int option_value(const char* arg, const char* name, const char** value) {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=') return 0;
+    *value = arg + length + 1;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    GeneratorOptions options;
+    generator_default_options(&options, SHAPE_MIXED);
+    int all_shapes = 1;
+    int repeat = 5;
+    int json = 0;
+    int emit = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* value;
+        if (option_value(argv[i], "--shape", &value)) {
+            options.shape = generator_shape_from_name(value);
+            if (options.shape == SHAPE_COUNT) {
+                fprintf(stderr, "Unknown shape '%s'\n", value);
+                return 1;
+            }
+            all_shapes = 0;
+        }
+        else if (option_value(argv[i], "--size", &value)) options.statements = atoi(value);
+        else if (option_value(argv[i], "--depth", &value)) options.depth = atoi(value);
+        else if (option_value(argv[i], "--width", &value)) options.width = atoi(value);
+        else if (option_value(argv[i], "--seed", &value)) options.seed = (unsigned int)strtoul(value, NULL, 10);
+        else if (option_value(argv[i], "--repeat", &value)) repeat = atoi(value);
+        else if (strcmp(argv[i], "--json") == 0) json = 1;
+        else if (strcmp(argv[i], "--emit") == 0) emit = 1;
+        else if (strcmp(argv[i], "--share") == 0) hash_consing = 1;
+        else if (option_value(argv[i], "--jobs", &value)) jobs = atoi(value);
+        else {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (repeat < 1) repeat = 1;
+    if (options.width < 1) options.width = 1;
+    if (options.depth < 0) options.depth = 0;
+
+    if (emit) {
+        char* source = generate_program(&options, NULL);
+        if (!source) return 1;
+        fputs(source, stdout);
+        free(source);
+        return 0;
+    }
+
+    BenchResult results[SHAPE_COUNT];
+    int count = 0;
+    for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+        if (!all_shapes && shape != (int)options.shape) continue;
+        memset(&results[count], 0, sizeof(BenchResult));
+        results[count].options = options;
+        results[count].options.shape = (GeneratorShape)shape;
+        if (!run_benchmark(&results[count], repeat)) {
+            fprintf(stderr, "Out of memory generating '%s'\n", generator_shape_name(shape));
+            return 1;
+        }
+        count++;
+    }
+
+    if (json) print_json(results, count, repeat);
+    else print_text(results, count);
+    return 0;
+}
@@ -0,0 +1,305 @@
+/* generator.c */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "generator.h"
+
+static const char* shape_names[SHAPE_COUNT] = {
+    "mixed",
+    "deep_nesting",
+    "long_expressions",
+    "many_scopes",
+    "identifier_heavy",
+    "comment_heavy",
+    "float_literals"
+};
+
+static const char* operators[] = { "+", "-", "*" };
+static const char* comparisons[] = { "<", ">", "<=", ">=", "==", "!=" };
+
+typedef struct {
+    const GeneratorOptions* options;
+    FILE* out;
+    unsigned int state;         // xorshift32, so output doesn't depend on the libc
+    int next_id;                // next unused variable number
+    int* visible;               // variables readable at the current point
+    int visible_count;
+    int visible_capacity;
+    int indent;
+    int failed;
+} Generator;
+
+void generator_default_options(GeneratorOptions* options, GeneratorShape shape) {
+    options->shape = shape;
+    options->statements = 2000;
+    options->depth = 32;
+    options->width = 256;
+    options->seed = 1;
+}
+
+const char* generator_shape_name(GeneratorShape shape) {
+    if (shape < 0 || shape >= SHAPE_COUNT) return "unknown";
+    return shape_names[shape];
+}
+
+GeneratorShape generator_shape_from_name(const char* name) {
+    for (int i = 0; i < SHAPE_COUNT; i++) {
+        if (strcmp(name, shape_names[i]) == 0) return (GeneratorShape)i;
+    }
+    return SHAPE_COUNT;
+}
+
+static unsigned int next_random(Generator* gen) {
+    unsigned int x = gen->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    gen->state = x;
+    return x;
+}
+
+// Uniform-ish value in [0, bound)
+static int random_below(Generator* gen, int bound) {
+    return (int)(next_random(gen) % (unsigned int)bound);
+}
+
+static void emit_indent(Generator* gen) {
+    fprintf(gen->out, "%*s", gen->indent * 4, "");
+}
+
+static void emit_name(Generator* gen, int id) {
+    if (gen->options->shape == SHAPE_IDENTIFIER_HEAVY) {
+        fprintf(gen->out, "identifier_heavy_variable_number_%d", id);
+    } else {
+        fprintf(gen->out, "v%d", id);
+    }
+}
+
+static void make_visible(Generator* gen, int id) {
+    if (gen->visible_count == gen->visible_capacity) {
+        int capacity = gen->visible_capacity ? gen->visible_capacity * 2 : 64;
+        int* grown = realloc(gen->visible, capacity * sizeof(int));
+        if (!grown) {
+            gen->failed = 1;
+            return;
+        }
+        gen->visible = grown;
+        gen->visible_capacity = capacity;
+    }
+    gen->visible[gen->visible_count++] = id;
+}
+
+static int random_variable(Generator* gen) {
+    return gen->visible[random_below(gen, gen->visible_count)];
+}
+
+// Float literals in the forms people write: plain decimals, long fractions,
+// and exponents in both directions
+static void emit_float_literal(Generator* gen) {
+    int whole = random_below(gen, 1000);
+    int fraction = random_below(gen, 1000000);
+    switch (random_below(gen, 4)) {
+        case 0:
+            fprintf(gen->out, "%d.%d", whole, fraction % 100);
+            break;
+        case 1:
+            fprintf(gen->out, "%d.%06d%06d", whole, fraction, random_below(gen, 1000000));
+            break;
+        case 2:
+            fprintf(gen->out, "%d.%de-%d", whole % 10, fraction, 1 + random_below(gen, 300));
+            break;
+        default:
+            fprintf(gen->out, "%d.%dE+%d", whole % 10, fraction, random_below(gen, 300));
+            break;
+    }
+}
+
+static void emit_term(Generator* gen) {
+    if (gen->options->shape == SHAPE_FLOAT_LITERALS) {
+        if (random_below(gen, 4) == 0) emit_name(gen, random_variable(gen));
+        else emit_float_literal(gen);
+        return;
+    }
+    // Identifier-heavy code never uses literals
+    if (gen->options->shape == SHAPE_IDENTIFIER_HEAVY || random_below(gen, 2) == 0) {
+        emit_name(gen, random_variable(gen));
+    } else {
+        fprintf(gen->out, "%d", random_below(gen, 1000));
+    }
+}
+
+static void emit_expression(Generator* gen, int terms) {
+    emit_term(gen);
+    for (int i = 1; i < terms; i++) {
+        fprintf(gen->out, " %s ", operators[random_below(gen, 3)]);
+        emit_term(gen);
+    }
+}
+
+static int expression_terms(Generator* gen) {
+    if (gen->options->shape == SHAPE_LONG_EXPRESSIONS) return gen->options->width;
+    if (gen->options->shape == SHAPE_FLOAT_LITERALS) return 4 + random_below(gen, 8);
+    if (gen->options->shape == SHAPE_IDENTIFIER_HEAVY) return 4 + random_below(gen, 8);
+    return 1 + random_below(gen, 4);
+}
+
+static void emit_condition(Generator* gen) {
+    emit_name(gen, random_variable(gen));
+    fprintf(gen->out, " %s %d", comparisons[random_below(gen, 6)], random_below(gen, 100));
+}
+
+static void emit_comment(Generator* gen) {
+    emit_indent(gen);
+    if (random_below(gen, 3) == 0) {
+        fprintf(gen->out, "/* block comment %d: the statement below is\n", gen->next_id);
+        emit_indent(gen);
+        fprintf(gen->out, "   generated, do not read too much into it */\n");
+    } else {
+        fprintf(gen->out, "// line comment %d, explaining nothing in particular\n", gen->next_id);
+    }
+}
+
+static void emit_declaration(Generator* gen) {
+    int id = gen->next_id++;
+    emit_indent(gen);
+    fprintf(gen->out, gen->options->shape == SHAPE_FLOAT_LITERALS ? "float " : "int ");
+    emit_name(gen, id);
+    fprintf(gen->out, ";\n");
+
+    // Assign right away so the variable is definitely initialized
+    emit_indent(gen);
+    emit_name(gen, id);
+    fprintf(gen->out, " = ");
+    if (gen->visible_count > 0) emit_expression(gen, expression_terms(gen));
+    else if (gen->options->shape == SHAPE_FLOAT_LITERALS) emit_float_literal(gen);
+    else fprintf(gen->out, "%d", random_below(gen, 1000));
+    fprintf(gen->out, ";\n");
+    make_visible(gen, id);
+}
+
+static void emit_assignment(Generator* gen) {
+    emit_indent(gen);
+    emit_name(gen, random_variable(gen));
+    fprintf(gen->out, " = ");
+    emit_expression(gen, expression_terms(gen));
+    fprintf(gen->out, ";\n");
+}
+
+static void emit_statement(Generator* gen, int depth);
+
+// '{' statements '}' with its own scope; leaves the output after the '}'
+static void emit_block_body(Generator* gen, int depth, int statements) {
+    int visible_before = gen->visible_count;
+    fprintf(gen->out, "{\n");
+    gen->indent++;
+    for (int i = 0; i < statements; i++) emit_statement(gen, depth);
+    gen->indent--;
+    emit_indent(gen);
+    fprintf(gen->out, "}");
+    gen->visible_count = visible_before;
+}
+
+static void emit_compound(Generator* gen, int kind, int depth, int statements) {
+    emit_indent(gen);
+    switch (kind) {
+        case 0:
+            fprintf(gen->out, "if (");
+            emit_condition(gen);
+            fprintf(gen->out, ") ");
+            emit_block_body(gen, depth, statements);
+            fprintf(gen->out, "\n");
+            break;
+        case 1:
+            fprintf(gen->out, "while (");
+            emit_condition(gen);
+            fprintf(gen->out, ") ");
+            emit_block_body(gen, depth, statements);
+            fprintf(gen->out, "\n");
+            break;
+        default:
+            fprintf(gen->out, "repeat ");
+            emit_block_body(gen, depth, statements);
+            fprintf(gen->out, " until (");
+            emit_condition(gen);
+            fprintf(gen->out, ");\n");
+            break;
+    }
+}
+
+// Bare blocks are left out: a block statement keeps its body on its own
+// `next` link, which is also what chains it into the enclosing statement list
+static int random_compound(Generator* gen) {
+    return random_below(gen, 3);
+}
+
+// `depth` is how many more compound statements may be nested inside this one
+static void emit_statement(Generator* gen, int depth) {
+    const GeneratorOptions* options = gen->options;
+
+    if (options->shape == SHAPE_COMMENT_HEAVY) emit_comment(gen);
+
+    switch (options->shape) {
+        case SHAPE_DEEP_NESTING:
+            if (depth > 0) {
+                // Exactly one nested statement per level, plus a declaration
+                // at the innermost level
+                emit_compound(gen, random_compound(gen), depth - 1, 1);
+            } else {
+                emit_declaration(gen);
+            }
+            return;
+
+        case SHAPE_LONG_EXPRESSIONS:
+            emit_assignment(gen);
+            return;
+
+        case SHAPE_MANY_SCOPES:
+            if (depth > 0) {
+                emit_compound(gen, random_compound(gen), 0, 2);
+            } else {
+                emit_declaration(gen);
+            }
+            return;
+
+        default: {
+            int roll = random_below(gen, 100);
+            if (roll < 25) emit_declaration(gen);
+            else if (roll < 60 || depth == 0) emit_assignment(gen);
+            else emit_compound(gen, random_compound(gen), depth - 1, 1 + random_below(gen, 3));
+            return;
+        }
+    }
+}
+
+char* generate_program(const GeneratorOptions* options, size_t* length) {
+    char* buffer = NULL;
+    size_t size = 0;
+    Generator gen;
+    memset(&gen, 0, sizeof(gen));
+    gen.options = options;
+    gen.state = options->seed ? options->seed : 1;
+    gen.out = open_memstream(&buffer, &size);
+    if (!gen.out) return NULL;
+
+    // A few variables up front so every statement has something to read
+    for (int i = 0; i < 4; i++) emit_declaration(&gen);
+
+    int depth = 3;
+    if (options->shape == SHAPE_DEEP_NESTING) depth = options->depth;
+    else if (options->shape == SHAPE_MANY_SCOPES) depth = 1;
+
+    for (int i = 0; i < options->statements && !gen.failed; i++) {
+        emit_statement(&gen, depth);
+    }
+
+    int failed = gen.failed || ferror(gen.out);
+    fclose(gen.out);
+    free(gen.visible);
+    if (failed) {
+        free(buffer);
+        return NULL;
+    }
+    if (length) *length = size;
+    return buffer;
+}
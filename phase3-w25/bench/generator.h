@@ -0,0 +1,42 @@
+/* generator.h */
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stddef.h>
+
+// Synthetic program generator for the benchmarks
+// Programs follow documentation/CFG_rules.txt and always pass lexing, parsing
+// and semantic checking: every variable has a unique name, is an int (a float
+// for SHAPE_FLOAT_LITERALS), and is declared and assigned before it is read.
+
+typedef enum {
+    SHAPE_MIXED,                // a bit of every statement kind
+    SHAPE_DEEP_NESTING,         // if/while/repeat nested `depth` levels deep
+    SHAPE_LONG_EXPRESSIONS,     // assignments with `width` terms
+    SHAPE_MANY_SCOPES,          // lots of small scopes, each declaring variables
+    SHAPE_IDENTIFIER_HEAVY,     // long names, expressions made of identifiers only
+    SHAPE_COMMENT_HEAVY,        // line and block comments around every statement
+    SHAPE_FLOAT_LITERALS,       // float variables, terms are mostly float literals
+    SHAPE_COUNT
+} GeneratorShape;
+
+typedef struct {
+    GeneratorShape shape;
+    int statements;             // top-level statements to emit
+    int depth;                  // nesting depth for SHAPE_DEEP_NESTING
+    int width;                  // terms per expression for SHAPE_LONG_EXPRESSIONS
+    unsigned int seed;          // same seed, same program
+} GeneratorOptions;
+
+// Defaults for everything but the shape
+void generator_default_options(GeneratorOptions* options, GeneratorShape shape);
+
+const char* generator_shape_name(GeneratorShape shape);
+// Returns SHAPE_COUNT for an unknown name
+GeneratorShape generator_shape_from_name(const char* name);
+
+// Generate a program. The caller frees the returned string.
+// Returns NULL when memory runs out.
+char* generate_program(const GeneratorOptions* options, size_t* length);
+
+#endif /* GENERATOR_H */
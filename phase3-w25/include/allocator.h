@@ -0,0 +1,66 @@
+/* allocator.h */
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Pluggable memory allocation
+// Every subsystem allocates through mem_alloc()/mem_free() and friends, tagged
+// with the subsystem the memory belongs to. The default allocator forwards to
+// malloc/free; the tracking allocator also keeps per-subsystem counts.
+// Every byte requested is also charged to the thread's active budget, if
+// any (see budget.h).
+
+typedef enum {
+    MEM_SOURCE,         // input buffers
+    MEM_AST,            // parser and optimizer nodes
+    MEM_SYMBOLS,        // symbol tables
+    MEM_DATAFLOW,       // definite-assignment analysis
+    MEM_OPTIMIZER,      // optimizer work lists
+    MEM_RUNTIME,        // big integers and the factorial cache
+    MEM_DIAGNOSTICS,    // recorded diagnostics
+    MEM_SERVER,         // protocol messages
+    MEM_BYTECODE,       // compiled programs and the VM's stack and globals
+    MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+typedef struct {
+    // Same contracts as malloc, realloc and free
+    void* (*allocate)(void* context, MemSubsystem subsystem, size_t size);
+    void* (*reallocate)(void* context, MemSubsystem subsystem, void* pointer, size_t size);
+    void (*release)(void* context, MemSubsystem subsystem, void* pointer);
+    void* context;
+} Allocator;
+
+typedef struct {
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t live_blocks;
+    size_t allocations;         // successful allocate/reallocate calls
+} MemUsage;
+
+// Install an allocator for every subsystem. Only call this before anything
+// has been allocated: memory must be freed by the allocator that made it.
+// NULL restores the default.
+void mem_set_allocator(const Allocator* allocator);
+
+void* mem_alloc(MemSubsystem subsystem, size_t size);
+void* mem_calloc(MemSubsystem subsystem, size_t count, size_t size);
+void* mem_realloc(MemSubsystem subsystem, void* pointer, size_t size);
+void mem_free(MemSubsystem subsystem, void* pointer);
+
+// Tracking allocator. Counters are updated atomically, so it can be shared by
+// worker threads.
+const Allocator* mem_tracking_allocator(void);
+// Usage of one subsystem so far; all zeros unless the tracking allocator is in use
+MemUsage mem_usage(MemSubsystem subsystem);
+// Peak of the total across all subsystems
+size_t mem_total_peak(void);
+
+// Per-subsystem live, peak and allocation counts
+void mem_report(FILE* out);
+// Subsystems that still have live blocks; returns the number of leaked blocks
+size_t mem_leak_report(FILE* out);
+
+#endif /* ALLOCATOR_H */
@@ -0,0 +1,78 @@
+/* analysis.h */
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "parser.h"
+#include "diagnostics.h"
+#include "line_index.h"
+#include "budget.h"
+#include "worker_pool.h"
+
+// Analyzing one input
+// The driver, the server and watch mode take every input through the same
+// steps: a diagnostics session with a line index, a budget, parsing into the
+// interned string pool (and the node table, with sharing), then the semantic
+// pass on the configured number of threads. Parsing and checking are each a
+// trace span and a stats phase.
+//
+// An Analyzer is what those steps need across inputs: its pool, table and
+// worker threads live until analyzer_free(), so a long-lived caller keeps
+// them warm. An Analysis is one input's session and budget.
+
+typedef struct {
+    int jobs;               // threads the semantic pass runs on, see parallel.h
+    int hash_consing;       // share closed expressions while parsing, see parser.h
+    int print_symbols;      // dump each checked program's symbol table to stdout
+    BudgetLimits limits;    // each input's, see budget.h
+} AnalysisOptions;
+
+// One job, no sharing, no symbol table dump, and only the depth limited, to
+// BUDGET_DEFAULT_MAX_DEPTH
+void analysis_default_options(AnalysisOptions* options);
+
+typedef struct {
+    AnalysisOptions options;
+    StringPool strings;     // literals of the inputs parsed since the last reset
+    NodeTable nodes;        // their shared expressions, with hash_consing
+    WorkerPool* workers;    // jobs - 1 threads; NULL checks serially
+} Analyzer;
+
+// NULL `options` are the defaults
+void analyzer_init(Analyzer* analyzer, const AnalysisOptions* options);
+// Drop the literals and shared expressions parsed so far. Every tree parsed
+// with them must have been freed.
+void analyzer_reset(Analyzer* analyzer);
+void analyzer_free(Analyzer* analyzer);
+
+typedef struct {
+    const char* name;       // what diagnostics and trace spans refer to
+    DiagnosticSession session;
+    LineIndex lines;        // of the text, once analysis_begin() built it
+    Budget budget;
+    DiagnosticSession* previous_session;
+    Budget* previous_budget;
+} Analysis;
+
+// Make a new session and budget for `text` this thread's. `text` may be
+// NULL, e.g. for an input that is streamed; its diagnostics then have no column.
+void analysis_begin(Analysis* analysis, const Analyzer* analyzer, const char* name, const char* text);
+// Parse `text`. NULL on a syntax error or an exceeded budget, reported to
+// the session. Shared nodes belong to the analyzer, see analyzer_reset().
+ASTNode* analysis_parse(Analysis* analysis, Analyzer* analyzer, const char* text);
+// Check a parsed program with analyze_program(); returns its result
+int analysis_check(Analysis* analysis, Analyzer* analyzer, ASTNode* program);
+// Put back the session and budget that were active before analysis_begin().
+// What was reported stays in `session`.
+void analysis_end(Analysis* analysis);
+// Make the session and budget this thread's again after analysis_end(),
+// e.g. to check on a worker thread what was parsed on another one. Pair
+// with analysis_end() on the same thread.
+void analysis_resume(Analysis* analysis);
+void analysis_free(Analysis* analysis);
+
+// Begin, parse, check and end. Returns 1 if the program parsed and checked;
+// the tree is left in `*program`, NULL if it didn't parse.
+int analyzer_run(Analyzer* analyzer, Analysis* analysis, const char* name, const char* text,
+                 ASTNode** program);
+
+#endif /* ANALYSIS_H */
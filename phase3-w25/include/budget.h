@@ -0,0 +1,74 @@
+/* budget.h */
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <stddef.h>
+
+// Per-input resource limits
+// A Budget caps how much work one input may cause: tokens lexed, syntax tree
+// nodes built, nesting depth, wall time and bytes allocated. The lexer,
+// parser and semantic loops charge the active budget at cheap checkpoints.
+// Once a limit is exceeded it is reported once, as a DIAG_PHASE_LIMIT
+// diagnostic, and every later checkpoint fails: the parser gives up on the
+// input (freeing the partial tree) and the semantic pass stops checking, so
+// a batch can move on to the next input.
+//
+// Each thread has its own active budget; with none, nothing is limited.
+// Worker threads of a parallel semantic check don't charge the caller's.
+
+typedef enum {
+    BUDGET_NONE,
+    BUDGET_TOKENS,
+    BUDGET_NODES,
+    BUDGET_DEPTH,           // statements, parentheses and operator chains inside one another
+    BUDGET_TIME,
+    BUDGET_BYTES            // allocated through mem_alloc() and friends, never credited back
+} BudgetLimit;
+
+// The analyzer's depth limit unless --max-depth says otherwise. Checking,
+// optimizing and compiling recurse once per level, so a much deeper input
+// would overflow the stack before its limit could be reported.
+#define BUDGET_DEFAULT_MAX_DEPTH 10000
+
+// 0 means unlimited
+typedef struct {
+    long max_tokens;
+    long max_nodes;
+    int max_depth;
+    long max_milliseconds;
+    size_t max_bytes;
+} BudgetLimits;
+
+typedef struct {
+    BudgetLimits limits;
+    long tokens;
+    long nodes;
+    int depth;
+    size_t bytes;
+    double deadline;        // CLOCK_MONOTONIC milliseconds, 0 without a time limit
+    unsigned ticks;         // checkpoints since the clock was last read
+    BudgetLimit exceeded;   // first limit exceeded, BUDGET_NONE while within all
+    int reported;
+} Budget;
+
+// Start counting from zero; the time limit runs from here
+void budget_init(Budget* budget, const BudgetLimits* limits);
+
+// Make `budget` the one this thread charges. Returns the previously active
+// one, to be restored with budget_end().
+Budget* budget_begin(Budget* budget);
+void budget_end(Budget* previous);
+Budget* budget_active(void);
+
+// Checkpoints. Each returns 1 while the active budget holds and 0 once any
+// limit has been exceeded, reporting it at `line` the first time.
+int budget_token(int line);
+int budget_node(int line);
+int budget_enter(int line);     // one level deeper; pair with budget_leave()
+void budget_leave(void);
+int budget_check(int line);     // only time and bytes
+
+// Called by the allocator; the next checkpoint notices the limit
+void budget_charge_bytes(size_t size);
+
+#endif /* BUDGET_H */
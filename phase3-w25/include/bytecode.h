@@ -0,0 +1,143 @@
+/* bytecode.h */
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "parser.h"
+#include "string_pool.h"
+
+// Compiled programs
+// A program that passed semantic analysis can be compiled once into an
+// artifact and then run any number of times without lexing, parsing or
+// checking it again. The artifact is a header followed by four sections,
+// each starting at a multiple of 8 bytes so a mapped file can be used in place:
+//
+//   constants   8-byte values: ints (and char codes) as int64, floats as double
+//   strings     the string pool's data block, literals NUL-terminated
+//   code        fixed-size instructions for a stack machine
+//   lines       (instruction, source line) pairs, sorted, for runtime errors
+//
+// Everything is little-endian; a big-endian host refuses to write or load
+// it. The loader checks the whole file up front: section bounds, every
+// operand, and the stack depth at every instruction. Running it then needs
+// no checks beyond the language's own runtime errors.
+//
+// Every variable gets a global slot, numbered by symbol id; a declaration
+// doesn't reset it and slots start out zero. A file can't declare more
+// slots than its loads and stores reach. char values are character
+// codes, a string literal's being its first byte, but `print "text";`
+// prints the whole literal. `factorial(n);` prints n! exactly.
+
+#define BYTECODE_MAGIC 0x43424e41u     // "ANBC"
+#define BYTECODE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t global_count;          // one past the highest variable the code uses
+    uint32_t max_stack;             // deepest the operand stack gets
+    uint32_t constant_count;
+    uint32_t string_bytes;
+    uint32_t code_count;            // instructions
+    uint32_t line_count;
+    uint32_t constants_offset;      // from the start of the file
+    uint32_t strings_offset;
+    uint32_t code_offset;
+    uint32_t lines_offset;
+} BytecodeHeader;
+
+typedef enum {
+    OP_HALT,
+    OP_CONST,               // push constants[arg]
+    OP_LOAD,                // push globals[arg]
+    OP_STORE,               // pop into globals[arg]
+    OP_INT_TO_FLOAT,        // convert the top of the stack
+    OP_ADD_INT,
+    OP_SUB_INT,
+    OP_MUL_INT,
+    OP_DIV_INT,
+    OP_ADD_FLOAT,
+    OP_SUB_FLOAT,
+    OP_MUL_FLOAT,
+    OP_DIV_FLOAT,
+    OP_COMPARE_INT,         // pop two, push 0 or 1; arg is a BytecodeComparison
+    OP_COMPARE_FLOAT,
+    OP_JUMP,                // to instruction arg
+    OP_JUMP_IF_FALSE,       // pop; jump if it was 0
+    OP_PRINT_INT,
+    OP_PRINT_FLOAT,
+    OP_PRINT_CHAR,
+    OP_PRINT_STRING,        // the literal at strings + arg
+    OP_FACTORIAL,           // pop n, print n!
+    OP_COUNT
+} BytecodeOp;
+
+typedef enum {
+    COMPARE_LESS,
+    COMPARE_GREATER,
+    COMPARE_LESS_EQUAL,
+    COMPARE_GREATER_EQUAL,
+    COMPARE_EQUAL,
+    COMPARE_NOT_EQUAL,
+    COMPARE_COUNT
+} BytecodeComparison;
+
+typedef struct {
+    uint32_t op;
+    int32_t arg;
+} Instruction;
+
+typedef struct {
+    uint32_t pc;            // first instruction of a statement
+    uint32_t line;
+} LineEntry;
+
+typedef union {
+    int64_t i;
+    double f;
+} Value;
+
+// How many values `op` pops off the operand stack and pushes back
+void bytecode_op_effect(BytecodeOp op, int* pops, int* pushes);
+
+// A whole artifact in memory
+typedef struct {
+    unsigned char* data;
+    size_t size;
+} BytecodeImage;
+
+// Compile a program that passed semantic analysis, optimized or not.
+// `strings` is the pool its literals were interned into while parsing, or
+// NULL. Returns 0 if a node wasn't annotated by the analysis or memory runs out.
+int bytecode_compile(ASTNode* program, const StringPool* strings, BytecodeImage* image);
+int bytecode_write_file(const BytecodeImage* image, const char* path);
+void bytecode_image_free(BytecodeImage* image);
+
+// A loaded artifact. The sections point into the file's mapping.
+typedef struct {
+    const BytecodeHeader* header;
+    const Value* constants;
+    const char* strings;
+    const Instruction* code;
+    const LineEntry* lines;
+    void* mapping;          // NULL when loaded from memory the caller owns
+    size_t mapping_size;
+} BytecodeProgram;
+
+// Validate an artifact in `data`, which must stay alive, unchanged and
+// 8-byte aligned while the program is used. On failure returns 0 and points
+// *error at a description.
+int bytecode_load_memory(BytecodeProgram* program, const void* data, size_t size, const char** error);
+// Same, for a file, which is mapped rather than read
+int bytecode_load_file(BytecodeProgram* program, const char* path, const char** error);
+void bytecode_unload(BytecodeProgram* program);
+
+// Run a loaded program, printing to `out`. Returns 1 if it ran to the end, 0
+// after a runtime error, which is reported through the active diagnostics
+// session at the line the failing statement started on.
+int bytecode_run(const BytecodeProgram* program, FILE* out);
+
+#endif /* BYTECODE_H */
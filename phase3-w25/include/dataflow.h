@@ -0,0 +1,18 @@
+/* dataflow.h */
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include "parser.h"
+
+// Flow-sensitive definite-assignment analysis
+// Builds a control-flow graph of basic blocks over the program and solves a
+// forward "must be assigned" problem with one bit per variable per block.
+// Every read of a variable that is not assigned on all paths reaching it is
+// reported as SEM_ERROR_UNINITIALIZED_VARIABLE.
+// Relies on the symbol_id annotations, so run it after check_program().
+// Returns the number of uninitialized uses reported, or -1 if it gave up
+// without reporting any: when memory runs out (reported as
+// SEM_ERROR_OUT_OF_MEMORY) or the active budget's time or bytes run out.
+int check_definite_assignment(ASTNode* program);
+
+#endif /* DATAFLOW_H */
@@ -0,0 +1,77 @@
+/* diagnostics.h */
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdio.h>
+#include "line_index.h"
+
+typedef enum {
+    DIAG_ERROR,
+    DIAG_WARNING
+} DiagnosticSeverity;
+
+// Which enum `code` belongs to
+typedef enum {
+    DIAG_PHASE_LEXICAL,     // ErrorType
+    DIAG_PHASE_PARSE,       // ParseError
+    DIAG_PHASE_SEMANTIC,    // SemanticErrorType
+    DIAG_PHASE_RUNTIME,     // RuntimeError
+    DIAG_PHASE_LIMIT        // BudgetLimit
+} DiagnosticPhase;
+
+typedef enum {
+    DIAG_FORMAT_TEXT,
+    DIAG_FORMAT_JSON
+} DiagnosticFormat;
+
+// One recorded diagnostic. Nothing is formatted when it is recorded; the
+// message text is only built when the session is written out.
+typedef struct {
+    DiagnosticSeverity severity;
+    DiagnosticPhase phase;
+    int code;
+    const char* file;       // not owned, must outlive the session
+    int line;
+    int column;             // 0 when unknown
+    int offset;             // in the input, -1 when unknown
+    char arg[256];          // the name/lexeme the message refers to
+} Diagnostic;
+
+typedef struct {
+    Diagnostic* items;
+    int count;
+    int capacity;
+    const char* file;       // attributed to diagnostics recorded from now on
+    const LineIndex* lines; // if set, locates diagnostics that have an offset
+    int enabled;            // when 0, diagnostics are only counted
+    int error_count;
+    int warning_count;
+} DiagnosticSession;
+
+// Set up an empty, enabled session. `file` may be NULL.
+void diag_session_init(DiagnosticSession* session, const char* file);
+void diag_session_free(DiagnosticSession* session);
+
+// Make `session` the one this thread reports into. Returns the previously
+// active session so nested users can restore it with diag_end().
+// With no active session, diagnostics are printed immediately as text.
+DiagnosticSession* diag_begin(DiagnosticSession* session);
+void diag_end(DiagnosticSession* previous);
+DiagnosticSession* diag_active(void);
+
+// Record a diagnostic in the active session
+void diag_report(DiagnosticPhase phase, int code, DiagnosticSeverity severity,
+                 int line, int column, const char* arg);
+// Same, at an input offset. Line and column are looked up in the session's
+// line index when the diagnostic is written; without one, `line` is used.
+void diag_report_at(DiagnosticPhase phase, int code, DiagnosticSeverity severity,
+                    int line, int offset, const char* arg);
+
+// Write every recorded diagnostic in one go
+void diag_write(const DiagnosticSession* session, DiagnosticFormat format, FILE* out);
+
+// Message text for a diagnostic, without the "<Phase> Error at line N: " or
+// "<Phase> Warning at line N: " prefix
+void diag_format_message(const Diagnostic* diagnostic, char* buffer, size_t size);
+
+#endif /* DIAGNOSTICS_H */
@@ -0,0 +1,16 @@
+/* float_literal.h */
+#ifndef FLOAT_LITERAL_H
+#define FLOAT_LITERAL_H
+
+// Decimal to binary conversion for float literals
+// `text` is a literal as the lexer accepts it: digits, then an optional '.'
+// and digits, then an optional exponent ('e' or 'E', a sign, digits). The
+// result is the nearest double, ties to even, as strtod() would give, but
+// computed with the Eisel-Lemire algorithm: one or two 64x128-bit multiplies
+// against a table of powers of five instead of big-number arithmetic.
+//
+// Returns 0, and sets the value to infinity, if the literal is too large to
+// be a finite double.
+int parse_float_literal(const char* text, double* value);
+
+#endif /* FLOAT_LITERAL_H */
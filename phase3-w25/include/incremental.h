@@ -0,0 +1,52 @@
+/* incremental.h */
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "parser.h"
+#include "semantic.h"
+#include "diagnostics.h"
+
+// Incremental semantic checking of a ParseTree
+// Every top-level statement is checked on its own, starting from a checkpoint:
+// the symbol table as the statements before it left it. Checkpoints are
+// snapshots of the persistent table, so they cost O(1) to keep.
+//
+// While a statement is checked, the names it looks up are recorded. After an
+// edit, the statements the parser replaced are checked, and so are reused
+// statements that look up a name whose declarations changed earlier in the
+// program. Every other statement keeps its symbols, annotations and
+// diagnostics from the previous run.
+
+typedef struct {
+    unsigned id;                // StatementSpan.id of the statement
+    Symbol* declared;           // newest symbol it declared, NULL if none
+    Symbol* oldest;             // oldest one; its `next` is the checkpoint's head
+    SymbolTable from;           // snapshot of the checkpoint it was checked from
+    SymbolTable after;          // snapshot once the statement is checked
+    SymbolMapNode* assigned;    // ids its assignments initialized
+    unsigned* reads;            // hashes of the names it looked up, sorted
+    int read_count;
+    Diagnostic* diagnostics;    // what checking it reported
+    int diagnostic_count;
+    int end_line;               // span end line and offset when they were recorded
+    int end;
+    int result;                 // check_statement() result
+} CheckedStatement;
+
+typedef struct {
+    SymbolTable table;          // state after the whole program; owns every symbol
+    CheckedStatement* statements;
+    int count;
+    int capacity;
+    int checked;                // statements checked by the last update
+} SemanticCache;
+
+void semantic_cache_init(SemanticCache* cache);
+// Bring the cache up to date with `tree` and replay every statement's
+// diagnostics into the active session, in program order. Returns 1 if the
+// whole program checks, like check_program(). Symbol ids are never reused,
+// so the annotations stay valid for check_definite_assignment().
+int semantic_cache_update(SemanticCache* cache, ParseTree* tree);
+void semantic_cache_free(SemanticCache* cache);
+
+#endif /* INCREMENTAL_H */
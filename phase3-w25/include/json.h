@@ -0,0 +1,44 @@
+/* json.h */
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Small JSON reader/writer for the server protocol
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JsonType;
+
+typedef struct JsonValue {
+    JsonType type;
+    int boolean;
+    double number;
+    char* string;               // JSON_STRING, NUL-terminated (may contain \u0000 as 0)
+    size_t length;              // JSON_STRING byte length
+    struct JsonValue* items;    // JSON_ARRAY elements, JSON_OBJECT member values
+    char** keys;                // JSON_OBJECT member names
+    int count;
+} JsonValue;
+
+// Parse one JSON document. Returns NULL on a syntax error, trailing garbage or
+// when memory runs out.
+JsonValue* json_parse(const char* text, size_t length);
+void json_free(JsonValue* value);
+
+// Member of an object, or NULL if absent (or `object` isn't an object)
+const JsonValue* json_get(const JsonValue* object, const char* key);
+// The string of a JSON_STRING member, or NULL
+const char* json_get_string(const JsonValue* object, const char* key);
+
+void json_write_string(const char* text, FILE* out);
+// Scalars only; arrays and objects are written as null
+void json_write_scalar(const JsonValue* value, FILE* out);
+
+#endif /* JSON_H */
@@ -2,11 +2,92 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stddef.h>
 #include "tokens.h"
 
+// What the lexer is in the middle of between two calls. At a token boundary
+// of a complete input it is always LEX_MODE_CODE; an input that ends inside a
+// comment leaves one of the comment modes, and the next input continues it.
+typedef enum {
+    LEX_MODE_CODE,
+    LEX_MODE_BLOCK_COMMENT,
+    LEX_MODE_LINE_COMMENT
+} LexerMode;
+
+typedef struct {
+    int line;
+    LexerMode mode;
+} LexerState;
+
 // Lexer functions that need to be visible to other files
 Token get_next_token(const char* input, int* pos);
 void print_token(Token token);
+// Upper-case name of a token type, as print_token() shows it
+const char* token_type_name(TokenType type);
 void print_error(ErrorType error, int line, const char* lexeme);
+// Start line numbering from 1 again, before lexing a new input
+void lexer_reset(void);
+// Same, but continue numbering from `line` (for lexing from the middle of an input)
+void lexer_set_line(int line);
+// Snapshot of everything get_next_token() carries between calls. Restoring a
+// snapshot taken at a token boundary lets lexing resume from that offset.
+LexerState lexer_save_state(void);
+void lexer_restore_state(LexerState state);
+
+// Incremental relexing
+// A TokenList owns its source text and keeps every token's span together with
+// the lexer state right after it. An edit is relexed from the end of the last
+// token before it, and stops as soon as a new token ends where an old one
+// ended past the edit, in the same mode: from there on the old tokens are
+// still right, only moved.
+
+typedef struct {
+    TokenType type;
+    ErrorType error;
+    int start;              // offset of the first character
+    int end;                // offset just past the last one
+    int line;               // line the token starts on
+    LexerState after;       // state once the token has been scanned
+} LexedToken;
+
+typedef struct {
+    char* source;           // owned, NUL-terminated
+    int length;
+    LexedToken* tokens;     // in order, without the EOF token
+    int count;
+    int capacity;
+} TokenList;
+
+// Returns 0 when memory runs out
+int token_list_init(TokenList* list, const char* text);
+// Replace `removed` bytes at `offset` with `inserted`. Returns the number of
+// tokens scanned, or -1 on a bad range or out of memory (list unchanged).
+int token_list_edit(TokenList* list, int offset, int removed, const char* inserted);
+void token_list_free(TokenList* list);
+
+// Streaming input
+// Lexes a file descriptor through a fixed-size buffer, so inputs of any size
+// take constant memory. A token that runs into the end of the buffer is
+// scanned again once more input has been read; comments left open carry over
+// as the lexer mode. The input must not contain NUL bytes.
+
+typedef struct {
+    int fd;                 // not owned
+    char* buffer;           // NUL-terminated window of the input
+    int capacity;
+    int length;             // bytes in the window
+    int pos;                // where the next token is scanned from
+    long long base;         // input offset of buffer[0]
+    LexerState state;       // this stream's lexer state between calls
+    int at_eof;
+    int read_error;         // reading failed; treated as the end of input
+} LexerStream;
+
+// `chunk_size` bytes are read at a time (at least 1024). Returns 0 when
+// memory runs out.
+int lexer_stream_open(LexerStream* stream, int fd, int chunk_size);
+// Next token, TOKEN_EOF at the end of the input
+Token lexer_stream_next(LexerStream* stream);
+void lexer_stream_close(LexerStream* stream);
 
 #endif /* LEXER_H */
\ No newline at end of file
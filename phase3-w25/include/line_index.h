@@ -0,0 +1,22 @@
+/* line_index.h */
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+// Offsets of every line start in a source text, so that an offset can be
+// turned into a line and column by binary search. Building it is a single
+// memchr() scan for newlines; positions are only looked up for the few
+// offsets that end up in a diagnostic.
+
+typedef struct {
+    int* starts;        // starts[i] is the offset of line i + 1
+    int count;
+    int length;         // length of the indexed text
+} LineIndex;
+
+// Returns 0 when memory runs out
+int line_index_build(LineIndex* index, const char* text, int length);
+// 1-based line and column of `offset`; offsets past the end clamp to it
+void line_index_position(const LineIndex* index, int offset, int* line, int* column);
+void line_index_free(LineIndex* index);
+
+#endif /* LINE_INDEX_H */
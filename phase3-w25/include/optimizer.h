@@ -0,0 +1,25 @@
+/* optimizer.h */
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "parser.h"
+
+// Prefix for compiler-generated temporaries. '$' can never start an
+// identifier in the source language, so these never clash with user names.
+#define LICM_TEMP_PREFIX "$licm"
+
+// Loop-invariant code motion
+// Finds expressions inside while and repeat-until loops whose operands are
+// never assigned (or declared) anywhere in the loop, and hoists each one into
+// a temporary that is declared and computed in a preheader just before the loop.
+// A while loop is rotated into "if (cond) { preheader; repeat ... }", so the
+// preheader only runs when the body runs at least once. An expression that could raise a
+// runtime error (int overflow, division by zero) only moves from the start
+// of the body, before anything else that could fail or print; anything
+// later in the body, or in a nested if or loop, stays put.
+// Run after semantic analysis has accepted the program. Temporaries get
+// symbol ids past the program's own, so the result can be compiled.
+// Returns the number of expressions hoisted.
+int optimize_loops(ASTNode* program);
+
+#endif /* OPTIMIZER_H */
@@ -0,0 +1,32 @@
+/* parallel.h */
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "parser.h"
+#include "semantic.h"
+#include "worker_pool.h"
+
+// Parallel semantic checking of top-level statements
+// A sequential pass walks the program in order. Simple statements are checked
+// as it goes. For if, while and repeat statements it only adds the symbols
+// checking them would declare, typing the conditions that decide whether a
+// body is reached, and takes an O(1) snapshot of the table in front of them.
+// Worker threads then check those statements against their snapshots,
+// declaring into private symbols with the same ids. What they assigned is
+// merged back into the table, and every statement's diagnostics are replayed
+// in program order.
+//
+// Two kinds of statements stay in the sequential pass: ones containing
+// hash-consed expressions, whose one annotation every use would write from
+// different threads, and everything from a top-level bare block on, since the parser
+// links a bare block's body into the rest of the program.
+
+// Same contract as check_program(): the diagnostics, annotations, symbol ids
+// and final table all match a serial run. `jobs` includes the calling thread;
+// the other threads are started for the call and joined before it returns.
+int check_program_parallel(ASTNode* ast, SymbolTable* table, int jobs);
+// Same, on the calling thread and the threads of `workers`, which stay up
+// for the next program. NULL checks serially.
+int check_program_pooled(ASTNode* ast, SymbolTable* table, WorkerPool* workers);
+
+#endif /* PARALLEL_H */
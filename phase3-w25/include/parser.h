@@ -3,6 +3,8 @@
 #define PARSER_H
 
 #include "tokens.h"
+#include "lexer.h"
+#include "string_pool.h"
 
 // Basic node types for AST
 typedef enum {
@@ -44,6 +46,9 @@ typedef enum {
     PARSE_ERROR_INVALID_COMPARISON,
 } ParseError;
 
+// value_type of a node the semantic pass hasn't typed (yet)
+#define TYPE_UNANNOTATED (-2)
+
 // AST Node structure
 typedef struct ASTNode {
     ASTNodeType type;           // Type of node
@@ -53,12 +58,93 @@ typedef struct ASTNode {
     // TODO: Add more fields if needed
     struct ASTNode* operand; // For unary operations (e.g., -x, !x)
     struct ASTNode* next;  // For linked structures (e.g., statement lists, argument lists)
+    // Annotations filled in once by semantic analysis
+    int value_type;          // Expression type (TOKEN_INT, TOKEN_CHAR, ...), -1 on error
+    int symbol_id;           // Identifiers/declarations: id of the resolved Symbol, -1 if none
+    int string_id;           // AST_STRING: id in the parser's string pool, -1 if none
+    int shared;              // hash-consed: owned by a NodeTable, maybe by several parents
 } ASTNode;
 
 // Parser functions
 void parser_init(const char* input);
+// NULL after a syntax error or an exceeded budget (see budget.h), both
+// reported to the diagnostics session; what was parsed so far is freed
 ASTNode* parse(void);
 void print_ast(ASTNode* node, int level);
 void free_ast(ASTNode* node);
+// Syntax-check a stream without keeping the tree: each top-level statement
+// is freed once parsed. Returns the number of statements, or -1 after a
+// syntax error (reported to the diagnostics session).
+long parse_stream(LexerStream* stream);
+
+// Incremental parsing
+// A ParseTree owns its source text and remembers where each top-level
+// statement ends. An edit re-lexes from the end of the last statement before
+// it and reparses statements until the new parse lines up again with an old
+// statement boundary past the edit. Everything else is reused. Line numbers
+// and offsets of reused statements are corrected lazily, by parse_tree_program().
+
+typedef struct {
+    ASTNode* node;          // the statement, in the program's `next` chain
+    unsigned id;            // unique within the tree; kept while the statement is reused
+    int end;                // offset just past the statement's last token
+    int end_line;           // line of that token
+    int line_shift;         // still to be added to the lines inside `node`
+    int offset_shift;       // and to the token offsets
+} StatementSpan;
+
+typedef struct {
+    ASTNode* program;       // use parse_tree_program() to read it
+    char* source;           // owned, NUL-terminated
+    int length;
+    StatementSpan* spans;   // one per top-level statement, in order
+    int count;
+    int capacity;
+    unsigned next_id;       // id of the next statement parsed
+    StringPool strings;     // literals of every statement parsed so far
+} ParseTree;
+
+// Parse `text` from scratch. Returns 0 on a syntax error (reported to the
+// diagnostics session) or when memory runs out.
+int parse_tree_init(ParseTree* tree, const char* text);
+// Replace `removed` bytes at `offset` with `inserted` and reparse what the
+// edit can affect. Returns the number of statements parsed, or -1 on a syntax
+// error or a bad range, in which case the tree (and its text) is unchanged.
+int parse_tree_edit(ParseTree* tree, int offset, int removed, const char* inserted);
+// The program with every line number up to date
+ASTNode* parse_tree_program(ParseTree* tree);
+void parse_tree_free(ParseTree* tree);
+
+// Hash-consing
+// While a NodeTable is set, the parser builds each distinct closed expression
+// only once: literals, and operators over closed operands. Every later copy
+// is the same node, so the tree becomes a DAG. Closed expressions mean the
+// same thing wherever they appear, which is why the semantic pass can keep
+// its one annotation per node; anything naming a variable depends on the
+// scope it sits in and is never shared. A shared node keeps the position of
+// its first occurrence; an error inside one is reported at every use, at the
+// innermost unshared node (operator or statement) that use belongs to.
+// Shared nodes belong to the table: free_ast() skips them, and the table
+// must outlive every tree parsed with it. A ParseTree never shares nodes.
+
+typedef struct {
+    ASTNode** slots;        // open addressing, NULL when empty
+    int slot_count;         // a power of two, at least twice `count`
+    int count;              // distinct shared nodes
+    long reused;            // nodes not allocated because an equal one existed
+} NodeTable;
+
+void node_table_init(NodeTable* table);
+// Memory the reuses saved
+size_t node_table_bytes_saved(const NodeTable* table);
+// Frees every shared node
+void node_table_free(NodeTable* table);
+// NULL (the default) turns hash-consing off
+void parser_set_node_table(NodeTable* table);
+
+// Pool that string literals are interned into while parsing; AST_STRING nodes
+// record their id in it. NULL (the default) leaves string_id at -1. A
+// ParseTree always uses its own pool.
+void parser_set_string_pool(StringPool* pool);
 
 #endif /* PARSER_H */
\ No newline at end of file
@@ -0,0 +1,52 @@
+/* runtime.h */
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stdint.h>
+
+// Support routines shared by the execution backends
+
+typedef enum {
+    RUNTIME_OK,
+    RUNTIME_ERROR_NEGATIVE_ARGUMENT,   // e.g. factorial(0 - 1)
+    RUNTIME_ERROR_INT_OVERFLOW,        // result doesn't fit the declared int type
+    RUNTIME_ERROR_OUT_OF_MEMORY,
+    RUNTIME_ERROR_DIVISION_BY_ZERO     // integer division by 0
+} RuntimeError;
+
+// Arbitrary-precision unsigned integer, little-endian base 2^32 limbs.
+// count == 0 represents zero.
+typedef struct {
+    uint32_t* limbs;
+    int count;
+} BigInt;
+
+// Largest n whose factorial is in the precomputed 64-bit table
+#define FACTORIAL_TABLE_MAX 20
+
+// Factorial for the language's int type.
+// Returns RUNTIME_ERROR_INT_OVERFLOW instead of wrapping when n! > INT_MAX
+// (n > 12), leaving *result untouched.
+RuntimeError runtime_factorial_int(int n, int* result);
+
+// Exact n! for 0 <= n <= FACTORIAL_TABLE_MAX, straight from the table
+uint64_t runtime_factorial_u64(int n);
+
+// Exact n! for any n >= 0. Small values come from the table; larger ones are
+// built by binary-splitting multiplication, starting from the closest smaller
+// cached factorial. Results are cached and owned by the runtime: don't free
+// them, and copy or print them before the next call (which may evict them).
+// Returns NULL for a negative n or when memory runs out.
+const BigInt* runtime_factorial_big(int n);
+
+// Release every cached factorial
+void runtime_free_factorial_cache(void);
+
+// Decimal representation of a BigInt; the caller frees the string
+char* bigint_to_string(const BigInt* value);
+void bigint_free(BigInt* value);
+
+// Report runtime errors
+void runtime_error(RuntimeError error, int line);
+
+#endif /* RUNTIME_H */
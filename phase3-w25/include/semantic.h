@@ -4,19 +4,28 @@
 
 #include "tokens.h"
 #include "parser.h"
+#include "symbol_map.h"
+#include "worker_pool.h"
 
 typedef struct Symbol {
+    int id;                 // Unique per table, recorded in ASTNode.symbol_id
     char name[100];
     int type;
     int scope_level;
     int line_declared;
-    int is_initialized;
     struct Symbol* next;
 } Symbol;
 
+// Checking never changes a declared symbol, and symbols are only ever
+// prepended to `head`, so a copy of the struct is a snapshot of the table: see
+// symbol_table_snapshot(). Lookups go through `names`, a persistent map, in
+// O(log n); whether a symbol has been assigned is kept in a second one.
 typedef struct {
-    Symbol* head;
+    Symbol* head;           // every symbol, newest first
+    SymbolMapNode* names;   // name hash -> the symbols with that name, newest first
+    SymbolMapNode* initialized; // symbol ids an assignment has initialized
     int current_scope;
+    int symbol_count;       // Symbols ever added; the next symbol's id
 } SymbolTable;
 
 // Initialize a new symbol table
@@ -26,6 +35,16 @@ SymbolTable* init_symbol_table();
 // Add a symbol to the table
 // Inserts a new variable with given name, type, and line number into the current scope
 void add_symbol(SymbolTable* table, const char* name, int type, int line);
+// Put an already declared symbol back on top of the table, e.g. to rebuild a
+// table from the statements that declared its symbols. Returns 0 if out of memory.
+int push_symbol(SymbolTable* table, Symbol* symbol);
+
+// Take an O(1) snapshot of `table` into `copy`. Adding to either one doesn't
+// show in the other, and both can be read from different threads. The
+// symbols still belong to whoever owns `table`; symbol_table_release() only
+// drops the snapshot's references to the maps.
+void symbol_table_snapshot(SymbolTable* copy, const SymbolTable* table);
+void symbol_table_release(SymbolTable* table);
 
 void remove_symbol(SymbolTable* table, const char* name);
 
@@ -54,11 +73,28 @@ void free_symbol_table(SymbolTable* table);
 int is_initialized(SymbolTable* table, const char* name);
 
 void initialize_symbol(SymbolTable* table, const char* name);   
+// Record that the symbol with id `symbol_id` has been assigned
+void mark_initialized(SymbolTable* table, int symbol_id);
+
 
 
+// Called with every name this thread's checks look up, while set. Lets a
+// caller record which declarations a statement depends on. NULL turns it off.
+typedef void (*SymbolReadHook)(void* context, const char* name);
+void semantic_set_read_hook(SymbolReadHook hook, void* context);
 
 // Main semantic analysis function
+// Besides checking, annotates the AST: every checked expression node gets its
+// value_type, and identifier/declaration nodes get the symbol_id they resolve to.
+// With `workers`, statements are checked on its threads too (see parallel.h);
+// NULL checks serially with check_program(). `print_symbols` dumps the final
+// symbol table to stdout.
+int analyze_program(ASTNode* ast, WorkerPool* workers, int print_symbols);
+// analyze_program() on the calling thread, dumping the symbol table
 int analyze_semantics(ASTNode* ast);
+// Check every statement of a parsed program against `table`, without the
+// flow-sensitive checks or the symbol table dump done by analyze_program()
+int check_program(ASTNode* ast, SymbolTable* table);
 int check_statement(ASTNode* ast, SymbolTable* table);
 int check_declaration(ASTNode* node, SymbolTable* table);
 int check_assignment(ASTNode* node, SymbolTable* table);
@@ -76,9 +112,12 @@ typedef enum {
     SEM_ERROR_SEMANTIC_ERROR,  // Generic semantic error
     SEM_ERROR_INVALID_CONDITION,
     SEM_ERROR_INVALID_PARAMETERS,
+    SEM_ERROR_OUT_OF_MEMORY,   // the analysis of this input was abandoned
 } SemanticErrorType;
 
 // Report semantic errors
 void semantic_error(SemanticErrorType error, const char* name, int line);
+// Same, located at `token` so the diagnostic can also carry a column
+void semantic_error_at(SemanticErrorType error, const char* name, const Token* token);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+/* server.h */
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "analysis.h"
+
+// Long-lived analysis server speaking JSON-RPC 2.0, one request per line.
+//
+//   {"jsonrpc":"2.0","id":1,"method":"analyze","params":{"path":"a.txt"}}
+//   {"jsonrpc":"2.0","id":2,"method":"analyze","params":{"text":"int x;","name":"buf"}}
+//   {"jsonrpc":"2.0","id":3,"method":"shutdown"}
+//
+// "analyze" answers with {"name","success","elapsed_us","diagnostics"}, where
+// "diagnostics" is the document diag_write() produces in JSON format.
+// Requests without an "id" are notifications and get no response.
+//
+// Every input is analyzed like the driver does (see analysis.h), under its
+// own budget, but the symbol table isn't dumped. The string pool, the node
+// table and the worker threads are kept from one request to the next.
+
+// Serve requests from stdin until EOF or "shutdown". NULL `options` are
+// analysis_default_options().
+int server_run_stdio(const AnalysisOptions* options);
+
+// Listen on a Unix domain socket and serve one connection at a time until a
+// "shutdown" request. Returns 0 if the socket can't be set up.
+int server_run_socket(const char* path, const AnalysisOptions* options);
+
+#endif /* SERVER_H */
@@ -0,0 +1,71 @@
+/* stats.h */
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "tokens.h"
+
+// Hot-path instrumentation counters
+// Only compiled in with -DANALYZER_STATS; otherwise every STAT_* macro expands
+// to nothing and the counters cost nothing. Counters are per thread.
+
+typedef enum {
+    STATS_PHASE_LEX,
+    STATS_PHASE_PARSE,          // includes the on-demand lexing
+    STATS_PHASE_SEMANTIC,
+    STATS_PHASE_OPTIMIZE,
+    STATS_PHASE_CODEGEN,        // compiling to bytecode, with --compile
+    STATS_PHASE_COUNT
+} StatsPhase;
+
+typedef enum {
+    STATS_FORMAT_TEXT,
+    STATS_FORMAT_JSON
+} StatsFormat;
+
+typedef struct {
+    unsigned long tokens[TOKEN_ERROR + 1];  // produced, by TokenType
+    unsigned long nodes_created;
+    unsigned long node_bytes;
+    unsigned long nodes_shared;             // not kept, hash-consing found an equal one
+    unsigned long shared_bytes;             // what they would have taken
+    unsigned long symbol_lookups;
+    unsigned long lookup_steps;             // symbols compared across all lookups
+    unsigned long scopes_entered;
+    double phase_seconds[STATS_PHASE_COUNT];
+} AnalyzerStats;
+
+#ifdef ANALYZER_STATS
+
+extern _Thread_local AnalyzerStats analyzer_stats;
+
+double stats_now(void);
+
+#define STAT_TOKEN(type)            (analyzer_stats.tokens[(type)]++)
+#define STAT_ADD(field, amount)     (analyzer_stats.field += (amount))
+// Time a region: STAT_TIMER_START(t); ... STAT_TIMER_STOP(t, STATS_PHASE_PARSE);
+#define STAT_TIMER_START(timer)     double timer = stats_now()
+#define STAT_TIMER_STOP(timer, phase) \
+    (analyzer_stats.phase_seconds[(phase)] += stats_now() - (timer))
+
+#else
+
+#define STAT_TOKEN(type)            ((void)0)
+#define STAT_ADD(field, amount)     ((void)0)
+#define STAT_TIMER_START(timer)
+#define STAT_TIMER_STOP(timer, phase) ((void)0)
+
+#endif /* ANALYZER_STATS */
+
+// 1 if the counters were compiled in
+int stats_enabled(void);
+
+// The calling thread's counters
+AnalyzerStats* stats_current(void);
+void stats_reset(void);
+// Add `from` into `into`, e.g. to total the counters of several workers
+void stats_merge(AnalyzerStats* into, const AnalyzerStats* from);
+
+void stats_write(const AnalyzerStats* stats, StatsFormat format, FILE* out);
+
+#endif /* STATS_H */
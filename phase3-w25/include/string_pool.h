@@ -0,0 +1,34 @@
+/* string_pool.h */
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <stddef.h>
+
+// Interned string literals
+// Every distinct literal is stored once, escapes already resolved by the
+// lexer, and named by a dense id in order of first appearance. The literals
+// sit back to back in `data`, each NUL-terminated, so the block can be
+// emitted as is as a backend's read-only data; offsets[id] is where literal
+// `id` starts in it. Entries are never removed or changed.
+
+typedef struct {
+    char* data;             // every literal, NUL-terminated, in id order
+    size_t size;            // bytes used in `data`
+    size_t data_capacity;
+    size_t* offsets;        // offsets[id] is where literal `id` starts in `data`
+    int* lengths;           // without the NUL
+    int count;
+    int capacity;
+    int* slots;             // open-addressing table of ids, -1 when empty
+    int slot_count;         // a power of two, at least twice `count`
+} StringPool;
+
+void string_pool_init(StringPool* pool);
+// Id of the literal `text` (`length` bytes), adding it if it's new.
+// Returns -1 when memory runs out.
+int string_pool_intern(StringPool* pool, const char* text, int length);
+const char* string_pool_get(const StringPool* pool, int id);
+int string_pool_length(const StringPool* pool, int id);
+void string_pool_free(StringPool* pool);
+
+#endif /* STRING_POOL_H */
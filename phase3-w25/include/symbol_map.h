@@ -0,0 +1,47 @@
+/* symbol_map.h */
+#ifndef SYMBOL_MAP_H
+#define SYMBOL_MAP_H
+
+#include <stdatomic.h>
+
+struct Symbol;
+
+// Persistent map from 32-bit keys to symbols
+// A hash array mapped trie whose nodes never change once built. Adding an
+// entry copies the nodes on the path to it, O(log n) of them, and shares the
+// rest with the version it was added to, which stays valid. A version is
+// just a pointer to its root; NULL is the empty map. Several entries can
+// share a key, newest first.
+//
+// Nodes are reference counted, atomically, so a version can be read, added
+// to and released by several threads at once.
+
+typedef struct SymbolMapNode {
+    atomic_uint refs;
+    unsigned bitmap;                    // branch: occupied slots; 0 for an entry
+    unsigned key;                       // entry: its key
+    struct Symbol* symbol;              // entry: its symbol
+    struct SymbolMapNode* older;        // entry: the previous entry under `key`
+    struct SymbolMapNode* children[];   // branch: one per bit set in `bitmap`
+} SymbolMapNode;
+
+// A new version with `symbol` added under `key`, in front of the entries
+// already there. `map` itself doesn't change. The result holds a reference
+// of its own; NULL if out of memory.
+SymbolMapNode* symbol_map_add(SymbolMapNode* map, unsigned key, struct Symbol* symbol);
+
+// Newest entry under `key`, NULL if none. Older ones follow through `older`.
+const SymbolMapNode* symbol_map_find(const SymbolMapNode* map, unsigned key);
+
+// Take or drop a reference to a version. Both accept NULL.
+SymbolMapNode* symbol_map_retain(SymbolMapNode* map);
+void symbol_map_release(SymbolMapNode* map);
+
+// Call `visit` with every entry of `map` that isn't in `base`, where `map`
+// was made by adding entries to `base`. Subtrees the two share are skipped,
+// so this costs O(k log n) for k added entries.
+typedef void (*SymbolMapVisit)(void* context, const SymbolMapNode* entry);
+void symbol_map_diff(const SymbolMapNode* map, const SymbolMapNode* base,
+                     SymbolMapVisit visit, void* context);
+
+#endif /* SYMBOL_MAP_H */
@@ -0,0 +1,84 @@
+/* token_dump.h */
+#ifndef TOKEN_DUMP_H
+#define TOKEN_DUMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tokens.h"
+
+// Binary token streams
+// Tools that only need tokens (highlighters, metrics) can read a dump instead
+// of lexing the source again. A dump is a header of six little-endian
+// uint32s followed by one record per token, without the EOF token:
+//
+//   header   magic, version, token count, source length,
+//            FNV-1a hash of the source, record bytes
+//   record   four unsigned LEB128 varints:
+//              kind     type | error << 5
+//              gap      bytes from the previous token's end to this one's start
+//              length   bytes the token spans
+//              lines    lines since the previous token's (the first's since line 1)
+//
+// so a typical token takes 4 bytes. Spans are byte offsets into the source
+// the dump was made from; the hash tells a reader whether the text it has
+// is that source. A dump is built in one pass over the input and read in
+// place, from memory or a mapped file. The reader checks the header when it
+// opens a dump and every record as it decodes it.
+
+#define TOKEN_DUMP_MAGIC 0x4b544e41u    // "ANTK"
+#define TOKEN_DUMP_VERSION 1
+#define TOKEN_DUMP_HEADER_SIZE 24
+
+// A dump being built
+typedef struct {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+    uint32_t count;         // tokens so far
+} TokenDump;
+
+// Lex `source` and encode its tokens. Lexical errors are kept in the
+// records, not reported. Returns 0 when memory runs out.
+int token_dump_build(TokenDump* dump, const char* source);
+// Returns 0 if the file can't be written
+int token_dump_write_file(const TokenDump* dump, const char* path);
+void token_dump_free(TokenDump* dump);
+
+// What the header's hash is computed over
+uint32_t token_dump_hash(const char* source, size_t length);
+
+typedef struct {
+    TokenType type;
+    ErrorType error;
+    int start;              // offset of the first character
+    int end;                // offset just past the last one
+    int line;               // line the token starts on
+} DumpedToken;
+
+typedef struct {
+    uint32_t count;
+    uint32_t source_length;
+    uint32_t source_hash;
+    const char* error;      // why the last token_dump_next() failed, NULL if it didn't
+    // Decoding position
+    const unsigned char* at;
+    const unsigned char* end;
+    uint32_t decoded;
+    int offset;             // end of the last token decoded
+    int line;
+    // Set by token_dump_open_file()
+    void* mapping;
+    size_t mapping_size;
+} TokenDumpReader;
+
+// Start reading the dump in `data`, which must stay valid while it's read.
+// Returns 0 if the header is malformed, with `*error` saying why.
+int token_dump_open_memory(TokenDumpReader* reader, const void* data, size_t size, const char** error);
+// Same for a file, mapped read-only
+int token_dump_open_file(TokenDumpReader* reader, const char* path, const char** error);
+// Decode the next token. Returns 0 after the last one, or when the records
+// are malformed; `reader->error` tells the two apart.
+int token_dump_next(TokenDumpReader* reader, DumpedToken* token);
+void token_dump_close(TokenDumpReader* reader);
+
+#endif /* TOKEN_DUMP_H */
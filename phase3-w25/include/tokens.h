@@ -5,7 +5,8 @@
  * TOKEN TYPES
  *--------------------------------------------------------------------*/
 typedef enum {
-    TOKEN_NUMBER,           // e.g., "123", "3.14" (if you add floating point support)
+    TOKEN_NUMBER,           // e.g., "123"
+    TOKEN_FLOAT_LITERAL,    // e.g., "3.14", "1e-9", "2.5E+3"
     TOKEN_IDENTIFIER,       // e.g., variable names, function names
     TOKEN_STRING_LITERAL,   // e.g., "Hello World"
     TOKEN_OPERATOR,         // e.g., "+", "-", "*", "/"
@@ -50,7 +51,9 @@ typedef enum {
     ERROR_INVALID_NUMBER,          // e.g., "123abc"
     ERROR_CONSECUTIVE_OPERATORS,   // e.g., "+++" if not allowed
     ERROR_UNTERMINATED_STRING,     // e.g., "Hello
-    ERROR_UNKNOWN_ESCAPE_SEQUENCE  // e.g., "\q"
+    ERROR_UNKNOWN_ESCAPE_SEQUENCE, // e.g., "\q"
+    ERROR_NUMBER_OVERFLOW,         // e.g., "99999999999", larger than INT_MAX
+    ERROR_FLOAT_OVERFLOW           // e.g., "1e999", larger than the largest double
 } ErrorType;
 
 /*--------------------------------------------------------------------
@@ -62,6 +65,9 @@ typedef struct {
     char lexeme[256];        // The text that makes up this token
     int line;                // Line number for debugging
     ErrorType error;         // Error code if this token is invalid
+    int offset;              // Where the token starts in the input, -1 if unknown
+    int value;               // TOKEN_NUMBER: the literal's value (INT_MAX on overflow)
+    double real;             // TOKEN_FLOAT_LITERAL: the literal's value, correctly rounded
 } Token;
 
 #endif /* TOKENS_H */
@@ -0,0 +1,31 @@
+/* trace.h */
+#ifndef TRACE_H
+#define TRACE_H
+
+// Timeline of analysis runs in the Chrome trace-event format
+// Spans are recorded as complete ("X") events, timestamped with the monotonic
+// clock, and written as one JSON file that Perfetto or chrome://tracing open.
+// Recording is thread-safe; each thread shows up as its own track.
+
+typedef struct {
+    const char* name;           // not copied: use string literals
+    const char* category;
+    double start;               // microseconds since trace_open()
+} TraceSpan;
+
+// Start recording; the file is written by trace_close(). Returns 0 if `path`
+// can't be opened for writing.
+int trace_open(const char* path);
+// Write every recorded event and stop recording. Returns 0 on a write error.
+int trace_close(void);
+int trace_enabled(void);
+
+// Label the calling thread's track
+void trace_thread_name(const char* name);
+
+// Spans must end on the thread that began them. Without an open trace both
+// calls do nothing. `detail` (may be NULL) is copied into the event's args.
+void trace_span_begin(TraceSpan* span, const char* name, const char* category);
+void trace_span_end(TraceSpan* span, const char* detail);
+
+#endif /* TRACE_H */
@@ -0,0 +1,33 @@
+/* watch.h */
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "diagnostics.h"
+#include "analysis.h"
+
+// Watch mode
+// Every file in a directory is analyzed once, then the directory is watched
+// with inotify. Events are collected until none has arrived for a short
+// while, so an editor's burst of writes and renames for one save becomes a
+// single update, and only the files it touched are analyzed again. Each file
+// keeps its ParseTree and SemanticCache between updates: the text is diffed
+// against the previous version, the statements the change reaches are
+// reparsed, and only statements that can see the change are checked again
+// (see incremental.h).
+//
+// Each file is analyzed under its own budget, with the trace spans and stats
+// phases of analysis.h. Files are parsed one after another, into the string
+// pools of their ParseTrees (which never share nodes), and the files of one
+// update are then checked on the analyzer's --jobs threads.
+//
+// Hidden files and editor backups (names starting with '.' or ending in '~')
+// are skipped. Subdirectories aren't watched.
+
+// Analyze and watch `directory`, writing every file's diagnostics to stdout
+// in `format` after each update, in name order. In text format each file's
+// summary line, which names it, comes first and its diagnostics follow. NULL
+// `options` are analysis_default_options(). Returns 0 if the directory can't
+// be watched, 1 once it goes away.
+int watch_run(const char* directory, DiagnosticFormat format, const AnalysisOptions* options);
+
+#endif /* WATCH_H */
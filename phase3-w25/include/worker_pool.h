@@ -0,0 +1,29 @@
+/* worker_pool.h */
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+// Threads kept for parallel work
+// A pool's threads are started once and sleep between runs, so a long-lived
+// caller (the server, watch mode) doesn't start and join threads for every
+// input. A run hands the same task to pool threads and to the caller, which
+// split the work among themselves, e.g. by taking items off a locked index.
+// Whatever the pool threads add to their statistics counters while running
+// is added to the caller's once the run is over.
+
+typedef struct WorkerPool WorkerPool;
+
+typedef void (*WorkerTask)(void* context);
+
+// A pool of `threads` threads besides the caller's, named "worker 1" and so
+// on in a trace. NULL if `threads` is below 1 or none could be started;
+// fewer than asked is not an error.
+WorkerPool* worker_pool_start(int threads);
+// Threads besides the caller's
+int worker_pool_size(const WorkerPool* pool);
+// Run `task(context)` on up to `threads` pool threads and on the calling
+// thread, and return once every one of them has returned. Not reentrant.
+void worker_pool_run(WorkerPool* pool, int threads, WorkerTask task, void* context);
+// Wait for the threads to exit; NULL is ignored
+void worker_pool_stop(WorkerPool* pool);
+
+#endif /* WORKER_POOL_H */
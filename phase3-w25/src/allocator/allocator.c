@@ -0,0 +1,203 @@
+/* allocator.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "../../include/allocator.h"
+#include "../../include/budget.h"
+
+static const char* subsystem_names[MEM_SUBSYSTEM_COUNT] = {
+    "source",
+    "ast",
+    "symbols",
+    "dataflow",
+    "optimizer",
+    "runtime",
+    "diagnostics",
+    "server",
+    "bytecode"
+};
+
+static void* system_allocate(void* context, MemSubsystem subsystem, size_t size) {
+    (void)context;
+    (void)subsystem;
+    return malloc(size);
+}
+
+static void* system_reallocate(void* context, MemSubsystem subsystem, void* pointer, size_t size) {
+    (void)context;
+    (void)subsystem;
+    return realloc(pointer, size);
+}
+
+static void system_release(void* context, MemSubsystem subsystem, void* pointer) {
+    (void)context;
+    (void)subsystem;
+    free(pointer);
+}
+
+static const Allocator system_allocator = {
+    system_allocate,
+    system_reallocate,
+    system_release,
+    NULL
+};
+
+static const Allocator* current = &system_allocator;
+
+void mem_set_allocator(const Allocator* allocator) {
+    current = allocator ? allocator : &system_allocator;
+}
+
+void* mem_alloc(MemSubsystem subsystem, size_t size) {
+    budget_charge_bytes(size);
+    return current->allocate(current->context, subsystem, size);
+}
+
+void* mem_calloc(MemSubsystem subsystem, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    budget_charge_bytes(count * size);
+    void* pointer = current->allocate(current->context, subsystem, count * size);
+    if (pointer) memset(pointer, 0, count * size);
+    return pointer;
+}
+
+void* mem_realloc(MemSubsystem subsystem, void* pointer, size_t size) {
+    budget_charge_bytes(size);
+    return current->reallocate(current->context, subsystem, pointer, size);
+}
+
+void mem_free(MemSubsystem subsystem, void* pointer) {
+    if (pointer) current->release(current->context, subsystem, pointer);
+}
+
+/* Tracking allocator */
+
+// Every tracked block starts with this header; the caller gets the memory
+// right after it. max_align_t keeps the returned pointer suitably aligned.
+typedef union {
+    struct {
+        size_t size;
+        MemSubsystem subsystem;
+    } info;
+    max_align_t align;
+} BlockHeader;
+
+typedef struct {
+    atomic_size_t live_bytes;
+    atomic_size_t peak_bytes;
+    atomic_size_t live_blocks;
+    atomic_size_t allocations;
+} Counters;
+
+static Counters counters[MEM_SUBSYSTEM_COUNT];
+static atomic_size_t total_live = 0;
+static atomic_size_t total_peak = 0;
+
+static void raise_peak(atomic_size_t* peak, size_t value) {
+    size_t seen = atomic_load(peak);
+    while (value > seen && !atomic_compare_exchange_weak(peak, &seen, value)) {
+        // `seen` was reloaded; retry while we're still higher
+    }
+}
+
+static void count_allocation(MemSubsystem subsystem, size_t size) {
+    Counters* c = &counters[subsystem];
+    size_t live = atomic_fetch_add(&c->live_bytes, size) + size;
+    raise_peak(&c->peak_bytes, live);
+    atomic_fetch_add(&c->live_blocks, 1);
+    atomic_fetch_add(&c->allocations, 1);
+    raise_peak(&total_peak, atomic_fetch_add(&total_live, size) + size);
+}
+
+static void count_release(MemSubsystem subsystem, size_t size) {
+    Counters* c = &counters[subsystem];
+    atomic_fetch_sub(&c->live_bytes, size);
+    atomic_fetch_sub(&c->live_blocks, 1);
+    atomic_fetch_sub(&total_live, size);
+}
+
+static void* tracking_allocate(void* context, MemSubsystem subsystem, size_t size) {
+    (void)context;
+    if (size > SIZE_MAX - sizeof(BlockHeader)) return NULL;
+    BlockHeader* header = malloc(sizeof(BlockHeader) + size);
+    if (!header) return NULL;
+    header->info.size = size;
+    header->info.subsystem = subsystem;
+    count_allocation(subsystem, size);
+    return header + 1;
+}
+
+static void tracking_release(void* context, MemSubsystem subsystem, void* pointer) {
+    (void)context;
+    (void)subsystem;
+    BlockHeader* header = (BlockHeader*)pointer - 1;
+    // Charge the subsystem that allocated it, even if another one frees it
+    count_release(header->info.subsystem, header->info.size);
+    free(header);
+}
+
+static void* tracking_reallocate(void* context, MemSubsystem subsystem, void* pointer, size_t size) {
+    if (!pointer) return tracking_allocate(context, subsystem, size);
+    if (size > SIZE_MAX - sizeof(BlockHeader)) return NULL;
+
+    BlockHeader* header = (BlockHeader*)pointer - 1;
+    MemSubsystem owner = header->info.subsystem;
+    size_t old_size = header->info.size;
+    BlockHeader* resized = realloc(header, sizeof(BlockHeader) + size);
+    if (!resized) return NULL;
+
+    count_release(owner, old_size);
+    resized->info.size = size;
+    count_allocation(owner, size);
+    return resized + 1;
+}
+
+static const Allocator tracking_allocator = {
+    tracking_allocate,
+    tracking_reallocate,
+    tracking_release,
+    NULL
+};
+
+const Allocator* mem_tracking_allocator(void) {
+    return &tracking_allocator;
+}
+
+MemUsage mem_usage(MemSubsystem subsystem) {
+    MemUsage usage;
+    const Counters* c = &counters[subsystem];
+    usage.live_bytes = atomic_load(&c->live_bytes);
+    usage.peak_bytes = atomic_load(&c->peak_bytes);
+    usage.live_blocks = atomic_load(&c->live_blocks);
+    usage.allocations = atomic_load(&c->allocations);
+    return usage;
+}
+
+size_t mem_total_peak(void) {
+    return atomic_load(&total_peak);
+}
+
+void mem_report(FILE* out) {
+    fprintf(out, "Memory:\n");
+    fprintf(out, "  %-12s %14s %14s %14s\n", "subsystem", "live bytes", "peak bytes", "allocations");
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        MemUsage usage = mem_usage((MemSubsystem)i);
+        fprintf(out, "  %-12s %14zu %14zu %14zu\n", subsystem_names[i],
+                usage.live_bytes, usage.peak_bytes, usage.allocations);
+    }
+    fprintf(out, "  total peak: %zu bytes\n", mem_total_peak());
+}
+
+size_t mem_leak_report(FILE* out) {
+    size_t leaked = 0;
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        MemUsage usage = mem_usage((MemSubsystem)i);
+        if (usage.live_blocks == 0) continue;
+        fprintf(out, "Leak: %zu block(s), %zu bytes still allocated by %s\n",
+                usage.live_blocks, usage.live_bytes, subsystem_names[i]);
+        leaked += usage.live_blocks;
+    }
+    return leaked;
+}
@@ -0,0 +1,97 @@
+/* analysis.c */
+#include <string.h>
+#include "../../include/parser.h"
+#include "../../include/semantic.h"
+#include "../../include/stats.h"
+#include "../../include/trace.h"
+#include "../../include/analysis.h"
+
+void analysis_default_options(AnalysisOptions* options) {
+    memset(options, 0, sizeof(*options));
+    options->jobs = 1;
+    options->limits.max_depth = BUDGET_DEFAULT_MAX_DEPTH;
+}
+
+void analyzer_init(Analyzer* analyzer, const AnalysisOptions* options) {
+    memset(analyzer, 0, sizeof(*analyzer));
+    if (options) analyzer->options = *options;
+    else analysis_default_options(&analyzer->options);
+    string_pool_init(&analyzer->strings);
+    node_table_init(&analyzer->nodes);
+    // Without threads the pass runs serially, as with one job
+    if (analyzer->options.jobs > 1) analyzer->workers = worker_pool_start(analyzer->options.jobs - 1);
+}
+
+void analyzer_reset(Analyzer* analyzer) {
+    node_table_free(&analyzer->nodes);
+    string_pool_free(&analyzer->strings);
+    string_pool_init(&analyzer->strings);
+}
+
+void analyzer_free(Analyzer* analyzer) {
+    node_table_free(&analyzer->nodes);
+    string_pool_free(&analyzer->strings);
+    worker_pool_stop(analyzer->workers);
+    analyzer->workers = NULL;
+}
+
+void analysis_begin(Analysis* analysis, const Analyzer* analyzer, const char* name, const char* text) {
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->name = name;
+    diag_session_init(&analysis->session, name);
+    if (text && line_index_build(&analysis->lines, text, (int)strlen(text))) {
+        analysis->session.lines = &analysis->lines;
+    }
+    analysis->previous_session = diag_begin(&analysis->session);
+    budget_init(&analysis->budget, &analyzer->options.limits);
+    analysis->previous_budget = budget_begin(&analysis->budget);
+}
+
+ASTNode* analysis_parse(Analysis* analysis, Analyzer* analyzer, const char* text) {
+    TraceSpan span;
+    trace_span_begin(&span, "parse", "phase");
+    STAT_TIMER_START(parse_start);
+    parser_set_string_pool(&analyzer->strings);
+    if (analyzer->options.hash_consing) parser_set_node_table(&analyzer->nodes);
+    parser_init(text);
+    ASTNode* program = parse();
+    parser_set_string_pool(NULL);
+    parser_set_node_table(NULL);
+    STAT_TIMER_STOP(parse_start, STATS_PHASE_PARSE);
+    trace_span_end(&span, analysis->name);
+    return program;
+}
+
+int analysis_check(Analysis* analysis, Analyzer* analyzer, ASTNode* program) {
+    TraceSpan span;
+    trace_span_begin(&span, "semantic", "phase");
+    STAT_TIMER_START(semantic_start);
+    int result = analyze_program(program, analyzer->workers, analyzer->options.print_symbols);
+    STAT_TIMER_STOP(semantic_start, STATS_PHASE_SEMANTIC);
+    trace_span_end(&span, analysis->name);
+    return result;
+}
+
+void analysis_end(Analysis* analysis) {
+    budget_end(analysis->previous_budget);
+    diag_end(analysis->previous_session);
+}
+
+void analysis_resume(Analysis* analysis) {
+    analysis->previous_session = diag_begin(&analysis->session);
+    analysis->previous_budget = budget_begin(&analysis->budget);
+}
+
+void analysis_free(Analysis* analysis) {
+    diag_session_free(&analysis->session);
+    line_index_free(&analysis->lines);
+}
+
+int analyzer_run(Analyzer* analyzer, Analysis* analysis, const char* name, const char* text,
+                 ASTNode** program) {
+    analysis_begin(analysis, analyzer, name, text);
+    *program = analysis_parse(analysis, analyzer, text);
+    int result = *program && analysis_check(analysis, analyzer, *program);
+    analysis_end(analysis);
+    return result;
+}
@@ -0,0 +1,113 @@
+/* budget.c */
+#define _POSIX_C_SOURCE 200809L     // clock_gettime
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../../include/budget.h"
+#include "../../include/diagnostics.h"
+
+// The clock is read on every this many checkpoints
+#define CLOCK_INTERVAL 64
+
+static _Thread_local Budget* active_budget = NULL;
+
+static double now_milliseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+void budget_init(Budget* budget, const BudgetLimits* limits) {
+    memset(budget, 0, sizeof(Budget));
+    if (limits) budget->limits = *limits;
+    if (budget->limits.max_milliseconds > 0) {
+        budget->deadline = now_milliseconds() + budget->limits.max_milliseconds;
+    }
+}
+
+Budget* budget_begin(Budget* budget) {
+    Budget* previous = active_budget;
+    active_budget = budget;
+    return previous;
+}
+
+void budget_end(Budget* previous) {
+    active_budget = previous;
+}
+
+Budget* budget_active(void) {
+    return active_budget;
+}
+
+static int exceed(Budget* budget, BudgetLimit limit, int line) {
+    if (budget->exceeded == BUDGET_NONE) budget->exceeded = limit;
+    if (!budget->reported) {
+        budget->reported = 1;
+        // The message quotes the limit
+        char arg[32];
+        switch (budget->exceeded) {
+            case BUDGET_TOKENS: snprintf(arg, sizeof(arg), "%ld", budget->limits.max_tokens); break;
+            case BUDGET_NODES: snprintf(arg, sizeof(arg), "%ld", budget->limits.max_nodes); break;
+            case BUDGET_DEPTH: snprintf(arg, sizeof(arg), "%d", budget->limits.max_depth); break;
+            case BUDGET_TIME: snprintf(arg, sizeof(arg), "%ld", budget->limits.max_milliseconds); break;
+            default: snprintf(arg, sizeof(arg), "%zu", budget->limits.max_bytes); break;
+        }
+        diag_report(DIAG_PHASE_LIMIT, budget->exceeded, DIAG_ERROR, line, 0, arg);
+    }
+    return 0;
+}
+
+// Limits that aren't charged at a checkpoint of their own
+static int within_budget(Budget* budget, int line) {
+    if (budget->exceeded != BUDGET_NONE) return exceed(budget, budget->exceeded, line);
+    if (budget->limits.max_bytes && budget->bytes > budget->limits.max_bytes) {
+        return exceed(budget, BUDGET_BYTES, line);
+    }
+    if (budget->deadline > 0 && ++budget->ticks >= CLOCK_INTERVAL) {
+        budget->ticks = 0;
+        if (now_milliseconds() > budget->deadline) return exceed(budget, BUDGET_TIME, line);
+    }
+    return 1;
+}
+
+int budget_token(int line) {
+    Budget* budget = active_budget;
+    if (!budget) return 1;
+    if (budget->limits.max_tokens && ++budget->tokens > budget->limits.max_tokens) {
+        return exceed(budget, BUDGET_TOKENS, line);
+    }
+    return within_budget(budget, line);
+}
+
+int budget_node(int line) {
+    Budget* budget = active_budget;
+    if (!budget) return 1;
+    if (budget->limits.max_nodes && ++budget->nodes > budget->limits.max_nodes) {
+        return exceed(budget, BUDGET_NODES, line);
+    }
+    return within_budget(budget, line);
+}
+
+int budget_enter(int line) {
+    Budget* budget = active_budget;
+    if (!budget) return 1;
+    budget->depth++;
+    if (budget->limits.max_depth && budget->depth > budget->limits.max_depth) {
+        return exceed(budget, BUDGET_DEPTH, line);
+    }
+    return within_budget(budget, line);
+}
+
+void budget_leave(void) {
+    if (active_budget) active_budget->depth--;
+}
+
+int budget_check(int line) {
+    Budget* budget = active_budget;
+    return budget ? within_budget(budget, line) : 1;
+}
+
+void budget_charge_bytes(size_t size) {
+    Budget* budget = active_budget;
+    if (budget) budget->bytes += size;
+}
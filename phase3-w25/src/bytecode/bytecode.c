@@ -0,0 +1,478 @@
+/* bytecode.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/parser.h"
+#include "../../include/tokens.h"
+#include "../../include/string_pool.h"
+#include "../../include/bytecode.h"
+#include "../../include/allocator.h"
+
+// Sections start at multiples of this
+#define SECTION_ALIGN 8
+
+typedef struct {
+    Instruction* code;
+    int code_count;
+    int code_capacity;
+    Value* constants;
+    int constant_count;
+    int constant_capacity;
+    int* constant_slots;        // open addressing over the bit patterns, -1 when empty
+    int constant_slot_count;    // a power of two, at least twice constant_count
+    LineEntry* lines;
+    int line_count;
+    int line_capacity;
+    int depth;                  // operand stack depth after the last instruction
+    int max_depth;
+    int global_count;
+    const StringPool* strings;  // the parser's pool, or `own`
+    StringPool own;
+    int ok;                     // cleared on the first failure
+} Compiler;
+
+void bytecode_op_effect(BytecodeOp op, int* pops, int* pushes) {
+    switch (op) {
+        case OP_CONST:
+        case OP_LOAD:
+            *pops = 0; *pushes = 1;
+            return;
+        case OP_STORE:
+        case OP_JUMP_IF_FALSE:
+        case OP_PRINT_INT:
+        case OP_PRINT_FLOAT:
+        case OP_PRINT_CHAR:
+        case OP_FACTORIAL:
+            *pops = 1; *pushes = 0;
+            return;
+        case OP_INT_TO_FLOAT:
+            *pops = 1; *pushes = 1;
+            return;
+        case OP_ADD_INT:
+        case OP_SUB_INT:
+        case OP_MUL_INT:
+        case OP_DIV_INT:
+        case OP_ADD_FLOAT:
+        case OP_SUB_FLOAT:
+        case OP_MUL_FLOAT:
+        case OP_DIV_FLOAT:
+        case OP_COMPARE_INT:
+        case OP_COMPARE_FLOAT:
+            *pops = 2; *pushes = 1;
+            return;
+        default:
+            *pops = 0; *pushes = 0;
+            return;
+    }
+}
+
+static int grow(void** items, int* capacity, size_t item_size) {
+    int new_capacity = *capacity ? *capacity * 2 : 64;
+    void* resized = mem_realloc(MEM_BYTECODE, *items, new_capacity * item_size);
+    if (!resized) return 0;
+    *items = resized;
+    *capacity = new_capacity;
+    return 1;
+}
+
+// Append an instruction; returns its index, -1 once compilation has failed
+static int emit(Compiler* compiler, BytecodeOp op, int32_t arg) {
+    if (!compiler->ok) return -1;
+    if (compiler->code_count == compiler->code_capacity &&
+        !grow((void**)&compiler->code, &compiler->code_capacity, sizeof(Instruction))) {
+        compiler->ok = 0;
+        return -1;
+    }
+    int pops, pushes;
+    bytecode_op_effect(op, &pops, &pushes);
+    compiler->depth += pushes - pops;
+    if (compiler->depth > compiler->max_depth) compiler->max_depth = compiler->depth;
+
+    compiler->code[compiler->code_count].op = op;
+    compiler->code[compiler->code_count].arg = arg;
+    return compiler->code_count++;
+}
+
+static void patch_jump(Compiler* compiler, int at, int target) {
+    if (at >= 0) compiler->code[at].arg = target;
+}
+
+// Statements that start at the same instruction keep the last one's line,
+// which is the one that runs
+static void mark_line(Compiler* compiler, int line) {
+    if (!compiler->ok) return;
+    uint32_t pc = (uint32_t)compiler->code_count;
+    if (compiler->line_count > 0 && compiler->lines[compiler->line_count - 1].pc == pc) {
+        compiler->lines[compiler->line_count - 1].line = (uint32_t)line;
+        return;
+    }
+    if (compiler->line_count == compiler->line_capacity &&
+        !grow((void**)&compiler->lines, &compiler->line_capacity, sizeof(LineEntry))) {
+        compiler->ok = 0;
+        return;
+    }
+    compiler->lines[compiler->line_count].pc = pc;
+    compiler->lines[compiler->line_count].line = (uint32_t)line;
+    compiler->line_count++;
+}
+
+static uint64_t value_bits(Value value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static unsigned hash_bits(uint64_t bits) {
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return (unsigned)bits;
+}
+
+static int grow_constant_slots(Compiler* compiler) {
+    int slot_count = compiler->constant_slot_count ? compiler->constant_slot_count * 2 : 64;
+    int* slots = mem_alloc(MEM_BYTECODE, slot_count * sizeof(int));
+    if (!slots) return 0;
+    for (int i = 0; i < slot_count; i++) slots[i] = -1;
+    for (int id = 0; id < compiler->constant_count; id++) {
+        unsigned slot = hash_bits(value_bits(compiler->constants[id])) & (slot_count - 1);
+        while (slots[slot] >= 0) slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = id;
+    }
+    mem_free(MEM_BYTECODE, compiler->constant_slots);
+    compiler->constant_slots = slots;
+    compiler->constant_slot_count = slot_count;
+    return 1;
+}
+
+// Index of a constant in the pool, adding it if it's new. An int and a float
+// with the same bits are the same 8 bytes, so they can share an entry.
+static int add_constant(Compiler* compiler, Value value) {
+    if (!compiler->ok) return -1;
+    if ((compiler->constant_count + 1) * 2 > compiler->constant_slot_count &&
+        !grow_constant_slots(compiler)) {
+        compiler->ok = 0;
+        return -1;
+    }
+    uint64_t bits = value_bits(value);
+    unsigned mask = (unsigned)compiler->constant_slot_count - 1;
+    unsigned slot = hash_bits(bits) & mask;
+    while (compiler->constant_slots[slot] >= 0) {
+        int id = compiler->constant_slots[slot];
+        if (value_bits(compiler->constants[id]) == bits) return id;
+        slot = (slot + 1) & mask;
+    }
+    if (compiler->constant_count == compiler->constant_capacity &&
+        !grow((void**)&compiler->constants, &compiler->constant_capacity, sizeof(Value))) {
+        compiler->ok = 0;
+        return -1;
+    }
+    compiler->constants[compiler->constant_count] = value;
+    compiler->constant_slots[slot] = compiler->constant_count;
+    return compiler->constant_count++;
+}
+
+static void emit_int(Compiler* compiler, int64_t value) {
+    Value constant;
+    constant.i = value;
+    emit(compiler, OP_CONST, add_constant(compiler, constant));
+}
+
+static void emit_float(Compiler* compiler, double value) {
+    Value constant;
+    constant.f = value;
+    emit(compiler, OP_CONST, add_constant(compiler, constant));
+}
+
+// Where a literal starts in the string section
+static long string_offset(Compiler* compiler, const ASTNode* node) {
+    int id = node->string_id;
+    if (compiler->strings == &compiler->own) {
+        id = string_pool_intern(&compiler->own, node->token.lexeme, (int)strlen(node->token.lexeme));
+    }
+    if (id < 0 || id >= compiler->strings->count) return -1;
+    return (long)compiler->strings->offsets[id];
+}
+
+static int variable_slot(Compiler* compiler, const ASTNode* node) {
+    if (node->symbol_id < 0) return -1;
+    if (node->symbol_id >= compiler->global_count) compiler->global_count = node->symbol_id + 1;
+    return node->symbol_id;
+}
+
+static int comparison_kind(const char* lexeme) {
+    if (strcmp(lexeme, "<") == 0) return COMPARE_LESS;
+    if (strcmp(lexeme, ">") == 0) return COMPARE_GREATER;
+    if (strcmp(lexeme, "<=") == 0) return COMPARE_LESS_EQUAL;
+    if (strcmp(lexeme, ">=") == 0) return COMPARE_GREATER_EQUAL;
+    if (strcmp(lexeme, "==") == 0) return COMPARE_EQUAL;
+    if (strcmp(lexeme, "!=") == 0) return COMPARE_NOT_EQUAL;
+    return -1;
+}
+
+static int typed(const ASTNode* node) {
+    return node && node->value_type != TYPE_UNANNOTATED && node->value_type != -1;
+}
+
+static void compile_expression(Compiler* compiler, ASTNode* node);
+
+// Compile `node` and convert it to float if the context wants one
+static void compile_operand(Compiler* compiler, ASTNode* node, int as_float) {
+    compile_expression(compiler, node);
+    if (as_float && compiler->ok && node->value_type != TOKEN_FLOAT) emit(compiler, OP_INT_TO_FLOAT, 0);
+}
+
+// Leaves the expression's value on the stack. ints and chars are both int64
+// there; which of them it is only matters to print.
+static void compile_expression(Compiler* compiler, ASTNode* node) {
+    if (!compiler->ok) return;
+    if (!typed(node)) {
+        compiler->ok = 0;
+        return;
+    }
+    switch (node->type) {
+        case AST_NUMBER:
+            if (node->value_type == TOKEN_FLOAT) emit_float(compiler, node->token.real);
+            else emit_int(compiler, node->token.value);
+            return;
+
+        case AST_STRING:
+            // A literal used as a char is its first character
+            emit_int(compiler, (unsigned char)node->token.lexeme[0]);
+            return;
+
+        case AST_IDENTIFIER: {
+            int slot = variable_slot(compiler, node);
+            if (slot < 0) compiler->ok = 0;
+            else emit(compiler, OP_LOAD, slot);
+            return;
+        }
+
+        case AST_BINOP: {
+            int as_float = node->value_type == TOKEN_FLOAT;
+            compile_operand(compiler, node->left, as_float);
+            compile_operand(compiler, node->right, as_float);
+            const char* op = node->token.lexeme;
+            BytecodeOp base = as_float ? OP_ADD_FLOAT : OP_ADD_INT;
+            if (strcmp(op, "+") == 0) emit(compiler, base, 0);
+            else if (strcmp(op, "-") == 0) emit(compiler, base + 1, 0);
+            else if (strcmp(op, "*") == 0) emit(compiler, base + 2, 0);
+            else if (strcmp(op, "/") == 0) emit(compiler, base + 3, 0);
+            else compiler->ok = 0;
+            return;
+        }
+
+        case AST_CONDITION:
+            compile_expression(compiler, node->left);
+            return;
+
+        case AST_COMPARISON: {
+            int kind = comparison_kind(node->token.lexeme);
+            if (kind < 0 || !typed(node->left) || !typed(node->right)) {
+                compiler->ok = 0;
+                return;
+            }
+            int as_float = node->left->value_type == TOKEN_FLOAT || node->right->value_type == TOKEN_FLOAT;
+            compile_operand(compiler, node->left, as_float);
+            compile_operand(compiler, node->right, as_float);
+            emit(compiler, as_float ? OP_COMPARE_FLOAT : OP_COMPARE_INT, kind);
+            return;
+        }
+
+        default:
+            compiler->ok = 0;
+            return;
+    }
+}
+
+// Leaves 1 on the stack if `node` is true, 0 if it isn't
+static void compile_test(Compiler* compiler, ASTNode* node) {
+    compile_expression(compiler, node);
+    if (compiler->ok && node->value_type == TOKEN_FLOAT) {
+        emit_float(compiler, 0.0);
+        emit(compiler, OP_COMPARE_FLOAT, COMPARE_NOT_EQUAL);
+    }
+}
+
+static void compile_statement(Compiler* compiler, ASTNode* node);
+
+static void compile_statements(Compiler* compiler, ASTNode* node) {
+    for (; node && compiler->ok; node = node->next) {
+        // The parser links a bare block's `next` to the statement after it
+        // and drops its body, so there is nothing of its own to run
+        if (node->type == AST_PROGRAM || node->type == AST_BLOCK) continue;
+        compile_statement(compiler, node);
+    }
+}
+
+// An if/while body: a block's statements, or a single statement
+static void compile_body(Compiler* compiler, ASTNode* node) {
+    if (!node) return;
+    if (node->type == AST_BLOCK) compile_statements(compiler, node->next);
+    else compile_statement(compiler, node);
+}
+
+static void compile_statement(Compiler* compiler, ASTNode* node) {
+    mark_line(compiler, node->token.line);
+    switch (node->type) {
+        case AST_VARDECL:
+            // Emits nothing: only loads and stores count towards the globals
+            if (node->symbol_id < 0) compiler->ok = 0;
+            return;
+
+        case AST_ASSIGN: {
+            int slot = node->left ? variable_slot(compiler, node->left) : -1;
+            if (slot < 0) {
+                compiler->ok = 0;
+                return;
+            }
+            compile_operand(compiler, node->right, node->left->value_type == TOKEN_FLOAT);
+            emit(compiler, OP_STORE, slot);
+            return;
+        }
+
+        case AST_PRINT: {
+            ASTNode* value = node->left;
+            if (value && value->type == AST_STRING) {
+                long offset = string_offset(compiler, value);
+                if (offset < 0) compiler->ok = 0;
+                else emit(compiler, OP_PRINT_STRING, (int32_t)offset);
+                return;
+            }
+            compile_expression(compiler, value);
+            if (!compiler->ok) return;
+            if (value->value_type == TOKEN_FLOAT) emit(compiler, OP_PRINT_FLOAT, 0);
+            else if (value->value_type == TOKEN_CHAR) emit(compiler, OP_PRINT_CHAR, 0);
+            else emit(compiler, OP_PRINT_INT, 0);
+            return;
+        }
+
+        case AST_FACTORIAL:
+            compile_expression(compiler, node->left);
+            emit(compiler, OP_FACTORIAL, 0);
+            return;
+
+        case AST_IF: {
+            compile_test(compiler, node->left);
+            int skip = emit(compiler, OP_JUMP_IF_FALSE, 0);
+            compile_body(compiler, node->right);
+            patch_jump(compiler, skip, compiler->code_count);
+            return;
+        }
+
+        case AST_WHILE: {
+            int top = compiler->code_count;
+            compile_test(compiler, node->left);
+            int done = emit(compiler, OP_JUMP_IF_FALSE, 0);
+            compile_body(compiler, node->right);
+            emit(compiler, OP_JUMP, top);
+            patch_jump(compiler, done, compiler->code_count);
+            return;
+        }
+
+        case AST_REPEAT: {
+            // repeat { ... } until (condition); runs the block again while
+            // the condition is false
+            int top = compiler->code_count;
+            compile_body(compiler, node->left);
+            if (!node->right || !node->right->left) {
+                compiler->ok = 0;
+                return;
+            }
+            mark_line(compiler, node->right->token.line);
+            compile_test(compiler, node->right->left);
+            emit(compiler, OP_JUMP_IF_FALSE, top);
+            return;
+        }
+
+        default:
+            compiler->ok = 0;
+            return;
+    }
+}
+
+static size_t align_section(size_t offset) {
+    return (offset + SECTION_ALIGN - 1) & ~(size_t)(SECTION_ALIGN - 1);
+}
+
+static int host_is_little_endian(void) {
+    const uint16_t probe = 1;
+    return *(const unsigned char*)&probe == 1;
+}
+
+// Lay the sections out behind the header in one buffer
+static int build_image(Compiler* compiler, BytecodeImage* image) {
+    const StringPool* strings = compiler->strings;
+    BytecodeHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BYTECODE_MAGIC;
+    header.version = BYTECODE_VERSION;
+    header.global_count = (uint32_t)compiler->global_count;
+    header.max_stack = (uint32_t)compiler->max_depth;
+    header.constant_count = (uint32_t)compiler->constant_count;
+    header.string_bytes = (uint32_t)strings->size;
+    header.code_count = (uint32_t)compiler->code_count;
+    header.line_count = (uint32_t)compiler->line_count;
+
+    size_t offset = align_section(sizeof(BytecodeHeader));
+    header.constants_offset = (uint32_t)offset;
+    offset = align_section(offset + compiler->constant_count * sizeof(Value));
+    header.strings_offset = (uint32_t)offset;
+    offset = align_section(offset + strings->size);
+    header.code_offset = (uint32_t)offset;
+    offset = align_section(offset + compiler->code_count * sizeof(Instruction));
+    header.lines_offset = (uint32_t)offset;
+    offset += compiler->line_count * sizeof(LineEntry);
+    if (offset > UINT32_MAX) return 0;
+
+    unsigned char* data = mem_calloc(MEM_BYTECODE, 1, offset);
+    if (!data) return 0;
+    memcpy(data, &header, sizeof(header));
+    if (compiler->constant_count) {
+        memcpy(data + header.constants_offset, compiler->constants, compiler->constant_count * sizeof(Value));
+    }
+    if (strings->size) memcpy(data + header.strings_offset, strings->data, strings->size);
+    memcpy(data + header.code_offset, compiler->code, compiler->code_count * sizeof(Instruction));
+    if (compiler->line_count) {
+        memcpy(data + header.lines_offset, compiler->lines, compiler->line_count * sizeof(LineEntry));
+    }
+    image->data = data;
+    image->size = offset;
+    return 1;
+}
+
+int bytecode_compile(ASTNode* program, const StringPool* strings, BytecodeImage* image) {
+    image->data = NULL;
+    image->size = 0;
+    if (!host_is_little_endian()) return 0;
+
+    Compiler compiler;
+    memset(&compiler, 0, sizeof(compiler));
+    compiler.ok = 1;
+    string_pool_init(&compiler.own);
+    compiler.strings = strings ? strings : &compiler.own;
+
+    compile_statements(&compiler, program);
+    emit(&compiler, OP_HALT, 0);
+    int ok = compiler.ok && build_image(&compiler, image);
+
+    mem_free(MEM_BYTECODE, compiler.code);
+    mem_free(MEM_BYTECODE, compiler.constants);
+    mem_free(MEM_BYTECODE, compiler.constant_slots);
+    mem_free(MEM_BYTECODE, compiler.lines);
+    string_pool_free(&compiler.own);
+    return ok;
+}
+
+int bytecode_write_file(const BytecodeImage* image, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return 0;
+    int ok = fwrite(image->data, 1, image->size, file) == image->size;
+    return fclose(file) == 0 && ok;
+}
+
+void bytecode_image_free(BytecodeImage* image) {
+    mem_free(MEM_BYTECODE, image->data);
+    image->data = NULL;
+    image->size = 0;
+}
@@ -0,0 +1,394 @@
+/* vm.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../../include/bytecode.h"
+#include "../../include/runtime.h"
+#include "../../include/allocator.h"
+
+static int host_is_little_endian(void) {
+    const uint16_t probe = 1;
+    return *(const unsigned char*)&probe == 1;
+}
+
+// Whether `count` items of `item_size` bytes at `offset` lie inside the file
+// and are aligned for the items
+static int section_fits(size_t size, uint32_t offset, uint32_t count, size_t item_size) {
+    if (offset % 8 != 0 || offset < sizeof(BytecodeHeader) || offset > size) return 0;
+    return (uint64_t)count * item_size <= size - offset;
+}
+
+// Every operand in range and every jump landing on an instruction. The
+// globals are sized from the header, so it mustn't claim more of them than
+// the code uses.
+static const char* check_operands(const BytecodeProgram* program) {
+    const BytecodeHeader* header = program->header;
+    uint32_t used = 0;      // one past the highest variable loaded or stored
+    for (uint32_t pc = 0; pc < header->code_count; pc++) {
+        const Instruction* instruction = &program->code[pc];
+        int32_t arg = instruction->arg;
+        switch (instruction->op) {
+            case OP_CONST:
+                if (arg < 0 || (uint32_t)arg >= header->constant_count) return "constant out of range";
+                break;
+            case OP_LOAD:
+            case OP_STORE:
+                if (arg < 0 || (uint32_t)arg >= header->global_count) return "variable out of range";
+                if ((uint32_t)arg >= used) used = (uint32_t)arg + 1;
+                break;
+            case OP_COMPARE_INT:
+            case OP_COMPARE_FLOAT:
+                if (arg < 0 || arg >= COMPARE_COUNT) return "unknown comparison";
+                break;
+            case OP_JUMP:
+            case OP_JUMP_IF_FALSE:
+                if (arg < 0 || (uint32_t)arg >= header->code_count) return "jump out of range";
+                break;
+            case OP_PRINT_STRING:
+                // The section ends with a NUL, so the literal does too
+                if (arg < 0 || (uint32_t)arg >= header->string_bytes) return "string out of range";
+                break;
+            default:
+                if (instruction->op >= OP_COUNT) return "unknown instruction";
+                break;
+        }
+    }
+    if (header->global_count > used) return "too many variables";
+    return NULL;
+}
+
+// Follow every path through the code, recording the stack depth each
+// instruction starts at. The depths have to agree wherever paths meet, never
+// go below zero or above max_stack, and no path may run past the end.
+static const char* check_stack(const BytecodeProgram* program) {
+    const BytecodeHeader* header = program->header;
+    uint32_t count = header->code_count;
+    int32_t* depths = mem_alloc(MEM_BYTECODE, count * sizeof(int32_t));
+    uint32_t* pending = mem_alloc(MEM_BYTECODE, count * sizeof(uint32_t));
+    if (!depths || !pending) {
+        mem_free(MEM_BYTECODE, depths);
+        mem_free(MEM_BYTECODE, pending);
+        return "out of memory";
+    }
+    for (uint32_t pc = 0; pc < count; pc++) depths[pc] = -1;
+
+    const char* error = NULL;
+    uint32_t pending_count = 0;
+    depths[0] = 0;
+    pending[pending_count++] = 0;
+    while (pending_count > 0 && !error) {
+        uint32_t pc = pending[--pending_count];
+        const Instruction* instruction = &program->code[pc];
+        int pops, pushes;
+        bytecode_op_effect((BytecodeOp)instruction->op, &pops, &pushes);
+        int64_t depth = depths[pc];
+        if (depth < pops) {
+            error = "stack underflow";
+            break;
+        }
+        depth += pushes - pops;
+        if (depth > header->max_stack) {
+            error = "stack deeper than declared";
+            break;
+        }
+
+        uint32_t successors[2];
+        int successor_count = 0;
+        if (instruction->op == OP_JUMP || instruction->op == OP_JUMP_IF_FALSE) {
+            successors[successor_count++] = (uint32_t)instruction->arg;
+        }
+        if (instruction->op != OP_JUMP && instruction->op != OP_HALT) {
+            if (pc + 1 >= count) {
+                error = "code runs past its end";
+                break;
+            }
+            successors[successor_count++] = pc + 1;
+        }
+        for (int i = 0; i < successor_count; i++) {
+            uint32_t next = successors[i];
+            if (depths[next] < 0) {
+                // Each instruction is queued once, so `pending` can't overflow
+                depths[next] = (int32_t)depth;
+                pending[pending_count++] = next;
+            } else if (depths[next] != depth) {
+                error = "stack depths disagree where paths meet";
+                break;
+            }
+        }
+    }
+    mem_free(MEM_BYTECODE, depths);
+    mem_free(MEM_BYTECODE, pending);
+    return error;
+}
+
+int bytecode_load_memory(BytecodeProgram* program, const void* data, size_t size, const char** error) {
+    memset(program, 0, sizeof(BytecodeProgram));
+    const unsigned char* bytes = data;
+    const BytecodeHeader* header = data;
+    const char* problem = NULL;
+
+    if (!host_is_little_endian()) problem = "big-endian hosts can't run bytecode";
+    else if ((uintptr_t)bytes % 8 != 0) problem = "not 8-byte aligned";
+    else if (size < sizeof(BytecodeHeader) || header->magic != BYTECODE_MAGIC) problem = "not a bytecode file";
+    else if (header->version != BYTECODE_VERSION || header->reserved != 0) problem = "unsupported version";
+    else if (!section_fits(size, header->constants_offset, header->constant_count, sizeof(Value)))
+        problem = "constant section out of bounds";
+    else if (!section_fits(size, header->strings_offset, header->string_bytes, 1))
+        problem = "string section out of bounds";
+    else if (!section_fits(size, header->code_offset, header->code_count, sizeof(Instruction)))
+        problem = "code section out of bounds";
+    else if (!section_fits(size, header->lines_offset, header->line_count, sizeof(LineEntry)))
+        problem = "line table out of bounds";
+    else if (header->string_bytes > 0 && bytes[header->strings_offset + header->string_bytes - 1] != '\0')
+        problem = "unterminated string section";
+    else if (header->code_count == 0) problem = "no code";
+    // The deepest the stack can get is one value per instruction
+    else if (header->max_stack > header->code_count) problem = "stack size out of range";
+
+    if (!problem) {
+        program->header = header;
+        program->constants = (const Value*)(bytes + header->constants_offset);
+        program->strings = (const char*)(bytes + header->strings_offset);
+        program->code = (const Instruction*)(bytes + header->code_offset);
+        program->lines = (const LineEntry*)(bytes + header->lines_offset);
+
+        for (uint32_t i = 0; i < header->line_count && !problem; i++) {
+            if (program->lines[i].pc >= header->code_count ||
+                (i > 0 && program->lines[i].pc <= program->lines[i - 1].pc)) {
+                problem = "line table out of order";
+            }
+        }
+        if (!problem) problem = check_operands(program);
+        if (!problem) problem = check_stack(program);
+    }
+
+    if (problem) {
+        memset(program, 0, sizeof(BytecodeProgram));
+        if (error) *error = problem;
+        return 0;
+    }
+    return 1;
+}
+
+int bytecode_load_file(BytecodeProgram* program, const char* path, const char** error) {
+    memset(program, 0, sizeof(BytecodeProgram));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (error) *error = "could not open the file";
+        return 0;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        if (error) *error = "not a bytecode file";
+        return 0;
+    }
+    size_t size = (size_t)info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        if (error) *error = "could not map the file";
+        return 0;
+    }
+    if (!bytecode_load_memory(program, mapping, size, error)) {
+        munmap(mapping, size);
+        return 0;
+    }
+    program->mapping = mapping;
+    program->mapping_size = size;
+    return 1;
+}
+
+void bytecode_unload(BytecodeProgram* program) {
+    if (program->mapping) munmap(program->mapping, program->mapping_size);
+    memset(program, 0, sizeof(BytecodeProgram));
+}
+
+// Line of the statement instruction `pc` belongs to, 0 if unknown
+static int line_of(const BytecodeProgram* program, uint32_t pc) {
+    uint32_t low = 0;
+    uint32_t high = program->header->line_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (program->lines[middle].pc <= pc) low = middle + 1;
+        else high = middle;
+    }
+    return low > 0 ? (int)program->lines[low - 1].line : 0;
+}
+
+// ints are 32 bits wide in the language
+static int fits_int(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static int compare(int kind, double left, double right) {
+    switch (kind) {
+        case COMPARE_LESS: return left < right;
+        case COMPARE_GREATER: return left > right;
+        case COMPARE_LESS_EQUAL: return left <= right;
+        case COMPARE_GREATER_EQUAL: return left >= right;
+        case COMPARE_EQUAL: return left == right;
+        default: return left != right;
+    }
+}
+
+static int compare_int(int kind, int64_t left, int64_t right) {
+    switch (kind) {
+        case COMPARE_LESS: return left < right;
+        case COMPARE_GREATER: return left > right;
+        case COMPARE_LESS_EQUAL: return left <= right;
+        case COMPARE_GREATER_EQUAL: return left >= right;
+        case COMPARE_EQUAL: return left == right;
+        default: return left != right;
+    }
+}
+
+static RuntimeError print_factorial(int64_t n, FILE* out) {
+    if (n < 0) return RUNTIME_ERROR_NEGATIVE_ARGUMENT;
+    if (n > INT32_MAX) return RUNTIME_ERROR_INT_OVERFLOW;
+    if (n <= FACTORIAL_TABLE_MAX) {
+        fprintf(out, "%llu\n", (unsigned long long)runtime_factorial_u64((int)n));
+        return RUNTIME_OK;
+    }
+    const BigInt* value = runtime_factorial_big((int)n);
+    char* text = value ? bigint_to_string(value) : NULL;
+    if (!text) return RUNTIME_ERROR_OUT_OF_MEMORY;
+    fprintf(out, "%s\n", text);
+    free(text);
+    return RUNTIME_OK;
+}
+
+int bytecode_run(const BytecodeProgram* program, FILE* out) {
+    const BytecodeHeader* header = program->header;
+    const Instruction* code = program->code;
+    const Value* constants = program->constants;
+    Value* stack = mem_alloc(MEM_BYTECODE, (header->max_stack + 1) * sizeof(Value));
+    Value* globals = mem_calloc(MEM_BYTECODE, header->global_count + 1, sizeof(Value));
+    if (!stack || !globals) {
+        mem_free(MEM_BYTECODE, stack);
+        mem_free(MEM_BYTECODE, globals);
+        runtime_error(RUNTIME_ERROR_OUT_OF_MEMORY, 0);
+        return 0;
+    }
+
+    // The loader proved every operand and stack access in range
+    Value* top = stack;         // one past the top value
+    uint32_t pc = 0;
+    RuntimeError error = RUNTIME_OK;
+    for (;;) {
+        const Instruction* instruction = &code[pc++];
+        switch ((BytecodeOp)instruction->op) {
+            case OP_HALT:
+                goto done;
+            case OP_CONST:
+                *top++ = constants[instruction->arg];
+                break;
+            case OP_LOAD:
+                *top++ = globals[instruction->arg];
+                break;
+            case OP_STORE:
+                globals[instruction->arg] = *--top;
+                break;
+            case OP_INT_TO_FLOAT:
+                top[-1].f = (double)top[-1].i;
+                break;
+
+            case OP_ADD_INT:
+            case OP_SUB_INT:
+            case OP_MUL_INT: {
+                // Operands are 32 bits wide, so 64-bit arithmetic is exact
+                int64_t right = (int32_t)(*--top).i;
+                int64_t left = (int32_t)top[-1].i;
+                int64_t result = instruction->op == OP_ADD_INT ? left + right
+                               : instruction->op == OP_SUB_INT ? left - right
+                               : left * right;
+                if (!fits_int(result)) {
+                    error = RUNTIME_ERROR_INT_OVERFLOW;
+                    goto done;
+                }
+                top[-1].i = result;
+                break;
+            }
+            case OP_DIV_INT: {
+                int64_t right = (int32_t)(*--top).i;
+                int64_t left = (int32_t)top[-1].i;
+                if (right == 0) {
+                    error = RUNTIME_ERROR_DIVISION_BY_ZERO;
+                    goto done;
+                }
+                if (!fits_int(left / right)) {
+                    error = RUNTIME_ERROR_INT_OVERFLOW;
+                    goto done;
+                }
+                top[-1].i = left / right;
+                break;
+            }
+
+            case OP_ADD_FLOAT:
+                top--;
+                top[-1].f += top[0].f;
+                break;
+            case OP_SUB_FLOAT:
+                top--;
+                top[-1].f -= top[0].f;
+                break;
+            case OP_MUL_FLOAT:
+                top--;
+                top[-1].f *= top[0].f;
+                break;
+            case OP_DIV_FLOAT:
+                top--;
+                top[-1].f /= top[0].f;
+                break;
+
+            case OP_COMPARE_INT:
+                top--;
+                top[-1].i = compare_int(instruction->arg, top[-1].i, top[0].i);
+                break;
+            case OP_COMPARE_FLOAT:
+                top--;
+                top[-1].i = compare(instruction->arg, top[-1].f, top[0].f);
+                break;
+
+            case OP_JUMP:
+                pc = (uint32_t)instruction->arg;
+                break;
+            case OP_JUMP_IF_FALSE:
+                if ((*--top).i == 0) pc = (uint32_t)instruction->arg;
+                break;
+
+            case OP_PRINT_INT:
+                fprintf(out, "%lld\n", (long long)(*--top).i);
+                break;
+            case OP_PRINT_FLOAT:
+                fprintf(out, "%g\n", (*--top).f);
+                break;
+            case OP_PRINT_CHAR:
+                fputc((unsigned char)(*--top).i, out);
+                fputc('\n', out);
+                break;
+            case OP_PRINT_STRING:
+                fprintf(out, "%s\n", program->strings + instruction->arg);
+                break;
+            case OP_FACTORIAL:
+                error = print_factorial((*--top).i, out);
+                if (error != RUNTIME_OK) goto done;
+                break;
+
+            default:
+                // Rejected by the loader
+                goto done;
+        }
+    }
+
+done:
+    if (error != RUNTIME_OK) runtime_error(error, line_of(program, pc - 1));
+    mem_free(MEM_BYTECODE, stack);
+    mem_free(MEM_BYTECODE, globals);
+    return error == RUNTIME_OK;
+}
@@ -0,0 +1,431 @@
+/* diagnostics.c */
+#define _POSIX_C_SOURCE 200809L     // open_memstream
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/tokens.h"
+#include "../../include/parser.h"
+#include "../../include/semantic.h"
+#include "../../include/runtime.h"
+#include "../../include/budget.h"
+#include "../../include/diagnostics.h"
+#include "../../include/allocator.h"
+
+// Each thread reports into its own session
+static _Thread_local DiagnosticSession* active_session = NULL;
+
+static const char* phase_names[] = {
+    "Lexical",
+    "Parse",
+    "Semantic",
+    "Runtime",
+    "Limit"
+};
+
+static const char* phase_ids[] = {
+    "lexical",
+    "parse",
+    "semantic",
+    "runtime",
+    "limit"
+};
+
+static const char* lexical_codes[] = {
+    "ERROR_NONE",
+    "ERROR_INVALID_CHAR",
+    "ERROR_INVALID_NUMBER",
+    "ERROR_CONSECUTIVE_OPERATORS",
+    "ERROR_UNTERMINATED_STRING",
+    "ERROR_UNKNOWN_ESCAPE_SEQUENCE",
+    "ERROR_NUMBER_OVERFLOW",
+    "ERROR_FLOAT_OVERFLOW"
+};
+
+static const char* parse_codes[] = {
+    "PARSE_ERROR_NONE",
+    "PARSE_ERROR_UNEXPECTED_TOKEN",
+    "PARSE_ERROR_MISSING_SEMICOLON",
+    "PARSE_ERROR_MISSING_IDENTIFIER",
+    "PARSE_ERROR_MISSING_EQUALS",
+    "PARSE_ERROR_INVALID_EXPRESSION",
+    "PARSE_ERROR_MISSING_LPAREN",
+    "PARSE_ERROR_MISSING_RPAREN",
+    "PARSE_ERROR_MISSING_LBRACE",
+    "PARSE_ERROR_MISSING_RBRACE",
+    "PARSE_ERROR_MISSING_LBRACK",
+    "PARSE_ERROR_MISSING_RBRACK",
+    "PARSE_ERROR_MISSING_QUOTE",
+    "PARSE_ERROR_INVALID_STATEMENT",
+    "PARSE_ERROR_MISSING_UNTIL",
+    "PARSE_ERROR_INVALID_COMPARISON"
+};
+
+static const char* semantic_codes[] = {
+    "SEM_ERROR_NONE",
+    "SEM_ERROR_UNDECLARED_VARIABLE",
+    "SEM_ERROR_REDECLARED_VARIABLE",
+    "SEM_ERROR_TYPE_MISMATCH",
+    "SEM_ERROR_UNINITIALIZED_VARIABLE",
+    "SEM_ERROR_INVALID_OPERATION",
+    "SEM_ERROR_SEMANTIC_ERROR",
+    "SEM_ERROR_INVALID_CONDITION",
+    "SEM_ERROR_INVALID_PARAMETERS",
+    "SEM_ERROR_OUT_OF_MEMORY"
+};
+
+static const char* runtime_codes[] = {
+    "RUNTIME_OK",
+    "RUNTIME_ERROR_NEGATIVE_ARGUMENT",
+    "RUNTIME_ERROR_INT_OVERFLOW",
+    "RUNTIME_ERROR_OUT_OF_MEMORY",
+    "RUNTIME_ERROR_DIVISION_BY_ZERO"
+};
+
+static const char* limit_codes[] = {
+    "BUDGET_NONE",
+    "BUDGET_TOKENS",
+    "BUDGET_NODES",
+    "BUDGET_DEPTH",
+    "BUDGET_TIME",
+    "BUDGET_BYTES"
+};
+
+#define COUNT_OF(array) ((int)(sizeof(array) / sizeof((array)[0])))
+
+static const char* code_name(const Diagnostic* d) {
+    switch (d->phase) {
+        case DIAG_PHASE_LEXICAL:
+            if (d->code >= 0 && d->code < COUNT_OF(lexical_codes)) return lexical_codes[d->code];
+            break;
+        case DIAG_PHASE_PARSE:
+            if (d->code >= 0 && d->code < COUNT_OF(parse_codes)) return parse_codes[d->code];
+            break;
+        case DIAG_PHASE_SEMANTIC:
+            if (d->code >= 0 && d->code < COUNT_OF(semantic_codes)) return semantic_codes[d->code];
+            break;
+        case DIAG_PHASE_RUNTIME:
+            if (d->code >= 0 && d->code < COUNT_OF(runtime_codes)) return runtime_codes[d->code];
+            break;
+        case DIAG_PHASE_LIMIT:
+            if (d->code >= 0 && d->code < COUNT_OF(limit_codes)) return limit_codes[d->code];
+            break;
+    }
+    return "UNKNOWN";
+}
+
+void diag_session_init(DiagnosticSession* session, const char* file) {
+    memset(session, 0, sizeof(DiagnosticSession));
+    session->file = file;
+    session->enabled = 1;
+}
+
+void diag_session_free(DiagnosticSession* session) {
+    if (!session) return;
+    mem_free(MEM_DIAGNOSTICS, session->items);
+    session->items = NULL;
+    session->count = session->capacity = 0;
+}
+
+DiagnosticSession* diag_begin(DiagnosticSession* session) {
+    DiagnosticSession* previous = active_session;
+    active_session = session;
+    return previous;
+}
+
+void diag_end(DiagnosticSession* previous) {
+    active_session = previous;
+}
+
+DiagnosticSession* diag_active(void) {
+    return active_session;
+}
+
+static void write_text(const Diagnostic* d, FILE* out) {
+    char message[512];
+    diag_format_message(d, message, sizeof(message));
+    const char* label = d->severity == DIAG_ERROR ? "Error" : "Warning";
+    if (d->column > 0) {
+        fprintf(out, "%s %s at line %d, column %d: %s\n",
+                phase_names[d->phase], label, d->line, d->column, message);
+    } else {
+        fprintf(out, "%s %s at line %d: %s\n", phase_names[d->phase], label, d->line, message);
+    }
+}
+
+// The diagnostic with its position resolved through the session's line index
+static Diagnostic locate(const DiagnosticSession* session, const Diagnostic* d) {
+    Diagnostic located = *d;
+    if (session->lines && d->offset >= 0) {
+        line_index_position(session->lines, d->offset, &located.line, &located.column);
+    }
+    return located;
+}
+
+static void record(DiagnosticPhase phase, int code, DiagnosticSeverity severity,
+                   int line, int column, int offset, const char* arg) {
+    DiagnosticSession* session = active_session;
+
+    if (!session) {
+        // No session: behave like the old direct printf reporting
+        Diagnostic d = {severity, phase, code, NULL, line, column, offset, ""};
+        if (arg) strncpy(d.arg, arg, sizeof(d.arg) - 1);
+        write_text(&d, stdout);
+        return;
+    }
+
+    if (severity == DIAG_ERROR) session->error_count++;
+    else session->warning_count++;
+    if (!session->enabled) return;
+
+    if (session->count == session->capacity) {
+        int capacity = session->capacity ? session->capacity * 2 : 32;
+        Diagnostic* items = mem_realloc(MEM_DIAGNOSTICS, session->items, capacity * sizeof(Diagnostic));
+        if (!items) return;
+        session->items = items;
+        session->capacity = capacity;
+    }
+
+    Diagnostic* d = &session->items[session->count++];
+    d->severity = severity;
+    d->phase = phase;
+    d->code = code;
+    d->file = session->file;
+    d->line = line;
+    d->column = column;
+    d->offset = offset;
+    if (arg) {
+        strncpy(d->arg, arg, sizeof(d->arg) - 1);
+        d->arg[sizeof(d->arg) - 1] = '\0';
+    } else {
+        d->arg[0] = '\0';
+    }
+}
+
+void diag_report(DiagnosticPhase phase, int code, DiagnosticSeverity severity,
+                 int line, int column, const char* arg) {
+    record(phase, code, severity, line, column, -1, arg);
+}
+
+void diag_report_at(DiagnosticPhase phase, int code, DiagnosticSeverity severity,
+                    int line, int offset, const char* arg) {
+    record(phase, code, severity, line, 0, offset, arg);
+}
+
+void diag_format_message(const Diagnostic* d, char* buffer, size_t size) {
+    const char* arg = d->arg;
+
+    switch (d->phase) {
+        case DIAG_PHASE_LEXICAL:
+            switch (d->code) {
+                case ERROR_INVALID_CHAR:
+                    snprintf(buffer, size, "Invalid character '%s'", arg);
+                    return;
+                case ERROR_INVALID_NUMBER:
+                    snprintf(buffer, size, "Invalid number format");
+                    return;
+                case ERROR_CONSECUTIVE_OPERATORS:
+                    snprintf(buffer, size, "Consecutive operators not allowed");
+                    return;
+                case ERROR_UNKNOWN_ESCAPE_SEQUENCE:
+                    snprintf(buffer, size, "Unknown escape sequence");
+                    return;
+                case ERROR_UNTERMINATED_STRING:
+                    snprintf(buffer, size, "Unterminated string");
+                    return;
+                case ERROR_NUMBER_OVERFLOW:
+                    snprintf(buffer, size, "Integer literal '%s' does not fit in int", arg);
+                    return;
+                case ERROR_FLOAT_OVERFLOW:
+                    snprintf(buffer, size, "Float literal '%s' is too large", arg);
+                    return;
+            }
+            break;
+
+        case DIAG_PHASE_PARSE:
+            switch (d->code) {
+                case PARSE_ERROR_UNEXPECTED_TOKEN:
+                    snprintf(buffer, size, "Unexpected token '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_SEMICOLON:
+                    snprintf(buffer, size, "Missing semicolon after '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_IDENTIFIER:
+                    snprintf(buffer, size, "Expected identifier after '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_EQUALS:
+                    snprintf(buffer, size, "Expected '=' after '%s'", arg);
+                    return;
+                case PARSE_ERROR_INVALID_EXPRESSION:
+                    snprintf(buffer, size, "Invalid expression after '%s'", arg);
+                    return;
+                case PARSE_ERROR_INVALID_STATEMENT:
+                    snprintf(buffer, size, "Invalid statement after '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_LPAREN:
+                    snprintf(buffer, size, "Expected '(' after '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_RPAREN:
+                    snprintf(buffer, size, "Expected ')' after '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_LBRACE:
+                    snprintf(buffer, size, "Expected '{' after '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_RBRACE:
+                    snprintf(buffer, size, "Expected '}' after '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_LBRACK:
+                    snprintf(buffer, size, "Expected '[' after '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_RBRACK:
+                    snprintf(buffer, size, "Expected ']' after '%s'", arg);
+                    return;
+                case PARSE_ERROR_MISSING_UNTIL:
+                    snprintf(buffer, size, "Expected 'until' after '%s'", arg);
+                    return;
+                case PARSE_ERROR_INVALID_COMPARISON:
+                    snprintf(buffer, size, "Invalid comparison at '%s'", arg);
+                    return;
+            }
+            break;
+
+        case DIAG_PHASE_SEMANTIC:
+            switch (d->code) {
+                case SEM_ERROR_UNDECLARED_VARIABLE:
+                    snprintf(buffer, size, "Undeclared variable '%s'", arg);
+                    return;
+                case SEM_ERROR_REDECLARED_VARIABLE:
+                    snprintf(buffer, size, "Variable '%s' already declared in this scope", arg);
+                    return;
+                case SEM_ERROR_TYPE_MISMATCH:
+                    snprintf(buffer, size, "Type mismatch involving '%s'", arg);
+                    return;
+                case SEM_ERROR_UNINITIALIZED_VARIABLE:
+                    snprintf(buffer, size, "Variable '%s' may be used uninitialized", arg);
+                    return;
+                case SEM_ERROR_INVALID_OPERATION:
+                    snprintf(buffer, size, "Invalid operation involving '%s'", arg);
+                    return;
+                case SEM_ERROR_SEMANTIC_ERROR:
+                    snprintf(buffer, size, "Semantic error involving '%s'", arg);
+                    return;
+                case SEM_ERROR_INVALID_CONDITION:
+                    snprintf(buffer, size, "Invalid condition involving '%s'", arg);
+                    return;
+                case SEM_ERROR_INVALID_PARAMETERS:
+                    snprintf(buffer, size, "Invalid parameter(s) involving '%s'", arg);
+                    return;
+                case SEM_ERROR_OUT_OF_MEMORY:
+                    snprintf(buffer, size, "Out of memory during %s", arg);
+                    return;
+            }
+            snprintf(buffer, size, "Unknown semantic error with '%s'", arg);
+            return;
+
+        case DIAG_PHASE_RUNTIME:
+            switch (d->code) {
+                case RUNTIME_ERROR_NEGATIVE_ARGUMENT:
+                    snprintf(buffer, size, "Factorial of a negative number");
+                    return;
+                case RUNTIME_ERROR_INT_OVERFLOW:
+                    snprintf(buffer, size, "Result does not fit in 'int'");
+                    return;
+                case RUNTIME_ERROR_OUT_OF_MEMORY:
+                    snprintf(buffer, size, "Out of memory");
+                    return;
+                case RUNTIME_ERROR_DIVISION_BY_ZERO:
+                    snprintf(buffer, size, "Division by zero");
+                    return;
+            }
+            snprintf(buffer, size, "Unknown runtime error");
+            return;
+
+        case DIAG_PHASE_LIMIT:
+            switch (d->code) {
+                case BUDGET_TOKENS:
+                    snprintf(buffer, size, "Input has more than %s tokens", arg);
+                    return;
+                case BUDGET_NODES:
+                    snprintf(buffer, size, "Input needs more than %s syntax tree nodes", arg);
+                    return;
+                case BUDGET_DEPTH:
+                    snprintf(buffer, size, "Input nests deeper than %s levels", arg);
+                    return;
+                case BUDGET_TIME:
+                    snprintf(buffer, size, "Analysis took longer than %s ms", arg);
+                    return;
+                case BUDGET_BYTES:
+                    snprintf(buffer, size, "Analysis needed more than %s bytes", arg);
+                    return;
+            }
+            snprintf(buffer, size, "Unknown limit exceeded");
+            return;
+    }
+    snprintf(buffer, size, "Unknown error");
+}
+
+static void write_json_string(const char* text, FILE* out) {
+    fputc('"', out);
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        switch (*p) {
+            case '"':  fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '\n': fputs("\\n", out); break;
+            case '\t': fputs("\\t", out); break;
+            case '\r': fputs("\\r", out); break;
+            default:
+                if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+                else fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_json(const DiagnosticSession* session, FILE* out) {
+    char message[512];
+
+    fprintf(out, "{\"errors\":%d,\"warnings\":%d,\"diagnostics\":[",
+            session->error_count, session->warning_count);
+    for (int i = 0; i < session->count; i++) {
+        Diagnostic located = locate(session, &session->items[i]);
+        const Diagnostic* d = &located;
+        diag_format_message(d, message, sizeof(message));
+
+        fprintf(out, "%s{\"severity\":\"%s\",\"phase\":\"%s\",\"code\":\"%s\",\"file\":",
+                i ? "," : "",
+                d->severity == DIAG_ERROR ? "error" : "warning",
+                phase_ids[d->phase], code_name(d));
+        if (d->file) write_json_string(d->file, out);
+        else fputs("null", out);
+        fprintf(out, ",\"line\":%d,\"column\":%d,\"message\":", d->line, d->column);
+        write_json_string(message, out);
+        fputs(",\"args\":[", out);
+        write_json_string(d->arg, out);
+        fputs("]}", out);
+    }
+    fputs("]}\n", out);
+}
+
+void diag_write(const DiagnosticSession* session, DiagnosticFormat format, FILE* out) {
+    if (!session) return;
+
+    // Build the whole report in memory, then write it with a single call
+    char* text = NULL;
+    size_t length = 0;
+    FILE* buffer = open_memstream(&text, &length);
+    FILE* target = buffer ? buffer : out;
+
+    if (format == DIAG_FORMAT_JSON) {
+        write_json(session, target);
+    } else {
+        for (int i = 0; i < session->count; i++) {
+            Diagnostic located = locate(session, &session->items[i]);
+            write_text(&located, target);
+        }
+    }
+
+    if (buffer) {
+        fclose(buffer);
+        fwrite(text, 1, length, out);
+        free(text);
+    }
+}
@@ -0,0 +1,47 @@
+/* line_index.c */
+#include <string.h>
+#include "../../include/line_index.h"
+#include "../../include/allocator.h"
+
+int line_index_build(LineIndex* index, const char* text, int length) {
+    memset(index, 0, sizeof(*index));
+    index->length = length;
+
+    int capacity = 64;
+    index->starts = mem_alloc(MEM_DIAGNOSTICS, capacity * sizeof(int));
+    if (!index->starts) return 0;
+    index->starts[index->count++] = 0;
+    for (const char* p = text; (p = memchr(p, '\n', text + length - p)) != NULL; p++) {
+        if (index->count == capacity) {
+            capacity *= 2;
+            int* starts = mem_realloc(MEM_DIAGNOSTICS, index->starts, capacity * sizeof(int));
+            if (!starts) {
+                line_index_free(index);
+                return 0;
+            }
+            index->starts = starts;
+        }
+        index->starts[index->count++] = (int)(p - text) + 1;
+    }
+    return 1;
+}
+
+void line_index_position(const LineIndex* index, int offset, int* line, int* column) {
+    if (offset < 0) offset = 0;
+    if (offset > index->length) offset = index->length;
+
+    // Last line start at or before the offset
+    int low = 0, high = index->count - 1;
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (index->starts[mid] <= offset) low = mid;
+        else high = mid - 1;
+    }
+    *line = low + 1;
+    *column = offset - index->starts[low] + 1;
+}
+
+void line_index_free(LineIndex* index) {
+    mem_free(MEM_DIAGNOSTICS, index->starts);
+    memset(index, 0, sizeof(*index));
+}
@@ -0,0 +1,463 @@
+/* main.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../../include/parser.h"
+#include "../../include/lexer.h"
+#include "../../include/tokens.h"
+#include "../../include/semantic.h"
+#include "../../include/optimizer.h"
+#include "../../include/diagnostics.h"
+#include "../../include/stats.h"
+#include "../../include/trace.h"
+#include "../../include/allocator.h"
+#include "../../include/server.h"
+#include "../../include/bytecode.h"
+#include "../../include/runtime.h"
+#include "../../include/watch.h"
+#include "../../include/token_dump.h"
+#include "../../include/analysis.h"
+
+// Read a whole source file into a NUL-terminated buffer
+static char* read_source_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* buffer = mem_alloc(MEM_SOURCE, size + 1);
+    if (buffer) {
+        size_t read = fread(buffer, 1, size, file);
+        buffer[read] = '\0';
+    }
+    fclose(file);
+    return buffer;
+}
+
+static AnalysisOptions options;        // --jobs, --share and --max-*
+static Analyzer analyzer;
+static Analysis analysis;               // of the input being analyzed
+static int session_pending = 0;
+static DiagnosticFormat diagnostics_format = DIAG_FORMAT_TEXT;
+static const char* compile_path = NULL;    // --compile: where the bytecode goes
+static const char* tokens_path = NULL;     // --dump-tokens: where the token dump goes
+
+// Write what was recorded for the current input and start over for the next.
+// Also runs at exit, in case something bails out half way through an input.
+static void write_diagnostics(void) {
+    if (!session_pending) return;
+    session_pending = 0;
+    diag_write(&analysis.session, diagnostics_format, stdout);
+    analysis_free(&analysis);
+}
+
+static StatsFormat stats_format = STATS_FORMAT_TEXT;
+
+// Statistics go to stderr so they don't mix with the analyzer's output
+static void write_stats(void) {
+    stats_write(stats_current(), stats_format, stderr);
+}
+
+// Runs after every other exit handler, once everything has been released
+static void write_memory_report(void) {
+    mem_report(stderr);
+    mem_leak_report(stderr);
+}
+
+static void finish_trace(void) {
+    if (trace_enabled() && !trace_close()) {
+        fprintf(stderr, "Could not write the trace file\n");
+    }
+}
+
+static void free_analyzer(void) {
+    analyzer_free(&analyzer);
+}
+
+// Analyze one input; `name` is what diagnostics and trace spans refer to
+static int analyze_input(const char* name, const char* input, int optimize) {
+    TraceSpan file_span;
+    trace_span_begin(&file_span, "file", "file");
+
+    analysis_begin(&analysis, &analyzer, name, input);
+    session_pending = 1;
+
+    printf("Analyzing input:\n%s\n\n", input);
+
+    // Whether or not it parses: highlighters want the tokens of broken inputs too
+    if (tokens_path) {
+        TokenDump dump;
+        if (!token_dump_build(&dump, input)) {
+            printf("Could not dump the tokens of '%s'\n", name);
+        } else {
+            if (!token_dump_write_file(&dump, tokens_path)) printf("Could not write '%s'\n", tokens_path);
+            else printf("Wrote %u token(s) in %zu bytes to '%s'\n\n", dump.count, dump.size, tokens_path);
+            token_dump_free(&dump);
+        }
+    }
+    
+    // Lexical analysis and parsing
+    ASTNode* ast = analysis_parse(&analysis, &analyzer, input);
+
+    // A syntax error or an exceeded budget; the diagnostic says which
+    if (!ast) {
+        analysis_end(&analysis);
+        write_diagnostics();
+        printf("Parsing failed. Semantic analysis skipped.\n");
+        analyzer_reset(&analyzer);
+        trace_span_end(&file_span, name);
+        return 0;
+    }
+    
+    printf("AST created. Performing semantic analysis...\n\n");
+    if (options.hash_consing) {
+        printf("Hash-consing shared %d expression(s), reused %ld time(s), saving %zu bytes.\n\n",
+               analyzer.nodes.count, analyzer.nodes.reused, node_table_bytes_saved(&analyzer.nodes));
+    }
+    
+    // Semantic analysis
+    int result = analysis_check(&analysis, &analyzer, ast);
+    
+    // The optimizer and the bytecode compiler are bounded by the tree's size
+    analysis_end(&analysis);
+    write_diagnostics();
+    if (result) {
+        printf("Semantic analysis successful. No errors found.\n");
+    } else {
+        printf("Semantic analysis failed. Errors detected.\n");
+    }
+
+    if (result && optimize) {
+        TraceSpan optimize_span;
+        trace_span_begin(&optimize_span, "optimize", "phase");
+        STAT_TIMER_START(optimize_start);
+        int hoisted = optimize_loops(ast);
+        STAT_TIMER_STOP(optimize_start, STATS_PHASE_OPTIMIZE);
+        trace_span_end(&optimize_span, name);
+        printf("\nLoop-invariant code motion hoisted %d expression(s).\n", hoisted);
+        print_ast(ast, 0);
+    }
+
+    // With -O, of the optimized tree
+    if (result && compile_path) {
+        BytecodeImage image;
+        TraceSpan codegen_span;
+        trace_span_begin(&codegen_span, "codegen", "phase");
+        STAT_TIMER_START(codegen_start);
+        int compiled = bytecode_compile(ast, &analyzer.strings, &image);
+        STAT_TIMER_STOP(codegen_start, STATS_PHASE_CODEGEN);
+        trace_span_end(&codegen_span, name);
+        if (!compiled) {
+            printf("Could not compile '%s'\n", name);
+            result = 0;
+        } else {
+            if (!bytecode_write_file(&image, compile_path)) {
+                printf("Could not write '%s'\n", compile_path);
+                result = 0;
+            } else {
+                printf("Wrote %zu bytes of bytecode to '%s'\n", image.size, compile_path);
+            }
+            bytecode_image_free(&image);
+        }
+    }
+    
+    // Clean up; each input's literals and shared expressions are its own
+    free_ast(ast);
+    analyzer_reset(&analyzer);
+    trace_span_end(&file_span, name);
+    return result;
+}
+
+// Run a compiled program; nothing is lexed, parsed or checked
+static int run_bytecode(const char* path) {
+    BytecodeProgram program;
+    const char* error = NULL;
+    if (!bytecode_load_file(&program, path, &error)) {
+        printf("Could not load '%s': %s\n", path, error);
+        return 0;
+    }
+    // Running isn't analyzing: no budget applies
+    diag_session_init(&analysis.session, path);
+    DiagnosticSession* previous = diag_begin(&analysis.session);
+    session_pending = 1;
+    int ok = bytecode_run(&program, stdout);
+    diag_end(previous);
+    fflush(stdout);
+    write_diagnostics();
+    bytecode_unload(&program);
+    return ok;
+}
+
+// List the tokens of a dump; the source it was made from isn't needed
+static int read_token_dump(const char* path) {
+    TokenDumpReader reader;
+    const char* error = NULL;
+    if (!token_dump_open_file(&reader, path, &error)) {
+        printf("Could not load '%s': %s\n", path, error);
+        return 0;
+    }
+    printf("%s: %u token(s) of a %u-byte source\n", path, reader.count, reader.source_length);
+    DumpedToken token;
+    while (token_dump_next(&reader, &token)) {
+        printf("Token: %s | Span: %d-%d | Line: %d", token_type_name(token.type), token.start, token.end, token.line);
+        if (token.error != ERROR_NONE) printf(" | Lexical error %d", token.error);
+        printf("\n");
+    }
+    int ok = reader.error == NULL;
+    if (!ok) printf("Could not read '%s': %s\n", path, reader.error);
+    token_dump_close(&reader);
+    return ok;
+}
+
+// Syntax-check one input through the streaming lexer; "-" is stdin
+static int check_stream(const char* path) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Could not read '%s'\n", path);
+        return 0;
+    }
+    LexerStream stream;
+    if (!lexer_stream_open(&stream, fd, 1 << 16)) {
+        if (fd != STDIN_FILENO) close(fd);
+        return 0;
+    }
+
+    analysis_begin(&analysis, &analyzer, path, NULL);
+    session_pending = 1;
+    long statements = parse_stream(&stream);
+    analysis_end(&analysis);
+    write_diagnostics();
+
+    int ok = statements >= 0 && !stream.read_error;
+    if (stream.read_error) printf("%s: read error\n", path);
+    else if (ok) printf("%s: %ld statement(s), syntax OK\n", path, statements);
+    lexer_stream_close(&stream);
+    if (fd != STDIN_FILENO) close(fd);
+    return ok;
+}
+
+// Usage: analyzer [-O] [--diagnostics=text|json] [--stats[=json]] [--trace=FILE]
+//                 [--memory] [--server[=SOCKET]] [--stream] [--share] [--jobs=N]
+//                 [--compile=FILE] [--run] [--watch DIR] [--max-tokens=N]
+//                 [--max-nodes=N] [--max-depth=N] [--max-time=MS]
+//                 [--max-memory=BYTES] [--dump-tokens=FILE] [--tokens] [file...]
+//   -O                  run loop-invariant code motion after a successful analysis
+//   --share             hash-cons closed expressions while parsing (see parser.h)
+//   --jobs=N            check if/while/repeat statements on N threads (see parallel.h)
+//   --compile=FILE      write the bytecode of a program that passed the analysis
+//                       to FILE (see bytecode.h), after -O if given; takes a single input
+//   --run               the files are bytecode: run them instead of analyzing
+//   --dump-tokens=FILE  write the input's tokens to FILE in a compact binary
+//                       form (see token_dump.h); takes a single input
+//   --tokens            the files are token dumps: list their tokens
+//   --watch DIR         analyze every file in DIR, then again whenever one
+//                       changes, only redoing what the change affects (see watch.h)
+//   --max-tokens=N, --max-nodes=N, --max-depth=N, --max-time=MS, --max-memory=BYTES
+//                       give up on an input that needs more than this, report
+//                       it and go on with the next one (see budget.h). Depth
+//                       is limited to BUDGET_DEFAULT_MAX_DEPTH unless given;
+//                       0 lifts a limit
+//   --diagnostics=json  write diagnostics as JSON, one document per file
+//   --stats             dump the instrumentation counters (-DANALYZER_STATS builds)
+//   --trace=FILE        write a Chrome trace-event timeline of the run to FILE
+//   --memory            track allocations; report usage and leaks at exit
+//   --server[=SOCKET]   answer JSON-RPC requests on stdin/stdout, or on a
+//                       Unix domain socket (see server.h)
+//   --stream            only check syntax, reading each file ("-" for stdin)
+//                       in chunks; memory use doesn't grow with the input
+// Files are analyzed one after another; without any, a built-in sample is used.
+// --share, --jobs and the --max-* limits apply to --server and --watch too.
+int main(int argc, char** argv) {
+    int optimize = 0;
+    int stats = 0;
+    int memory = 0;
+    int server = 0;
+    int streaming = 0;
+    int running = 0;
+    int reading_tokens = 0;
+    const char* socket_path = NULL;
+    const char* trace_path = NULL;
+    const char* watch_path = NULL;
+    const char** paths = malloc(argc * sizeof(const char*));
+    int path_count = 0;
+    if (!paths) return 1;
+    analysis_default_options(&options);
+    options.print_symbols = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-O") == 0) optimize = 1;
+        else if (strcmp(argv[i], "--diagnostics=json") == 0) diagnostics_format = DIAG_FORMAT_JSON;
+        else if (strcmp(argv[i], "--diagnostics=text") == 0) diagnostics_format = DIAG_FORMAT_TEXT;
+        else if (strcmp(argv[i], "--stats") == 0) stats = 1;
+        else if (strcmp(argv[i], "--stats=json") == 0) {
+            stats = 1;
+            stats_format = STATS_FORMAT_JSON;
+        }
+        else if (strcmp(argv[i], "--memory") == 0) memory = 1;
+        else if (strcmp(argv[i], "--server") == 0) server = 1;
+        else if (strncmp(argv[i], "--server=", 9) == 0) {
+            server = 1;
+            socket_path = argv[i] + 9;
+        }
+        else if (strcmp(argv[i], "--stream") == 0) streaming = 1;
+        else if (strcmp(argv[i], "--share") == 0) options.hash_consing = 1;
+        else if (strncmp(argv[i], "--jobs=", 7) == 0) options.jobs = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--trace=", 8) == 0) trace_path = argv[i] + 8;
+        else if (strncmp(argv[i], "--compile=", 10) == 0) compile_path = argv[i] + 10;
+        else if (strcmp(argv[i], "--run") == 0) running = 1;
+        else if (strncmp(argv[i], "--dump-tokens=", 14) == 0) tokens_path = argv[i] + 14;
+        else if (strcmp(argv[i], "--tokens") == 0) reading_tokens = 1;
+        else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) watch_path = argv[++i];
+        else if (strncmp(argv[i], "--watch=", 8) == 0) watch_path = argv[i] + 8;
+        else if (strncmp(argv[i], "--max-tokens=", 13) == 0) options.limits.max_tokens = atol(argv[i] + 13);
+        else if (strncmp(argv[i], "--max-nodes=", 12) == 0) options.limits.max_nodes = atol(argv[i] + 12);
+        else if (strncmp(argv[i], "--max-depth=", 12) == 0) options.limits.max_depth = atoi(argv[i] + 12);
+        else if (strncmp(argv[i], "--max-time=", 11) == 0) options.limits.max_milliseconds = atol(argv[i] + 11);
+        else if (strncmp(argv[i], "--max-memory=", 13) == 0) options.limits.max_bytes = strtoull(argv[i] + 13, NULL, 10);
+        else paths[path_count++] = argv[i];
+    }
+
+    if (memory) {
+        // Before anything is allocated through mem_alloc()
+        mem_set_allocator(mem_tracking_allocator());
+        atexit(write_memory_report);
+    }
+
+    if (trace_path) {
+        if (!trace_open(trace_path)) {
+            printf("Could not open trace file '%s'\n", trace_path);
+            return 1;
+        }
+        trace_thread_name("main");
+    }
+
+    if (watch_path) {
+        int ok = watch_run(watch_path, diagnostics_format, &options);
+        if (!ok) fprintf(stderr, "Could not watch '%s'\n", watch_path);
+        free(paths);
+        return ok ? 0 : 1;
+    }
+
+    if (server) {
+        int ok = 1;
+        if (!socket_path) {
+            server_run_stdio(&options);
+        } else if (!server_run_socket(socket_path, &options)) {
+            fprintf(stderr, "Could not listen on '%s'\n", socket_path);
+            ok = 0;
+        }
+        free(paths);
+        return ok ? 0 : 1;
+    }
+
+    // Exit handlers run in reverse: diagnostics, stats, the trace, the
+    // analyzer's threads and tables, then memory
+    analyzer_init(&analyzer, &options);
+    atexit(free_analyzer);
+    atexit(finish_trace);
+    if (stats) atexit(write_stats);
+    atexit(write_diagnostics);
+
+    const char* valid_input = "int x;\n"
+                          "char test;\n"
+                          "test = \"a\";\n"  // Using a valid char assignment
+                          "x = test + 1;\n"
+                          "int expr;\n"
+                          "expr = 123;\n"
+                          "int foo;\n"
+                          "foo = 4;\n"
+                          "if (foo > 2) {\n"
+                          "   int z;\n"
+                          "   z = 10;\n"
+                          "}\n";
+
+    const char* invalid_input = "int x;\n"
+                            "int x;\n"  // Redeclaration error
+                            "y = 5;\n"  // Undeclared variable usage
+                            "if (x > 0) {\n"
+                            "    int y;\n"
+                            "    y = x + 10;\n"
+                            "    print y;\n"
+                            "}\n"
+                            "z = 10;\n"  // Undeclared variable usage
+                            "char test;\n"
+                            "test = \"123\";\n"  // Type mismatch
+                            "x = test + 1;\n"
+                            "char foo;\n"
+                            "if (foo > 2) {\n"
+                            "   int z;\n"
+                            "   z = 10;\n"
+                            "}\n"
+                            "char x;\n"
+                            "int expr;\n"
+                            "expr = 123;\n"
+                            "x = expr;\n"  // Type mismatch
+                            "char y;\n"
+                            "int num;\n"
+                            "y = \"hello\";\n"
+                            "num = 40;\n"
+                            "num = y < num;\n"  // Invalid operation
+                            "if (1) {\n"
+                            "    int scope_var;\n"
+                            "    scope_var = 10;\n"
+                            "}\n"
+                            "print scope_var;\n"  // Scope error
+                            "if (\"hello\") {\n"
+                            "    print \"bye\";\n"
+                            "}\n"  // Invalid condition
+                            "factorial(5 < 3);\n";  // Invalid function parameter
+    (void)invalid_input;
+
+    int status = 0;
+    if (streaming) {
+        for (int i = 0; i < path_count; i++) {
+            if (!check_stream(paths[i])) status = 1;
+        }
+        free(paths);
+        return status;
+    }
+    if (running) {
+        for (int i = 0; i < path_count; i++) {
+            if (!run_bytecode(paths[i])) status = 1;
+        }
+        runtime_free_factorial_cache();
+        free(paths);
+        return status;
+    }
+    if (reading_tokens) {
+        for (int i = 0; i < path_count; i++) {
+            if (!read_token_dump(paths[i])) status = 1;
+        }
+        free(paths);
+        return status;
+    }
+    if (compile_path && path_count > 1) {
+        printf("--compile takes a single input\n");
+        free(paths);
+        return 1;
+    }
+    if (tokens_path && path_count > 1) {
+        printf("--dump-tokens takes a single input\n");
+        free(paths);
+        return 1;
+    }
+    if (path_count == 0) {
+        if (!analyze_input("<input>", valid_input, optimize)) status = 1;
+    }
+    for (int i = 0; i < path_count; i++) {
+        char* file_input = read_source_file(paths[i]);
+        if (!file_input) {
+            printf("Could not read '%s'\n", paths[i]);
+            status = 1;
+            continue;
+        }
+        if (!analyze_input(paths[i], file_input, optimize)) status = 1;
+        mem_free(MEM_SOURCE, file_input);
+    }
+
+    free(paths);
+    return status;
+}
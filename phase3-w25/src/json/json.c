@@ -0,0 +1,334 @@
+/* json.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/json.h"
+#include "../../include/allocator.h"
+
+// Deeper documents are rejected rather than risking the stack
+#define JSON_MAX_DEPTH 64
+
+typedef struct {
+    const char* text;
+    size_t length;
+    size_t pos;
+} JsonReader;
+
+static int parse_value(JsonReader* reader, JsonValue* out, int depth);
+
+static void skip_whitespace(JsonReader* reader) {
+    while (reader->pos < reader->length) {
+        char c = reader->text[reader->pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+        reader->pos++;
+    }
+}
+
+static int peek(JsonReader* reader) {
+    return reader->pos < reader->length ? (unsigned char)reader->text[reader->pos] : -1;
+}
+
+static int consume_literal(JsonReader* reader, const char* literal) {
+    size_t n = strlen(literal);
+    if (reader->length - reader->pos < n || strncmp(reader->text + reader->pos, literal, n) != 0) {
+        return 0;
+    }
+    reader->pos += n;
+    return 1;
+}
+
+static int hex_digit(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int read_hex4(JsonReader* reader, unsigned int* code) {
+    if (reader->length - reader->pos < 4) return 0;
+    *code = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_digit((unsigned char)reader->text[reader->pos++]);
+        if (digit < 0) return 0;
+        *code = (*code << 4) | (unsigned int)digit;
+    }
+    return 1;
+}
+
+static size_t encode_utf8(unsigned int code, char* out) {
+    if (code < 0x80) {
+        out[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = (char)(0xC0 | (code >> 6));
+        out[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        out[0] = (char)(0xE0 | (code >> 12));
+        out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (code >> 18));
+    out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+// Reads a string starting at the opening quote. The decoded text is never
+// longer than the escaped text, so one allocation of that size is enough.
+static char* parse_string(JsonReader* reader, size_t* length) {
+    reader->pos++; // opening quote
+    size_t start = reader->pos;
+    size_t end = start;
+    while (end < reader->length && reader->text[end] != '"') {
+        if (reader->text[end] == '\\') end++;
+        end++;
+    }
+    if (end >= reader->length) return NULL;
+
+    char* out = mem_alloc(MEM_SERVER, end - start + 1);
+    if (!out) return NULL;
+    size_t n = 0;
+    while (reader->pos < end) {
+        unsigned char c = (unsigned char)reader->text[reader->pos++];
+        if (c < 0x20) goto fail;
+        if (c != '\\') {
+            out[n++] = (char)c;
+            continue;
+        }
+        c = (unsigned char)reader->text[reader->pos++];
+        switch (c) {
+            case '"': out[n++] = '"'; break;
+            case '\\': out[n++] = '\\'; break;
+            case '/': out[n++] = '/'; break;
+            case 'b': out[n++] = '\b'; break;
+            case 'f': out[n++] = '\f'; break;
+            case 'n': out[n++] = '\n'; break;
+            case 'r': out[n++] = '\r'; break;
+            case 't': out[n++] = '\t'; break;
+            case 'u': {
+                unsigned int code;
+                if (!read_hex4(reader, &code)) goto fail;
+                // Surrogate pair
+                if (code >= 0xD800 && code <= 0xDBFF && reader->pos + 1 < end &&
+                    reader->text[reader->pos] == '\\' && reader->text[reader->pos + 1] == 'u') {
+                    unsigned int low;
+                    reader->pos += 2;
+                    if (!read_hex4(reader, &low) || low < 0xDC00 || low > 0xDFFF) goto fail;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                // Six escaped bytes always cover the (at most four) UTF-8 bytes
+                n += encode_utf8(code, out + n);
+                break;
+            }
+            default:
+                goto fail;
+        }
+    }
+    reader->pos = end + 1; // closing quote
+    out[n] = '\0';
+    *length = n;
+    return out;
+
+fail:
+    mem_free(MEM_SERVER, out);
+    return NULL;
+}
+
+static int parse_number(JsonReader* reader, JsonValue* out) {
+    const char* start = reader->text + reader->pos;
+    char* end;
+    // The buffer isn't necessarily NUL-terminated after the number; copy it
+    size_t n = 0;
+    while (reader->pos + n < reader->length && n < 63 &&
+           strchr("+-0123456789.eE", reader->text[reader->pos + n])) {
+        n++;
+    }
+    char buffer[64];
+    memcpy(buffer, start, n);
+    buffer[n] = '\0';
+    out->number = strtod(buffer, &end);
+    if (end == buffer) return 0;
+    reader->pos += (size_t)(end - buffer);
+    out->type = JSON_NUMBER;
+    return 1;
+}
+
+// Appends to a growable array of values (and keys, for objects)
+static int append_member(JsonValue* container, int* capacity, char* key, JsonValue* value) {
+    if (container->count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 4;
+        JsonValue* items = mem_realloc(MEM_SERVER, container->items, grown * sizeof(JsonValue));
+        if (!items) return 0;
+        container->items = items;
+        if (container->type == JSON_OBJECT) {
+            char** keys = mem_realloc(MEM_SERVER, container->keys, grown * sizeof(char*));
+            if (!keys) return 0;
+            container->keys = keys;
+        }
+        *capacity = grown;
+    }
+    if (container->type == JSON_OBJECT) container->keys[container->count] = key;
+    container->items[container->count++] = *value;
+    return 1;
+}
+
+static void free_contents(JsonValue* value);
+
+static int parse_container(JsonReader* reader, JsonValue* out, int depth) {
+    int object = peek(reader) == '{';
+    char close = object ? '}' : ']';
+    int capacity = 0;
+    out->type = object ? JSON_OBJECT : JSON_ARRAY;
+    reader->pos++;
+
+    skip_whitespace(reader);
+    if (peek(reader) == close) {
+        reader->pos++;
+        return 1;
+    }
+    for (;;) {
+        char* key = NULL;
+        size_t key_length;
+        skip_whitespace(reader);
+        if (object) {
+            if (peek(reader) != '"' || !(key = parse_string(reader, &key_length))) return 0;
+            skip_whitespace(reader);
+            if (peek(reader) != ':') {
+                mem_free(MEM_SERVER, key);
+                return 0;
+            }
+            reader->pos++;
+        }
+
+        JsonValue member;
+        if (!parse_value(reader, &member, depth + 1)) {
+            mem_free(MEM_SERVER, key);
+            return 0;
+        }
+        if (!append_member(out, &capacity, key, &member)) {
+            mem_free(MEM_SERVER, key);
+            free_contents(&member);
+            return 0;
+        }
+
+        skip_whitespace(reader);
+        int c = peek(reader);
+        reader->pos++;
+        if (c == close) return 1;
+        if (c != ',') return 0;
+    }
+}
+
+static int parse_value(JsonReader* reader, JsonValue* out, int depth) {
+    memset(out, 0, sizeof(*out));
+    if (depth > JSON_MAX_DEPTH) return 0;
+    skip_whitespace(reader);
+    switch (peek(reader)) {
+        case '{':
+        case '[':
+            if (parse_container(reader, out, depth)) return 1;
+            free_contents(out);
+            return 0;
+        case '"':
+            out->type = JSON_STRING;
+            out->string = parse_string(reader, &out->length);
+            return out->string != NULL;
+        case 't':
+            out->type = JSON_BOOL;
+            out->boolean = 1;
+            return consume_literal(reader, "true");
+        case 'f':
+            out->type = JSON_BOOL;
+            return consume_literal(reader, "false");
+        case 'n':
+            out->type = JSON_NULL;
+            return consume_literal(reader, "null");
+        default:
+            return parse_number(reader, out);
+    }
+}
+
+static void free_contents(JsonValue* value) {
+    if (value->type == JSON_STRING) mem_free(MEM_SERVER, value->string);
+    if (value->type == JSON_ARRAY || value->type == JSON_OBJECT) {
+        for (int i = 0; i < value->count; i++) {
+            free_contents(&value->items[i]);
+            if (value->keys) mem_free(MEM_SERVER, value->keys[i]);
+        }
+        mem_free(MEM_SERVER, value->items);
+        mem_free(MEM_SERVER, value->keys);
+    }
+}
+
+JsonValue* json_parse(const char* text, size_t length) {
+    JsonReader reader = {text, length, 0};
+    JsonValue* value = mem_alloc(MEM_SERVER, sizeof(JsonValue));
+    if (!value) return NULL;
+    if (!parse_value(&reader, value, 0)) {
+        mem_free(MEM_SERVER, value);
+        return NULL;
+    }
+    skip_whitespace(&reader);
+    if (reader.pos != reader.length) {
+        json_free(value);
+        return NULL;
+    }
+    return value;
+}
+
+void json_free(JsonValue* value) {
+    if (!value) return;
+    free_contents(value);
+    mem_free(MEM_SERVER, value);
+}
+
+const JsonValue* json_get(const JsonValue* object, const char* key) {
+    if (!object || object->type != JSON_OBJECT) return NULL;
+    for (int i = 0; i < object->count; i++) {
+        if (strcmp(object->keys[i], key) == 0) return &object->items[i];
+    }
+    return NULL;
+}
+
+const char* json_get_string(const JsonValue* object, const char* key) {
+    const JsonValue* value = json_get(object, key);
+    return value && value->type == JSON_STRING ? value->string : NULL;
+}
+
+void json_write_string(const char* text, FILE* out) {
+    fputc('"', out);
+    for (const char* p = text; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c == '\n') fputs("\\n", out);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+void json_write_scalar(const JsonValue* value, FILE* out) {
+    if (!value) {
+        fputs("null", out);
+        return;
+    }
+    switch (value->type) {
+        case JSON_BOOL:
+            fputs(value->boolean ? "true" : "false", out);
+            break;
+        case JSON_NUMBER:
+            fprintf(out, "%.17g", value->number);
+            break;
+        case JSON_STRING:
+            json_write_string(value->string, out);
+            break;
+        default:
+            fputs("null", out);
+            break;
+    }
+}
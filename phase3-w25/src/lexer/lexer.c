@@ -3,32 +3,80 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
 #include "../../include/tokens.h"
+#include "../../include/lexer.h"
+#include "../../include/diagnostics.h"
+#include "../../include/stats.h"
+#include "../../include/allocator.h"
+#include "../../include/float_literal.h"
 
-// Line tracking
+// Lexer state carried from one token to the next
 static int current_line = 1;
-static char last_token_type = 'x'; // For checking consecutive operators
+static LexerMode current_mode = LEX_MODE_CODE;
+// Offset where the last scanned token begins, past whitespace and comments
+static int token_start = 0;
 
-/* Print error messages for lexical errors */
+void lexer_set_line(int line) {
+    current_line = line;
+    current_mode = LEX_MODE_CODE;
+}
+
+void lexer_reset(void) {
+    lexer_set_line(1);
+}
+
+LexerState lexer_save_state(void) {
+    LexerState state = {current_line, current_mode};
+    return state;
+}
+
+void lexer_restore_state(LexerState state) {
+    current_line = state.line;
+    current_mode = state.mode;
+}
+
+/* Report a lexical error to the active diagnostics session */
 void print_error(ErrorType error, int line, const char *lexeme) {
-    printf("Lexical Error at line %d: ", line);
-    switch (error) {
-        case ERROR_INVALID_CHAR:
-            printf("Invalid character '%s'\n", lexeme);
-            break;
-        case ERROR_INVALID_NUMBER:
-            printf("Invalid number format\n");
-            break;
-        case ERROR_CONSECUTIVE_OPERATORS:
-            printf("Consecutive operators not allowed\n");
-            break;
-        case ERROR_UNKNOWN_ESCAPE_SEQUENCE:
-            printf("Unknown escape sequence\n");
-            break;
-        case ERROR_UNTERMINATED_STRING:
-            printf("Unterminated string\n");
-        default:
-            printf("Unknown error\n");
+    diag_report(DIAG_PHASE_LEXICAL, error, DIAG_ERROR, line, 0, lexeme);
+}
+
+const char *token_type_name(TokenType type) {
+    switch (type) {
+        case TOKEN_STRING_LITERAL:  return "STRING";
+        case TOKEN_NUMBER:          return "NUMBER";
+        case TOKEN_FLOAT_LITERAL:   return "FLOAT_LITERAL";
+        case TOKEN_OPERATOR:        return "OPERATOR";
+        case TOKEN_COMPARISON:      return "COMPARISON";
+        case TOKEN_IDENTIFIER:      return "IDENTIFIER";
+        case TOKEN_EQUALS:          return "EQUALS";
+        case TOKEN_SEMICOLON:       return "SEMICOLON";
+        case TOKEN_LPAREN:          return "LPAREN";
+        case TOKEN_RPAREN:          return "RPAREN";
+        case TOKEN_LBRACE:          return "LBRACE";
+        case TOKEN_RBRACE:          return "RBRACE";
+        case TOKEN_LBRACK:          return "LBRACK";
+        case TOKEN_RBRACK:          return "RBRACK";
+        case TOKEN_IF:              return "IF";
+        case TOKEN_ELSE:            return "ELSE";
+        case TOKEN_REPEAT:          return "REPEAT";
+        case TOKEN_UNTIL:           return "UNTIL";
+        case TOKEN_FOR:             return "FOR";
+        case TOKEN_WHILE:           return "WHILE";
+        case TOKEN_BREAK:           return "BREAK";
+        case TOKEN_RETURN:          return "RETURN";
+        case TOKEN_VOID:            return "VOID";
+        case TOKEN_CONST:           return "CONST";
+        case TOKEN_INT:             return "INT";
+        case TOKEN_FLOAT:           return "FLOAT";
+        case TOKEN_CHAR:            return "CHAR";
+        case TOKEN_PRINT:           return "PRINT";
+        case TOKEN_FACTORIAL:       return "FACTORIAL";
+        case TOKEN_EOF:             return "EOF";
+        case TOKEN_ERROR:           return "ERROR";
+        default:                    return "UNKNOWN";
     }
 }
 
@@ -43,37 +91,7 @@ void print_token(Token token) {
         return;
     }
 
-    printf("Token: ");
-    switch (token.type) {
-        case TOKEN_STRING_LITERAL: printf("STRING"); break;
-        case TOKEN_NUMBER:      printf("NUMBER"); break;
-        case TOKEN_OPERATOR:    printf("OPERATOR"); break;
-        case TOKEN_COMPARISON:  printf("COMPARISON"); break;
-        case TOKEN_IDENTIFIER:  printf("IDENTIFIER"); break;
-        case TOKEN_EQUALS:      printf("EQUALS"); break;
-        case TOKEN_SEMICOLON:   printf("SEMICOLON"); break;
-        case TOKEN_LPAREN:      printf("LPAREN"); break;
-        case TOKEN_RPAREN:      printf("RPAREN"); break;
-        case TOKEN_LBRACE:      printf("LBRACE"); break;
-        case TOKEN_RBRACE:      printf("RBRACE"); break;
-        case TOKEN_LBRACK:      printf("LBRACK"); break;
-        case TOKEN_RBRACK:      printf("RBRACK"); break;
-        case TOKEN_IF:          printf("IF"); break;
-        case TOKEN_ELSE:        printf("ELSE"); break;
-        case TOKEN_REPEAT:      printf("REPEAT"); break;
-        case TOKEN_UNTIL:       printf("UNTIL"); break;
-        case TOKEN_FOR:         printf("FOR"); break;
-        case TOKEN_BREAK:       printf("BREAK"); break;
-        case TOKEN_VOID:        printf("VOID"); break;
-        case TOKEN_CONST:       printf("CONST"); break;
-        case TOKEN_INT:         printf("INT"); break;
-        case TOKEN_FLOAT:       printf("FLOAT"); break;
-        case TOKEN_CHAR:        printf("CHAR"); break;
-        case TOKEN_PRINT:       printf("PRINT"); break;
-        case TOKEN_FACTORIAL:   printf("FACTORIAL"); break;
-        case TOKEN_EOF:         printf("EOF"); break;
-        default:                printf("UNKNOWN");
-    }
+    printf("Token: %s", token_type_name(token.type));
     printf(" | Lexeme: '%s' | Line: %d\n",
            token.lexeme, token.line);
 }
@@ -137,13 +155,68 @@ int is_operator_char(char c) {
 }
 
 
-/* Get next token from input */
-Token get_next_token(const char *input, int *pos) {
-    Token token = {TOKEN_ERROR, "", current_line, ERROR_NONE};
+// Appends a float literal's fraction ('.' and digits) or exponent ('e', an
+// optional sign, digits) to the lexeme, as far as it has room. Returns the
+// new lexeme length and sets `*digits` to the number of digits taken.
+static int scan_float_part(const char *input, int *pos, char *lexeme, int idx, int *digits) {
+    const int limit = sizeof(((Token *)0)->lexeme) - 1;
+    *digits = 0;
+    if (idx >= limit) return idx;
+    char marker = input[*pos];
+    lexeme[idx++] = input[(*pos)++];
+    if (marker != '.' && (input[*pos] == '+' || input[*pos] == '-') && idx < limit) {
+        lexeme[idx++] = input[(*pos)++];
+    }
+    while (isdigit((unsigned char)input[*pos]) && idx < limit) {
+        lexeme[idx++] = input[(*pos)++];
+        (*digits)++;
+    }
+    return idx;
+}
+
+/* Skip the rest of a block comment; stays in comment mode if the input ends first */
+static void skip_block_comment(const char *input, int *pos) {
+    char c = input[*pos];
+    while (c != '\0' && !(c == '*' && input[*pos + 1] == '/')) {
+        // A final '*' may be closed by the next input's '/'
+        if (c == '*' && input[*pos + 1] == '\0') break;
+        if (c == '\n') current_line++;
+        (*pos)++;
+        c = input[*pos];
+    }
+    if (c == '*' && input[*pos + 1] == '/') {
+        // skip closing */
+        (*pos) += 2;
+        current_mode = LEX_MODE_CODE;
+    } else {
+        current_mode = LEX_MODE_BLOCK_COMMENT;
+    }
+}
+
+/* Skip to the end of a line comment, leaving the newline */
+static void skip_line_comment(const char *input, int *pos) {
+    while (input[*pos] != '\0' && input[*pos] != '\n') (*pos)++;
+    current_mode = input[*pos] == '\0' ? LEX_MODE_LINE_COMMENT : LEX_MODE_CODE;
+}
+
+/* Scan the next token from input */
+static Token scan_token(const char *input, int *pos) {
+    Token token = {TOKEN_ERROR, "", current_line, ERROR_NONE, *pos, 0, 0.0};
     char c;
 
     int idx = 0;
 
+    // Resuming inside a comment that an earlier input ended in
+    if (current_mode == LEX_MODE_BLOCK_COMMENT) skip_block_comment(input, pos);
+    if (current_mode == LEX_MODE_LINE_COMMENT) skip_line_comment(input, pos);
+    if (current_mode != LEX_MODE_CODE) {
+        token.type = TOKEN_EOF;
+        token.offset = *pos;
+        strcpy(token.lexeme, "EOF");
+        return token;
+    }
+    token.line = current_line;
+
     // Skip whitespace and track line numbers
     while ((c = input[*pos]) != '\0' && (c == ' ' || c == '\n' || c == '\t')) {
         if (c == '\n') {
@@ -155,6 +228,7 @@ Token get_next_token(const char *input, int *pos) {
 
     if (input[*pos] == '\0') {
         token.type = TOKEN_EOF;
+        token.offset = *pos;
         strcpy(token.lexeme, "EOF");
         return token;
     }
@@ -165,48 +239,69 @@ Token get_next_token(const char *input, int *pos) {
     if (c == '/' && input[*pos + 1] == '/') {
         // single-line comment, skip until newline or end of input
         (*pos) += 2;
-        c = input[*pos];
-
-        while (c != '\0' && c != '\n') {
-            (*pos)++;
-            c = input[*pos];
-        }
+        skip_line_comment(input, pos);
         // recurse here to get the next toke
-        return get_next_token(input, pos);
+        return scan_token(input, pos);
     }
     if (c == '/' && input[*pos + 1] == '*') {
         // multi-line comment, skip until */ or end of input
         (*pos) += 2;
-        c = input[*pos];
-
-        while (c != '\0' && !(c == '*' && input[*pos + 1] == '/')) {
-            (*pos)++;
-            c = input[*pos];
-        }
-        if (c != '\0') {
-            // skip closing */
-            (*pos) += 2;
-        }
+        skip_block_comment(input, pos);
         // recurse to get next token
-        return get_next_token(input, pos);
+        return scan_token(input, pos);
     }
 
+    token_start = *pos;
+    token.offset = token_start;
+
     // Handle numbers
     if (isdigit(c)) {
+        // The value is accumulated while scanning, saturating at INT_MAX
+        int value = 0;
+        int overflow = 0;
         while (isdigit(c)) {
+            int digit = c - '0';
+            if (value > (INT_MAX - digit) / 10) overflow = 1;
+            else value = value * 10 + digit;
             token.lexeme[idx++] = c;
             (*pos)++;
             c = input[*pos];
             if (idx >= (int)sizeof(token.lexeme) - 1) break;
         }
+        token.value = overflow ? INT_MAX : value;
+
+        // A fraction or an exponent makes it a float literal. Both are taken
+        // greedily, so a literal cut off by the end of a stream chunk ends
+        // there and gets scanned again.
+        int is_float = 0;
+        int malformed = 0;
+        int digits;
+        if (c == '.') {
+            is_float = 1;
+            idx = scan_float_part(input, pos, token.lexeme, idx, &digits);
+            c = input[*pos];
+        }
+        if (c == 'e' || c == 'E') {
+            is_float = 1;
+            idx = scan_float_part(input, pos, token.lexeme, idx, &digits);
+            malformed = digits == 0;    // an exponent needs at least one digit
+            c = input[*pos];
+        }
         token.lexeme[idx] = '\0';
+
         // Optional: check next char to ensure valid number format
         // e.g., 123abc => ERROR_INVALID_NUMBER
-        if (isalpha(c)) {
+        if (isalpha(c) || malformed) {
             token.type = TOKEN_ERROR;
             token.error = ERROR_INVALID_NUMBER;
+        } else if (is_float) {
+            // Overflow is reported by the parser, like for integers
+            token.type = TOKEN_FLOAT_LITERAL;
+            if (!parse_float_literal(token.lexeme, &token.real)) token.error = ERROR_FLOAT_OVERFLOW;
         } else {
+            // Still a number, so parsing goes on; the error is reported by the parser
             token.type = TOKEN_NUMBER;
+            if (overflow) token.error = ERROR_NUMBER_OVERFLOW;
         }
         return token;
     }
@@ -241,6 +336,7 @@ Token get_next_token(const char *input, int *pos) {
             if (c == '\\') {
                 (*pos)++;
                 c = input[*pos];
+                if (c == '\0') break; // input ends inside the escape
                 switch (c) {
                     case 'n':
                         token.lexeme[idx++] = '\n';
@@ -259,6 +355,7 @@ Token get_next_token(const char *input, int *pos) {
                         token.lexeme[idx++] = c;
                 }
             } else {
+                if (c == '\n') current_line++;
                 token.lexeme[idx++] = c;
             }
             (*pos)++;
@@ -329,6 +426,226 @@ Token get_next_token(const char *input, int *pos) {
     return token;
 }
 
+/* Get next token from input */
+Token get_next_token(const char *input, int *pos) {
+    Token token = scan_token(input, pos);
+    STAT_TOKEN(token.type);
+    return token;
+}
+
+static int reserve_tokens(TokenList *list, int needed) {
+    if (needed <= list->capacity) return 1;
+    int capacity = list->capacity ? list->capacity : 256;
+    while (capacity < needed) capacity *= 2;
+    LexedToken *tokens = mem_realloc(MEM_SOURCE, list->tokens, capacity * sizeof(LexedToken));
+    if (!tokens) return 0;
+    list->tokens = tokens;
+    list->capacity = capacity;
+    return 1;
+}
+
+// First token whose end is at least `offset`; tokens are sorted
+static int first_token_ending_at(const TokenList *list, int offset) {
+    int low = 0, high = list->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (list->tokens[mid].end < offset) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+int token_list_init(TokenList *list, const char *text) {
+    memset(list, 0, sizeof(*list));
+    list->length = (int)strlen(text);
+    list->source = mem_alloc(MEM_SOURCE, list->length + 1);
+    if (!list->source) return 0;
+    memcpy(list->source, text, list->length + 1);
+    // Relexing everything is an edit that changes nothing in an empty list
+    if (token_list_edit(list, 0, 0, "") < 0) {
+        token_list_free(list);
+        return 0;
+    }
+    return 1;
+}
+
+int token_list_edit(TokenList *list, int offset, int removed, const char *inserted) {
+    int inserted_length = (int)strlen(inserted);
+    if (offset < 0 || removed < 0 || offset + removed > list->length) return -1;
+    int edit_end = offset + removed;        // in old coordinates
+    int delta = inserted_length - removed;
+
+    int new_length = list->length + delta;
+    char *text = mem_alloc(MEM_SOURCE, new_length + 1);
+    if (!text) return -1;
+    memcpy(text, list->source, offset);
+    memcpy(text + offset, inserted, inserted_length);
+    memcpy(text + offset + inserted_length, list->source + edit_end, list->length - edit_end + 1);
+
+    // A token ending right at the edit may grow into it ("ab" + "c"), so
+    // resume after the last token that ends strictly before it
+    int first = first_token_ending_at(list, offset);
+    int resume = first > 0 ? list->tokens[first - 1].end : 0;
+    LexerState initial = {1, LEX_MODE_CODE};
+    LexerState state = first > 0 ? list->tokens[first - 1].after : initial;
+
+    // New tokens go into a scratch array until we know how many replace what
+    LexedToken *scanned = NULL;
+    int scanned_count = 0, scanned_capacity = 0;
+    int sync = first;       // old tokens before `sync` end before the new scan
+    int synced = 0;
+    int line_delta = 0;
+
+    LexerState saved = lexer_save_state();
+    lexer_restore_state(state);
+    int pos = resume;
+    for (;;) {
+        Token token = scan_token(text, &pos);
+        if (token.type == TOKEN_EOF) break;
+        if (scanned_count == scanned_capacity) {
+            int capacity = scanned_capacity ? scanned_capacity * 2 : 16;
+            LexedToken *grown = mem_realloc(MEM_SOURCE, scanned, capacity * sizeof(LexedToken));
+            if (!grown) {
+                lexer_restore_state(saved);
+                mem_free(MEM_SOURCE, scanned);
+                mem_free(MEM_SOURCE, text);
+                return -1;
+            }
+            scanned = grown;
+            scanned_capacity = capacity;
+        }
+        LexedToken *lexed = &scanned[scanned_count++];
+        lexed->type = token.type;
+        lexed->error = token.error;
+        lexed->end = pos;
+        lexed->line = token.line;
+        lexed->after = lexer_save_state();
+        lexed->start = token_start;
+
+        // Past the edit, an old token ending at the same place in the same
+        // mode means everything after it lexes exactly as before
+        while (sync < list->count && list->tokens[sync].end + delta < pos) sync++;
+        if (sync < list->count && list->tokens[sync].end + delta == pos &&
+            list->tokens[sync].end >= edit_end && list->tokens[sync].after.mode == lexed->after.mode) {
+            line_delta = lexed->after.line - list->tokens[sync].after.line;
+            sync++;
+            synced = 1;
+            break;
+        }
+    }
+    lexer_restore_state(saved);
+    if (!synced) sync = list->count;
+
+    int new_count = list->count - (sync - first) + scanned_count;
+    if (!reserve_tokens(list, new_count)) {
+        mem_free(MEM_SOURCE, scanned);
+        mem_free(MEM_SOURCE, text);
+        return -1;
+    }
+    if (sync < list->count) {
+        memmove(&list->tokens[first + scanned_count], &list->tokens[sync],
+                (list->count - sync) * sizeof(LexedToken));
+    }
+    for (int i = first + scanned_count; i < new_count; i++) {
+        LexedToken *moved = &list->tokens[i];
+        moved->start += delta;
+        moved->end += delta;
+        moved->line += line_delta;
+        moved->after.line += line_delta;
+    }
+    if (scanned_count > 0) memcpy(&list->tokens[first], scanned, scanned_count * sizeof(LexedToken));
+    list->count = new_count;
+    mem_free(MEM_SOURCE, scanned);
+
+    mem_free(MEM_SOURCE, list->source);
+    list->source = text;
+    list->length = new_length;
+    return scanned_count;
+}
+
+void token_list_free(TokenList *list) {
+    mem_free(MEM_SOURCE, list->tokens);
+    mem_free(MEM_SOURCE, list->source);
+    memset(list, 0, sizeof(*list));
+}
+
+/* Streaming input */
+
+// Drop the first `keep` bytes of the window, then read what fits. Returns the
+// number of bytes read, 0 at the end of the input.
+static int refill(LexerStream *stream, int keep) {
+    memmove(stream->buffer, stream->buffer + keep, stream->length - keep);
+    stream->base += keep;
+    stream->length -= keep;
+    stream->pos -= keep;
+
+    ssize_t n;
+    do {
+        n = read(stream->fd, stream->buffer + stream->length, stream->capacity - 1 - stream->length);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        stream->at_eof = 1;
+        stream->read_error = n < 0;
+        n = 0;
+    }
+    stream->length += (int)n;
+    stream->buffer[stream->length] = '\0';
+    return (int)n;
+}
+
+int lexer_stream_open(LexerStream *stream, int fd, int chunk_size) {
+    memset(stream, 0, sizeof(*stream));
+    stream->fd = fd;
+    // Room for a whole chunk plus the longest token carried over
+    stream->capacity = (chunk_size < 1024 ? 1024 : chunk_size) + (int)sizeof(((Token *)0)->lexeme) + 2;
+    stream->buffer = mem_alloc(MEM_SOURCE, stream->capacity);
+    if (!stream->buffer) return 0;
+    stream->buffer[0] = '\0';
+    stream->state.line = 1;
+    stream->state.mode = LEX_MODE_CODE;
+    return 1;
+}
+
+Token lexer_stream_next(LexerStream *stream) {
+    LexerState saved = lexer_save_state();
+    Token token;
+    for (;;) {
+        lexer_restore_state(stream->state);
+        int pos = stream->pos;
+        token = scan_token(stream->buffer, &pos);
+
+        if (token.type == TOKEN_EOF && !stream->at_eof) {
+            // Only whitespace or comment was left; it's been consumed
+            stream->pos = pos;
+            stream->state = lexer_save_state();
+            refill(stream, stream->pos);
+            continue;
+        }
+        if (token.type != TOKEN_EOF && pos == stream->length && !stream->at_eof) {
+            // The token may go on in the next chunk: scan it again from its start
+            stream->pos = token_start;
+            stream->state.line = token.line;
+            stream->state.mode = LEX_MODE_CODE;
+            refill(stream, stream->pos);
+            continue;
+        }
+        stream->pos = pos;
+        stream->state = lexer_save_state();
+        break;
+    }
+    // Offsets are relative to the whole input, as far as an int reaches
+    long long offset = stream->base + token.offset;
+    token.offset = offset <= INT_MAX ? (int)offset : -1;
+    lexer_restore_state(saved);
+    STAT_TOKEN(token.type);
+    return token;
+}
+
+void lexer_stream_close(LexerStream *stream) {
+    mem_free(MEM_SOURCE, stream->buffer);
+    memset(stream, 0, sizeof(*stream));
+}
+
 // This is a basic lexer that handles numbers (e.g., "123", "456"), basic operators (+ and -), consecutive operator errors, whitespace and newlines, with simple line tracking for error reporting.
 
 // int main() {
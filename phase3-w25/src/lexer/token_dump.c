@@ -0,0 +1,230 @@
+/* token_dump.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../../include/token_dump.h"
+#include "../../include/lexer.h"
+#include "../../include/allocator.h"
+
+// A kind packs the type into its low bits
+#define TYPE_BITS 5
+_Static_assert(TOKEN_ERROR < (1 << TYPE_BITS), "token types don't fit the kind's type bits");
+
+// A record is four varints of at most 5 bytes each
+#define MAX_RECORD_SIZE 20
+
+uint32_t token_dump_hash(const char* source, size_t length) {
+    uint32_t hash = 2166136261u;     // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)source[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void put_u32(unsigned char* at, uint32_t value) {
+    for (int i = 0; i < 4; i++) at[i] = (unsigned char)(value >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char* at) {
+    return (uint32_t)at[0] | (uint32_t)at[1] << 8 | (uint32_t)at[2] << 16 | (uint32_t)at[3] << 24;
+}
+
+static unsigned char* put_varint(unsigned char* at, uint32_t value) {
+    while (value >= 0x80) {
+        *at++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *at++ = (unsigned char)value;
+    return at;
+}
+
+// NULL if the varint runs past `end` or doesn't fit 32 bits
+static const unsigned char* get_varint(const unsigned char* at, const unsigned char* end, uint32_t* value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (at == end) return NULL;
+        unsigned char byte = *at++;
+        if (shift == 28 && byte > 0x0f) return NULL;
+        result |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return at;
+        }
+    }
+    return NULL;
+}
+
+static int reserve(TokenDump* dump, size_t needed) {
+    if (dump->size + needed <= dump->capacity) return 1;
+    size_t capacity = dump->capacity ? dump->capacity : 4096;
+    while (capacity < dump->size + needed) capacity *= 2;
+    unsigned char* data = mem_realloc(MEM_SOURCE, dump->data, capacity);
+    if (!data) return 0;
+    dump->data = data;
+    dump->capacity = capacity;
+    return 1;
+}
+
+int token_dump_build(TokenDump* dump, const char* source) {
+    memset(dump, 0, sizeof(TokenDump));
+    size_t length = strlen(source);
+    if (length > INT_MAX) return 0;
+    // Most tokens are a few bytes of source and encode in 4
+    if (!reserve(dump, TOKEN_DUMP_HEADER_SIZE + length / 2 + MAX_RECORD_SIZE)) return 0;
+    dump->size = TOKEN_DUMP_HEADER_SIZE;
+
+    LexerState saved = lexer_save_state();
+    lexer_reset();
+    int pos = 0;
+    int previous_end = 0;
+    int previous_line = 1;
+    int ok = 1;
+    for (;;) {
+        Token token = get_next_token(source, &pos);
+        if (token.type == TOKEN_EOF) break;
+        if (!reserve(dump, MAX_RECORD_SIZE)) {
+            ok = 0;
+            break;
+        }
+        unsigned char* at = dump->data + dump->size;
+        at = put_varint(at, (uint32_t)token.type | (uint32_t)token.error << TYPE_BITS);
+        at = put_varint(at, (uint32_t)(token.offset - previous_end));
+        at = put_varint(at, (uint32_t)(pos - token.offset));
+        at = put_varint(at, (uint32_t)(token.line - previous_line));
+        dump->size = at - dump->data;
+        dump->count++;
+        previous_end = pos;
+        previous_line = token.line;
+    }
+    lexer_restore_state(saved);
+    if (!ok) {
+        token_dump_free(dump);
+        return 0;
+    }
+
+    put_u32(dump->data, TOKEN_DUMP_MAGIC);
+    put_u32(dump->data + 4, TOKEN_DUMP_VERSION);
+    put_u32(dump->data + 8, dump->count);
+    put_u32(dump->data + 12, (uint32_t)length);
+    put_u32(dump->data + 16, token_dump_hash(source, length));
+    put_u32(dump->data + 20, (uint32_t)(dump->size - TOKEN_DUMP_HEADER_SIZE));
+    return 1;
+}
+
+int token_dump_write_file(const TokenDump* dump, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return 0;
+    int ok = fwrite(dump->data, 1, dump->size, file) == dump->size;
+    return fclose(file) == 0 && ok;
+}
+
+void token_dump_free(TokenDump* dump) {
+    mem_free(MEM_SOURCE, dump->data);
+    memset(dump, 0, sizeof(TokenDump));
+}
+
+int token_dump_open_memory(TokenDumpReader* reader, const void* data, size_t size, const char** error) {
+    memset(reader, 0, sizeof(TokenDumpReader));
+    const unsigned char* bytes = data;
+    const char* problem = NULL;
+
+    if (size < TOKEN_DUMP_HEADER_SIZE || get_u32(bytes) != TOKEN_DUMP_MAGIC) problem = "not a token dump";
+    else if (get_u32(bytes + 4) != TOKEN_DUMP_VERSION) problem = "unsupported version";
+    else if (get_u32(bytes + 20) != size - TOKEN_DUMP_HEADER_SIZE) problem = "record section out of bounds";
+    else if (get_u32(bytes + 12) > INT_MAX) problem = "source too long";
+    // Every record takes at least 4 bytes
+    else if (get_u32(bytes + 8) > (size - TOKEN_DUMP_HEADER_SIZE) / 4) problem = "token count out of range";
+
+    if (problem) {
+        if (error) *error = problem;
+        return 0;
+    }
+    reader->count = get_u32(bytes + 8);
+    reader->source_length = get_u32(bytes + 12);
+    reader->source_hash = get_u32(bytes + 16);
+    reader->at = bytes + TOKEN_DUMP_HEADER_SIZE;
+    reader->end = bytes + size;
+    reader->line = 1;
+    return 1;
+}
+
+int token_dump_open_file(TokenDumpReader* reader, const char* path, const char** error) {
+    memset(reader, 0, sizeof(TokenDumpReader));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (error) *error = "could not open the file";
+        return 0;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        if (error) *error = "not a token dump";
+        return 0;
+    }
+    size_t size = (size_t)info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        if (error) *error = "could not map the file";
+        return 0;
+    }
+    if (!token_dump_open_memory(reader, mapping, size, error)) {
+        munmap(mapping, size);
+        return 0;
+    }
+    reader->mapping = mapping;
+    reader->mapping_size = size;
+    return 1;
+}
+
+int token_dump_next(TokenDumpReader* reader, DumpedToken* token) {
+    if (reader->error) return 0;
+    if (reader->decoded == reader->count) {
+        if (reader->at != reader->end) reader->error = "trailing bytes after the last token";
+        return 0;
+    }
+
+    uint32_t kind, gap, length, lines;
+    const unsigned char* at = reader->at;
+    if (!(at = get_varint(at, reader->end, &kind)) ||
+        !(at = get_varint(at, reader->end, &gap)) ||
+        !(at = get_varint(at, reader->end, &length)) ||
+        !(at = get_varint(at, reader->end, &lines))) {
+        reader->error = "truncated record";
+        return 0;
+    }
+    uint32_t type = kind & ((1u << TYPE_BITS) - 1);
+    uint32_t kind_error = kind >> TYPE_BITS;
+    // Spans stay inside the source, lines inside an int
+    uint32_t available = reader->source_length - (uint32_t)reader->offset;
+    if (type > TOKEN_ERROR || type == TOKEN_EOF || kind_error > ERROR_FLOAT_OVERFLOW) {
+        reader->error = "unknown token kind";
+    } else if (gap > available || length > available - gap) {
+        reader->error = "token span out of bounds";
+    } else if (lines > (uint32_t)(INT_MAX - reader->line)) {
+        reader->error = "line out of range";
+    }
+    if (reader->error) return 0;
+
+    token->type = (TokenType)type;
+    token->error = (ErrorType)kind_error;
+    token->start = reader->offset + (int)gap;
+    token->end = token->start + (int)length;
+    token->line = reader->line + (int)lines;
+    reader->at = at;
+    reader->offset = token->end;
+    reader->line = token->line;
+    reader->decoded++;
+    return 1;
+}
+
+void token_dump_close(TokenDumpReader* reader) {
+    if (reader->mapping) munmap(reader->mapping, reader->mapping_size);
+    memset(reader, 0, sizeof(TokenDumpReader));
+}
@@ -0,0 +1,609 @@
+/* optimizer.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../../include/parser.h"
+#include "../../include/tokens.h"
+#include "../../include/optimizer.h"
+#include "../../include/allocator.h"
+
+// Growable list of names (points at lexemes owned by the AST)
+typedef struct {
+    const char** names;
+    int count;
+    int capacity;
+} NameSet;
+
+// Declarations seen so far, in program order. Lookups take the most recent
+// match, which is the same resolution lookup_symbol() uses in the semantic pass.
+typedef struct {
+    ASTNode** decls;
+    int count;
+    int capacity;
+} DeclEnv;
+
+// State for hoisting out of a single loop
+typedef struct {
+    NameSet assigned;       // names assigned or declared anywhere in the loop
+    DeclEnv* env;
+    ASTNode* pre_head;      // preheader statements built so far
+    ASTNode* pre_tail;
+    int line;               // line of the loop, used for generated nodes
+    int statement_line;     // line of the statement being rewritten, for its temporaries
+    // Still in the body's unconditional prefix: nothing evaluated so far in
+    // the first iteration could have failed or printed, so an expression
+    // that can fail may be hoisted too
+    int prefix;
+} LoopContext;
+
+static int temp_counter = 0;
+// Symbol id of the next temporary: past every id the semantic pass handed out
+static int next_symbol_id = 0;
+
+static int optimize_statement(ASTNode** slot, int in_list, DeclEnv* env);
+
+static int grow(void** items, int* capacity, size_t item_size) {
+    int new_capacity = *capacity ? *capacity * 2 : 16;
+    void* resized = mem_realloc(MEM_OPTIMIZER, *items, new_capacity * item_size);
+    if (!resized) return 0;
+    *items = resized;
+    *capacity = new_capacity;
+    return 1;
+}
+
+static void nameset_add(NameSet* set, const char* name) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->names[i], name) == 0) return;
+    }
+    if (set->count == set->capacity &&
+        !grow((void**)&set->names, &set->capacity, sizeof(const char*))) {
+        return;
+    }
+    set->names[set->count++] = name;
+}
+
+static int nameset_contains(const NameSet* set, const char* name) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->names[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+static void env_add(DeclEnv* env, ASTNode* decl) {
+    if (env->count == env->capacity &&
+        !grow((void**)&env->decls, &env->capacity, sizeof(ASTNode*))) {
+        return;
+    }
+    env->decls[env->count++] = decl;
+}
+
+static ASTNode* env_lookup(const DeclEnv* env, const char* name) {
+    for (int i = env->count - 1; i >= 0; i--) {
+        if (strcmp(env->decls[i]->token.lexeme, name) == 0) return env->decls[i];
+    }
+    return NULL;
+}
+
+static ASTNode* new_node(ASTNodeType type, TokenType token_type, const char* lexeme, int line) {
+    ASTNode* node = mem_calloc(MEM_AST, 1, sizeof(ASTNode));
+    if (node) {
+        node->type = type;
+        node->token.type = token_type;
+        snprintf(node->token.lexeme, sizeof(node->token.lexeme), "%s", lexeme);
+        node->token.line = line;
+        node->token.error = ERROR_NONE;
+        node->token.offset = -1;    // synthesized, not in the input
+        node->value_type = TYPE_UNANNOTATED;
+        node->symbol_id = -1;
+        node->string_id = -1;
+    }
+    return node;
+}
+
+// Copy of an expression for a second place in the tree. Shared nodes are used
+// as they are. NULL if memory runs out.
+static ASTNode* copy_expression(ASTNode* node) {
+    if (node->shared) return node;
+    ASTNode* copy = mem_alloc(MEM_AST, sizeof(ASTNode));
+    if (!copy) return NULL;
+    *copy = *node;
+    copy->next = NULL;
+    copy->left = NULL;
+    copy->right = NULL;
+    copy->operand = NULL;
+    if ((node->left && !(copy->left = copy_expression(node->left))) ||
+        (node->right && !(copy->right = copy_expression(node->right))) ||
+        (node->operand && !(copy->operand = copy_expression(node->operand)))) {
+        free_ast(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+// Collect every name assigned or declared inside a loop, including nested loops
+static void collect_assigned(ASTNode* node, NameSet* set) {
+    if (!node) return;
+
+    switch (node->type) {
+        case AST_ASSIGN:
+            if (node->left) nameset_add(set, node->left->token.lexeme);
+            break;
+        case AST_VARDECL:
+            nameset_add(set, node->token.lexeme);
+            break;
+        case AST_BLOCK:
+            for (ASTNode* stmt = node->next; stmt; stmt = stmt->next) {
+                collect_assigned(stmt, set);
+            }
+            break;
+        case AST_IF:
+        case AST_WHILE:
+            collect_assigned(node->right, set);
+            break;
+        case AST_REPEAT:
+            collect_assigned(node->left, set);
+            break;
+        default:
+            break;
+    }
+}
+
+// An expression is invariant when every identifier it reads is declared outside
+// the loop and never assigned in it
+static int is_invariant(ASTNode* node, LoopContext* ctx) {
+    if (!node) return 0;
+
+    switch (node->type) {
+        case AST_NUMBER:
+        case AST_STRING:
+            return 1;
+        case AST_IDENTIFIER:
+            return !nameset_contains(&ctx->assigned, node->token.lexeme) &&
+                   env_lookup(ctx->env, node->token.lexeme) != NULL;
+        case AST_BINOP:
+        case AST_COMPARISON:
+            return is_invariant(node->left, ctx) && is_invariant(node->right, ctx);
+        case AST_CONDITION:
+            return is_invariant(node->left, ctx);
+        default:
+            return 0;
+    }
+}
+
+// Type for the temporary holding an expression, or -1 if it can't be typed.
+// Uses the semantic pass's annotation when present; otherwise (e.g. nodes made
+// by an earlier round of this pass) applies the same rules as get_expression_type().
+static int expression_type(ASTNode* node, const DeclEnv* env) {
+    if (!node) return -1;
+    if (node->value_type != TYPE_UNANNOTATED) return node->value_type;
+
+    switch (node->type) {
+        case AST_NUMBER:
+            return node->token.type == TOKEN_FLOAT_LITERAL ? TOKEN_FLOAT : TOKEN_INT;
+        case AST_STRING:
+            return TOKEN_CHAR;
+        case AST_IDENTIFIER: {
+            ASTNode* decl = env_lookup(env, node->token.lexeme);
+            return decl ? (int)decl->token.type : -1;
+        }
+        case AST_BINOP: {
+            int left_type = expression_type(node->left, env);
+            int right_type = expression_type(node->right, env);
+            if (left_type == -1 || right_type == -1) return -1;
+            if (left_type == TOKEN_INT && right_type == TOKEN_INT) return TOKEN_INT;
+            if ((left_type == TOKEN_INT || left_type == TOKEN_FLOAT) &&
+                (right_type == TOKEN_INT || right_type == TOKEN_FLOAT)) {
+                return TOKEN_FLOAT;
+            }
+            if (left_type == TOKEN_FLOAT || right_type == TOKEN_FLOAT) return -1;
+            if (left_type == TOKEN_CHAR || right_type == TOKEN_CHAR) {
+                if (strcmp(node->token.lexeme, "*") == 0 || strcmp(node->token.lexeme, "/") == 0) {
+                    return -1;
+                }
+                return TOKEN_CHAR;
+            }
+            return -1;
+        }
+        case AST_CONDITION:
+            return expression_type(node->left, env);
+        case AST_COMPARISON: {
+            int left_type = expression_type(node->left, env);
+            int right_type = expression_type(node->right, env);
+            if ((left_type != TOKEN_INT && left_type != TOKEN_FLOAT) ||
+                (right_type != TOKEN_INT && right_type != TOKEN_FLOAT)) {
+                return -1;
+            }
+            return TOKEN_INT;
+        }
+        default:
+            return -1;
+    }
+}
+
+// Value of an int expression made only of literals, if it has one
+static int constant_value(ASTNode* node, long long* value) {
+    if (!node) return 0;
+    if (node->type == AST_NUMBER) {
+        if (node->token.type == TOKEN_FLOAT_LITERAL) return 0;
+        *value = node->token.value;
+        return 1;
+    }
+    long long left, right;
+    if (node->type != AST_BINOP || !constant_value(node->left, &left) ||
+        !constant_value(node->right, &right)) {
+        return 0;
+    }
+    const char* op = node->token.lexeme;
+    if (strcmp(op, "+") == 0) *value = left + right;
+    else if (strcmp(op, "-") == 0) *value = left - right;
+    else if (strcmp(op, "*") == 0) *value = left * right;
+    else if (strcmp(op, "/") == 0 && right != 0) *value = left / right;
+    else return 0;
+    return *value >= INT32_MIN && *value <= INT32_MAX;
+}
+
+// Whether evaluating the expression can raise a runtime error: float
+// arithmetic never does, int arithmetic overflows or divides by zero unless
+// its operands are known.
+static int can_fail(ASTNode* node, const DeclEnv* env) {
+    if (!node) return 1;
+
+    switch (node->type) {
+        case AST_NUMBER:
+        case AST_STRING:
+        case AST_IDENTIFIER:
+            return 0;
+        case AST_CONDITION:
+            return can_fail(node->left, env);
+        case AST_COMPARISON:
+            return can_fail(node->left, env) || can_fail(node->right, env);
+        case AST_BINOP: {
+            if (expression_type(node, env) == TOKEN_FLOAT) {
+                return can_fail(node->left, env) || can_fail(node->right, env);
+            }
+            long long value;
+            if (constant_value(node, &value)) return 0;
+            // Only x / 0 and INT_MIN / -1 fail
+            if (strcmp(node->token.lexeme, "/") == 0 && constant_value(node->right, &value) &&
+                value != 0 && value != -1) {
+                return can_fail(node->left, env);
+            }
+            return 1;
+        }
+        default:
+            return 1;
+    }
+}
+
+static void append_preheader(LoopContext* ctx, ASTNode* first, ASTNode* last) {
+    first->next = last;
+    last->next = NULL;
+    if (ctx->pre_tail) {
+        ctx->pre_tail->next = first;
+    } else {
+        ctx->pre_head = first;
+    }
+    ctx->pre_tail = last;
+}
+
+// A preheader left behind by an inner loop ("T $licmN; $licmN = expr;") whose
+// expression is also invariant in this loop can move out as a whole, rather
+// than being hoisted again into a second temporary.
+static int is_movable_preheader(ASTNode* decl, LoopContext* ctx) {
+    ASTNode* assign = decl->next;
+    return decl->type == AST_VARDECL &&
+           strncmp(decl->token.lexeme, LICM_TEMP_PREFIX, strlen(LICM_TEMP_PREFIX)) == 0 &&
+           assign && assign->type == AST_ASSIGN && assign->left &&
+           strcmp(assign->left->token.lexeme, decl->token.lexeme) == 0 &&
+           is_invariant(assign->right, ctx) && !can_fail(assign->right, ctx->env);
+}
+
+// Move *slot into a new temporary: append "T tmp; tmp = expr;" to the preheader
+// and replace the expression in the loop with a reference to tmp.
+static int hoist_expression(ASTNode** slot, LoopContext* ctx) {
+    ASTNode* expr = *slot;
+    int type = expression_type(expr, ctx->env);
+    if (type == -1) return 0;
+
+    char name[32];
+    snprintf(name, sizeof(name), LICM_TEMP_PREFIX "%d", temp_counter);
+
+    // A runtime error in the preheader is reported where the expression was
+    ASTNode* decl = new_node(AST_VARDECL, (TokenType)type, name, ctx->statement_line);
+    ASTNode* assign = new_node(AST_ASSIGN, TOKEN_IDENTIFIER, name, ctx->statement_line);
+    ASTNode* target = new_node(AST_IDENTIFIER, TOKEN_IDENTIFIER, name, ctx->statement_line);
+    ASTNode* use = new_node(AST_IDENTIFIER, TOKEN_IDENTIFIER, name, expr->token.line);
+    if (!decl || !assign || !target || !use) {
+        mem_free(MEM_AST, decl);
+        mem_free(MEM_AST, assign);
+        mem_free(MEM_AST, target);
+        mem_free(MEM_AST, use);
+        return 0;
+    }
+    temp_counter++;
+    int symbol_id = next_symbol_id++;
+
+    decl->symbol_id = symbol_id;
+    target->symbol_id = symbol_id;
+    use->symbol_id = symbol_id;
+    target->value_type = type;
+    use->value_type = type;
+    assign->left = target;
+    assign->right = expr;
+    append_preheader(ctx, decl, assign);
+
+    // The temporary is declared before the loop, in the enclosing scope
+    env_add(ctx->env, decl);
+
+    *slot = use;
+    return 1;
+}
+
+// Hoist the largest invariant subexpressions reachable from *slot, in the
+// order they're evaluated. The preheader runs once, before the first
+// iteration, so one that can fail only moves while nothing before it could
+// fail or print: the error then comes at the same point in the output.
+static int hoist_in_expression(ASTNode** slot, LoopContext* ctx) {
+    ASTNode* node = *slot;
+    if (!node) return 0;
+
+    if ((node->type == AST_BINOP || node->type == AST_CONDITION) && is_invariant(node, ctx) &&
+        (ctx->prefix || !can_fail(node, ctx->env))) {
+        if (hoist_expression(slot, ctx)) return 1;
+    }
+    // A hash-consed node is also an operand elsewhere, so rewrite a copy
+    if (node->shared && (node->type == AST_BINOP || node->type == AST_COMPARISON ||
+                         node->type == AST_CONDITION)) {
+        ASTNode* copy = mem_alloc(MEM_AST, sizeof(ASTNode));
+        if (!copy) return 0;
+        *copy = *node;
+        copy->shared = 0;
+        *slot = node = copy;
+    }
+
+    int hoisted = 0;
+    switch (node->type) {
+        case AST_BINOP:
+        case AST_COMPARISON:
+            hoisted += hoist_in_expression(&node->left, ctx);
+            hoisted += hoist_in_expression(&node->right, ctx);
+            break;
+        case AST_CONDITION:
+            hoisted += hoist_in_expression(&node->left, ctx);
+            break;
+        default:
+            break;
+    }
+    // What's left is evaluated in the loop
+    if (can_fail(node, ctx->env)) ctx->prefix = 0;
+    return hoisted;
+}
+
+static int hoist_in_statement(ASTNode* node, LoopContext* ctx) {
+    if (!node) return 0;
+
+    int hoisted = 0;
+    ctx->statement_line = node->token.line;
+    switch (node->type) {
+        case AST_ASSIGN:
+            return hoist_in_expression(&node->right, ctx);
+        case AST_PRINT:
+        case AST_FACTORIAL:
+            hoisted += hoist_in_expression(&node->left, ctx);
+            ctx->prefix = 0;
+            return hoisted;
+        case AST_BLOCK: {
+            ASTNode** link = &node->next;
+            while (*link) {
+                ASTNode* stmt = *link;
+                if (is_movable_preheader(stmt, ctx)) {
+                    ASTNode* assign = stmt->next;
+                    *link = assign->next;
+                    append_preheader(ctx, stmt, assign);
+                    // Its block has been left, so it's declared out here now
+                    env_add(ctx->env, stmt);
+                    continue;
+                }
+                hoisted += hoist_in_statement(stmt, ctx);
+                link = &stmt->next;
+            }
+            return hoisted;
+        }
+        case AST_IF:
+        case AST_WHILE:
+            hoisted += hoist_in_expression(&node->left, ctx);
+            // The body may not run, so the prefix ends here
+            ctx->prefix = 0;
+            hoisted += hoist_in_statement(node->right, ctx);
+            return hoisted;
+        case AST_REPEAT:
+            ctx->prefix = 0;
+            hoisted += hoist_in_statement(node->left, ctx);
+            if (node->right) {
+                ctx->statement_line = node->right->token.line;
+                hoisted += hoist_in_expression(&node->right->left, ctx);
+            }
+            return hoisted;
+        default:
+            return 0;
+    }
+}
+
+// The parts of a while loop rotated into "if (cond) { preheader; repeat
+// body until (cond == 0); }", so that the preheader only runs when the body
+// does at least once. The guard keeps the original condition and the loop
+// tests a copy.
+typedef struct {
+    ASTNode* guard;         // AST_IF
+    ASTNode* block;         // its body: the preheader, then the loop
+    ASTNode* until;         // AST_CONDITION of the repeat
+    ASTNode* test;          // AST_COMPARISON in it: the copy == 0
+} Rotation;
+
+static int rotation_init(Rotation* rotation, ASTNode* loop) {
+    int line = loop->token.line;
+    rotation->guard = new_node(AST_IF, TOKEN_IF, "if", line);
+    rotation->block = new_node(AST_BLOCK, TOKEN_LBRACE, "{", line);
+    rotation->until = new_node(AST_CONDITION, TOKEN_COMPARISON, "==", line);
+    rotation->test = new_node(AST_COMPARISON, TOKEN_COMPARISON, "==", line);
+    ASTNode* zero = new_node(AST_NUMBER, TOKEN_NUMBER, "0", line);
+    ASTNode* copy = copy_expression(loop->left);
+    if (!rotation->guard || !rotation->block || !rotation->until || !rotation->test || !zero || !copy) {
+        mem_free(MEM_AST, rotation->guard);
+        mem_free(MEM_AST, rotation->block);
+        mem_free(MEM_AST, rotation->until);
+        mem_free(MEM_AST, rotation->test);
+        mem_free(MEM_AST, zero);
+        if (copy) free_ast(copy);
+        return 0;
+    }
+    zero->value_type = TOKEN_INT;
+    rotation->test->value_type = TOKEN_INT;
+    rotation->test->left = copy;
+    rotation->test->right = zero;
+    rotation->until->value_type = TOKEN_INT;
+    rotation->until->left = rotation->test;
+    return 1;
+}
+
+static void rotation_free(Rotation* rotation) {
+    mem_free(MEM_AST, rotation->guard);
+    mem_free(MEM_AST, rotation->block);
+    free_ast(rotation->until);
+}
+
+// Hoist invariant expressions out of the loop at *slot. A while loop is
+// rotated so that its preheader sits behind a test of the condition. A
+// repeat loop's preheader is spliced in front of it when it sits in a
+// statement list; otherwise (e.g. the body of a brace-less if) the preheader
+// and loop are wrapped in a new block.
+static int hoist_loop(ASTNode** slot, int in_list, DeclEnv* env) {
+    ASTNode* loop = *slot;
+    LoopContext ctx = { {NULL, 0, 0}, env, NULL, NULL, loop->token.line, loop->token.line, 1 };
+    int scope = env->count;
+
+    Rotation rotation = {NULL, NULL, NULL, NULL};
+    ASTNode* block = NULL;
+    if (loop->type == AST_WHILE) {
+        if (!rotation_init(&rotation, loop)) return 0;
+    } else if (!in_list) {
+        block = new_node(AST_BLOCK, loop->token.type, loop->token.lexeme, loop->token.line);
+        if (!block) return 0;
+    }
+
+    collect_assigned(loop, &ctx.assigned);
+
+    int hoisted = 0;
+    if (loop->type == AST_WHILE) {
+        hoisted += hoist_in_expression(&rotation.test->left, &ctx);
+        // The guard has already evaluated the whole condition
+        ctx.prefix = 1;
+        hoisted += hoist_in_statement(loop->right, &ctx);
+    } else {
+        hoisted += hoist_in_statement(loop->left, &ctx);
+        if (loop->right) {
+            ctx.statement_line = loop->right->token.line;
+            hoisted += hoist_in_expression(&loop->right->left, &ctx);
+        }
+    }
+    mem_free(MEM_OPTIMIZER, ctx.assigned.names);
+
+    if (!ctx.pre_head) {
+        if (rotation.guard) rotation_free(&rotation);
+        mem_free(MEM_AST, block);
+        return 0;
+    }
+
+    ctx.pre_tail->next = loop;
+    if (rotation.guard) {
+        rotation.guard->left = loop->left;
+        rotation.guard->right = rotation.block;
+        rotation.guard->next = loop->next;
+        rotation.block->next = ctx.pre_head;
+        loop->type = AST_REPEAT;
+        loop->left = loop->right;
+        loop->right = rotation.until;
+        loop->next = NULL;
+        // The temporaries are local to the guarded block
+        env->count = scope;
+        *slot = rotation.guard;
+    } else if (block) {
+        // The temporaries are local to the new block
+        env->count = scope;
+        block->next = ctx.pre_head;
+        *slot = block;
+    } else {
+        *slot = ctx.pre_head;
+    }
+    return hoisted;
+}
+
+static int optimize_list(ASTNode** link, DeclEnv* env) {
+    int hoisted = 0;
+    while (*link) {
+        ASTNode* after = (*link)->next;
+        hoisted += optimize_statement(link, 1, env);
+        // Skip over what replaced the statement, e.g. a preheader and the loop
+        while (*link != after) link = &(*link)->next;
+    }
+    return hoisted;
+}
+
+static int optimize_statement(ASTNode** slot, int in_list, DeclEnv* env) {
+    ASTNode* node = *slot;
+    if (!node) return 0;
+
+    int hoisted = 0;
+    switch (node->type) {
+        case AST_VARDECL:
+            env_add(env, node);
+            return 0;
+        case AST_BLOCK: {
+            // Declarations end with the block, as symbols do in the semantic pass
+            int scope = env->count;
+            hoisted = optimize_list(&node->next, env);
+            env->count = scope;
+            return hoisted;
+        }
+        case AST_IF:
+            return optimize_statement(&node->right, 0, env);
+        case AST_WHILE:
+            // Inner loops first, so their preheaders can be hoisted again by this one
+            hoisted += optimize_statement(&node->right, 0, env);
+            hoisted += hoist_loop(slot, in_list, env);
+            return hoisted;
+        case AST_REPEAT:
+            hoisted += optimize_statement(&node->left, 0, env);
+            hoisted += hoist_loop(slot, in_list, env);
+            return hoisted;
+        default:
+            return 0;
+    }
+}
+
+// Largest symbol id in the tree. Shared nodes are closed expressions, which
+// have none.
+static int max_symbol_id(const ASTNode* node) {
+    int max = -1;
+    for (; node && !node->shared; node = node->next) {
+        if (node->symbol_id > max) max = node->symbol_id;
+        int left = max_symbol_id(node->left);
+        int right = max_symbol_id(node->right);
+        int operand = max_symbol_id(node->operand);
+        if (left > max) max = left;
+        if (right > max) max = right;
+        if (operand > max) max = operand;
+    }
+    return max;
+}
+
+int optimize_loops(ASTNode* program) {
+    if (!program) return 0;
+
+    next_symbol_id = max_symbol_id(program) + 1;
+    DeclEnv env = {NULL, 0, 0};
+    int hoisted = optimize_list(&program->next, &env);
+    mem_free(MEM_OPTIMIZER, env.decls);
+    return hoisted;
+}
@@ -1,9 +1,16 @@
 /* parser.c */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <setjmp.h>
 #include "../../include/parser.h"
 #include "../../include/lexer.h"
 #include "../../include/tokens.h"
+#include "../../include/diagnostics.h"
+#include "../../include/stats.h"
+#include "../../include/allocator.h"
+#include "../../include/budget.h"
 
 
 // TODO 1: Add more parsing function declarations for:
@@ -30,6 +37,13 @@ static ASTNode* parse_factorial(void);
 static Token current_token;
 static int position = 0;
 static const char *source;
+static LexerStream *stream = NULL;      // tokens come from here instead, when set
+static jmp_buf *recovery = NULL;
+static StringPool *string_pool = NULL;
+static NodeTable *node_table = NULL;
+// End offset and line of the last consumed token
+static int previous_end = 0;
+static int previous_line = 1;
 
 
 static void parse_error(ParseError error, Token token) {
@@ -40,69 +54,205 @@ static void parse_error(ParseError error, Token token) {
     // - Invalid operator
     // - Function call errors
 
-    printf("Parse Error at line %d: ", token.line);
-    switch (error) {
-        case PARSE_ERROR_UNEXPECTED_TOKEN:
-            printf("Unexpected token '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_SEMICOLON:
-            printf("Missing semicolon after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_IDENTIFIER:
-            printf("Expected identifier after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_EQUALS:
-            printf("Expected '=' after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_INVALID_EXPRESSION:
-            printf("Invalid expression after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_INVALID_STATEMENT:
-            printf("Invalid statement after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_LPAREN:
-            printf("Expected '(' after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_RPAREN:
-            printf("Expected ')' after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_LBRACE:
-            printf("Expected '{' after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_RBRACE:
-            printf("Expected '}' after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_LBRACK:
-            printf("Expected '[' after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_RBRACK:
-            printf("Expected ']' after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_MISSING_UNTIL:
-            printf("Expected 'until' after '%s'\n", token.lexeme);
-            break;
-        case PARSE_ERROR_INVALID_COMPARISON:
-            printf("Invalid comparison at '%s'\n", token.lexeme);
-        default:
-            printf("Unknown error\n");
+    // Messages are formatted by the diagnostics module when the session is written
+    diag_report_at(DIAG_PHASE_PARSE, error, DIAG_ERROR, token.line, token.offset, token.lexeme);
+}
+
+void parser_set_string_pool(StringPool *pool) {
+    string_pool = pool;
+}
+
+void parser_set_node_table(NodeTable *table) {
+    node_table = table;
+}
+
+// Give up on the input after a syntax error or an exceeded budget, both
+// already reported. Every entry point sets `recovery` first.
+static _Noreturn void parse_abort(void) {
+    longjmp(*recovery, 1);
+}
+
+// Nodes of the top-level statement being parsed. Nothing owns them until the
+// statement is complete, so they're freed from here when parsing is abandoned.
+// Static so they survive a longjmp.
+static ASTNode **in_flight = NULL;
+static int in_flight_count = 0;
+static int in_flight_capacity = 0;
+
+static void track_node(ASTNode *node) {
+    if (in_flight_count == in_flight_capacity) {
+        int capacity = in_flight_capacity ? in_flight_capacity * 2 : 64;
+        ASTNode **nodes = mem_realloc(MEM_AST, in_flight, capacity * sizeof(ASTNode *));
+        if (!nodes) return;     // the node leaks if the parse is abandoned
+        in_flight = nodes;
+        in_flight_capacity = capacity;
     }
+    in_flight[in_flight_count++] = node;
+}
+
+// `node` is about to be freed. It was built recently, so look from the end.
+static void untrack_node(ASTNode *node) {
+    for (int i = in_flight_count - 1; i >= 0; i--) {
+        if (in_flight[i] == node) {
+            in_flight[i] = in_flight[--in_flight_count];
+            return;
+        }
+    }
+}
+
+// The statement was linked into the tree, which owns its nodes now
+static void statement_complete(void) {
+    in_flight_count = 0;
+}
+
+// Free what was built of an abandoned statement. Shared nodes belong to the
+// node table.
+static void free_in_flight(void) {
+    for (int i = 0; i < in_flight_count; i++) {
+        if (!in_flight[i]->shared) mem_free(MEM_AST, in_flight[i]);
+    }
+    mem_free(MEM_AST, in_flight);
+    in_flight = NULL;
+    in_flight_count = in_flight_capacity = 0;
+}
+
+static void next_token(void) {
+    STAT_TIMER_START(lex_start);
+    previous_end = position;
+    previous_line = current_token.line;
+    current_token = stream ? lexer_stream_next(stream) : get_next_token(source, &position);
+    STAT_TIMER_STOP(lex_start, STATS_PHASE_LEX);
 }
 
 // Get next token
 static void advance(void) {
-    current_token = get_next_token(source, &position);
+    next_token();
+    if (!budget_token(current_token.line)) parse_abort();
 }
 
 // Create a new AST node
-static ASTNode *create_node(ASTNodeType type) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+static ASTNode *allocate_node(ASTNodeType type) {
+    ASTNode *node = mem_alloc(MEM_AST, sizeof(ASTNode));
+    STAT_ADD(nodes_created, 1);
+    STAT_ADD(node_bytes, sizeof(ASTNode));
     if (node) {
         node->type = type;
         node->token = current_token;
         node->left = NULL;
         node->right = NULL;
         node->next = NULL;
+        node->operand = NULL;
+        node->value_type = TYPE_UNANNOTATED;
+        node->symbol_id = -1;
+        node->string_id = -1;
+        node->shared = 0;
+    }
+    return node;
+}
+
+// Same, charged to the budget and freed if the statement is abandoned
+static ASTNode *create_node(ASTNodeType type) {
+    if (!budget_node(current_token.line)) parse_abort();
+    ASTNode *node = allocate_node(type);
+    if (node) track_node(node);
+    return node;
+}
+
+/* Hash-consing */
+
+void node_table_init(NodeTable *table) {
+    memset(table, 0, sizeof(*table));
+}
+
+size_t node_table_bytes_saved(const NodeTable *table) {
+    return (size_t)table->reused * sizeof(ASTNode);
+}
+
+void node_table_free(NodeTable *table) {
+    for (int i = 0; i < table->slot_count; i++) {
+        mem_free(MEM_AST, table->slots[i]);
     }
+    mem_free(MEM_AST, table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+// Operands are compared by address: they're shared already, so equal
+// operands are the same node
+static unsigned hash_node(const ASTNode *node) {
+    unsigned hash = 2166136261u;     // FNV-1a
+    hash = (hash ^ (unsigned)node->type) * 16777619u;
+    hash = (hash ^ (unsigned)node->token.type) * 16777619u;
+    for (const unsigned char *p = (const unsigned char *)node->token.lexeme; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    hash = (hash ^ (unsigned)((uintptr_t)node->left >> 4)) * 16777619u;
+    hash = (hash ^ (unsigned)((uintptr_t)node->right >> 4)) * 16777619u;
+    return hash;
+}
+
+static int same_node(const ASTNode *a, const ASTNode *b) {
+    return a->type == b->type && a->token.type == b->token.type &&
+           a->left == b->left && a->right == b->right &&
+           strcmp(a->token.lexeme, b->token.lexeme) == 0;
+}
+
+// Slot holding a node equal to `node`, or the empty slot where it belongs
+static int find_shared(const NodeTable *table, const ASTNode *node, unsigned hash) {
+    unsigned mask = (unsigned)table->slot_count - 1;
+    for (unsigned slot = hash & mask; ; slot = (slot + 1) & mask) {
+        if (!table->slots[slot] || same_node(table->slots[slot], node)) return (int)slot;
+    }
+}
+
+static int grow_shared(NodeTable *table) {
+    int slot_count = table->slot_count ? table->slot_count * 2 : 256;
+    ASTNode **slots = mem_calloc(MEM_AST, slot_count, sizeof(ASTNode *));
+    if (!slots) return 0;
+    ASTNode **old = table->slots;
+    int old_count = table->slot_count;
+    table->slots = slots;
+    table->slot_count = slot_count;
+    for (int i = 0; i < old_count; i++) {
+        if (old[i]) table->slots[find_shared(table, old[i], hash_node(old[i]))] = old[i];
+    }
+    mem_free(MEM_AST, old);
+    return 1;
+}
+
+// The shared node equal to the freshly built `node`, which is then freed, or
+// `node` itself, now owned by the table. Only closed expressions qualify:
+// literals, and operators whose operands are shared.
+static ASTNode *share_node(ASTNode *node) {
+    if (!node_table || !node) return node;
+    switch (node->type) {
+        case AST_NUMBER:
+        case AST_STRING:
+            break;
+        case AST_BINOP:
+        case AST_COMPARISON:
+            if (!node->left || !node->left->shared || !node->right || !node->right->shared) return node;
+            break;
+        case AST_CONDITION:
+            if (!node->left || !node->left->shared || node->right) return node;
+            break;
+        default:
+            return node;
+    }
+    if ((node_table->count + 1) * 2 > node_table->slot_count && !grow_shared(node_table)) return node;
+
+    int slot = find_shared(node_table, node, hash_node(node));
+    ASTNode *existing = node_table->slots[slot];
+    if (existing) {
+        untrack_node(node);
+        mem_free(MEM_AST, node);
+        node_table->reused++;
+        STAT_ADD(nodes_shared, 1);
+        STAT_ADD(shared_bytes, sizeof(ASTNode));
+        return existing;
+    }
+    node->shared = 1;
+    node_table->slots[slot] = node;
+    node_table->count++;
     return node;
 }
 
@@ -117,7 +267,7 @@ static void expect(TokenType type) {
         advance();
     } else {
         parse_error(PARSE_ERROR_UNEXPECTED_TOKEN, current_token);
-        exit(1); // Or implement error recovery
+        parse_abort(); // Or implement error recovery
     }
 }
 
@@ -143,12 +293,12 @@ static ASTNode *parse_block(void) {
             current = current->next;
         } else {
             parse_error(PARSE_ERROR_UNEXPECTED_TOKEN, current_token);
-            exit(1);
+            parse_abort();
         }
     }
     if (!match(TOKEN_RBRACE)) {
         parse_error(PARSE_ERROR_MISSING_RBRACE, current_token);
-        exit(1);
+        parse_abort();
     }
     advance(); // consume '}'
 
@@ -176,7 +326,7 @@ static ASTNode *parse_if_statement(void) {
             node->right = statement;
         } else {
             parse_error(PARSE_ERROR_INVALID_STATEMENT, current_token);
-            exit(1);
+            parse_abort();
         }
     }
 
@@ -204,7 +354,7 @@ static ASTNode *parse_while_statement(void) {
             node->right = statement;
         } else {
             parse_error(PARSE_ERROR_INVALID_STATEMENT, current_token);
-            exit(1);
+            parse_abort();
         }
     }
 
@@ -218,7 +368,7 @@ static ASTNode *parse_repeat_statement(void) {
 
     if (!match(TOKEN_LBRACE)) {
         parse_error(PARSE_ERROR_MISSING_LBRACE, current_token);
-        exit(1);
+        parse_abort();
     }
 
     node->left = parse_block();
@@ -248,7 +398,7 @@ static ASTNode *parse_print_statement(void) {
         node->left = expression;
     } else {
         parse_error(PARSE_ERROR_INVALID_EXPRESSION, current_token);
-        exit(1);
+        parse_abort();
     }
 
     expect(TOKEN_SEMICOLON);
@@ -268,7 +418,7 @@ static ASTNode *parse_factorial(void) {
         node->left = expression;
     } else {
         parse_error(PARSE_ERROR_INVALID_EXPRESSION, current_token);
-        exit(1);
+        parse_abort();
     }
 
     expect(TOKEN_RPAREN);
@@ -301,18 +451,14 @@ static ASTNode *parse_declaration(void) {
     // Advance past the semicolon
     advance();
 
-    ASTNode* decl_node = (ASTNode*)malloc(sizeof(ASTNode));
-    decl_node->type = AST_VARDECL;  // This indicates a "var declaration" node
+    ASTNode* decl_node = create_node(AST_VARDECL);
+    if (!decl_node) return NULL;
 
-    // Put the type (int/char) in decl_node->token.type
+    // The identifier's token, with the type (int/char) in decl_node->token.type
+    decl_node->token = ident_token;
     decl_node->token.type = type_token.type; 
         // e.g., TOKEN_INT if we saw "int", TOKEN_CHAR if we saw "char"
 
-    strcpy(decl_node->token.lexeme, ident_token.lexeme);
-    decl_node->token.line = ident_token.line;
-
-    decl_node->left = decl_node->right = decl_node->next = decl_node->operand = NULL;
-
     return decl_node;
 }
 
@@ -326,7 +472,7 @@ static ASTNode *parse_assignment(void) {
 
     if (!match(TOKEN_EQUALS)) {
         parse_error(PARSE_ERROR_MISSING_EQUALS, current_token);
-        exit(1);
+        parse_abort();
     }
     advance();
 
@@ -334,7 +480,7 @@ static ASTNode *parse_assignment(void) {
 
     if (!match(TOKEN_SEMICOLON)) {
         parse_error(PARSE_ERROR_MISSING_SEMICOLON, current_token);
-        exit(1);
+        parse_abort();
     }
     advance();
 
@@ -345,7 +491,7 @@ static ASTNode *parse_binop(void) {
     ASTNode *node = parse_expression(); 
     if (!match(TOKEN_SEMICOLON)) {
         parse_error(PARSE_ERROR_MISSING_SEMICOLON, current_token);
-        exit(1);
+        parse_abort();
     }
     // Consume semicolon
     advance(); 
@@ -375,7 +521,7 @@ static ASTNode *parse_binop(void) {
 // }
 
 // Parse statement
-static ASTNode *parse_statement(void) {
+static ASTNode *parse_statement_kind(void) {
     // printf("Parsing statement w/ lexeme: %s\n", current_token.lexeme);
     if (match(TOKEN_INT) || match(TOKEN_FLOAT) || match(TOKEN_CHAR))    return parse_declaration();
     else if (match(TOKEN_IDENTIFIER))   return parse_assignment();
@@ -393,8 +539,16 @@ static ASTNode *parse_statement(void) {
     // else if (match(TOKEN_PRINT)) return parse_print_statement(); [DONE]
     // ...
 
-    printf("Syntax Error: Unexpected token\n");
-    exit(1);
+    parse_error(PARSE_ERROR_INVALID_STATEMENT, current_token);
+    parse_abort();
+}
+
+// Statements nest through blocks and if/while bodies
+static ASTNode *parse_statement(void) {
+    if (!budget_enter(current_token.line)) parse_abort();
+    ASTNode *statement = parse_statement_kind();
+    budget_leave();
+    return statement;
 }
 
 // Parse expression (currently only handles numbers and identifiers)
@@ -413,14 +567,16 @@ static ASTNode *parse_primary(void) {
     if (match(TOKEN_LPAREN)) {
         // Consume '('
         advance();
+        if (!budget_enter(current_token.line)) parse_abort();
 
         // Recursively parse whatever is inside the parentheses
         ASTNode *sub_expr = parse_expression();
+        budget_leave();
 
         // Expect the closing ')'
         if (!match(TOKEN_RPAREN)) {
             parse_error(PARSE_ERROR_MISSING_RPAREN, current_token);
-            exit(1);
+            parse_abort();
         }
         // Consume ')'
         advance();
@@ -428,10 +584,15 @@ static ASTNode *parse_primary(void) {
         return sub_expr;
     }
     // If it’s a number
-    else if (match(TOKEN_NUMBER)) {
+    else if (match(TOKEN_NUMBER) || match(TOKEN_FLOAT_LITERAL)) {
         ASTNode *node = create_node(AST_NUMBER);
+        if (current_token.error != ERROR_NONE) {
+            // Out of range; the semantic pass rejects the node
+            diag_report_at(DIAG_PHASE_LEXICAL, current_token.error, DIAG_ERROR,
+                           current_token.line, current_token.offset, current_token.lexeme);
+        }
         advance(); // consume the number token
-        return node;
+        return share_node(node);
     }
     // If it’s an identifier
     else if (match(TOKEN_IDENTIFIER)) {
@@ -442,13 +603,18 @@ static ASTNode *parse_primary(void) {
     // If it's a string
     else if (match(TOKEN_STRING_LITERAL)) {
         ASTNode *node = create_node(AST_STRING);
+        // The lexer already resolved the escapes; -1 if the pool is out of memory
+        if (node && string_pool) {
+            node->string_id = string_pool_intern(string_pool, current_token.lexeme,
+                                                 (int)strlen(current_token.lexeme));
+        }
         advance();
-        return node;
+        return share_node(node);
     }
     // If none of the above, it’s an invalid expression
     else {
         parse_error(PARSE_ERROR_INVALID_EXPRESSION, current_token);
-        exit(1);
+        parse_abort();
     }
 }
 
@@ -456,9 +622,13 @@ static ASTNode *parse_primary(void) {
 static ASTNode *parse_expression(void) {
     // First, parse a primary expression (number, identifier, or parenthesized)
     ASTNode *node = parse_primary();
+    // Every operator puts what came before it one level deeper
+    int levels = 0;
 
     // As long as the next token is an operator or comparison, consume it
     while (match(TOKEN_OPERATOR) || match(TOKEN_COMPARISON)) {
+        if (!budget_enter(current_token.line)) parse_abort();
+        levels++;
         if (match(TOKEN_COMPARISON)) {
             // 1) Create the container AST_CONDITION node
             ASTNode *condNode = create_node(AST_CONDITION);
@@ -479,10 +649,10 @@ static ASTNode *parse_expression(void) {
             compNode->right = parse_primary();
 
             // Attach the AST_COMPARISON node as a child of the AST_CONDITION
-            condNode->left = compNode;
+            condNode->left = share_node(compNode);
 
             // Now 'condNode' becomes the top node so far
-            node = condNode;
+            node = share_node(condNode);
         }
         else {
             // Normal binary operator (+, -, *, /, etc.)
@@ -497,21 +667,30 @@ static ASTNode *parse_expression(void) {
             binopNode->right = parse_primary();
 
             // binopNode becomes the top node
-            node = binopNode;
+            node = share_node(binopNode);
         }
     }
+    while (levels-- > 0) budget_leave();
 
     return node;
 }
 
 
+// Program being parsed by parse(); static so it survives a longjmp
+static ASTNode *parsed_program = NULL;
+
 // Parse program (multiple statements)
 static ASTNode *parse_program(void) {
     ASTNode *program = create_node(AST_PROGRAM);
+    statement_complete();
+    parsed_program = program;
     ASTNode *current = program;
 
     while (!match(TOKEN_EOF)) {
         current->next = parse_statement();
+        // NULL means the statement's error was already reported
+        if (!current->next) parse_abort();
+        statement_complete();
         current = current->next;
         // if (!match(TOKEN_EOF)) {
         //     current->right = create_node(AST_PROGRAM);
@@ -525,13 +704,307 @@ static ASTNode *parse_program(void) {
 // Initialize parser
 void parser_init(const char *input) {
     source = input;
+    stream = NULL;
     position = 0;
-    advance(); // Get first token
+    lexer_reset();
+    next_token(); // Get first token; parse() charges it to the budget
 }
 
 // Main parse function
 ASTNode *parse(void) {
-    return parse_program();
+    jmp_buf point;
+    recovery = &point;
+    if (setjmp(point)) {
+        recovery = NULL;
+        free_in_flight();
+        free_ast(parsed_program);
+        parsed_program = NULL;
+        return NULL;
+    }
+    if (!budget_token(current_token.line)) parse_abort();
+    ASTNode *program = parse_program();
+    recovery = NULL;
+    parsed_program = NULL;
+    free_in_flight();
+    return program;
+}
+
+// Statements are freed as soon as they're parsed, so memory stays constant
+long parse_stream(LexerStream *input) {
+    volatile long statements = 0;
+    // Shared nodes would outlive the statements they were parsed for
+    NodeTable *saved_table = node_table;
+    jmp_buf point;
+    jmp_buf *saved_recovery = recovery;
+    if (setjmp(point)) {
+        recovery = saved_recovery;
+        node_table = saved_table;
+        stream = NULL;
+        free_in_flight();
+        return -1;
+    }
+    recovery = &point;
+    node_table = NULL;
+
+    stream = input;
+    advance();
+    while (!match(TOKEN_EOF)) {
+        ASTNode *statement = parse_statement();
+        if (!statement) parse_abort(); // error already reported
+        statement_complete();
+        free_ast(statement);
+        statements++;
+    }
+    free_in_flight();
+    stream = NULL;
+    recovery = saved_recovery;
+    node_table = saved_table;
+    return statements;
+}
+
+/* Incremental reparsing */
+
+// Start lexing `input` at `offset`, which must be between tokens
+static void parser_resume(const char *input, int offset, int line) {
+    source = input;
+    stream = NULL;
+    position = offset;
+    lexer_set_line(line);
+    current_token.line = line;
+    advance();
+}
+
+static int reserve_spans(ParseTree *tree, int needed) {
+    if (needed <= tree->capacity) return 1;
+    int capacity = tree->capacity ? tree->capacity : 64;
+    while (capacity < needed) capacity *= 2;
+    StatementSpan *spans = mem_realloc(MEM_AST, tree->spans, capacity * sizeof(StatementSpan));
+    if (!spans) return 0;
+    tree->spans = spans;
+    tree->capacity = capacity;
+    return 1;
+}
+
+// Shift the positions of a reused subtree. Top-level statements are chained
+// by `next`, so only nested lists are followed.
+static void shift_positions(ASTNode *node, int lines, int offset, int follow_next) {
+    while (node) {
+        node->token.line += lines;
+        if (node->token.offset >= 0) node->token.offset += offset;
+        shift_positions(node->left, lines, offset, 1);
+        shift_positions(node->right, lines, offset, 1);
+        shift_positions(node->operand, lines, offset, 1);
+        if (!follow_next) return;
+        node = node->next;
+    }
+}
+
+// Offset where statement `index` starts being lexed: the end of the one before
+static int statement_boundary(const ParseTree *tree, int index) {
+    return index > 0 ? tree->spans[index - 1].end : 0;
+}
+
+// First statement whose boundary is at least `offset`; spans are sorted
+static int first_boundary_at(const ParseTree *tree, int offset) {
+    int low = 0, high = tree->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (statement_boundary(tree, mid) < offset) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// Statements parsed so far by an edit; static so they survive a longjmp
+static ASTNode *pending_head = NULL;
+static StatementSpan *pending_spans = NULL;
+static int pending_count = 0;
+static int pending_capacity = 0;
+
+static void reset_pending(int free_nodes) {
+    while (free_nodes && pending_head) {
+        ASTNode *next = pending_head->next;
+        pending_head->next = NULL;
+        free_ast(pending_head);
+        pending_head = next;
+    }
+    pending_head = NULL;
+    mem_free(MEM_AST, pending_spans);
+    pending_spans = NULL;
+    pending_count = pending_capacity = 0;
+}
+
+static void add_pending(ParseTree *tree, ASTNode *statement) {
+    if (pending_count == pending_capacity) {
+        int capacity = pending_capacity ? pending_capacity * 2 : 16;
+        StatementSpan *spans = mem_realloc(MEM_AST, pending_spans, capacity * sizeof(StatementSpan));
+        if (!spans) parse_abort();
+        pending_spans = spans;
+        pending_capacity = capacity;
+    }
+    if (pending_count > 0) pending_spans[pending_count - 1].node->next = statement;
+    else pending_head = statement;
+    StatementSpan *span = &pending_spans[pending_count++];
+    span->node = statement;
+    span->id = tree->next_id++;
+    span->end = previous_end;
+    span->end_line = previous_line;
+    span->line_shift = 0;
+    span->offset_shift = 0;
+}
+
+int parse_tree_init(ParseTree *tree, const char *text) {
+    memset(tree, 0, sizeof(*tree));
+    string_pool_init(&tree->strings);
+    tree->length = (int)strlen(text);
+    tree->source = mem_alloc(MEM_SOURCE, tree->length + 1);
+    // Outside of any statement, so it's neither charged nor tracked
+    tree->program = allocate_node(AST_PROGRAM);
+    if (!tree->source || !tree->program) {
+        parse_tree_free(tree);
+        return 0;
+    }
+    memcpy(tree->source, text, tree->length + 1);
+    // An edit that changes nothing in an empty tree parses everything
+    if (parse_tree_edit(tree, 0, 0, "") < 0) {
+        parse_tree_free(tree);
+        return 0;
+    }
+    return 1;
+}
+
+int parse_tree_edit(ParseTree *tree, int offset, int removed, const char *inserted) {
+    int inserted_length = (int)strlen(inserted);
+    if (offset < 0 || removed < 0 || offset + removed > tree->length) return -1;
+    int edit_end = offset + removed;       // in old coordinates
+    int delta = inserted_length - removed;
+
+    // Apply the edit to a new buffer; the tree is untouched until we succeed
+    int new_length = tree->length + delta;
+    char *text = mem_alloc(MEM_SOURCE, new_length + 1);
+    if (!text) return -1;
+    memcpy(text, tree->source, offset);
+    memcpy(text + offset, inserted, inserted_length);
+    memcpy(text + offset + inserted_length, tree->source + edit_end, tree->length - edit_end + 1);
+
+    // First statement the edit can touch: the first one that doesn't end
+    // strictly before it. Everything before it is reused as is, and lexing
+    // restarts right after its predecessor's last token.
+    int first = first_boundary_at(tree, offset + 1) - 1;
+    if (first < 0) first = 0;
+    int resume = statement_boundary(tree, first);
+    int resume_line = first > 0 ? tree->spans[first - 1].end_line : 1;
+
+    // Old statements from `sync` on can be reused once the new parse ends
+    // exactly at their (shifted) boundary. The text after such a boundary is
+    // unchanged, so it has to lie at or past the end of the edit.
+    int sync = first_boundary_at(tree, edit_end);
+    if (sync < first) sync = first;
+
+    // Literals of statements that are later replaced stay in the pool.
+    // Nodes aren't shared: reused statements get their positions shifted.
+    StringPool *saved_pool = string_pool;
+    NodeTable *saved_table = node_table;
+    jmp_buf point;
+    jmp_buf *saved_recovery = recovery;
+    if (setjmp(point)) {
+        recovery = saved_recovery;
+        string_pool = saved_pool;
+        node_table = saved_table;
+        free_in_flight();
+        reset_pending(1);
+        mem_free(MEM_SOURCE, text);
+        return -1;
+    }
+    recovery = &point;
+    string_pool = &tree->strings;
+    node_table = NULL;
+
+    int line_delta = 0;
+    int synced = 0;
+    parser_resume(text, resume, resume_line);
+    while (!match(TOKEN_EOF)) {
+        ASTNode *statement = parse_statement();
+        if (!statement) parse_abort(); // error already reported
+        add_pending(tree, statement);
+        statement_complete();
+
+        // Skip old statements we've parsed past; stop if we land on a boundary
+        while (sync < tree->count && statement_boundary(tree, sync) + delta < previous_end) sync++;
+        if (sync < tree->count && statement_boundary(tree, sync) + delta == previous_end) {
+            int old_line = sync > 0 ? tree->spans[sync - 1].end_line : 1;
+            line_delta = previous_line - old_line;
+            synced = 1;
+            break;
+        }
+    }
+    if (!synced) sync = tree->count;
+    free_in_flight();
+    recovery = saved_recovery;
+    string_pool = saved_pool;
+    node_table = saved_table;
+
+    // Splice: statements [first, sync) are replaced by the pending ones
+    int reparsed = pending_count;
+    int new_count = tree->count - (sync - first) + pending_count;
+    if (!reserve_spans(tree, new_count)) {
+        reset_pending(1);
+        mem_free(MEM_SOURCE, text);
+        return -1;
+    }
+
+    ASTNode *before = first > 0 ? tree->spans[first - 1].node : tree->program;
+    ASTNode *after = sync < tree->count ? tree->spans[sync].node : NULL;
+    for (int i = first; i < sync; i++) {
+        tree->spans[i].node->next = NULL;
+        free_ast(tree->spans[i].node);
+    }
+    if (pending_count > 0) {
+        before->next = pending_head;
+        pending_spans[pending_count - 1].node->next = after;
+    } else {
+        before->next = after;
+    }
+
+    if (sync < tree->count) {
+        memmove(&tree->spans[first + pending_count], &tree->spans[sync],
+                (tree->count - sync) * sizeof(StatementSpan));
+    }
+    for (int i = first + pending_count; i < new_count; i++) {
+        tree->spans[i].end += delta;
+        tree->spans[i].end_line += line_delta;
+        tree->spans[i].line_shift += line_delta;
+        tree->spans[i].offset_shift += delta;
+    }
+    if (pending_count > 0) {
+        memcpy(&tree->spans[first], pending_spans, pending_count * sizeof(StatementSpan));
+    }
+    tree->count = new_count;
+    reset_pending(0);
+
+    mem_free(MEM_SOURCE, tree->source);
+    tree->source = text;
+    tree->length = new_length;
+    return reparsed;
+}
+
+ASTNode *parse_tree_program(ParseTree *tree) {
+    for (int i = 0; i < tree->count; i++) {
+        StatementSpan *span = &tree->spans[i];
+        if (span->line_shift == 0 && span->offset_shift == 0) continue;
+        shift_positions(span->node, span->line_shift, span->offset_shift, 0);
+        span->line_shift = 0;
+        span->offset_shift = 0;
+    }
+    return tree->program;
+}
+
+void parse_tree_free(ParseTree *tree) {
+    free_ast(tree->program);
+    mem_free(MEM_SOURCE, tree->source);
+    mem_free(MEM_AST, tree->spans);
+    string_pool_free(&tree->strings);
+    memset(tree, 0, sizeof(*tree));
 }
 
 // Print AST (for debugging)
@@ -604,10 +1077,17 @@ void print_ast(ASTNode *node, int level) {
 
 // Free AST memory
 void free_ast(ASTNode *node) {
-    if (!node) return;
-    free_ast(node->left);
-    free_ast(node->right);
-    free(node);
+    // Statement lists hang off `next`; walk them iteratively so long
+    // programs don't recurse once per statement
+    while (node) {
+        if (node->shared) return;  // the NodeTable frees it
+        ASTNode *next = node->next;
+        free_ast(node->left);
+        free_ast(node->right);
+        free_ast(node->operand);
+        mem_free(MEM_AST, node);
+        node = next;
+    }
 }
 
 // Example of examining tokens
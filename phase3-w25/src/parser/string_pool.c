@@ -0,0 +1,100 @@
+/* string_pool.c */
+#include <string.h>
+#include "../../include/allocator.h"
+#include "../../include/string_pool.h"
+
+static unsigned hash_bytes(const char* text, int length) {
+    unsigned hash = 2166136261u;     // FNV-1a
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void string_pool_init(StringPool* pool) {
+    memset(pool, 0, sizeof(*pool));
+}
+
+// Slot holding `text`, or the empty slot where it belongs
+static int find_slot(const StringPool* pool, const char* text, int length, unsigned hash) {
+    unsigned mask = (unsigned)pool->slot_count - 1;
+    for (unsigned slot = hash & mask; ; slot = (slot + 1) & mask) {
+        int id = pool->slots[slot];
+        if (id < 0) return (int)slot;
+        if (pool->lengths[id] == length &&
+            memcmp(pool->data + pool->offsets[id], text, length) == 0) {
+            return (int)slot;
+        }
+    }
+}
+
+static int grow_slots(StringPool* pool) {
+    int slot_count = pool->slot_count ? pool->slot_count * 2 : 64;
+    int* slots = mem_alloc(MEM_AST, slot_count * sizeof(int));
+    if (!slots) return 0;
+    memset(slots, 0xff, slot_count * sizeof(int));
+
+    int* old = pool->slots;
+    pool->slots = slots;
+    pool->slot_count = slot_count;
+    for (int id = 0; id < pool->count; id++) {
+        const char* text = pool->data + pool->offsets[id];
+        int length = pool->lengths[id];
+        pool->slots[find_slot(pool, text, length, hash_bytes(text, length))] = id;
+    }
+    mem_free(MEM_AST, old);
+    return 1;
+}
+
+int string_pool_intern(StringPool* pool, const char* text, int length) {
+    if ((pool->count + 1) * 2 > pool->slot_count && !grow_slots(pool)) return -1;
+
+    int slot = find_slot(pool, text, length, hash_bytes(text, length));
+    if (pool->slots[slot] >= 0) return pool->slots[slot];
+
+    if (pool->count == pool->capacity) {
+        int capacity = pool->capacity ? pool->capacity * 2 : 32;
+        size_t* offsets = mem_realloc(MEM_AST, pool->offsets, capacity * sizeof(size_t));
+        if (!offsets) return -1;
+        pool->offsets = offsets;
+        int* lengths = mem_realloc(MEM_AST, pool->lengths, capacity * sizeof(int));
+        if (!lengths) return -1;
+        pool->lengths = lengths;
+        pool->capacity = capacity;
+    }
+    if (pool->size + length + 1 > pool->data_capacity) {
+        size_t capacity = pool->data_capacity ? pool->data_capacity : 1024;
+        while (pool->size + length + 1 > capacity) capacity *= 2;
+        char* data = mem_realloc(MEM_AST, pool->data, capacity);
+        if (!data) return -1;
+        pool->data = data;
+        pool->data_capacity = capacity;
+    }
+
+    int id = pool->count++;
+    pool->offsets[id] = pool->size;
+    pool->lengths[id] = length;
+    memcpy(pool->data + pool->size, text, length);
+    pool->data[pool->size + length] = '\0';
+    pool->size += length + 1;
+    pool->slots[slot] = id;
+    return id;
+}
+
+const char* string_pool_get(const StringPool* pool, int id) {
+    if (id < 0 || id >= pool->count) return NULL;
+    return pool->data + pool->offsets[id];
+}
+
+int string_pool_length(const StringPool* pool, int id) {
+    if (id < 0 || id >= pool->count) return -1;
+    return pool->lengths[id];
+}
+
+void string_pool_free(StringPool* pool) {
+    mem_free(MEM_AST, pool->data);
+    mem_free(MEM_AST, pool->offsets);
+    mem_free(MEM_AST, pool->lengths);
+    mem_free(MEM_AST, pool->slots);
+    memset(pool, 0, sizeof(*pool));
+}
@@ -0,0 +1,381 @@
+/* runtime.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "../../include/runtime.h"
+#include "../../include/diagnostics.h"
+#include "../../include/allocator.h"
+
+// Operands shorter than this (in limbs) use schoolbook multiplication
+#define KARATSUBA_THRESHOLD 32
+
+// Number of large factorials kept between calls
+#define FACTORIAL_CACHE_SIZE 32
+
+static const uint64_t factorial_table[FACTORIAL_TABLE_MAX + 1] = {
+    1ULL,
+    1ULL,
+    2ULL,
+    6ULL,
+    24ULL,
+    120ULL,
+    720ULL,
+    5040ULL,
+    40320ULL,
+    362880ULL,
+    3628800ULL,
+    39916800ULL,
+    479001600ULL,
+    6227020800ULL,
+    87178291200ULL,
+    1307674368000ULL,
+    20922789888000ULL,
+    355687428096000ULL,
+    6402373705728000ULL,
+    121645100408832000ULL,
+    2432902008176640000ULL
+};
+
+typedef struct {
+    int n;
+    BigInt value;
+    unsigned long last_used;
+} FactorialCacheEntry;
+
+static FactorialCacheEntry factorial_cache[FACTORIAL_CACHE_SIZE];
+static int factorial_cache_count = 0;
+static unsigned long factorial_cache_clock = 0;
+
+// ---------------------------------------------------------------------------
+// INT FACTORIAL
+// ---------------------------------------------------------------------------
+
+uint64_t runtime_factorial_u64(int n) {
+    if (n < 0 || n > FACTORIAL_TABLE_MAX) return 0;
+    return factorial_table[n];
+}
+
+RuntimeError runtime_factorial_int(int n, int* result) {
+    if (n < 0) return RUNTIME_ERROR_NEGATIVE_ARGUMENT;
+    if (n > FACTORIAL_TABLE_MAX || factorial_table[n] > (uint64_t)INT_MAX) {
+        return RUNTIME_ERROR_INT_OVERFLOW;
+    }
+    *result = (int)factorial_table[n];
+    return RUNTIME_OK;
+}
+
+// ---------------------------------------------------------------------------
+// BIG INTEGERS
+// ---------------------------------------------------------------------------
+
+static void trim(BigInt* value) {
+    while (value->count > 0 && value->limbs[value->count - 1] == 0) value->count--;
+}
+
+static int bigint_from_u64(BigInt* value, uint64_t x) {
+    value->limbs = mem_alloc(MEM_RUNTIME, 2 * sizeof(uint32_t));
+    if (!value->limbs) return 0;
+    value->limbs[0] = (uint32_t)x;
+    value->limbs[1] = (uint32_t)(x >> 32);
+    value->count = 2;
+    trim(value);
+    return 1;
+}
+
+void bigint_free(BigInt* value) {
+    if (!value) return;
+    mem_free(MEM_RUNTIME, value->limbs);
+    value->limbs = NULL;
+    value->count = 0;
+}
+
+// dst[0..dst_len) += src[0..src_len), src_len <= dst_len
+static void add_limbs(uint32_t* dst, int dst_len, const uint32_t* src, int src_len) {
+    uint64_t carry = 0;
+    int i;
+    for (i = 0; i < src_len; i++) {
+        uint64_t sum = (uint64_t)dst[i] + src[i] + carry;
+        dst[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+    for (; carry && i < dst_len; i++) {
+        uint64_t sum = (uint64_t)dst[i] + carry;
+        dst[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+}
+
+// dst[0..dst_len) -= src[0..src_len), the result must not be negative
+static void sub_limbs(uint32_t* dst, int dst_len, const uint32_t* src, int src_len) {
+    int64_t borrow = 0;
+    int i;
+    for (i = 0; i < src_len; i++) {
+        int64_t diff = (int64_t)dst[i] - src[i] - borrow;
+        borrow = diff < 0;
+        dst[i] = (uint32_t)diff;
+    }
+    for (; borrow && i < dst_len; i++) {
+        int64_t diff = (int64_t)dst[i] - borrow;
+        borrow = diff < 0;
+        dst[i] = (uint32_t)diff;
+    }
+}
+
+static void schoolbook_mul(const uint32_t* a, int na, const uint32_t* b, int nb, uint32_t* out) {
+    for (int i = 0; i < na; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < nb; j++) {
+            uint64_t t = (uint64_t)a[i] * b[j] + out[i + j] + carry;
+            out[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        out[i + nb] = (uint32_t)carry;
+    }
+}
+
+// out[0..na+nb) = a * b; out must be zeroed. Returns 0 when out of memory.
+static int mul_limbs(const uint32_t* a, int na, const uint32_t* b, int nb, uint32_t* out) {
+    if (na < nb) {
+        const uint32_t* t = a; a = b; b = t;
+        int tn = na; na = nb; nb = tn;
+    }
+    if (nb == 0) return 1;
+    if (nb < KARATSUBA_THRESHOLD) {
+        schoolbook_mul(a, na, b, nb, out);
+        return 1;
+    }
+
+    int m = na / 2;
+    if (nb <= m) {
+        // Unbalanced: multiply b by nb-sized slices of a
+        uint32_t* partial = mem_alloc(MEM_RUNTIME, (size_t)2 * nb * sizeof(uint32_t));
+        if (!partial) return 0;
+        for (int offset = 0; offset < na; offset += nb) {
+            int len = na - offset < nb ? na - offset : nb;
+            memset(partial, 0, (size_t)(len + nb) * sizeof(uint32_t));
+            if (!mul_limbs(a + offset, len, b, nb, partial)) {
+                mem_free(MEM_RUNTIME, partial);
+                return 0;
+            }
+            add_limbs(out + offset, na + nb - offset, partial, len + nb);
+        }
+        mem_free(MEM_RUNTIME, partial);
+        return 1;
+    }
+
+    // Karatsuba: a = a1*B^m + a0, b = b1*B^m + b0
+    int na1 = na - m, nb1 = nb - m;
+    int nsa = (na1 > m ? na1 : m) + 1;
+    int nsb = (nb1 > m ? nb1 : m) + 1;
+    uint32_t* sa = mem_calloc(MEM_RUNTIME, nsa, sizeof(uint32_t));
+    uint32_t* sb = mem_calloc(MEM_RUNTIME, nsb, sizeof(uint32_t));
+    uint32_t* z0 = mem_calloc(MEM_RUNTIME, 2 * m, sizeof(uint32_t));
+    uint32_t* z2 = mem_calloc(MEM_RUNTIME, na1 + nb1, sizeof(uint32_t));
+    uint32_t* z1 = mem_calloc(MEM_RUNTIME, nsa + nsb, sizeof(uint32_t));
+    int ok = sa && sb && z0 && z2 && z1;
+
+    if (ok) {
+        memcpy(sa, a, m * sizeof(uint32_t));
+        add_limbs(sa, nsa, a + m, na1);
+        memcpy(sb, b, m * sizeof(uint32_t));
+        add_limbs(sb, nsb, b + m, nb1);
+
+        ok = mul_limbs(a, m, b, m, z0) &&
+             mul_limbs(a + m, na1, b + m, nb1, z2) &&
+             mul_limbs(sa, nsa, sb, nsb, z1);
+    }
+    if (ok) {
+        // z1 = (a0 + a1)(b0 + b1) - z0 - z2 = a0*b1 + a1*b0
+        sub_limbs(z1, nsa + nsb, z0, 2 * m);
+        sub_limbs(z1, nsa + nsb, z2, na1 + nb1);
+
+        int total = na + nb;
+        add_limbs(out, total, z0, 2 * m);
+        // The true values fit in the result, so any limbs cut off here are zero
+        int z1_len = nsa + nsb < total - m ? nsa + nsb : total - m;
+        add_limbs(out + m, total - m, z1, z1_len);
+        add_limbs(out + 2 * m, total - 2 * m, z2, na1 + nb1);
+    }
+
+    mem_free(MEM_RUNTIME, sa);
+    mem_free(MEM_RUNTIME, sb);
+    mem_free(MEM_RUNTIME, z0);
+    mem_free(MEM_RUNTIME, z2);
+    mem_free(MEM_RUNTIME, z1);
+    return ok;
+}
+
+static int bigint_mul(const BigInt* a, const BigInt* b, BigInt* out) {
+    out->count = a->count + b->count;
+    out->limbs = mem_calloc(MEM_RUNTIME, out->count ? out->count : 1, sizeof(uint32_t));
+    if (!out->limbs) return 0;
+    if (!mul_limbs(a->limbs, a->count, b->limbs, b->count, out->limbs)) {
+        bigint_free(out);
+        return 0;
+    }
+    trim(out);
+    return 1;
+}
+
+char* bigint_to_string(const BigInt* value) {
+    if (!value || value->count == 0) {
+        char* zero = malloc(2);
+        if (zero) strcpy(zero, "0");
+        return zero;
+    }
+
+    // Peel off base-10^9 chunks, least significant first
+    uint32_t* work = mem_alloc(MEM_RUNTIME, value->count * sizeof(uint32_t));
+    uint32_t* chunks = mem_alloc(MEM_RUNTIME, (value->count * 10 / 9 + 2) * sizeof(uint32_t));
+    if (!work || !chunks) {
+        mem_free(MEM_RUNTIME, work);
+        mem_free(MEM_RUNTIME, chunks);
+        return NULL;
+    }
+    memcpy(work, value->limbs, value->count * sizeof(uint32_t));
+    int len = value->count;
+    int chunk_count = 0;
+    while (len > 0) {
+        uint64_t rem = 0;
+        for (int i = len - 1; i >= 0; i--) {
+            uint64_t cur = (rem << 32) | work[i];
+            work[i] = (uint32_t)(cur / 1000000000u);
+            rem = cur % 1000000000u;
+        }
+        chunks[chunk_count++] = (uint32_t)rem;
+        while (len > 0 && work[len - 1] == 0) len--;
+    }
+
+    char* text = malloc((size_t)chunk_count * 9 + 1);
+    if (text) {
+        int pos = sprintf(text, "%u", chunks[chunk_count - 1]);
+        for (int i = chunk_count - 2; i >= 0; i--) {
+            pos += sprintf(text + pos, "%09u", chunks[i]);
+        }
+    }
+    mem_free(MEM_RUNTIME, work);
+    mem_free(MEM_RUNTIME, chunks);
+    return text;
+}
+
+// ---------------------------------------------------------------------------
+// BIG FACTORIAL
+// ---------------------------------------------------------------------------
+
+// out = (lo+1) * (lo+2) * ... * hi, split in halves so both sides of every
+// multiplication have similar sizes
+static int product_range(uint32_t lo, uint32_t hi, BigInt* out) {
+    if (hi - lo <= 16) {
+        if (!bigint_from_u64(out, 1)) return 0;
+        uint64_t acc = 1;
+        for (uint32_t k = lo + 1; k <= hi; k++) {
+            if (acc > UINT32_MAX / k) {
+                BigInt factor, product;
+                if (!bigint_from_u64(&factor, acc)) return 0;
+                int ok = bigint_mul(out, &factor, &product);
+                bigint_free(&factor);
+                if (!ok) return 0;
+                bigint_free(out);
+                *out = product;
+                acc = 1;
+            }
+            acc *= k;
+        }
+        BigInt factor, product;
+        if (!bigint_from_u64(&factor, acc)) return 0;
+        int ok = bigint_mul(out, &factor, &product);
+        bigint_free(&factor);
+        bigint_free(out);
+        if (!ok) return 0;
+        *out = product;
+        return 1;
+    }
+
+    uint32_t mid = lo + (hi - lo) / 2;
+    BigInt left, right;
+    if (!product_range(lo, mid, &left)) return 0;
+    if (!product_range(mid, hi, &right)) {
+        bigint_free(&left);
+        return 0;
+    }
+    int ok = bigint_mul(&left, &right, out);
+    bigint_free(&left);
+    bigint_free(&right);
+    return ok;
+}
+
+static FactorialCacheEntry* cache_slot(void) {
+    if (factorial_cache_count < FACTORIAL_CACHE_SIZE) {
+        return &factorial_cache[factorial_cache_count++];
+    }
+    // Evict the least recently used entry
+    FactorialCacheEntry* victim = &factorial_cache[0];
+    for (int i = 1; i < FACTORIAL_CACHE_SIZE; i++) {
+        if (factorial_cache[i].last_used < victim->last_used) victim = &factorial_cache[i];
+    }
+    bigint_free(&victim->value);
+    return victim;
+}
+
+const BigInt* runtime_factorial_big(int n) {
+    if (n < 0) return NULL;
+
+    // Exact hit, or the closest smaller factorial to start from
+    FactorialCacheEntry* base = NULL;
+    for (int i = 0; i < factorial_cache_count; i++) {
+        FactorialCacheEntry* entry = &factorial_cache[i];
+        if (entry->n == n) {
+            entry->last_used = ++factorial_cache_clock;
+            return &entry->value;
+        }
+        if (entry->n < n && (!base || entry->n > base->n)) base = entry;
+    }
+
+    BigInt value;
+    if (n <= FACTORIAL_TABLE_MAX) {
+        if (!bigint_from_u64(&value, factorial_table[n])) return NULL;
+    } else {
+        // n! = start! * (start+1) * ... * n
+        BigInt start;
+        int start_n;
+        if (base && base->n > FACTORIAL_TABLE_MAX) {
+            start = base->value;
+            start_n = base->n;
+        } else {
+            start_n = FACTORIAL_TABLE_MAX;
+            if (!bigint_from_u64(&start, factorial_table[FACTORIAL_TABLE_MAX])) return NULL;
+        }
+
+        BigInt rest;
+        int ok = product_range((uint32_t)start_n, (uint32_t)n, &rest);
+        if (ok) {
+            ok = bigint_mul(&start, &rest, &value);
+            bigint_free(&rest);
+        }
+        if (start_n == FACTORIAL_TABLE_MAX) bigint_free(&start);
+        if (!ok) return NULL;
+    }
+
+    FactorialCacheEntry* entry = cache_slot();
+    entry->n = n;
+    entry->value = value;
+    entry->last_used = ++factorial_cache_clock;
+    return &entry->value;
+}
+
+void runtime_free_factorial_cache(void) {
+    for (int i = 0; i < factorial_cache_count; i++) {
+        bigint_free(&factorial_cache[i].value);
+    }
+    factorial_cache_count = 0;
+    factorial_cache_clock = 0;
+}
+
+// ---------------------------------------------------------------------------
+// ERROR REPORTING
+// ---------------------------------------------------------------------------
+
+void runtime_error(RuntimeError error, int line) {
+    diag_report(DIAG_PHASE_RUNTIME, error, DIAG_ERROR, line, 0, NULL);
+}
@@ -0,0 +1,402 @@
+/* dataflow.c */
+#include <stdint.h>
+#include <string.h>
+#include "../../include/parser.h"
+#include "../../include/semantic.h"
+#include "../../include/dataflow.h"
+#include "../../include/allocator.h"
+#include "../../include/budget.h"
+
+typedef uint64_t BitWord;
+#define WORD_BITS 64
+
+typedef enum {
+    EVENT_DECLARE,      // variable comes into existence unassigned
+    EVENT_ASSIGN,       // variable is given a value
+    EVENT_USE           // variable is read
+} FlowEventKind;
+
+typedef struct {
+    FlowEventKind kind;
+    int var;
+    ASTNode* node;      // identifier node, for reporting uses
+} FlowEvent;
+
+typedef struct {
+    FlowEvent* events;
+    int count;
+    int capacity;
+    int succ[2];        // structured control flow never needs more than two
+    int succ_count;
+} FlowBlock;
+
+typedef struct {
+    FlowBlock* blocks;
+    int block_count;
+    int block_capacity;
+    int current;        // block receiving new events
+    int var_count;      // one past the largest symbol id seen
+    int failed;         // out of memory; the graph is incomplete
+} FlowGraph;
+
+static void build_statement(FlowGraph* graph, ASTNode* node);
+
+// Once an allocation failed the graph is only built far enough to be freed:
+// new blocks are the current one and edges and events are dropped.
+static int new_block(FlowGraph* graph) {
+    if (graph->failed) return graph->current;
+    if (graph->block_count == graph->block_capacity) {
+        int capacity = graph->block_capacity ? graph->block_capacity * 2 : 16;
+        FlowBlock* blocks = mem_realloc(MEM_DATAFLOW, graph->blocks, capacity * sizeof(FlowBlock));
+        if (!blocks) {
+            graph->failed = 1;
+            return graph->current;
+        }
+        graph->blocks = blocks;
+        graph->block_capacity = capacity;
+    }
+    FlowBlock* block = &graph->blocks[graph->block_count];
+    memset(block, 0, sizeof(FlowBlock));
+    return graph->block_count++;
+}
+
+static void add_edge(FlowGraph* graph, int from, int to) {
+    if (graph->failed) return;
+    FlowBlock* block = &graph->blocks[from];
+    block->succ[block->succ_count++] = to;
+}
+
+// Variables are the symbol ids annotated by the semantic pass, so this pass
+// resolves names exactly as lookup_symbol() did. Unresolved names (already
+// reported as undeclared or redeclared) carry no id and are skipped.
+static void add_event(FlowGraph* graph, FlowEventKind kind, int var, ASTNode* node) {
+    if (var < 0 || graph->failed) return;
+    if (var >= graph->var_count) graph->var_count = var + 1;
+
+    FlowBlock* block = &graph->blocks[graph->current];
+    if (block->count == block->capacity) {
+        int capacity = block->capacity ? block->capacity * 2 : 8;
+        FlowEvent* events = mem_realloc(MEM_DATAFLOW, block->events, capacity * sizeof(FlowEvent));
+        if (!events) {
+            graph->failed = 1;
+            return;
+        }
+        block->events = events;
+        block->capacity = capacity;
+    }
+    FlowEvent* event = &block->events[block->count++];
+    event->kind = kind;
+    event->var = var;
+    event->node = node;
+}
+
+static void build_uses(FlowGraph* graph, ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case AST_IDENTIFIER:
+            add_event(graph, EVENT_USE, node->symbol_id, node);
+            break;
+        case AST_BINOP:
+        case AST_COMPARISON:
+            build_uses(graph, node->left);
+            build_uses(graph, node->right);
+            break;
+        case AST_CONDITION:
+        case AST_FACTORIAL:
+            build_uses(graph, node->left);
+            break;
+        default:
+            break;
+    }
+}
+
+// Build a chain of statements linked through next
+static void build_list(FlowGraph* graph, ASTNode* stmt) {
+    while (stmt) {
+        build_statement(graph, stmt);
+        stmt = stmt->next;
+    }
+}
+
+static void build_statement(FlowGraph* graph, ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case AST_VARDECL:
+            add_event(graph, EVENT_DECLARE, node->symbol_id, node);
+            break;
+        case AST_ASSIGN:
+            build_uses(graph, node->right);
+            if (node->left) add_event(graph, EVENT_ASSIGN, node->left->symbol_id, node->left);
+            break;
+        case AST_PRINT:
+        case AST_FACTORIAL:
+            build_uses(graph, node->left);
+            break;
+        case AST_BLOCK:
+            build_list(graph, node->next);
+            break;
+        case AST_IF: {
+            // cond -> then -> join, cond -> join
+            build_uses(graph, node->left);
+            int cond = graph->current;
+            int then_block = new_block(graph);
+            add_edge(graph, cond, then_block);
+            graph->current = then_block;
+            build_statement(graph, node->right);
+            int then_end = graph->current;
+            int join = new_block(graph);
+            add_edge(graph, then_end, join);
+            add_edge(graph, cond, join);
+            graph->current = join;
+            break;
+        }
+        case AST_WHILE: {
+            // pre -> header -> body -> header, header -> exit
+            int header = new_block(graph);
+            add_edge(graph, graph->current, header);
+            graph->current = header;
+            build_uses(graph, node->left);
+            int body = new_block(graph);
+            add_edge(graph, header, body);
+            graph->current = body;
+            build_statement(graph, node->right);
+            add_edge(graph, graph->current, header);
+            int exit_block = new_block(graph);
+            add_edge(graph, header, exit_block);
+            graph->current = exit_block;
+            break;
+        }
+        case AST_REPEAT: {
+            // pre -> body -> cond -> body, cond -> exit
+            int body = new_block(graph);
+            add_edge(graph, graph->current, body);
+            graph->current = body;
+            build_statement(graph, node->left);
+            if (node->right) build_uses(graph, node->right->left);
+            int cond_end = graph->current;
+            add_edge(graph, cond_end, body);
+            int exit_block = new_block(graph);
+            add_edge(graph, cond_end, exit_block);
+            graph->current = exit_block;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void free_graph(FlowGraph* graph) {
+    for (int i = 0; i < graph->block_count; i++) {
+        mem_free(MEM_DATAFLOW, graph->blocks[i].events);
+    }
+    mem_free(MEM_DATAFLOW, graph->blocks);
+}
+
+int check_definite_assignment(ASTNode* program) {
+    if (!program) return 0;
+
+    FlowGraph graph;
+    memset(&graph, 0, sizeof(graph));
+    graph.current = new_block(&graph);     // entry
+    build_list(&graph, program->next);
+
+    int blocks = graph.block_count;
+    int vars = graph.var_count;
+    int reported = -1;
+    int* dense = NULL;
+    int* stamp = NULL;
+    char* local = NULL;
+    BitWord* sets = NULL;
+    int* pred_start = NULL;
+    int* preds = NULL;
+    int* worklist = NULL;
+    char* queued = NULL;
+    int* fill = NULL;
+    if (graph.failed) goto done;
+
+    // Only variables with an upward-exposed use (a read before any declaration
+    // or assignment in the same block) need a bit in the global problem; every
+    // other read is decided by the events before it in its own block. This
+    // keeps the bit vectors small for programs with many short-lived variables.
+    dense = mem_alloc(MEM_DATAFLOW, (vars ? vars : 1) * sizeof(int));
+    stamp = mem_alloc(MEM_DATAFLOW, (vars ? vars : 1) * sizeof(int));
+    local = mem_alloc(MEM_DATAFLOW, vars ? vars : 1);
+    if (!dense || !stamp || !local) {
+        graph.failed = 1;
+        goto done;
+    }
+    for (int v = 0; v < vars; v++) {
+        dense[v] = -1;
+        stamp[v] = -1;
+    }
+    int tracked = 0;
+    for (int b = 0; b < blocks; b++) {
+        FlowBlock* block = &graph.blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            int var = block->events[i].var;
+            if (block->events[i].kind != EVENT_USE) {
+                stamp[var] = b;
+            } else if (stamp[var] != b && dense[var] < 0) {
+                dense[var] = tracked++;
+            }
+        }
+    }
+
+    int words = (tracked + WORD_BITS - 1) / WORD_BITS;
+    if (words == 0) words = 1;
+
+    // in/out/gen/kill for every block, each `words` long, in one allocation
+    sets = mem_calloc(MEM_DATAFLOW, (size_t)blocks * 4 * words, sizeof(BitWord));
+    pred_start = mem_calloc(MEM_DATAFLOW, blocks + 1, sizeof(int));
+    preds = mem_alloc(MEM_DATAFLOW, (size_t)blocks * 2 * sizeof(int));
+    worklist = mem_alloc(MEM_DATAFLOW, blocks * sizeof(int));
+    queued = mem_alloc(MEM_DATAFLOW, blocks);
+    fill = mem_calloc(MEM_DATAFLOW, blocks, sizeof(int));
+    if (!sets || !pred_start || !preds || !worklist || !queued || !fill) {
+        graph.failed = 1;
+        goto done;
+    }
+#define IN(b)   (sets + ((size_t)(b) * 4 + 0) * words)
+#define OUT(b)  (sets + ((size_t)(b) * 4 + 1) * words)
+#define GEN(b)  (sets + ((size_t)(b) * 4 + 2) * words)
+#define KILL(b) (sets + ((size_t)(b) * 4 + 3) * words)
+
+    // Local effect of each block, replaying its events in order
+    for (int b = 0; b < blocks; b++) {
+        BitWord* gen = GEN(b);
+        BitWord* kill = KILL(b);
+        FlowBlock* block = &graph.blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            int var = dense[block->events[i].var];
+            if (var < 0) continue;
+            BitWord bit = (BitWord)1 << (var % WORD_BITS);
+            if (block->events[i].kind == EVENT_ASSIGN) {
+                gen[var / WORD_BITS] |= bit;
+                kill[var / WORD_BITS] &= ~bit;
+            } else if (block->events[i].kind == EVENT_DECLARE) {
+                kill[var / WORD_BITS] |= bit;
+                gen[var / WORD_BITS] &= ~bit;
+            }
+        }
+        // Everything starts optimistic ("assigned") except the entry
+        memset(OUT(b), 0xff, words * sizeof(BitWord));
+    }
+
+    // Predecessor lists (compressed rows)
+    for (int b = 0; b < blocks; b++) {
+        for (int s = 0; s < graph.blocks[b].succ_count; s++) {
+            pred_start[graph.blocks[b].succ[s] + 1]++;
+        }
+    }
+    for (int b = 0; b < blocks; b++) pred_start[b + 1] += pred_start[b];
+    for (int b = 0; b < blocks; b++) {
+        for (int s = 0; s < graph.blocks[b].succ_count; s++) {
+            int to = graph.blocks[b].succ[s];
+            preds[pred_start[to] + fill[to]++] = b;
+        }
+    }
+
+    // Worklist iteration, seeded in creation order (which follows program order)
+    int head = 0, size = blocks;
+    for (int b = 0; b < blocks; b++) {
+        worklist[b] = b;
+        queued[b] = 1;
+    }
+    while (size > 0) {
+        // Large programs can take a while to settle; past --max-time the
+        // solution is incomplete, so nothing is reported
+        if (!budget_check(0)) goto done;
+        int b = worklist[head];
+        head = (head + 1) % blocks;
+        size--;
+        queued[b] = 0;
+
+        BitWord* in = IN(b);
+        if (b == 0) {
+            memset(in, 0, words * sizeof(BitWord));
+        } else {
+            memset(in, 0xff, words * sizeof(BitWord));
+            for (int p = pred_start[b]; p < pred_start[b + 1]; p++) {
+                BitWord* pred_out = OUT(preds[p]);
+                for (int w = 0; w < words; w++) in[w] &= pred_out[w];
+            }
+        }
+
+        BitWord* out = OUT(b);
+        BitWord* gen = GEN(b);
+        BitWord* kill = KILL(b);
+        BitWord changed = 0;
+        for (int w = 0; w < words; w++) {
+            BitWord next = (in[w] & ~kill[w]) | gen[w];
+            changed |= next ^ out[w];
+            out[w] = next;
+        }
+
+        if (changed) {
+            for (int s = 0; s < graph.blocks[b].succ_count; s++) {
+                int succ = graph.blocks[b].succ[s];
+                if (!queued[succ]) {
+                    queued[succ] = 1;
+                    worklist[(head + size) % blocks] = succ;
+                    size++;
+                }
+            }
+        }
+    }
+
+    // Report reads that are not assigned on every incoming path. Blocks are
+    // visited in creation order, which keeps the warnings in program order.
+    reported = 0;
+    for (int v = 0; v < vars; v++) stamp[v] = -1;
+    for (int b = 0; b < blocks; b++) {
+        FlowBlock* block = &graph.blocks[b];
+        BitWord* in = IN(b);
+        for (int i = 0; i < block->count; i++) {
+            FlowEvent* event = &block->events[i];
+            int var = event->var;
+            switch (event->kind) {
+                case EVENT_ASSIGN:
+                case EVENT_DECLARE:
+                    stamp[var] = b;
+                    local[var] = event->kind == EVENT_ASSIGN;
+                    break;
+                case EVENT_USE: {
+                    int assigned;
+                    if (stamp[var] == b) {
+                        assigned = local[var];
+                    } else {
+                        int bit = dense[var];
+                        assigned = (in[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+                    }
+                    if (!assigned) {
+                        semantic_error_at(SEM_ERROR_UNINITIALIZED_VARIABLE,
+                                          event->node->token.lexeme, &event->node->token);
+                        reported++;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+#undef IN
+#undef OUT
+#undef GEN
+#undef KILL
+
+done:
+    // Like a syntax error, running out of memory gives up on this input only
+    if (graph.failed) semantic_error(SEM_ERROR_OUT_OF_MEMORY, "definite assignment", 0);
+    mem_free(MEM_DATAFLOW, dense);
+    mem_free(MEM_DATAFLOW, stamp);
+    mem_free(MEM_DATAFLOW, local);
+    mem_free(MEM_DATAFLOW, sets);
+    mem_free(MEM_DATAFLOW, pred_start);
+    mem_free(MEM_DATAFLOW, preds);
+    mem_free(MEM_DATAFLOW, worklist);
+    mem_free(MEM_DATAFLOW, queued);
+    mem_free(MEM_DATAFLOW, fill);
+    free_graph(&graph);
+    return reported;
+}
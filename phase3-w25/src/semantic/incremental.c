@@ -0,0 +1,363 @@
+/* incremental.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/parser.h"
+#include "../../include/semantic.h"
+#include "../../include/diagnostics.h"
+#include "../../include/allocator.h"
+#include "../../include/incremental.h"
+
+// A sorted set of name hashes. Two names with the same hash only cost an
+// unnecessary re-check. `everything` stands in for a set we couldn't grow.
+typedef struct {
+    unsigned* items;
+    int count;
+    int capacity;
+    int everything;
+} NameSet;
+
+static unsigned hash_name(const char* name) {
+    unsigned hash = 2166136261u;     // FNV-1a
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static int find_hash(const unsigned* items, int count, unsigned hash) {
+    int low = 0, high = count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (items[mid] < hash) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+static void set_add(NameSet* set, unsigned hash) {
+    if (set->everything) return;
+    int at = find_hash(set->items, set->count, hash);
+    if (at < set->count && set->items[at] == hash) return;
+    if (set->count == set->capacity) {
+        int capacity = set->capacity ? set->capacity * 2 : 16;
+        unsigned* items = mem_realloc(MEM_SYMBOLS, set->items, capacity * sizeof(unsigned));
+        if (!items) {
+            set->everything = 1;
+            return;
+        }
+        set->items = items;
+        set->capacity = capacity;
+    }
+    memmove(&set->items[at + 1], &set->items[at], (set->count - at) * sizeof(unsigned));
+    set->items[at] = hash;
+    set->count++;
+}
+
+// Whether a statement that read `reads` could resolve differently now
+static int reads_changed(const CheckedStatement* statement, const NameSet* changed) {
+    if (changed->everything || statement->read_count < 0) return 1;
+    if (changed->count == 0) return 0;
+    for (int i = 0; i < statement->read_count; i++) {
+        int at = find_hash(changed->items, changed->count, statement->reads[i]);
+        if (at < changed->count && changed->items[at] == statement->reads[i]) return 1;
+    }
+    return 0;
+}
+
+static void add_declared(NameSet* changed, const CheckedStatement* statement) {
+    if (!statement->declared) return;
+    for (Symbol* symbol = statement->declared; ; symbol = symbol->next) {
+        set_add(changed, hash_name(symbol->name));
+        if (symbol == statement->oldest) break;
+    }
+}
+
+// Drops what checking the statement produced, keeping its id
+static void clear_statement(CheckedStatement* statement) {
+    symbol_table_release(&statement->from);
+    symbol_table_release(&statement->after);
+    symbol_map_release(statement->assigned);
+    statement->assigned = NULL;
+    Symbol* symbol = statement->declared;
+    while (symbol) {
+        Symbol* next = symbol->next;
+        int last = symbol == statement->oldest;
+        mem_free(MEM_SYMBOLS, symbol);
+        if (last) break;
+        symbol = next;
+    }
+    mem_free(MEM_SYMBOLS, statement->reads);
+    mem_free(MEM_DIAGNOSTICS, statement->diagnostics);
+    statement->declared = statement->oldest = NULL;
+    statement->reads = NULL;
+    statement->read_count = 0;
+    statement->diagnostics = NULL;
+    statement->diagnostic_count = 0;
+    statement->result = 1;
+}
+
+// Collects the names looked up while one statement is checked
+typedef struct {
+    unsigned* items;
+    int count;
+    int capacity;
+    int failed;
+} ReadLog;
+
+static void log_read(void* context, const char* name) {
+    ReadLog* log = context;
+    if (log->failed) return;
+    if (log->count == log->capacity) {
+        int capacity = log->capacity ? log->capacity * 2 : 8;
+        unsigned* items = mem_realloc(MEM_SYMBOLS, log->items, capacity * sizeof(unsigned));
+        if (!items) {
+            log->failed = 1;
+            return;
+        }
+        log->items = items;
+        log->capacity = capacity;
+    }
+    log->items[log->count++] = hash_name(name);
+}
+
+static int compare_hashes(const void* a, const void* b) {
+    unsigned x = *(const unsigned*)a, y = *(const unsigned*)b;
+    return (x > y) - (x < y);
+}
+
+// Annotations from a previous check would be read back as cached results
+static void reset_annotations(ASTNode* node, int follow_next) {
+    while (node) {
+        node->value_type = TYPE_UNANNOTATED;
+        node->symbol_id = -1;
+        reset_annotations(node->left, 1);
+        reset_annotations(node->right, 1);
+        reset_annotations(node->operand, 1);
+        if (!follow_next) return;
+        node = node->next;
+    }
+}
+
+static void add_initialized(void* context, const SymbolMapNode* entry) {
+    mark_initialized(context, (int)entry->key);
+}
+
+// Check one statement from the checkpoint the table is at
+static void check_from(SemanticCache* cache, CheckedStatement* statement,
+                       const StatementSpan* span) {
+    SymbolTable* table = &cache->table;
+    Symbol* before = table->head;
+    symbol_table_snapshot(&statement->from, table);
+    // Checking doesn't read what is initialized; an empty set collects what
+    // the statement itself assigns, even if the checkpoint had it already
+    SymbolMapNode* initialized = table->initialized;
+    table->initialized = NULL;
+    reset_annotations(span->node, 0);
+
+    ReadLog log = {0};
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    DiagnosticSession* previous = diag_begin(&session);
+    semantic_set_read_hook(log_read, &log);
+    statement->result = check_statement(span->node, table);
+    semantic_set_read_hook(NULL, NULL);
+    diag_end(previous);
+    statement->assigned = table->initialized;
+    table->initialized = initialized;
+    symbol_map_diff(statement->assigned, NULL, add_initialized, table);
+
+    // Everything in front of the checkpoint was declared by this statement
+    statement->declared = table->head != before ? table->head : NULL;
+    statement->oldest = NULL;
+    for (Symbol* symbol = statement->declared; symbol && symbol != before; symbol = symbol->next) {
+        statement->oldest = symbol;
+    }
+    symbol_table_snapshot(&statement->after, table);
+
+    if (log.failed) {
+        mem_free(MEM_SYMBOLS, log.items);
+        statement->reads = NULL;
+        statement->read_count = -1;     // depends on everything
+    } else {
+        qsort(log.items, log.count, sizeof(unsigned), compare_hashes);
+        int unique = 0;
+        for (int i = 0; i < log.count; i++) {
+            if (unique == 0 || log.items[unique - 1] != log.items[i]) log.items[unique++] = log.items[i];
+        }
+        statement->reads = log.items;
+        statement->read_count = unique;
+    }
+
+    // Keep the session's array rather than copying it
+    statement->diagnostics = session.items;
+    statement->diagnostic_count = session.count;
+    statement->end_line = span->end_line;
+    statement->end = span->end;
+    cache->checked++;
+}
+
+// Lines and offsets moved by edits before a reused statement
+static void shift_statement(CheckedStatement* statement, int delta, int offset_delta) {
+    for (int i = 0; i < statement->diagnostic_count; i++) {
+        statement->diagnostics[i].line += delta;
+        if (statement->diagnostics[i].offset >= 0) statement->diagnostics[i].offset += offset_delta;
+    }
+    if (delta == 0) return;
+    for (Symbol* symbol = statement->declared; symbol; symbol = symbol->next) {
+        symbol->line_declared += delta;
+        if (symbol == statement->oldest) break;
+    }
+}
+
+// Put a reused statement's symbols and assignments back on top of the table.
+// From the checkpoint it was checked from, its snapshot can be taken over.
+static void relink_statement(SemanticCache* cache, CheckedStatement* statement) {
+    SymbolTable* table = &cache->table;
+    SymbolTable from;
+    symbol_table_snapshot(&from, table);
+
+    if (table->head == statement->from.head && table->names == statement->from.names) {
+        symbol_map_release(table->names);
+        table->names = symbol_map_retain(statement->after.names);
+        table->head = statement->after.head;
+    } else if (statement->declared) {
+        // Oldest first, so the newer ones shadow the older ones again
+        Symbol* reversed = NULL;
+        for (Symbol* symbol = statement->declared; ; ) {
+            Symbol* next = symbol->next;
+            int last = symbol == statement->oldest;
+            symbol->next = reversed;
+            reversed = symbol;
+            if (last) break;
+            symbol = next;
+        }
+        while (reversed) {
+            Symbol* next = reversed->next;
+            if (!push_symbol(table, reversed)) {
+                // Keep the list whole; lookups miss what the map couldn't take
+                reversed->next = table->head;
+                table->head = reversed;
+            }
+            reversed = next;
+        }
+    }
+
+    if (table->initialized == statement->from.initialized) {
+        symbol_map_release(table->initialized);
+        table->initialized = symbol_map_retain(statement->after.initialized);
+    } else {
+        symbol_map_diff(statement->assigned, NULL, add_initialized, table);
+    }
+
+    symbol_table_release(&statement->from);
+    symbol_table_release(&statement->after);
+    statement->from = from;
+    symbol_table_snapshot(&statement->after, table);
+}
+
+void semantic_cache_init(SemanticCache* cache) {
+    memset(cache, 0, sizeof(*cache));
+}
+
+int semantic_cache_update(SemanticCache* cache, ParseTree* tree) {
+    parse_tree_program(tree);
+    cache->checked = 0;
+
+    // The parser keeps a statement's id while it reuses it, so everything
+    // outside the common prefix and suffix of ids was replaced
+    int old_count = cache->count;
+    int prefix = 0;
+    while (prefix < old_count && prefix < tree->count &&
+           cache->statements[prefix].id == tree->spans[prefix].id) {
+        prefix++;
+    }
+    int suffix = 0;
+    while (suffix < old_count - prefix && suffix < tree->count - prefix &&
+           cache->statements[old_count - 1 - suffix].id == tree->spans[tree->count - 1 - suffix].id) {
+        suffix++;
+    }
+
+    if (tree->count > cache->capacity) {
+        int capacity = cache->capacity ? cache->capacity : 64;
+        while (capacity < tree->count) capacity *= 2;
+        CheckedStatement* statements = mem_realloc(MEM_SYMBOLS, cache->statements,
+                                                   capacity * sizeof(CheckedStatement));
+        if (!statements) return 0;
+        cache->statements = statements;
+        cache->capacity = capacity;
+    }
+
+    // Names declared by removed statements resolve differently from now on
+    NameSet changed = {0};
+    for (int i = prefix; i < old_count - suffix; i++) {
+        add_declared(&changed, &cache->statements[i]);
+        clear_statement(&cache->statements[i]);
+    }
+    int added = tree->count - prefix - suffix;
+    memmove(&cache->statements[prefix + added], &cache->statements[old_count - suffix],
+            suffix * sizeof(CheckedStatement));
+    memset(&cache->statements[prefix], 0, added * sizeof(CheckedStatement));
+    cache->count = tree->count;
+
+    // Back to the checkpoint in front of the first statement that changed;
+    // ids are never reused, so the count carries on
+    int symbol_count = cache->table.symbol_count;
+    symbol_table_release(&cache->table);
+    if (prefix > 0) {
+        symbol_table_snapshot(&cache->table, &cache->statements[prefix - 1].after);
+    } else {
+        memset(&cache->table, 0, sizeof(cache->table));
+    }
+    cache->table.symbol_count = symbol_count;
+    cache->table.current_scope = 0;
+
+    for (int i = prefix; i < cache->count; i++) {
+        CheckedStatement* statement = &cache->statements[i];
+        const StatementSpan* span = &tree->spans[i];
+        if (i < prefix + added) {
+            statement->id = span->id;
+            check_from(cache, statement, span);
+            add_declared(&changed, statement);
+        } else if (span->node->type == AST_BLOCK || reads_changed(statement, &changed)) {
+            // Its symbols get new ids, so readers of them must follow
+            add_declared(&changed, statement);
+            clear_statement(statement);
+            check_from(cache, statement, span);
+            add_declared(&changed, statement);
+        } else {
+            if (span->end_line != statement->end_line || span->end != statement->end) {
+                shift_statement(statement, span->end_line - statement->end_line, span->end - statement->end);
+                statement->end_line = span->end_line;
+                statement->end = span->end;
+            }
+            relink_statement(cache, statement);
+        }
+        // A bare block's body is linked into the program's statement list by
+        // the parser, so checking it walks (and annotates) everything after
+        // it. Nothing after one can be reused.
+        if (span->node->type == AST_BLOCK) changed.everything = 1;
+    }
+    mem_free(MEM_SYMBOLS, changed.items);
+
+    int result = 1;
+    for (int i = 0; i < cache->count; i++) {
+        const CheckedStatement* statement = &cache->statements[i];
+        for (int j = 0; j < statement->diagnostic_count; j++) {
+            const Diagnostic* d = &statement->diagnostics[j];
+            if (d->offset >= 0) diag_report_at(d->phase, d->code, d->severity, d->line, d->offset, d->arg);
+            else diag_report(d->phase, d->code, d->severity, d->line, d->column, d->arg);
+        }
+        result = statement->result && result;
+    }
+    return result;
+}
+
+void semantic_cache_free(SemanticCache* cache) {
+    for (int i = 0; i < cache->count; i++) {
+        clear_statement(&cache->statements[i]);
+    }
+    symbol_table_release(&cache->table);
+    mem_free(MEM_SYMBOLS, cache->statements);
+    memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,212 @@
+/* parallel.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../../include/parser.h"
+#include "../../include/semantic.h"
+#include "../../include/diagnostics.h"
+#include "../../include/trace.h"
+#include "../../include/allocator.h"
+#include "../../include/parallel.h"
+
+typedef struct {
+    ASTNode* node;
+    int deferred;               // checked by a worker
+    SymbolTable before;         // deferred: snapshot of the table in front of it
+    SymbolMapNode* initialized; // deferred: before.initialized plus its assignments
+    Diagnostic* diagnostics;    // what checking it reported
+    int diagnostic_count;
+    int result;                 // check_statement() result
+} ParallelStatement;
+
+typedef struct {
+    ParallelStatement* statements;
+    int count;
+    int next;                   // next statement to hand out
+    pthread_mutex_t lock;
+} ParallelJob;
+
+// Whether any node of the statement is hash-consed. A top-level statement's
+// `next` is the following statement, a nested one's is the rest of its block.
+static int has_shared(const ASTNode* node, int follow_next) {
+    while (node) {
+        if (node->shared) return 1;
+        if (has_shared(node->left, 1) || has_shared(node->right, 1) || has_shared(node->operand, 1)) return 1;
+        if (!follow_next) return 0;
+        node = node->next;
+    }
+    return 0;
+}
+
+// Annotations made while typing a condition, so a worker types it again and
+// reports its errors
+static void reset_annotations(ASTNode* node) {
+    if (!node) return;
+    node->value_type = TYPE_UNANNOTATED;
+    node->symbol_id = -1;
+    reset_annotations(node->left);
+    reset_annotations(node->right);
+    reset_annotations(node->operand);
+}
+
+// Add the symbols that checking `node` would declare, in the same order,
+// without checking anything else. Mirrors check_statement(): a body is only
+// walked if checking would reach it. Runs with diagnostics turned off.
+static void declare_statement(ASTNode* node, SymbolTable* table) {
+    if (!node) return;
+    switch (node->type) {
+        case AST_VARDECL:
+            check_declaration(node, table);
+            break;
+        case AST_BLOCK:
+            enter_scope(table);
+            for (ASTNode* stmt = node->next; stmt; stmt = stmt->next) {
+                declare_statement(stmt, table);
+            }
+            exit_scope(table);
+            break;
+        case AST_IF:
+        case AST_WHILE: {
+            int reached = check_condition(node->left, table);
+            reset_annotations(node->left);
+            if (reached) declare_statement(node->right, table);
+            break;
+        }
+        case AST_REPEAT:
+            declare_statement(node->left, table);
+            break;
+        default:
+            break;
+    }
+}
+
+// The snapshot's symbols are shared with other workers and the table, so
+// the statement declares into private ones. They get the same ids the
+// sequential pass gave its symbols, and are dropped once it is checked.
+static void check_deferred(ParallelStatement* statement) {
+    SymbolTable table;
+    symbol_table_snapshot(&table, &statement->before);
+
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    DiagnosticSession* previous = diag_begin(&session);
+    statement->result = check_statement(statement->node, &table);
+    diag_end(previous);
+
+    statement->initialized = symbol_map_retain(table.initialized);
+    symbol_table_release(&table);
+    while (table.head != statement->before.head) {
+        Symbol* next = table.head->next;
+        mem_free(MEM_SYMBOLS, table.head);
+        table.head = next;
+    }
+
+    statement->diagnostics = session.items;
+    statement->diagnostic_count = session.count;
+}
+
+static void run_worker(void* argument) {
+    ParallelJob* job = argument;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        while (job->next < job->count && !job->statements[job->next].deferred) job->next++;
+        ParallelStatement* statement = job->next < job->count ? &job->statements[job->next++] : NULL;
+        pthread_mutex_unlock(&job->lock);
+        if (!statement) break;
+        TraceSpan span;
+        trace_span_begin(&span, "check", "statement");
+        check_deferred(statement);
+        char detail[32] = "";
+        if (trace_enabled()) snprintf(detail, sizeof(detail), "line %d", statement->node->token.line);
+        trace_span_end(&span, detail);
+    }
+}
+
+// An assignment a worker made. Its private symbols have the table's ids.
+static void add_initialized(void* context, const SymbolMapNode* entry) {
+    mark_initialized(context, (int)entry->key);
+}
+
+// With `workers` NULL, threads are started for this call and joined after it
+static int check_parallel(ASTNode* ast, SymbolTable* table, int jobs, WorkerPool* workers) {
+    int count = 0;
+    for (ASTNode* node = ast; node; node = node->next) {
+        if (node->type != AST_PROGRAM) count++;
+    }
+    ParallelJob job = {0};
+    job.statements = mem_calloc(MEM_SYMBOLS, count ? count : 1, sizeof(ParallelStatement));
+    if (jobs <= 1 || !job.statements) {
+        mem_free(MEM_SYMBOLS, job.statements);
+        return check_program(ast, table);
+    }
+    job.count = count;
+
+    // Sequential pass: check what stays here, declare what is deferred
+    DiagnosticSession quiet;
+    diag_session_init(&quiet, NULL);
+    quiet.enabled = 0;
+    int serial = 0;
+    int deferred = 0;
+    int i = 0;
+    for (ASTNode* node = ast; node; node = node->next) {
+        if (node->type == AST_PROGRAM) continue;
+        ParallelStatement* statement = &job.statements[i++];
+        statement->node = node;
+
+        if (node->type == AST_BLOCK) serial = 1;
+        statement->deferred = !serial &&
+            (node->type == AST_IF || node->type == AST_WHILE || node->type == AST_REPEAT) &&
+            !has_shared(node, 0);
+
+        DiagnosticSession session;
+        diag_session_init(&session, NULL);
+        DiagnosticSession* previous = diag_begin(statement->deferred ? &quiet : &session);
+        if (statement->deferred) {
+            symbol_table_snapshot(&statement->before, table);
+            declare_statement(node, table);
+            deferred++;
+        } else {
+            statement->result = check_statement(node, table);
+        }
+        diag_end(previous);
+        statement->diagnostics = session.items;
+        statement->diagnostic_count = session.count;
+    }
+    diag_session_free(&quiet);
+
+    if (jobs > deferred) jobs = deferred;
+    pthread_mutex_init(&job.lock, NULL);
+    WorkerPool* own = NULL;
+    if (!workers && jobs > 1) workers = own = worker_pool_start(jobs - 1);
+    worker_pool_run(workers, jobs - 1, run_worker, &job);
+    worker_pool_stop(own);
+    pthread_mutex_destroy(&job.lock);
+
+    int result = 1;
+    for (i = 0; i < job.count; i++) {
+        ParallelStatement* statement = &job.statements[i];
+        if (statement->deferred) {
+            symbol_map_diff(statement->initialized, statement->before.initialized, add_initialized, table);
+            symbol_map_release(statement->initialized);
+            symbol_table_release(&statement->before);
+        }
+        for (int j = 0; j < statement->diagnostic_count; j++) {
+            const Diagnostic* d = &statement->diagnostics[j];
+            if (d->offset >= 0) diag_report_at(d->phase, d->code, d->severity, d->line, d->offset, d->arg);
+            else diag_report(d->phase, d->code, d->severity, d->line, d->column, d->arg);
+        }
+        mem_free(MEM_DIAGNOSTICS, statement->diagnostics);
+        result = statement->result && result;
+    }
+    mem_free(MEM_SYMBOLS, job.statements);
+    return result;
+}
+
+int check_program_parallel(ASTNode* ast, SymbolTable* table, int jobs) {
+    return check_parallel(ast, table, jobs, NULL);
+}
+
+int check_program_pooled(ASTNode* ast, SymbolTable* table, WorkerPool* workers) {
+    return check_parallel(ast, table, worker_pool_size(workers) + 1, workers);
+}
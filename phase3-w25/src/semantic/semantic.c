@@ -5,28 +5,95 @@
 #include "../../include/lexer.h"
 #include "../../include/tokens.h"
 #include "../../include/semantic.h"
+#include "../../include/dataflow.h"
+#include "../../include/diagnostics.h"
+#include "../../include/stats.h"
+#include "../../include/allocator.h"
+#include "../../include/parallel.h"
+#include "../../include/budget.h"
 // Initialize symbol table
 SymbolTable* init_symbol_table() {
-    SymbolTable* table = malloc(sizeof(SymbolTable));
+    SymbolTable* table = mem_alloc(MEM_SYMBOLS, sizeof(SymbolTable));
     if (table) {
         table->head = NULL;
+        table->names = NULL;
+        table->initialized = NULL;
         table->current_scope = 0;
+        table->symbol_count = 0;
     }
     return table;
 }
 
+// Key of a name in table->names
+static unsigned name_key(const char* name) {
+    unsigned hash = 2166136261u;     // FNV-1a
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+int push_symbol(SymbolTable* table, Symbol* symbol) {
+    SymbolMapNode* names = symbol_map_add(table->names, name_key(symbol->name), symbol);
+    if (!names) return 0;
+    symbol_map_release(table->names);
+    table->names = names;
+    symbol->next = table->head;
+    table->head = symbol;
+    return 1;
+}
+
 // Add symbol to table
 void add_symbol(SymbolTable* table, const char* name, int type, int line) {
-    Symbol* symbol = malloc(sizeof(Symbol));
+    Symbol* symbol = mem_alloc(MEM_SYMBOLS, sizeof(Symbol));
     if (symbol) {
+        symbol->id = table->symbol_count;
         strcpy(symbol->name, name);
         symbol->type = type;
         symbol->scope_level = table->current_scope;
         symbol->line_declared = line;
-        symbol->is_initialized = 0;  // Not initialized yet
 
-        symbol->next = table->head;
-        table->head = symbol;
+        if (!push_symbol(table, symbol)) {
+            mem_free(MEM_SYMBOLS, symbol);
+            return;
+        }
+        table->symbol_count++;
+    }
+}
+
+void symbol_table_snapshot(SymbolTable* copy, const SymbolTable* table) {
+    *copy = *table;
+    symbol_map_retain(copy->names);
+    symbol_map_retain(copy->initialized);
+}
+
+void symbol_table_release(SymbolTable* table) {
+    symbol_map_release(table->names);
+    symbol_map_release(table->initialized);
+    table->names = NULL;
+    table->initialized = NULL;
+}
+
+// After symbols were unlinked from `head`: the map can't drop entries, so
+// build it again, oldest symbol first. Not for tables with snapshots.
+static void rebuild_names(SymbolTable* table) {
+    Symbol* reversed = NULL;
+    while (table->head) {
+        Symbol* next = table->head->next;
+        table->head->next = reversed;
+        reversed = table->head;
+        table->head = next;
+    }
+    symbol_map_release(table->names);
+    table->names = NULL;
+    while (reversed) {
+        Symbol* next = reversed->next;
+        if (!push_symbol(table, reversed)) {
+            // Keep the list whole; lookups miss what the map couldn't take
+            reversed->next = table->head;
+            table->head = reversed;
+        }
+        reversed = next;
     }
 }
 
@@ -46,7 +113,8 @@ void remove_symbol(SymbolTable* table, const char* name) {
             } else {
                 prev->next = current->next;
             }
-            free(current);
+            mem_free(MEM_SYMBOLS, current);
+            rebuild_names(table);
             return;
         }
         prev = current;
@@ -54,31 +122,40 @@ void remove_symbol(SymbolTable* table, const char* name) {
     }
 }
 
+// Dependency recording for incremental checking, see semantic_set_read_hook()
+static _Thread_local SymbolReadHook read_hook = NULL;
+static _Thread_local void* read_hook_context = NULL;
+
+void semantic_set_read_hook(SymbolReadHook hook, void* context) {
+    read_hook = hook;
+    read_hook_context = context;
+}
+
 Symbol* lookup_symbol(SymbolTable* table, const char* name) {
-    // printf("LOOKUP SYMBOL");
-    Symbol* current = table->head;
-    // printf("Searching for: %s\n", name);
-    while (current) {
-        // printf("Symbol table item name: %s\n", current->name);
-        if (strcmp(current->name, name) == 0) {
-            // printf("Found\n");
-            return current;
+    STAT_ADD(symbol_lookups, 1);
+    if (read_hook) read_hook(read_hook_context, name);
+    // Only symbols whose names share a hash are compared, newest first
+    const SymbolMapNode* entry = symbol_map_find(table->names, name_key(name));
+    for (; entry; entry = entry->older) {
+        STAT_ADD(lookup_steps, 1);
+        if (strcmp(entry->symbol->name, name) == 0) {
+            return entry->symbol;
         }
-        current = current->next;
     }
     return NULL;
 }
 
 // Look up symbol in current scope only
 Symbol* lookup_symbol_current_scope(SymbolTable* table, const char* name) {
-    Symbol* current = table->head;
-    while (current) {
-        if (strcmp(current->name, name) == 0 &&
-            current->scope_level == table->current_scope) {
-            printf("current scope: %d\n", table->current_scope);
-            return current;
+    STAT_ADD(symbol_lookups, 1);
+    if (read_hook) read_hook(read_hook_context, name);
+    const SymbolMapNode* entry = symbol_map_find(table->names, name_key(name));
+    for (; entry; entry = entry->older) {
+        STAT_ADD(lookup_steps, 1);
+        if (strcmp(entry->symbol->name, name) == 0 &&
+            entry->symbol->scope_level == table->current_scope) {
+            return entry->symbol;
         }
-        current = current->next;
     }
     return NULL;
 }
@@ -86,6 +163,7 @@ Symbol* lookup_symbol_current_scope(SymbolTable* table, const char* name) {
 void enter_scope(SymbolTable* table) {
     if (!table) return;
     table->current_scope++;
+    STAT_ADD(scopes_entered, 1);
 }
 
 void exit_scope(SymbolTable* table) {
@@ -102,7 +180,7 @@ void remove_symbols_in_current_scope(SymbolTable* table) {
     while (table->head && table->head->scope_level > table->current_scope) {
         Symbol* temp = table->head;
         table->head = table->head->next;
-        free(temp);
+        mem_free(MEM_SYMBOLS, temp);
     }
 
     Symbol* current = table->head;
@@ -110,23 +188,33 @@ void remove_symbols_in_current_scope(SymbolTable* table) {
         if (current->next->scope_level > table->current_scope) {
             Symbol* temp = current->next;
             current->next = current->next->next;
-            free(temp);
+            mem_free(MEM_SYMBOLS, temp);
         } else {
             current = current->next;
         }
     }
+    rebuild_names(table);
+}
+
+void mark_initialized(SymbolTable* table, int symbol_id) {
+    unsigned key = (unsigned)symbol_id;
+    if (symbol_map_find(table->initialized, key)) return;
+    SymbolMapNode* initialized = symbol_map_add(table->initialized, key, NULL);
+    if (!initialized) return;
+    symbol_map_release(table->initialized);
+    table->initialized = initialized;
 }
 
 void initialize_symbol(SymbolTable* table, const char* name) {
     Symbol* current = lookup_symbol(table, name);
     if (current) {
-        current->is_initialized = 1;
+        mark_initialized(table, current->id);
     }
 }
 
 int is_initialized(SymbolTable* table, const char* name) {
     Symbol* current = lookup_symbol(table, name);
-    return (current && current->is_initialized);
+    return current && symbol_map_find(table->initialized, (unsigned)current->id);
 }
 
 void free_symbol_table(SymbolTable* table) {
@@ -136,9 +224,10 @@ void free_symbol_table(SymbolTable* table) {
     while (current) {
         Symbol* temp = current;
         current = current->next;
-        free(temp);
+        mem_free(MEM_SYMBOLS, temp);
     }
-    free(table);
+    symbol_table_release(table);
+    mem_free(MEM_SYMBOLS, table);
 }
 
 // Optional helper to print the symbol table for debugging
@@ -159,6 +248,8 @@ static void print_symbol_table(SymbolTable* table) {
         printf("  Name: %s\n", current->name);
         if (current->type == TOKEN_INT)
             printf("  Type: int\n");
+        else if (current->type == TOKEN_FLOAT)
+            printf("  Type: float\n");
         else if (current->type == TOKEN_CHAR)
             printf("  Type: char\n");
         else
@@ -166,7 +257,7 @@ static void print_symbol_table(SymbolTable* table) {
 
         printf("  Scope Level: %d\n", current->scope_level);
         printf("  Line Declared: %d\n", current->line_declared);
-        printf("  Initialized: %s\n\n", current->is_initialized ? "Yes" : "No");
+        printf("  Initialized: %s\n\n", symbol_map_find(table->initialized, (unsigned)current->id) ? "Yes" : "No");
         current = current->next;
         index++;
     }
@@ -175,6 +266,17 @@ static void print_symbol_table(SymbolTable* table) {
 
 // Forward declarations for expression type-checking
 static int get_expression_type(ASTNode* node, SymbolTable* table);
+static int compute_expression_type(ASTNode* node, SymbolTable* table);
+static int check_statement_kind(ASTNode* node, SymbolTable* table);
+
+// A hash-consed node keeps the position of its first occurrence, so errors
+// inside one are reported at the innermost unshared node using it: the
+// operator or statement the occurrence being checked belongs to.
+static _Thread_local const Token* use_site = NULL;
+
+static const Token* error_site(const ASTNode* node) {
+    return node->shared && use_site ? use_site : &node->token;
+}
 
 static int check_if(ASTNode* node, SymbolTable* table);
 static int check_while(ASTNode* node, SymbolTable* table);
@@ -198,21 +300,39 @@ int check_program(ASTNode* node, SymbolTable* table) {
     return result;
 }
 
-int analyze_semantics(ASTNode* ast) {
+int analyze_program(ASTNode* ast, WorkerPool* workers, int print_symbols) {
     SymbolTable* table = init_symbol_table();
-    int result = check_program(ast, table);
+    int result = workers ? check_program_pooled(ast, table, workers) : check_program(ast, table);
+
+    // Uninitialized uses are warnings; they don't fail the analysis, but
+    // giving up on it does. After the budget ran out the annotations are
+    // incomplete, so it's skipped.
+    if (budget_check(0) && check_definite_assignment(ast) < 0) result = 0;
 
-    // Uncomment to see the final symbol table after analysis:
-    print_symbol_table(table);
+    if (print_symbols) print_symbol_table(table);
 
     free_symbol_table(table);
     return result;
 }
 
+int analyze_semantics(ASTNode* ast) {
+    return analyze_program(ast, NULL, 1);
+}
+
 
 int check_statement(ASTNode* node, SymbolTable* table) {
     if (!node) return 1;
+    // Once the budget is spent every statement fails without being looked at
+    if (!budget_check(node->token.line)) return 0;
+
+    const Token* saved_site = use_site;
+    use_site = &node->token;
+    int result = check_statement_kind(node, table);
+    use_site = saved_site;
+    return result;
+}
 
+static int check_statement_kind(ASTNode* node, SymbolTable* table) {
     switch (node->type) {
         case AST_VARDECL:
             return check_declaration(node, table);
@@ -239,8 +359,8 @@ int check_statement(ASTNode* node, SymbolTable* table) {
             return check_factorial(node, table);
 
         default:
-            semantic_error(SEM_ERROR_SEMANTIC_ERROR,
-                           "Unknown statement type", node->token.line);
+            semantic_error_at(SEM_ERROR_SEMANTIC_ERROR,
+                              "Unknown statement type", &node->token);
             return 0;
     }
 }
@@ -253,13 +373,16 @@ int check_declaration(ASTNode* node, SymbolTable* table) {
     // Check if variable is redeclared in the same scope
     Symbol* existing = lookup_symbol_current_scope(table, name);
     if (existing) {
-        semantic_error(SEM_ERROR_REDECLARED_VARIABLE, name, node->token.line);
+        semantic_error_at(SEM_ERROR_REDECLARED_VARIABLE, name, &node->token);
         return 0;
     }
 
     int declared_type = node->token.type; // e.g., TOKEN_INT or TOKEN_CHAR
 
     add_symbol(table, name, declared_type, node->token.line);
+    if (table->head && table->head->id == table->symbol_count - 1) {
+        node->symbol_id = table->head->id;
+    }
     return 1;
 }
 
@@ -272,9 +395,11 @@ int check_assignment(ASTNode* node, SymbolTable* table) {
     // Ensure variable is declared
     Symbol* symbol = lookup_symbol(table, var_name);
     if (!symbol) {
-        semantic_error(SEM_ERROR_UNDECLARED_VARIABLE, var_name, node->token.line);
+        semantic_error_at(SEM_ERROR_UNDECLARED_VARIABLE, var_name, &node->token);
         return 0;
     }
+    node->left->symbol_id = symbol->id;
+    node->left->value_type = symbol->type;
 
     // Get expression type
     int expr_type = get_expression_type(node->right, table);
@@ -286,36 +411,44 @@ int check_assignment(ASTNode* node, SymbolTable* table) {
     // Check type compatibility. 
     // Simple logic: if symbol->type == TOKEN_INT but expr_type == TOKEN_CHAR,
     //   we allow it (char -> int). If symbol->type == TOKEN_CHAR but expr_type == TOKEN_INT,
+    //   we don't. Likewise int widens to float, but float never narrows to int.
     if (symbol->type == TOKEN_INT && expr_type == TOKEN_CHAR) {
         // Allowed: char -> int
     }
+    else if (symbol->type == TOKEN_FLOAT && expr_type == TOKEN_INT) {
+        // Allowed: int -> float
+    }
     else if (symbol->type == TOKEN_CHAR && expr_type == TOKEN_INT) {
         // Not allowed: int -> char
-        semantic_error(SEM_ERROR_TYPE_MISMATCH, var_name, node->token.line);
+        semantic_error_at(SEM_ERROR_TYPE_MISMATCH, var_name, &node->token);
         return 0;
     }
     else if (symbol->type != expr_type) {
         if (!(symbol->type == TOKEN_INT && expr_type == TOKEN_INT) &&
             !(symbol->type == TOKEN_CHAR && expr_type == TOKEN_CHAR))
         {
-            semantic_error(SEM_ERROR_TYPE_MISMATCH, var_name, node->token.line);
+            semantic_error_at(SEM_ERROR_TYPE_MISMATCH, var_name, &node->token);
             return 0;
         }
     }
 
     // Mark variable as initialized
-    symbol->is_initialized = 1;
+    mark_initialized(table, symbol->id);
     return 1;
 }
 
+// Whether `node` types as an if/while condition. Only the condition's own
+// errors are reported; the caller reports an invalid condition.
+int check_condition(ASTNode* node, SymbolTable* table) {
+    return get_expression_type(node, table) == TOKEN_INT;
+}
+
 static int check_if(ASTNode* node, SymbolTable* table) {
     // node->left = expression (the condition)
     // node->right = statement or block
     //  e.g. if(...) { ... } 
-    int cond_type = get_expression_type(node->left, table);
-
-    if(cond_type != TOKEN_INT) {
-        semantic_error(SEM_ERROR_INVALID_CONDITION, "if statement", node->token.line);
+    if (!check_condition(node->left, table)) {
+        semantic_error_at(SEM_ERROR_INVALID_CONDITION, "if statement", &node->token);
         return 0; // error
     }
 
@@ -326,10 +459,8 @@ static int check_if(ASTNode* node, SymbolTable* table) {
 static int check_while(ASTNode* node, SymbolTable* table) {
     // node->left = expression (the condition)
     // node->right = statement or block
-    int cond_type = get_expression_type(node->left, table);
-
-    if(cond_type != TOKEN_INT) {
-        semantic_error(SEM_ERROR_INVALID_CONDITION, "while statement", node->token.line);
+    if (!check_condition(node->left, table)) {
+        semantic_error_at(SEM_ERROR_INVALID_CONDITION, "while statement", &node->token);
         return 0; // error
     }
     // Check body
@@ -353,7 +484,7 @@ static int check_repeat(ASTNode* node, SymbolTable* table) {
         int cond_type = get_expression_type(node->right->left, table);
         if (cond_type == -1) result = 0;
     } else {
-        semantic_error(SEM_ERROR_SEMANTIC_ERROR, "repeat-until condition", node->token.line);
+        semantic_error_at(SEM_ERROR_SEMANTIC_ERROR, "repeat-until condition", &node->token);
         result = 0;
     }
 
@@ -383,18 +514,18 @@ int check_block(ASTNode* node, SymbolTable* table) {
 static int check_print(ASTNode* node, SymbolTable* table) {
     // For print, node->left should be the expression to print.
     int expr_type = get_expression_type(node->left, table);
-    if(expr_type != TOKEN_INT || expr_type != TOKEN_CHAR) {
-        semantic_error(SEM_ERROR_INVALID_PARAMETERS, "print statement", node->token.line);
+    if (expr_type != TOKEN_INT && expr_type != TOKEN_CHAR && expr_type != TOKEN_FLOAT) {
+        semantic_error_at(SEM_ERROR_INVALID_PARAMETERS, "print statement", &node->token);
         return 0; // error
     }
     return 1;
 }
 
 static int check_factorial(ASTNode* node, SymbolTable* table) {
-    // For print, node->left should be the expression to print.
+    // node->left is the argument; an int, like factorial() in an expression
     int expr_type = get_expression_type(node->left, table);
-    if(expr_type != TOKEN_INT || expr_type != TOKEN_CHAR) {
-        semantic_error(SEM_ERROR_INVALID_PARAMETERS, "factorial statement", node->token.line);
+    if (expr_type != TOKEN_INT) {
+        semantic_error_at(SEM_ERROR_INVALID_PARAMETERS, "factorial statement", &node->token);
         return 0; // error
     }
     return 1;
@@ -402,22 +533,41 @@ static int check_factorial(ASTNode* node, SymbolTable* table) {
 
 
 /**
- * Return the type of the expression:
- *   TOKEN_INT, TOKEN_CHAR, or -1 if error
+ * Return the type of the expression, computing it on first use.
+ * The result is cached in node->value_type (errors included, so they are
+ * only reported once) and later calls, or later passes, read it in O(1).
+ * A shared node only caches a valid type: each use of an ill-typed one is
+ * checked again and reports its error at that use.
+ */
+static int get_expression_type(ASTNode* node, SymbolTable* table) {
+    if (!node) return -1; // error if no expression
+    if (node->value_type != TYPE_UNANNOTATED) return node->value_type;
+
+    const Token* saved_site = use_site;
+    if (!node->shared) use_site = &node->token;
+    int type = compute_expression_type(node, table);
+    use_site = saved_site;
+    if (type != -1 || !node->shared) node->value_type = type;
+    return type;
+}
+
+/**
+ * Compute the type of the expression:
+ *   TOKEN_INT, TOKEN_FLOAT, TOKEN_CHAR, or -1 if error
  * We do basic checks for:
- *   - AST_NUMBER => int
+ *   - AST_NUMBER => int, or float for a literal with a fraction or exponent
  *   - AST_IDENTIFIER => type from symbol table (error if not declared)
  *   - AST_BINOP => unify left & right type, or report mismatch
  *   - AST_CONDITION => typically yields int or bool. For simplicity, treat as int
  *   - AST_FACTORIAL => typically int
  *   etc.
  */
-static int get_expression_type(ASTNode* node, SymbolTable* table) {
-    if (!node) return -1; // error if no expression
-
+static int compute_expression_type(ASTNode* node, SymbolTable* table) {
     switch (node->type) {
         case AST_NUMBER:
-            return TOKEN_INT;
+            // An out-of-range literal was reported when it was parsed
+            if (node->token.error != ERROR_NONE) return -1;
+            return node->token.type == TOKEN_FLOAT_LITERAL ? TOKEN_FLOAT : TOKEN_INT;
         case AST_STRING:
             return TOKEN_CHAR;
         case AST_IDENTIFIER: {
@@ -425,15 +575,13 @@ static int get_expression_type(ASTNode* node, SymbolTable* table) {
             // printf("get_expression_type lexeme: %s\n", node->token.lexeme);
             
             if (!sym) {
-                semantic_error(SEM_ERROR_UNDECLARED_VARIABLE,
-                               node->token.lexeme, node->token.line);
+                semantic_error_at(SEM_ERROR_UNDECLARED_VARIABLE,
+                                  node->token.lexeme, error_site(node));
                 return -1;
             }
-            // Warn if uninitialized
-            if (!sym->is_initialized) {
-                semantic_error(SEM_ERROR_UNINITIALIZED_VARIABLE,
-                               node->token.lexeme, node->token.line);
-            }
+            node->symbol_id = sym->id;
+            // Uninitialized reads are reported by check_definite_assignment(),
+            // which follows control flow instead of this flag
             return sym->type;
         }
 
@@ -445,16 +593,24 @@ static int get_expression_type(ASTNode* node, SymbolTable* table) {
 
             if (left_type == TOKEN_INT && right_type == TOKEN_INT) {
                 return TOKEN_INT;  
+            } else if ((left_type == TOKEN_INT || left_type == TOKEN_FLOAT) &&
+                       (right_type == TOKEN_INT || right_type == TOKEN_FLOAT)) {
+                // An int operand is promoted to float
+                return TOKEN_FLOAT;
+            } else if (right_type == TOKEN_FLOAT || left_type == TOKEN_FLOAT) {
+                // float with char
+                semantic_error_at(SEM_ERROR_INVALID_OPERATION, node->token.lexeme, error_site(node));
+                return -1;
             } else if (right_type == TOKEN_CHAR || left_type == TOKEN_CHAR) {
                 if (strcmp(node->token.lexeme, "*") == 0 || strcmp(node->token.lexeme, "/") == 0) {
-                    semantic_error(SEM_ERROR_INVALID_OPERATION, node->token.lexeme, node->token.line);
+                    semantic_error_at(SEM_ERROR_INVALID_OPERATION, node->token.lexeme, error_site(node));
                     return -1;
                 }
                 
                 return TOKEN_CHAR;
             }
 
-            semantic_error(SEM_ERROR_INVALID_OPERATION, node->token.lexeme, node->token.line);
+            semantic_error_at(SEM_ERROR_INVALID_OPERATION, node->token.lexeme, error_site(node));
             return -1;
         }
 
@@ -467,7 +623,7 @@ static int get_expression_type(ASTNode* node, SymbolTable* table) {
             if (left_type == -1 || right_type == -1) return -1; // error
 
             if (left_type == TOKEN_CHAR || right_type == TOKEN_CHAR) {
-                semantic_error(SEM_ERROR_INVALID_CONDITION, node->token.lexeme, node->token.line);
+                semantic_error_at(SEM_ERROR_INVALID_CONDITION, node->token.lexeme, error_site(node));
                 return -1;
             }
             return TOKEN_INT;
@@ -478,8 +634,8 @@ static int get_expression_type(ASTNode* node, SymbolTable* table) {
             // node->left is the argument
             int arg_type = get_expression_type(node->left, table);
             if (arg_type == -1) return -1; 
-            if (arg_type == TOKEN_CHAR) {
-                semantic_error(SEM_ERROR_TYPE_MISMATCH, "factorial()", node->token.line);
+            if (arg_type == TOKEN_CHAR || arg_type == TOKEN_FLOAT) {
+                semantic_error_at(SEM_ERROR_TYPE_MISMATCH, "factorial()", error_site(node));
                 return -1;
             }
             return TOKEN_INT;
@@ -487,7 +643,7 @@ static int get_expression_type(ASTNode* node, SymbolTable* table) {
 
         default:
             // If it's something else (like AST_BLOCK?), that's not a valid expression
-            semantic_error(SEM_ERROR_INVALID_OPERATION, "expression", node->token.line);
+            semantic_error_at(SEM_ERROR_INVALID_OPERATION, "expression", error_site(node));
             return -1;
     }
 }
@@ -497,108 +653,13 @@ static int get_expression_type(ASTNode* node, SymbolTable* table) {
 // ---------------------------------------------------------------------------
 
 void semantic_error(SemanticErrorType error, const char* name, int line) {
-    printf("Semantic Error at line %d: ", line);
-
-    switch (error) {
-        case SEM_ERROR_UNDECLARED_VARIABLE:
-            printf("Undeclared variable '%s'\n", name);
-            break;
-        case SEM_ERROR_REDECLARED_VARIABLE:
-            printf("Variable '%s' already declared in this scope\n", name);
-            break;
-        case SEM_ERROR_TYPE_MISMATCH:
-            printf("Type mismatch involving '%s'\n", name);
-            break;
-        case SEM_ERROR_UNINITIALIZED_VARIABLE:
-            printf("Variable '%s' may be used uninitialized\n", name);
-            break;
-        case SEM_ERROR_INVALID_OPERATION:
-            printf("Invalid operation involving '%s'\n", name);
-            break;
-        case SEM_ERROR_SEMANTIC_ERROR:
-            printf("Semantic error involving '%s'\n", name);
-            break;
-        case SEM_ERROR_INVALID_CONDITION:
-            printf("Invalid condition involving '%s'\n", name);
-            break;
-        case SEM_ERROR_INVALID_PARAMETERS:
-            printf("Invalid parameter(s) involving '%s'\n", name);
-            break;
-        default:
-            printf("Unknown semantic error with '%s'\n", name);
-    }
-}
-
-
-int main() {
-    const char* valid_input = "int x;\n"
-                          "char test;\n"
-                          "test = \"a\";\n"  // Using a valid char assignment
-                          "x = test + 1;\n"
-                          "int expr;\n"
-                          "expr = 123;\n"
-                          "int foo;\n"
-                          "foo = 4;\n"
-                          "if (foo > 2) {\n"
-                          "   int z;\n"
-                          "   z = 10;\n"
-                          "}\n";
-
-    const char* invalid_input = "int x;\n"
-                            "int x;\n"  // Redeclaration error
-                            "y = 5;\n"  // Undeclared variable usage
-                            "if (x > 0) {\n"
-                            "    int y;\n"
-                            "    y = x + 10;\n"
-                            "    print y;\n"
-                            "}\n"
-                            "z = 10;\n"  // Undeclared variable usage
-                            "char test;\n"
-                            "test = \"123\";\n"  // Type mismatch
-                            "x = test + 1;\n"
-                            "char foo;\n"
-                            "if (foo > 2) {\n"
-                            "   int z;\n"
-                            "   z = 10;\n"
-                            "}\n"
-                            "char x;\n"
-                            "int expr;\n"
-                            "expr = 123;\n"
-                            "x = expr;\n"  // Type mismatch
-                            "char y;\n"
-                            "int num;\n"
-                            "y = \"hello\";\n"
-                            "num = 40;\n"
-                            "num = y < num;\n"  // Invalid operation
-                            "if (1) {\n"
-                            "    int scope_var;\n"
-                            "    scope_var = 10;\n"
-                            "}\n"
-                            "print scope_var;\n"  // Scope error
-                            "if (\"hello\") {\n"
-                            "    print \"bye\";\n"
-                            "}\n"  // Invalid condition
-                            "factorial(5 < 3);\n";  // Invalid function parameter
-    
-    printf("Analyzing input:\n%s\n\n", valid_input);
-    
-    // Lexical analysis and parsing
-    parser_init(valid_input);
-    ASTNode* ast = parse();
-    
-    printf("AST created. Performing semantic analysis...\n\n");
-    
-    // Semantic analysis
-    int result = analyze_semantics(ast);
-    
-    if (result) {
-        printf("Semantic analysis successful. No errors found.\n");
-    } else {
-        printf("Semantic analysis failed. Errors detected.\n");
-    }
-    
-    // Clean up
-    free_ast(ast);
-    
-    return 0;
+    Token token = {TOKEN_ERROR, "", line, ERROR_NONE, -1, 0, 0.0};
+    semantic_error_at(error, name, &token);
+}
+
+void semantic_error_at(SemanticErrorType error, const char* name, const Token* token) {
+    // Uninitialized reads don't fail the analysis, everything else does
+    DiagnosticSeverity severity =
+        error == SEM_ERROR_UNINITIALIZED_VARIABLE ? DIAG_WARNING : DIAG_ERROR;
+    diag_report_at(DIAG_PHASE_SEMANTIC, error, severity, token->line, token->offset, name);
 }
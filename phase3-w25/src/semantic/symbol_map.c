@@ -0,0 +1,144 @@
+/* symbol_map.c */
+#include <stdlib.h>
+#include "../../include/allocator.h"
+#include "../../include/symbol_map.h"
+
+// Each level of the trie consumes 5 bits of the key
+#define SLOT_BITS 5
+#define SLOT(key, shift) (((key) >> (shift)) & 31u)
+
+static int popcount(unsigned bits) {
+    bits = bits - ((bits >> 1) & 0x55555555u);
+    bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+    return (int)((((bits + (bits >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24);
+}
+
+static SymbolMapNode* new_node(int children) {
+    SymbolMapNode* node = mem_alloc(MEM_SYMBOLS, sizeof(SymbolMapNode) + children * sizeof(SymbolMapNode*));
+    if (node) {
+        atomic_init(&node->refs, 1);
+        node->bitmap = 0;
+        node->key = 0;
+        node->symbol = NULL;
+        node->older = NULL;
+    }
+    return node;
+}
+
+static SymbolMapNode* new_entry(unsigned key, struct Symbol* symbol, SymbolMapNode* older) {
+    SymbolMapNode* entry = new_node(0);
+    if (entry) {
+        entry->key = key;
+        entry->symbol = symbol;
+        entry->older = symbol_map_retain(older);
+    }
+    return entry;
+}
+
+SymbolMapNode* symbol_map_retain(SymbolMapNode* map) {
+    if (map) atomic_fetch_add_explicit(&map->refs, 1, memory_order_relaxed);
+    return map;
+}
+
+void symbol_map_release(SymbolMapNode* map) {
+    // Branches are at most 7 deep; chains of entries under one key can be
+    // long, so those are followed in a loop
+    while (map && atomic_fetch_sub_explicit(&map->refs, 1, memory_order_acq_rel) == 1) {
+        SymbolMapNode* older = map->older;
+        int count = popcount(map->bitmap);
+        for (int i = 0; i < count; i++) {
+            symbol_map_release(map->children[i]);
+        }
+        mem_free(MEM_SYMBOLS, map);
+        map = older;
+    }
+}
+
+static SymbolMapNode* add_at(SymbolMapNode* node, unsigned key, struct Symbol* symbol, int shift) {
+    if (!node) return new_entry(key, symbol, NULL);
+
+    if (node->bitmap == 0) {
+        if (node->key == key) return new_entry(key, symbol, node);
+        // Another key shares this slot: push its entry down into a branch.
+        // Two different keys differ in some bit, so this ends by shift 30.
+        SymbolMapNode* branch = new_node(1);
+        if (!branch) return NULL;
+        branch->bitmap = 1u << SLOT(node->key, shift);
+        branch->children[0] = symbol_map_retain(node);
+        SymbolMapNode* result = add_at(branch, key, symbol, shift);
+        symbol_map_release(branch);
+        return result;
+    }
+
+    unsigned bit = 1u << SLOT(key, shift);
+    int index = popcount(node->bitmap & (bit - 1));
+    int count = popcount(node->bitmap);
+    int present = (node->bitmap & bit) != 0;
+
+    SymbolMapNode* child = add_at(present ? node->children[index] : NULL, key, symbol, shift + SLOT_BITS);
+    if (!child) return NULL;
+    SymbolMapNode* copy = new_node(count + !present);
+    if (!copy) {
+        symbol_map_release(child);
+        return NULL;
+    }
+    copy->bitmap = node->bitmap | bit;
+    for (int i = 0; i < index; i++) {
+        copy->children[i] = symbol_map_retain(node->children[i]);
+    }
+    copy->children[index] = child;
+    for (int i = index + present; i < count; i++) {
+        copy->children[i + !present] = symbol_map_retain(node->children[i]);
+    }
+    return copy;
+}
+
+SymbolMapNode* symbol_map_add(SymbolMapNode* map, unsigned key, struct Symbol* symbol) {
+    return add_at(map, key, symbol, 0);
+}
+
+static const SymbolMapNode* find_at(const SymbolMapNode* node, unsigned key, int shift) {
+    while (node && node->bitmap) {
+        unsigned bit = 1u << SLOT(key, shift);
+        if (!(node->bitmap & bit)) return NULL;
+        node = node->children[popcount(node->bitmap & (bit - 1))];
+        shift += SLOT_BITS;
+    }
+    return node && node->key == key ? node : NULL;
+}
+
+const SymbolMapNode* symbol_map_find(const SymbolMapNode* map, unsigned key) {
+    return find_at(map, key, 0);
+}
+
+static void diff_at(const SymbolMapNode* map, const SymbolMapNode* base, int shift,
+                    SymbolMapVisit visit, void* context) {
+    if (!map || map == base) return;
+
+    if (map->bitmap == 0) {
+        // The entries base has under this key are a tail of map's
+        const SymbolMapNode* known = find_at(base, map->key, shift);
+        for (const SymbolMapNode* entry = map; entry && entry != known; entry = entry->older) {
+            visit(context, entry);
+        }
+        return;
+    }
+
+    int index = 0;
+    for (unsigned slot = 0; slot < 32; slot++) {
+        unsigned bit = 1u << slot;
+        if (!(map->bitmap & bit)) continue;
+        const SymbolMapNode* base_child = NULL;
+        if (base && base->bitmap) {
+            if (base->bitmap & bit) base_child = base->children[popcount(base->bitmap & (bit - 1))];
+        } else if (base && SLOT(base->key, shift) == slot) {
+            base_child = base;      // an entry that was pushed down since
+        }
+        diff_at(map->children[index++], base_child, shift + SLOT_BITS, visit, context);
+    }
+}
+
+void symbol_map_diff(const SymbolMapNode* map, const SymbolMapNode* base,
+                     SymbolMapVisit visit, void* context) {
+    diff_at(map, base, 0, visit, context);
+}
@@ -0,0 +1,124 @@
+/* worker_pool.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../../include/stats.h"
+#include "../../include/trace.h"
+#include "../../include/allocator.h"
+#include "../../include/worker_pool.h"
+
+typedef struct {
+    WorkerPool* pool;
+    pthread_t thread;
+    int index;
+} PoolThread;
+
+struct WorkerPool {
+    PoolThread* threads;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t start;       // a run began, or the pool is stopping
+    pthread_cond_t done;        // the last pool thread of a run finished
+    unsigned generation;        // runs so far
+    int active;                 // pool threads taking part in the current run
+    int running;                // of those, still in the task
+    int stopping;
+    WorkerTask task;
+    void* context;
+    AnalyzerStats collected;    // the current run's counters from pool threads
+};
+
+static void* run_pool_thread(void* argument) {
+    PoolThread* self = argument;
+    WorkerPool* pool = self->pool;
+    char name[32];
+    snprintf(name, sizeof(name), "worker %d", self->index + 1);
+    trace_thread_name(name);
+    unsigned seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->generation == seen) pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stopping) break;
+        seen = pool->generation;
+        if (self->index >= pool->active) continue;
+
+        WorkerTask task = pool->task;
+        void* context = pool->context;
+        pthread_mutex_unlock(&pool->lock);
+        task(context);
+        pthread_mutex_lock(&pool->lock);
+        stats_merge(&pool->collected, stats_current());
+        stats_reset();
+        if (--pool->running == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+WorkerPool* worker_pool_start(int threads) {
+    if (threads < 1) return NULL;
+    WorkerPool* pool = mem_calloc(MEM_SYMBOLS, 1, sizeof(WorkerPool));
+    if (!pool) return NULL;
+    pool->threads = mem_calloc(MEM_SYMBOLS, threads, sizeof(PoolThread));
+    if (!pool->threads) {
+        mem_free(MEM_SYMBOLS, pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    while (pool->count < threads) {
+        PoolThread* thread = &pool->threads[pool->count];
+        thread->pool = pool;
+        thread->index = pool->count;
+        if (pthread_create(&thread->thread, NULL, run_pool_thread, thread) != 0) break;
+        pool->count++;
+    }
+    if (pool->count == 0) {
+        worker_pool_stop(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int worker_pool_size(const WorkerPool* pool) {
+    return pool ? pool->count : 0;
+}
+
+void worker_pool_run(WorkerPool* pool, int threads, WorkerTask task, void* context) {
+    if (!pool || threads < 1) {
+        task(context);
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->active = threads < pool->count ? threads : pool->count;
+    pool->running = pool->active;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    task(context);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0) pthread_cond_wait(&pool->done, &pool->lock);
+    stats_merge(stats_current(), &pool->collected);
+    memset(&pool->collected, 0, sizeof(pool->collected));
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void worker_pool_stop(WorkerPool* pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->count; i++) pthread_join(pool->threads[i].thread, NULL);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    mem_free(MEM_SYMBOLS, pool->threads);
+    mem_free(MEM_SYMBOLS, pool);
+}
@@ -0,0 +1,218 @@
+/* server.c */
+#define _POSIX_C_SOURCE 200809L     // getline, open_memstream, fdopen
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../../include/parser.h"
+#include "../../include/diagnostics.h"
+#include "../../include/allocator.h"
+#include "../../include/trace.h"
+#include "../../include/json.h"
+#include "../../include/analysis.h"
+#include "../../include/server.h"
+
+// JSON-RPC error codes
+#define RPC_PARSE_ERROR       (-32700)
+#define RPC_INVALID_REQUEST   (-32600)
+#define RPC_METHOD_NOT_FOUND  (-32601)
+#define RPC_INVALID_PARAMS    (-32602)
+
+// Literals and shared expressions are kept for later requests until they
+// take this much memory
+#define CACHE_LIMIT_BYTES     (64u << 20)
+
+static double now_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static char* read_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* buffer = size >= 0 ? mem_alloc(MEM_SOURCE, size + 1) : NULL;
+    if (buffer) {
+        size_t read = fread(buffer, 1, size, file);
+        buffer[read] = '\0';
+    }
+    fclose(file);
+    return buffer;
+}
+
+static void write_error(FILE* out, const JsonValue* id, int code, const char* message) {
+    fprintf(out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_write_scalar(id, out);
+    fprintf(out, ",\"error\":{\"code\":%d,\"message\":", code);
+    json_write_string(message, out);
+    fprintf(out, "}}\n");
+}
+
+static void handle_analyze(Analyzer* analyzer, const JsonValue* id, const JsonValue* params, FILE* out) {
+    double start = now_microseconds();
+    const char* path = json_get_string(params, "path");
+    const char* text = json_get_string(params, "text");
+    const char* name = json_get_string(params, "name");
+    if (!path && !text) {
+        write_error(out, id, RPC_INVALID_PARAMS, "analyze needs \"path\" or \"text\"");
+        return;
+    }
+
+    char* file_text = NULL;
+    if (!text) {
+        file_text = read_file(path);
+        if (!file_text) {
+            write_error(out, id, RPC_INVALID_PARAMS, "could not read file");
+            return;
+        }
+        text = file_text;
+    }
+    if (!name) name = path ? path : "<text>";
+
+    TraceSpan file_span;
+    trace_span_begin(&file_span, "file", "file");
+    Analysis analysis;
+    ASTNode* ast;
+    int success = analyzer_run(analyzer, &analysis, name, text, &ast);
+    free_ast(ast);
+    size_t cached = analyzer->strings.size + (size_t)analyzer->nodes.count * sizeof(ASTNode);
+    if (cached > CACHE_LIMIT_BYTES) analyzer_reset(analyzer);
+    trace_span_end(&file_span, name);
+    double elapsed = now_microseconds() - start;
+
+    fprintf(out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_write_scalar(id, out);
+    fprintf(out, ",\"result\":{\"name\":");
+    json_write_string(name, out);
+    fprintf(out, ",\"success\":%s,\"elapsed_us\":%.1f,\"diagnostics\":",
+            success ? "true" : "false", elapsed);
+    // Embed the session's JSON document, minus its trailing newline
+    char* diagnostics = NULL;
+    size_t length = 0;
+    FILE* buffer = open_memstream(&diagnostics, &length);
+    if (buffer) {
+        diag_write(&analysis.session, DIAG_FORMAT_JSON, buffer);
+        fclose(buffer);
+    }
+    if (diagnostics && length > 0 && diagnostics[length - 1] == '\n') length--;
+    if (diagnostics) fwrite(diagnostics, 1, length, out);
+    else fputs("null", out);
+    fprintf(out, "}}\n");
+    free(diagnostics);
+
+    analysis_free(&analysis);
+    mem_free(MEM_SOURCE, file_text);
+}
+
+// Returns 0 once a "shutdown" request has been answered
+static int handle_line(Analyzer* analyzer, const char* line, size_t length, FILE* out) {
+    JsonValue* request = json_parse(line, length);
+    if (!request) {
+        write_error(out, NULL, RPC_PARSE_ERROR, "Parse error");
+        fflush(out);
+        return 1;
+    }
+
+    int keep_going = 1;
+    const JsonValue* id = json_get(request, "id");
+    const char* method = json_get_string(request, "method");
+    if (!method) {
+        write_error(out, id, RPC_INVALID_REQUEST, "Invalid Request");
+    } else if (strcmp(method, "analyze") == 0) {
+        if (id) handle_analyze(analyzer, id, json_get(request, "params"), out);
+    } else if (strcmp(method, "shutdown") == 0) {
+        if (id) {
+            fprintf(out, "{\"jsonrpc\":\"2.0\",\"id\":");
+            json_write_scalar(id, out);
+            fprintf(out, ",\"result\":null}\n");
+        }
+        keep_going = 0;
+    } else if (id) {
+        write_error(out, id, RPC_METHOD_NOT_FOUND, "Method not found");
+    }
+    fflush(out);
+    json_free(request);
+    return keep_going;
+}
+
+// Serve newline-delimited requests. Returns 0 after "shutdown", 1 at EOF.
+static int serve(Analyzer* analyzer, FILE* in, FILE* out) {
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    int keep_going = 1;
+    while (keep_going && (length = getline(&line, &capacity, in)) >= 0) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) length--;
+        if (length == 0) continue;
+        keep_going = handle_line(analyzer, line, (size_t)length, out);
+    }
+    free(line);
+    return keep_going;
+}
+
+// Stdout may be the protocol, so symbol tables are never dumped
+static void start_analyzer(Analyzer* analyzer, const AnalysisOptions* options) {
+    AnalysisOptions server_options;
+    if (options) server_options = *options;
+    else analysis_default_options(&server_options);
+    server_options.print_symbols = 0;
+    analyzer_init(analyzer, &server_options);
+}
+
+int server_run_stdio(const AnalysisOptions* options) {
+    Analyzer analyzer;
+    start_analyzer(&analyzer, options);
+    serve(&analyzer, stdin, stdout);
+    analyzer_free(&analyzer);
+    return 1;
+}
+
+int server_run_socket(const char* path, const AnalysisOptions* options) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) return 0;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) return 0;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(listener, 8) < 0) {
+        close(listener);
+        return 0;
+    }
+
+    // A client that disconnects mid-response must not take the server down
+    signal(SIGPIPE, SIG_IGN);
+
+    Analyzer analyzer;
+    start_analyzer(&analyzer, options);
+    int keep_going = 1;
+    while (keep_going) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) continue;
+        int write_fd = dup(connection);
+        FILE* in = fdopen(connection, "r");
+        FILE* out = write_fd >= 0 ? fdopen(write_fd, "w") : NULL;
+        if (in && out) keep_going = serve(&analyzer, in, out);
+        if (in) fclose(in);
+        else close(connection);
+        if (out) fclose(out);
+        else if (write_fd >= 0) close(write_fd);
+    }
+
+    analyzer_free(&analyzer);
+    close(listener);
+    unlink(path);
+    return 1;
+}
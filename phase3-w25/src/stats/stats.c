@@ -0,0 +1,151 @@
+/* stats.c */
+#define _POSIX_C_SOURCE 200809L     // clock_gettime
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../../include/stats.h"
+
+#ifdef ANALYZER_STATS
+_Thread_local AnalyzerStats analyzer_stats;
+#else
+// Never updated, so the stats surface still works (all zeros) without the counters
+static _Thread_local AnalyzerStats analyzer_stats;
+#endif
+
+static const char* phase_names[STATS_PHASE_COUNT] = {
+    "lex",
+    "parse",
+    "semantic",
+    "optimize",
+    "codegen"
+};
+
+static const char* token_names[TOKEN_ERROR + 1] = {
+    [TOKEN_NUMBER] = "NUMBER",
+    [TOKEN_FLOAT_LITERAL] = "FLOAT_LITERAL",
+    [TOKEN_IDENTIFIER] = "IDENTIFIER",
+    [TOKEN_STRING_LITERAL] = "STRING",
+    [TOKEN_OPERATOR] = "OPERATOR",
+    [TOKEN_COMPARISON] = "COMPARISON",
+    [TOKEN_EQUALS] = "EQUALS",
+    [TOKEN_SEMICOLON] = "SEMICOLON",
+    [TOKEN_LPAREN] = "LPAREN",
+    [TOKEN_RPAREN] = "RPAREN",
+    [TOKEN_LBRACE] = "LBRACE",
+    [TOKEN_RBRACE] = "RBRACE",
+    [TOKEN_LBRACK] = "LBRACK",
+    [TOKEN_RBRACK] = "RBRACK",
+    [TOKEN_IF] = "IF",
+    [TOKEN_ELSE] = "ELSE",
+    [TOKEN_REPEAT] = "REPEAT",
+    [TOKEN_UNTIL] = "UNTIL",
+    [TOKEN_FOR] = "FOR",
+    [TOKEN_WHILE] = "WHILE",
+    [TOKEN_BREAK] = "BREAK",
+    [TOKEN_PRINT] = "PRINT",
+    [TOKEN_FACTORIAL] = "FACTORIAL",
+    [TOKEN_RETURN] = "RETURN",
+    [TOKEN_VOID] = "VOID",
+    [TOKEN_CONST] = "CONST",
+    [TOKEN_INT] = "INT",
+    [TOKEN_FLOAT] = "FLOAT",
+    [TOKEN_CHAR] = "CHAR",
+    [TOKEN_EOF] = "EOF",
+    [TOKEN_ERROR] = "ERROR"
+};
+
+double stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int stats_enabled(void) {
+#ifdef ANALYZER_STATS
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+AnalyzerStats* stats_current(void) {
+    return &analyzer_stats;
+}
+
+void stats_reset(void) {
+    memset(&analyzer_stats, 0, sizeof(analyzer_stats));
+}
+
+void stats_merge(AnalyzerStats* into, const AnalyzerStats* from) {
+    for (int i = 0; i <= TOKEN_ERROR; i++) into->tokens[i] += from->tokens[i];
+    into->nodes_created += from->nodes_created;
+    into->node_bytes += from->node_bytes;
+    into->nodes_shared += from->nodes_shared;
+    into->shared_bytes += from->shared_bytes;
+    into->symbol_lookups += from->symbol_lookups;
+    into->lookup_steps += from->lookup_steps;
+    into->scopes_entered += from->scopes_entered;
+    for (int i = 0; i < STATS_PHASE_COUNT; i++) into->phase_seconds[i] += from->phase_seconds[i];
+}
+
+static unsigned long total_tokens(const AnalyzerStats* stats) {
+    unsigned long total = 0;
+    for (int i = 0; i <= TOKEN_ERROR; i++) total += stats->tokens[i];
+    return total;
+}
+
+static double average_chain(const AnalyzerStats* stats) {
+    if (stats->symbol_lookups == 0) return 0;
+    return (double)stats->lookup_steps / stats->symbol_lookups;
+}
+
+static void write_text(const AnalyzerStats* stats, FILE* out) {
+    if (!stats_enabled()) {
+        fprintf(out, "Statistics not compiled in (build with -DANALYZER_STATS)\n");
+        return;
+    }
+    fprintf(out, "Statistics:\n");
+    fprintf(out, "  tokens:            %lu\n", total_tokens(stats));
+    for (int i = 0; i <= TOKEN_ERROR; i++) {
+        if (stats->tokens[i] == 0) continue;
+        fprintf(out, "    %-16s %lu\n", token_names[i], stats->tokens[i]);
+    }
+    fprintf(out, "  nodes created:     %lu (%lu bytes)\n", stats->nodes_created, stats->node_bytes);
+    if (stats->nodes_shared > 0) {
+        fprintf(out, "  nodes shared:      %lu (%lu bytes saved)\n",
+                stats->nodes_shared, stats->shared_bytes);
+    }
+    fprintf(out, "  symbol lookups:    %lu (%.2f symbols compared on average)\n",
+            stats->symbol_lookups, average_chain(stats));
+    fprintf(out, "  scopes entered:    %lu\n", stats->scopes_entered);
+    for (int i = 0; i < STATS_PHASE_COUNT; i++) {
+        fprintf(out, "  %-8s time:     %.6f s\n", phase_names[i], stats->phase_seconds[i]);
+    }
+}
+
+static void write_json(const AnalyzerStats* stats, FILE* out) {
+    fprintf(out, "{\"enabled\":%s,\"tokens\":{", stats_enabled() ? "true" : "false");
+    int first = 1;
+    for (int i = 0; i <= TOKEN_ERROR; i++) {
+        if (stats->tokens[i] == 0) continue;
+        fprintf(out, "%s\"%s\":%lu", first ? "" : ",", token_names[i], stats->tokens[i]);
+        first = 0;
+    }
+    fprintf(out, "},\"tokens_total\":%lu,\"nodes_created\":%lu,\"node_bytes\":%lu,"
+                 "\"nodes_shared\":%lu,\"shared_bytes\":%lu,"
+                 "\"symbol_lookups\":%lu,\"lookup_steps\":%lu,\"average_chain\":%.3f,"
+                 "\"scopes_entered\":%lu,\"phase_seconds\":{",
+            total_tokens(stats), stats->nodes_created, stats->node_bytes,
+            stats->nodes_shared, stats->shared_bytes,
+            stats->symbol_lookups, stats->lookup_steps, average_chain(stats),
+            stats->scopes_entered);
+    for (int i = 0; i < STATS_PHASE_COUNT; i++) {
+        fprintf(out, "%s\"%s\":%.9f", i ? "," : "", phase_names[i], stats->phase_seconds[i]);
+    }
+    fprintf(out, "}}\n");
+}
+
+void stats_write(const AnalyzerStats* stats, StatsFormat format, FILE* out) {
+    if (format == STATS_FORMAT_JSON) write_json(stats, out);
+    else write_text(stats, out);
+}
@@ -0,0 +1,155 @@
+/* trace.c */
+#define _POSIX_C_SOURCE 200809L     // clock_gettime, strdup
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../../include/trace.h"
+
+typedef struct {
+    char phase;                 // 'X' complete span, 'M' thread name metadata
+    const char* name;
+    const char* category;
+    char* detail;               // owned
+    double start;
+    double duration;
+    int tid;
+} TraceEvent;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE* trace_file = NULL;
+static TraceEvent* events = NULL;
+static int event_count = 0;
+static int event_capacity = 0;
+static double trace_origin = 0;
+static atomic_int recording = 0;
+
+// Small, stable per-thread ids read better in the viewer than pthread_t values
+static atomic_int next_tid = 1;
+static _Thread_local int thread_id = 0;
+
+static double now_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int current_tid(void) {
+    if (thread_id == 0) thread_id = atomic_fetch_add(&next_tid, 1);
+    return thread_id;
+}
+
+// Takes ownership of `detail`
+static void record(TraceEvent event) {
+    pthread_mutex_lock(&trace_lock);
+    if (event_count == event_capacity) {
+        int capacity = event_capacity ? event_capacity * 2 : 256;
+        TraceEvent* grown = realloc(events, capacity * sizeof(TraceEvent));
+        if (!grown) {
+            // Drop the event rather than fail the analysis
+            pthread_mutex_unlock(&trace_lock);
+            free(event.detail);
+            return;
+        }
+        events = grown;
+        event_capacity = capacity;
+    }
+    events[event_count++] = event;
+    pthread_mutex_unlock(&trace_lock);
+}
+
+int trace_open(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) return 0;
+    pthread_mutex_lock(&trace_lock);
+    trace_file = file;
+    trace_origin = now_microseconds();
+    atomic_store(&recording, 1);
+    pthread_mutex_unlock(&trace_lock);
+    return 1;
+}
+
+int trace_enabled(void) {
+    return atomic_load(&recording);
+}
+
+void trace_thread_name(const char* name) {
+    if (!trace_enabled()) return;
+    TraceEvent event = { 'M', "thread_name", "__metadata", strdup(name), 0, 0, current_tid() };
+    record(event);
+}
+
+void trace_span_begin(TraceSpan* span, const char* name, const char* category) {
+    span->name = name;
+    span->category = category;
+    span->start = trace_enabled() ? now_microseconds() - trace_origin : 0;
+}
+
+void trace_span_end(TraceSpan* span, const char* detail) {
+    if (!trace_enabled()) return;
+    double end = now_microseconds() - trace_origin;
+    TraceEvent event = {
+        'X', span->name, span->category, detail ? strdup(detail) : NULL,
+        span->start, end - span->start, current_tid()
+    };
+    record(event);
+}
+
+static void write_json_string(const char* text, FILE* out) {
+    fputc('"', out);
+    for (const char* p = text; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+int trace_close(void) {
+    pthread_mutex_lock(&trace_lock);
+    atomic_store(&recording, 0);
+    FILE* out = trace_file;
+    trace_file = NULL;
+    if (!out) {
+        pthread_mutex_unlock(&trace_lock);
+        return 1;
+    }
+
+    int pid = (int)getpid();
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (int i = 0; i < event_count; i++) {
+        const TraceEvent* event = &events[i];
+        fprintf(out, "%s\n{\"ph\":\"%c\",\"name\":", i ? "," : "", event->phase);
+        write_json_string(event->name, out);
+        fprintf(out, ",\"cat\":");
+        write_json_string(event->category, out);
+        fprintf(out, ",\"pid\":%d,\"tid\":%d", pid, event->tid);
+        if (event->phase == 'M') {
+            fprintf(out, ",\"args\":{\"name\":");
+            write_json_string(event->detail ? event->detail : "", out);
+            fprintf(out, "}}");
+        } else {
+            fprintf(out, ",\"ts\":%.3f,\"dur\":%.3f", event->start, event->duration);
+            if (event->detail) {
+                fprintf(out, ",\"args\":{\"detail\":");
+                write_json_string(event->detail, out);
+                fputc('}', out);
+            }
+            fputc('}', out);
+        }
+        free(event->detail);
+    }
+    fprintf(out, "\n]}\n");
+
+    free(events);
+    events = NULL;
+    event_count = event_capacity = 0;
+    pthread_mutex_unlock(&trace_lock);
+
+    int failed = ferror(out);
+    return fclose(out) == 0 && !failed;
+}
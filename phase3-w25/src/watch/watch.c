@@ -0,0 +1,389 @@
+/* watch.c */
+#define _POSIX_C_SOURCE 200809L     // clock_gettime, poll
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include "../../include/parser.h"
+#include "../../include/semantic.h"
+#include "../../include/incremental.h"
+#include "../../include/dataflow.h"
+#include "../../include/diagnostics.h"
+#include "../../include/stats.h"
+#include "../../include/trace.h"
+#include "../../include/allocator.h"
+#include "../../include/watch.h"
+
+// An update starts once no event has arrived for this long...
+#define DEBOUNCE_MS 30
+// ...or this long after its first event, whichever comes first
+#define MAX_DELAY_MS 500
+
+typedef struct {
+    char* name;             // within the directory
+    ParseTree tree;         // the last version that parsed
+    int parsed;             // whether `tree` is set up
+    int stale;              // the file's current text didn't parse
+    SemanticCache cache;
+} WatchedFile;
+
+typedef struct {
+    const char* directory;
+    DiagnosticFormat format;
+    Analyzer analyzer;      // budgets and worker threads for every file
+    WatchedFile* files;
+    int count;
+    int capacity;
+    char** pending;         // names changed since the last update
+    int pending_count;
+    int pending_capacity;
+} Watcher;
+
+// One file's part of an update
+typedef struct {
+    const char* name;
+    char* path;
+    char* text;             // NULL if the file is gone
+    int removed;            // it was watched until now
+    WatchedFile* file;      // NULL if there's nothing to report
+    Analysis analysis;
+    int parsed;
+    int result;
+    double elapsed;         // milliseconds spent parsing and checking it
+} FileUpdate;
+
+// Files of an update that are checked, handed out to the worker threads
+typedef struct {
+    FileUpdate* updates;
+    int count;
+    int next;
+    pthread_mutex_t lock;
+} CheckJob;
+
+static double now_milliseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int skipped_name(const char* name) {
+    size_t length = strlen(name);
+    return length == 0 || name[0] == '.' || name[length - 1] == '~';
+}
+
+static char* join_path(const char* directory, const char* name) {
+    size_t length = strlen(directory) + strlen(name) + 2;
+    char* path = mem_alloc(MEM_SOURCE, length);
+    if (path) snprintf(path, length, "%s/%s", directory, name);
+    return path;
+}
+
+// NULL if it's gone, or isn't a regular file
+static char* read_file(const char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) return NULL;
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* buffer = size >= 0 ? mem_alloc(MEM_SOURCE, size + 1) : NULL;
+    if (buffer) {
+        size_t read = fread(buffer, 1, size, file);
+        buffer[read] = '\0';
+    }
+    fclose(file);
+    return buffer;
+}
+
+static WatchedFile* find_file(Watcher* watcher, const char* name) {
+    for (int i = 0; i < watcher->count; i++) {
+        if (strcmp(watcher->files[i].name, name) == 0) return &watcher->files[i];
+    }
+    return NULL;
+}
+
+static WatchedFile* add_file(Watcher* watcher, const char* name) {
+    if (watcher->count == watcher->capacity) {
+        int capacity = watcher->capacity ? watcher->capacity * 2 : 16;
+        WatchedFile* files = mem_realloc(MEM_SOURCE, watcher->files, capacity * sizeof(WatchedFile));
+        if (!files) return NULL;
+        watcher->files = files;
+        watcher->capacity = capacity;
+    }
+    WatchedFile* file = &watcher->files[watcher->count];
+    memset(file, 0, sizeof(WatchedFile));
+    file->name = mem_alloc(MEM_SOURCE, strlen(name) + 1);
+    if (!file->name) return NULL;
+    strcpy(file->name, name);
+    semantic_cache_init(&file->cache);
+    watcher->count++;
+    return file;
+}
+
+static void free_file(WatchedFile* file) {
+    if (file->parsed) parse_tree_free(&file->tree);
+    semantic_cache_free(&file->cache);
+    mem_free(MEM_SOURCE, file->name);
+}
+
+static void remove_file(Watcher* watcher, WatchedFile* file) {
+    free_file(file);
+    *file = watcher->files[--watcher->count];
+}
+
+// Bring the file's tree up to date with `text`: the bytes between the
+// longest common prefix and suffix of the old and new text are one edit.
+// Returns 0 on a syntax error, reported to the active session.
+static int reparse(WatchedFile* file, char* text) {
+    if (!file->parsed) {
+        file->parsed = parse_tree_init(&file->tree, text);
+        return file->parsed;
+    }
+    const char* old = file->tree.source;
+    int old_length = file->tree.length;
+    int new_length = (int)strlen(text);
+    int prefix = 0;
+    while (prefix < old_length && prefix < new_length && old[prefix] == text[prefix]) prefix++;
+    int suffix = 0;
+    while (suffix < old_length - prefix && suffix < new_length - prefix &&
+           old[old_length - 1 - suffix] == text[new_length - 1 - suffix]) {
+        suffix++;
+    }
+
+    char saved = text[new_length - suffix];
+    text[new_length - suffix] = '\0';
+    int parsed = parse_tree_edit(&file->tree, prefix, old_length - prefix - suffix, text + prefix);
+    text[new_length - suffix] = saved;
+    return parsed >= 0;
+}
+
+// Parse on the calling thread: the parser isn't reentrant
+static void parse_file(Watcher* watcher, FileUpdate* update) {
+    WatchedFile* file = update->file;
+    double start = now_milliseconds();
+    analysis_begin(&update->analysis, &watcher->analyzer, update->path, update->text);
+    TraceSpan span;
+    trace_span_begin(&span, "parse", "phase");
+    STAT_TIMER_START(parse_start);
+    update->parsed = reparse(file, update->text);
+    STAT_TIMER_STOP(parse_start, STATS_PHASE_PARSE);
+    trace_span_end(&span, update->path);
+    file->stale = !update->parsed;
+    analysis_end(&update->analysis);
+    update->elapsed = now_milliseconds() - start;
+}
+
+// Files are independent of one another, so each can be checked on any thread
+static void check_file(FileUpdate* update) {
+    double start = now_milliseconds();
+    analysis_resume(&update->analysis);
+    TraceSpan span;
+    trace_span_begin(&span, "semantic", "phase");
+    STAT_TIMER_START(semantic_start);
+    WatchedFile* file = update->file;
+    update->result = semantic_cache_update(&file->cache, &file->tree);
+    if (budget_check(0) && check_definite_assignment(parse_tree_program(&file->tree)) < 0) {
+        update->result = 0;
+    }
+    STAT_TIMER_STOP(semantic_start, STATS_PHASE_SEMANTIC);
+    trace_span_end(&span, update->path);
+    analysis_end(&update->analysis);
+    update->elapsed += now_milliseconds() - start;
+}
+
+static void run_check_job(void* argument) {
+    CheckJob* job = argument;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        while (job->next < job->count && !job->updates[job->next].parsed) job->next++;
+        FileUpdate* update = job->next < job->count ? &job->updates[job->next++] : NULL;
+        pthread_mutex_unlock(&job->lock);
+        if (!update) break;
+        check_file(update);
+    }
+}
+
+static void report_file(Watcher* watcher, FileUpdate* update) {
+    // Text diagnostics don't name their file, so its summary heads them
+    if (watcher->format == DIAG_FORMAT_TEXT) {
+        if (!update->parsed) {
+            printf("%s: syntax error (%.2f ms)\n", update->path, update->elapsed);
+        } else {
+            printf("%s: %s, checked %d of %d statement(s) (%.2f ms)\n", update->path,
+                   update->result ? "OK" : "errors", update->file->cache.checked,
+                   update->file->cache.count, update->elapsed);
+        }
+    }
+    diag_write(&update->analysis.session, watcher->format, stdout);
+    analysis_free(&update->analysis);
+}
+
+static void add_pending(Watcher* watcher, const char* name) {
+    if (skipped_name(name)) return;
+    for (int i = 0; i < watcher->pending_count; i++) {
+        if (strcmp(watcher->pending[i], name) == 0) return;
+    }
+    if (watcher->pending_count == watcher->pending_capacity) {
+        int capacity = watcher->pending_capacity ? watcher->pending_capacity * 2 : 16;
+        char** pending = mem_realloc(MEM_SOURCE, watcher->pending, capacity * sizeof(char*));
+        if (!pending) return;
+        watcher->pending = pending;
+        watcher->pending_capacity = capacity;
+    }
+    char* copy = mem_alloc(MEM_SOURCE, strlen(name) + 1);
+    if (!copy) return;
+    strcpy(copy, name);
+    watcher->pending[watcher->pending_count++] = copy;
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Queue every file in the directory, and every file we know of in case it
+// is gone. Used at startup and when the kernel's event queue overflowed.
+static void add_all_pending(Watcher* watcher) {
+    DIR* dir = opendir(watcher->directory);
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir))) add_pending(watcher, entry->d_name);
+        closedir(dir);
+    }
+    for (int i = 0; i < watcher->count; i++) add_pending(watcher, watcher->files[i].name);
+}
+
+// Every pending file is read and parsed in name order, the ones that parsed
+// are checked on the analyzer's threads, and then each is reported in order
+static void run_update(Watcher* watcher) {
+    qsort(watcher->pending, watcher->pending_count, sizeof(char*), compare_names);
+    int count = watcher->pending_count;
+    FileUpdate* updates = mem_calloc(MEM_SOURCE, count ? count : 1, sizeof(FileUpdate));
+    if (!updates) count = 0;
+
+    // Files come and go first: that moves the others in memory
+    for (int i = 0; i < count; i++) {
+        FileUpdate* update = &updates[i];
+        update->name = watcher->pending[i];
+        update->path = join_path(watcher->directory, update->name);
+        if (!update->path) continue;
+        update->text = read_file(update->path);
+        WatchedFile* file = find_file(watcher, update->name);
+        if (!update->text && file) {
+            remove_file(watcher, file);
+            update->removed = 1;
+        } else if (update->text && !file) add_file(watcher, update->name);
+    }
+    for (int i = 0; i < count; i++) {
+        FileUpdate* update = &updates[i];
+        if (!update->text) continue;
+        WatchedFile* file = find_file(watcher, update->name);
+        // Nothing to say about a save that didn't change what was last reported
+        if (!file || (file->parsed && !file->stale && strcmp(file->tree.source, update->text) == 0)) continue;
+        update->file = file;
+        parse_file(watcher, update);
+    }
+
+    CheckJob job;
+    job.updates = updates;
+    job.count = count;
+    job.next = 0;
+    pthread_mutex_init(&job.lock, NULL);
+    worker_pool_run(watcher->analyzer.workers, count - 1, run_check_job, &job);
+    pthread_mutex_destroy(&job.lock);
+
+    for (int i = 0; i < count; i++) {
+        FileUpdate* update = &updates[i];
+        if (update->file) report_file(watcher, update);
+        else if (update->removed && watcher->format == DIAG_FORMAT_TEXT) printf("%s: removed\n", update->path);
+        mem_free(MEM_SOURCE, update->text);
+        mem_free(MEM_SOURCE, update->path);
+    }
+    mem_free(MEM_SOURCE, updates);
+    for (int i = 0; i < watcher->pending_count; i++) mem_free(MEM_SOURCE, watcher->pending[i]);
+    watcher->pending_count = 0;
+    fflush(stdout);
+}
+
+// Returns 0 once the directory itself is gone
+static int read_events(Watcher* watcher, int fd) {
+    union {
+        struct inotify_event event;         // for the alignment
+        char bytes[64 * 1024];
+    } buffer;
+    ssize_t length = read(fd, buffer.bytes, sizeof(buffer.bytes));
+    if (length <= 0) return length < 0 && (errno == EINTR || errno == EAGAIN);
+
+    for (char* at = buffer.bytes; at < buffer.bytes + length; ) {
+        const struct inotify_event* event = (const struct inotify_event*)at;
+        at += sizeof(struct inotify_event) + event->len;
+        if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) return 0;
+        if (event->mask & IN_Q_OVERFLOW) add_all_pending(watcher);
+        else if (event->len > 0 && !(event->mask & IN_ISDIR)) add_pending(watcher, event->name);
+    }
+    return 1;
+}
+
+int watch_run(const char* directory, DiagnosticFormat format, const AnalysisOptions* options) {
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) return 0;
+    uint32_t mask = IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE |
+                    IN_DELETE_SELF | IN_MOVE_SELF;
+    if (inotify_add_watch(fd, directory, mask) < 0) {
+        close(fd);
+        return 0;
+    }
+
+    Watcher watcher;
+    memset(&watcher, 0, sizeof(watcher));
+    watcher.directory = directory;
+    watcher.format = format;
+    // Stdout is the report, so symbol tables are never dumped
+    AnalysisOptions watch_options;
+    if (options) watch_options = *options;
+    else analysis_default_options(&watch_options);
+    watch_options.print_symbols = 0;
+    analyzer_init(&watcher.analyzer, &watch_options);
+    add_all_pending(&watcher);
+    run_update(&watcher);
+
+    double first_event = 0;
+    for (;;) {
+        int timeout = -1;
+        if (watcher.pending_count > 0) {
+            double waited = now_milliseconds() - first_event;
+            timeout = waited >= MAX_DELAY_MS ? 0 : DEBOUNCE_MS;
+        }
+        struct pollfd poll_fd = {fd, POLLIN, 0};
+        int ready = poll(&poll_fd, 1, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (ready > 0) {
+            int had_pending = watcher.pending_count > 0;
+            if (!read_events(&watcher, fd)) break;
+            if (!had_pending) first_event = now_milliseconds();
+            if (now_milliseconds() - first_event < MAX_DELAY_MS) continue;
+        }
+        if (watcher.pending_count > 0) run_update(&watcher);
+    }
+
+    // Whatever was still queued refers to a directory that's gone
+    for (int i = 0; i < watcher.pending_count; i++) mem_free(MEM_SOURCE, watcher.pending[i]);
+    mem_free(MEM_SOURCE, watcher.pending);
+    for (int i = 0; i < watcher.count; i++) free_file(&watcher.files[i]);
+    mem_free(MEM_SOURCE, watcher.files);
+    analyzer_free(&watcher.analyzer);
+    close(fd);
+    return 1;
+}
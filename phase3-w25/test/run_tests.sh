@@ -0,0 +1,78 @@
+#!/bin/sh
+# Build the analyzer and the unit tests, then run everything under test/.
+#
+#   test_*.c      unit tests, each linked against the analyzer's sources and
+#                 the benchmarks' program generator; a test prints what
+#                 failed and exits non-zero. test_NAME.flags, if present,
+#                 holds extra compiler flags for that test's build.
+#   cases/N.txt   an input for the analyzer, run with the flags in N.args (if
+#                 any). Its diagnostics, result lines and exit status must
+#                 match N.expected.
+#   bench         the benchmarks, built with the command their usage comment
+#                 documents, and run once on small programs.
+#
+# Usage: test/run_tests.sh [extra compiler flags, e.g. -fsanitize=address,undefined]
+cd "$(dirname "$0")/.." || exit 1
+CC=${CC:-cc}
+CFLAGS="-std=c11 -D_GNU_SOURCE -g -O1 -pthread $*"
+BUILD=$(mktemp -d) || exit 1
+trap 'rm -rf "$BUILD"' EXIT
+SOURCES=$(find src -name '*.c' ! -name default_lexer.c ! -path 'src/driver/*' | sort)
+
+if ! $CC $CFLAGS -o "$BUILD/analyzer" $SOURCES src/driver/main.c -lm; then
+    echo "FAIL building the analyzer"
+    exit 1
+fi
+
+failed=0
+for test in test/test_*.c; do
+    name=$(basename "$test" .c)
+    flags=""
+    [ -f "test/$name.flags" ] && flags=$(cat "test/$name.flags")
+    if ! $CC $CFLAGS $flags -Iinclude -o "$BUILD/$name" "$test" $SOURCES bench/generator.c -lm; then
+        echo "FAIL $name (build)"
+        failed=1
+    # What the analyzer prints on stdout is noise here; failures go to stderr
+    elif (cd "$BUILD" && "./$name") > /dev/null 2> "$BUILD/$name.err"; then
+        echo "PASS $name"
+    else
+        echo "FAIL $name"
+        cat "$BUILD/$name.err"
+        failed=1
+    fi
+done
+
+for input in test/cases/*.txt; do
+    [ -f "$input" ] || continue
+    name=${input%.txt}
+    args=""
+    [ -f "$name.args" ] && args=$(cat "$name.args")
+    # Run from the case directory so .args can name files next to the input
+    (cd test/cases && "$BUILD/analyzer" $args "$(basename "$input")" > "$BUILD/case.out" 2>&1
+     echo "exit $?" >> "$BUILD/case.out")
+    grep -E '(Error|Warning) at line|^Semantic analysis|^Parsing failed|^exit ' "$BUILD/case.out" \
+        > "$BUILD/case.actual"
+    if diff -u "$name.expected" "$BUILD/case.actual" > "$BUILD/case.diff"; then
+        echo "PASS $(basename "$name")"
+    else
+        echo "FAIL $(basename "$name")"
+        cat "$BUILD/case.diff"
+        failed=1
+    fi
+done
+
+# The command documented in bench.c, so the documentation can't go stale
+BENCH_ARGS=$(sed -n '\|^//   gcc |,\|-pthread$|s|^//  *||p' bench/bench.c |
+             sed "s|^gcc ||; s|-o analyzer_bench|-o $BUILD/analyzer_bench|")
+if ! $CC $BENCH_ARGS $CFLAGS; then
+    echo "FAIL bench (build)"
+    failed=1
+elif "$BUILD/analyzer_bench" --size=100 --repeat=1 > /dev/null 2> "$BUILD/bench.err"; then
+    echo "PASS bench"
+else
+    echo "FAIL bench"
+    cat "$BUILD/bench.err"
+    failed=1
+fi
+
+exit $failed
@@ -0,0 +1,65 @@
+/* test.h */
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parser.h"
+#include "semantic.h"
+#include "diagnostics.h"
+
+// Shared by the unit tests (test_*.c). run_tests.sh builds each one against
+// the analyzer's sources and runs it; a test reports every failed check and
+// exits non-zero if there was one.
+
+static int test_failures = 0;
+
+#define CHECK(condition) do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            test_failures++; \
+        } \
+    } while (0)
+
+// Compare two strings, showing both when they differ
+#define CHECK_STRING(actual, expected) do { \
+        const char* actual_ = (actual); \
+        const char* expected_ = (expected); \
+        if (strcmp(actual_, expected_) != 0) { \
+            fprintf(stderr, "%s:%d: %s is\n%s\nexpected\n%s\n", __FILE__, __LINE__, \
+                    #actual, actual_, expected_); \
+            test_failures++; \
+        } \
+    } while (0)
+
+static int test_result(void) {
+    if (test_failures) fprintf(stderr, "%d check(s) failed\n", test_failures);
+    return test_failures ? 1 : 0;
+}
+
+// What `session` holds, written as text into a malloc'd string
+static char* diagnostics_text(const DiagnosticSession* session) {
+    char* text = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&text, &length);
+    diag_write(session, DIAG_FORMAT_TEXT, out);
+    fclose(out);
+    return text;
+}
+
+// Parse and check `source`, recording into `session` (initialized here).
+// Returns the analysis result; the tree is left in `*tree`, NULL if it
+// didn't parse.
+static int analyze_source(const char* source, DiagnosticSession* session, ASTNode** tree) {
+    diag_session_init(session, NULL);
+    DiagnosticSession* previous = diag_begin(session);
+    parser_init(source);
+    ASTNode* ast = parse();
+    int result = ast ? analyze_semantics(ast) : 0;
+    diag_end(previous);
+    *tree = ast;
+    return result;
+}
+
+#endif /* TEST_H */
@@ -0,0 +1,69 @@
+/* test_allocator.c */
+// The tracking allocator charges each block to the subsystem that allocated
+// it, follows reallocations, and finds nothing live once an analysis has
+// freed what it made.
+#include "test.h"
+#include "allocator.h"
+#include "optimizer.h"
+#include "runtime.h"
+
+int main(void) {
+    // Before anything is allocated
+    mem_set_allocator(mem_tracking_allocator());
+
+    char* block = mem_alloc(MEM_SOURCE, 100);
+    CHECK(block != NULL);
+    MemUsage usage = mem_usage(MEM_SOURCE);
+    CHECK(usage.live_bytes == 100 && usage.live_blocks == 1 && usage.allocations == 1);
+    block = mem_realloc(MEM_SOURCE, block, 300);
+    usage = mem_usage(MEM_SOURCE);
+    CHECK(usage.live_bytes == 300 && usage.live_blocks == 1 && usage.peak_bytes == 300);
+    block = mem_realloc(MEM_SOURCE, block, 50);
+    usage = mem_usage(MEM_SOURCE);
+    CHECK(usage.live_bytes == 50 && usage.peak_bytes == 300);
+    // Freed under another tag, still charged to its owner
+    mem_free(MEM_AST, block);
+    CHECK(mem_usage(MEM_SOURCE).live_bytes == 0);
+    CHECK(mem_usage(MEM_AST).allocations == 0);
+    CHECK(mem_calloc(MEM_SOURCE, SIZE_MAX / 2, 4) == NULL);
+
+    DiagnosticSession session;
+    ASTNode* program;
+    CHECK(analyze_source("int x;\n"
+                         "int y;\n"
+                         "x = 0;\n"
+                         "while (x < 10) {\n"
+                         "    y = 2 * 3;\n"
+                         "    x = x + 1;\n"
+                         "}\n", &session, &program));
+    CHECK(optimize_loops(program) == 1);
+    CHECK(mem_usage(MEM_AST).live_blocks > 0);
+    CHECK(mem_usage(MEM_AST).peak_bytes >= mem_usage(MEM_AST).live_bytes);
+    free_ast(program);
+    diag_session_free(&session);
+    CHECK(runtime_factorial_big(50) != NULL);
+    runtime_free_factorial_cache();
+
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        CHECK(mem_usage((MemSubsystem)i).live_bytes == 0);
+        CHECK(mem_usage((MemSubsystem)i).live_blocks == 0);
+    }
+    CHECK(mem_usage(MEM_AST).allocations > 0);
+    CHECK(mem_usage(MEM_SYMBOLS).allocations > 0);
+    CHECK(mem_usage(MEM_RUNTIME).allocations > 0);
+    CHECK(mem_total_peak() >= mem_usage(MEM_AST).peak_bytes);
+
+    // A leak is reported with its subsystem
+    void* leaked = mem_alloc(MEM_BYTECODE, 16);
+    char* report = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&report, &length);
+    CHECK(mem_leak_report(out) == 1);
+    fclose(out);
+    CHECK(strstr(report, "bytecode") != NULL);
+    free(report);
+    mem_free(MEM_BYTECODE, leaked);
+    CHECK(mem_leak_report(stdout) == 0);
+
+    return test_result();
+}
@@ -0,0 +1,63 @@
+/* test_annotations.c */
+// The semantic pass leaves each expression's type and each name's symbol id
+// on the tree, for later passes to use without resolving anything again.
+#include "test.h"
+
+// The `index`th statement of a list (0-based)
+static ASTNode* statement(ASTNode* first, int index) {
+    while (first && index-- > 0) first = first->next;
+    return first;
+}
+
+int main(void) {
+    const char* source = "int x;\n"            // 0
+                         "float f;\n"          // 1
+                         "char c;\n"           // 2
+                         "x = 1;\n"            // 3
+                         "f = x + 2.5;\n"      // 4
+                         "c = \"a\";\n"        // 5
+                         "if (x > 0) {\n"      // 6
+                         "    float x;\n"
+                         "    x = f * 2.0;\n"
+                         "}\n";
+    DiagnosticSession session;
+    ASTNode* program;
+    CHECK(analyze_source(source, &session, &program));
+    ASTNode* first = program->next;
+
+    ASTNode* outer_x = statement(first, 0);
+    ASTNode* f = statement(first, 1);
+    CHECK(outer_x->symbol_id >= 0);
+    CHECK(f->symbol_id >= 0 && f->symbol_id != outer_x->symbol_id);
+
+    // int + float is float; the int operand keeps its own type
+    ASTNode* widened = statement(first, 4);
+    CHECK(widened->left->symbol_id == f->symbol_id);
+    CHECK(widened->right->value_type == TOKEN_FLOAT);
+    CHECK(widened->right->left->value_type == TOKEN_INT);
+    CHECK(widened->right->left->symbol_id == outer_x->symbol_id);
+    CHECK(widened->right->right->value_type == TOKEN_FLOAT);
+
+    CHECK(statement(first, 5)->right->value_type == TOKEN_CHAR);
+
+    // The inner x gets a symbol of its own
+    ASTNode* body = statement(first, 6)->right;
+    ASTNode* inner_x = statement(body->next, 0);
+    ASTNode* inner_assign = statement(body->next, 1);
+    CHECK(inner_x->symbol_id >= 0 && inner_x->symbol_id != outer_x->symbol_id);
+    CHECK(inner_assign->left->symbol_id == inner_x->symbol_id);
+    CHECK(inner_assign->right->value_type == TOKEN_FLOAT);
+    free_ast(program);
+    diag_session_free(&session);
+
+    // An ill-typed expression is marked as such, not left unannotated
+    CHECK(!analyze_source("int x;\n"
+                          "char c;\n"
+                          "x = c * 2;\n", &session, &program));
+    ASTNode* bad = statement(program->next, 2);
+    CHECK(bad->right->value_type == -1);
+    free_ast(program);
+    diag_session_free(&session);
+
+    return test_result();
+}
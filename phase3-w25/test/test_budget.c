@@ -0,0 +1,157 @@
+/* test_budget.c */
+// Budgets: each limit stops the input it's exceeded on, is reported once,
+// and nothing is limited without an active budget. The default depth limit
+// turns an expression too deep to check into a diagnostic, not a crash.
+#include "test.h"
+#include "budget.h"
+#include "../bench/generator.h"
+
+typedef struct {
+    int result;
+    int parsed;
+    BudgetLimit exceeded;
+    int errors;
+    char* report;
+} Outcome;
+
+static Outcome analyze_within(const char* source, const BudgetLimits* limits) {
+    Outcome outcome;
+    Budget budget;
+    budget_init(&budget, limits);
+    Budget* previous = budget_begin(&budget);
+    DiagnosticSession session;
+    ASTNode* program;
+    outcome.result = analyze_source(source, &session, &program);
+    budget_end(previous);
+    CHECK(budget_active() == NULL);
+    outcome.parsed = program != NULL;
+    outcome.exceeded = budget.exceeded;
+    outcome.errors = session.error_count;
+    outcome.report = diagnostics_text(&session);
+    free_ast(program);
+    diag_session_free(&session);
+    return outcome;
+}
+
+// `terms` ones added up, left to right
+static char* chain(int terms) {
+    char* source = malloc(2 * (size_t)terms + 32);
+    int length = sprintf(source, "int x;\nx = 1");
+    for (int i = 1; i < terms; i++) length += sprintf(source + length, "+1");
+    strcpy(source + length, ";\nprint x;\n");
+    return source;
+}
+
+static void check_limit(const char* source, const BudgetLimits* limits, BudgetLimit exceeded,
+                        const char* report) {
+    Outcome outcome = analyze_within(source, limits);
+    CHECK(!outcome.result);
+    CHECK(outcome.exceeded == exceeded);
+    CHECK(outcome.errors == 1);
+    if (report) CHECK_STRING(outcome.report, report);
+    free(outcome.report);
+}
+
+static void check_within(const char* source, const BudgetLimits* limits) {
+    Outcome outcome = analyze_within(source, limits);
+    CHECK(outcome.result && outcome.parsed);
+    CHECK(outcome.exceeded == BUDGET_NONE);
+    CHECK_STRING(outcome.report, "");
+    free(outcome.report);
+}
+
+int main(void) {
+    const char* program = "int x;\n"
+                          "x = 1;\n"
+                          "while (x < 10) {\n"
+                          "    if (x > 5) {\n"
+                          "        print (x + (1 * 2));\n"
+                          "    }\n"
+                          "    x = x + 1;\n"
+                          "}\n";
+
+    // Without a budget every checkpoint passes
+    CHECK(budget_active() == NULL);
+    CHECK(budget_token(1) && budget_node(1) && budget_check(1));
+    CHECK(budget_enter(1));
+    budget_leave();
+
+    // All zero: nothing is limited
+    BudgetLimits limits;
+    memset(&limits, 0, sizeof(limits));
+    check_within(program, &limits);
+
+    limits.max_tokens = 10;
+    check_limit(program, &limits, BUDGET_TOKENS,
+                "Limit Error at line 3: Input has more than 10 tokens\n");
+    limits.max_tokens = 1000;
+    check_within(program, &limits);
+
+    memset(&limits, 0, sizeof(limits));
+    limits.max_nodes = 8;
+    check_limit(program, &limits, BUDGET_NODES, NULL);
+    limits.max_nodes = 1000;
+    check_within(program, &limits);
+
+    // Statements, parentheses and operators all count: the print is the
+    // fifth level down
+    memset(&limits, 0, sizeof(limits));
+    limits.max_depth = 5;
+    check_limit(program, &limits, BUDGET_DEPTH,
+                "Limit Error at line 5: Input nests deeper than 5 levels\n");
+    limits.max_depth = 7;
+    check_within(program, &limits);
+
+    memset(&limits, 0, sizeof(limits));
+    limits.max_bytes = 256;
+    check_limit(program, &limits, BUDGET_BYTES, NULL);
+    limits.max_bytes = 1 << 20;
+    check_within(program, &limits);
+
+    // A program that takes far longer than a millisecond to analyze
+    GeneratorOptions options;
+    generator_default_options(&options, SHAPE_MIXED);
+    options.statements = 200000;
+    char* large = generate_program(&options, NULL);
+    CHECK(large != NULL);
+    memset(&limits, 0, sizeof(limits));
+    limits.max_milliseconds = 1;
+    if (large) check_limit(large, &limits, BUDGET_TIME, NULL);
+    free(large);
+
+    // Once exceeded, every checkpoint fails, but the limit is reported once
+    memset(&limits, 0, sizeof(limits));
+    limits.max_tokens = 1;
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    DiagnosticSession* previous_session = diag_begin(&session);
+    Budget budget;
+    budget_init(&budget, &limits);
+    Budget* previous = budget_begin(&budget);
+    CHECK(budget_active() == &budget);
+    CHECK(budget_token(1));
+    CHECK(!budget_token(2));
+    CHECK(!budget_node(3) && !budget_check(4) && !budget_enter(5));
+    budget_end(previous);
+    diag_end(previous_session);
+    CHECK(session.error_count == 1 && session.count == 1 && session.items[0].line == 2);
+    diag_session_free(&session);
+
+    // An operator chain deep enough to overflow the stack while it's typed
+    // is stopped while parsing, at the default depth
+    memset(&limits, 0, sizeof(limits));
+    limits.max_depth = BUDGET_DEFAULT_MAX_DEPTH;
+    char* deep = chain(200000);
+    Outcome outcome = analyze_within(deep, &limits);
+    CHECK(!outcome.result && !outcome.parsed);
+    CHECK(outcome.exceeded == BUDGET_DEPTH);
+    CHECK_STRING(outcome.report, "Limit Error at line 2: Input nests deeper than 10000 levels\n");
+    free(outcome.report);
+    free(deep);
+    // Anything under it is checked in full
+    deep = chain(BUDGET_DEFAULT_MAX_DEPTH - 1);
+    check_within(deep, &limits);
+    free(deep);
+
+    return test_result();
+}
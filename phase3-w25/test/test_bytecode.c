@@ -0,0 +1,252 @@
+/* test_bytecode.c */
+// Compiled programs: what a checked program prints when run from its
+// artifact, and the loader turning away artifacts that are damaged in any
+// of the ways it promises to check.
+#include <unistd.h>
+#include "test.h"
+#include "bytecode.h"
+
+// Analyze and compile `source`; 0 if either fails
+static int compile(const char* source, BytecodeImage* image) {
+    StringPool strings;
+    string_pool_init(&strings);
+    parser_set_string_pool(&strings);
+    DiagnosticSession session;
+    ASTNode* program;
+    int ok = analyze_source(source, &session, &program);
+    parser_set_string_pool(NULL);
+    ok = ok && bytecode_compile(program, &strings, image);
+    free_ast(program);
+    diag_session_free(&session);
+    string_pool_free(&strings);
+    return ok;
+}
+
+typedef struct {
+    int ok;
+    char* output;
+    char* report;       // runtime errors
+} Run;
+
+static Run run(const BytecodeImage* image) {
+    Run result = {0, NULL, NULL};
+    BytecodeProgram program;
+    const char* error = NULL;
+    if (!bytecode_load_memory(&program, image->data, image->size, &error)) {
+        fprintf(stderr, "load failed: %s\n", error);
+        return result;
+    }
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    DiagnosticSession* previous = diag_begin(&session);
+    size_t length = 0;
+    FILE* out = open_memstream(&result.output, &length);
+    result.ok = bytecode_run(&program, out);
+    fclose(out);
+    diag_end(previous);
+    result.report = diagnostics_text(&session);
+    diag_session_free(&session);
+    bytecode_unload(&program);
+    return result;
+}
+
+static void check_output(const char* source, const char* output) {
+    BytecodeImage image;
+    CHECK(compile(source, &image));
+    Run result = run(&image);
+    CHECK(result.ok);
+    CHECK_STRING(result.output, output);
+    CHECK_STRING(result.report, "");
+    free(result.output);
+    free(result.report);
+    bytecode_image_free(&image);
+}
+
+// A copy of `image`'s data the test can damage
+static unsigned char* copy_image(const BytecodeImage* image) {
+    unsigned char* data = malloc(image->size);
+    memcpy(data, image->data, image->size);
+    return data;
+}
+
+static void check_rejected(const unsigned char* data, size_t size, const char* expected) {
+    BytecodeProgram program;
+    const char* error = NULL;
+    CHECK(!bytecode_load_memory(&program, data, size, &error));
+    CHECK_STRING(error ? error : "(loaded)", expected);
+    CHECK(program.code == NULL);
+}
+
+static Instruction* instruction_at(unsigned char* data, uint32_t pc) {
+    const BytecodeHeader* header = (const BytecodeHeader*)data;
+    return (Instruction*)(data + header->code_offset) + pc;
+}
+
+// First or last instruction of `image` with operation `op`, -1 if none
+static int find_op(const BytecodeImage* image, BytecodeOp op, int last) {
+    const BytecodeHeader* header = (const BytecodeHeader*)image->data;
+    const Instruction* code = (const Instruction*)(image->data + header->code_offset);
+    int found = -1;
+    for (uint32_t pc = 0; pc < header->code_count; pc++) {
+        if (code[pc].op == (uint32_t)op) {
+            found = (int)pc;
+            if (!last) break;
+        }
+    }
+    return found;
+}
+
+int main(void) {
+    check_output("int x;\n"
+                 "int total;\n"
+                 "float f;\n"
+                 "char c;\n"
+                 "x = 0;\n"
+                 "total = 0;\n"
+                 "while (x < 5) {\n"
+                 "    total = total + x * 2;\n"
+                 "    x = x + 1;\n"
+                 "}\n"
+                 "print total;\n"
+                 "f = total / 4 + 0.5;\n"
+                 "print f;\n"
+                 "c = \"hello\";\n"
+                 "print c;\n"
+                 "print \"hello\";\n"
+                 "repeat {\n"
+                 "    x = x - 2;\n"
+                 "} until (x <= 0);\n"
+                 "print x;\n"
+                 "if (f > 5) {\n"
+                 "    print 1;\n"
+                 "}\n"
+                 "factorial(20);\n"
+                 "factorial(25);\n",
+                 "52\n13.5\nh\nhello\n-1\n1\n"
+                 "2432902008176640000\n15511210043330985984000000\n");
+
+    // Runtime errors stop the program at the line of their statement
+    BytecodeImage image;
+    CHECK(compile("int x;\n"
+                  "int y;\n"
+                  "x = 1;\n"
+                  "print x;\n"
+                  "y = x / (x - 1);\n"
+                  "print y;\n", &image));
+    Run result = run(&image);
+    CHECK(!result.ok);
+    CHECK_STRING(result.output, "1\n");
+    CHECK(strstr(result.report, "line 5") != NULL);
+    free(result.output);
+    free(result.report);
+    bytecode_image_free(&image);
+
+    // The same artifact, written out and mapped back in
+    CHECK(compile("int x;\nx = 6;\nfactorial(x);\n", &image));
+    char path[] = "/tmp/test_bytecodeXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    CHECK(bytecode_write_file(&image, path));
+    BytecodeProgram program;
+    const char* error = NULL;
+    CHECK(bytecode_load_file(&program, path, &error));
+    CHECK(program.mapping != NULL && program.header->code_count > 0);
+    bytecode_unload(&program);
+    unlink(path);
+    CHECK(!bytecode_load_file(&program, path, &error));
+    CHECK_STRING(error, "could not open the file");
+    bytecode_image_free(&image);
+
+    // Only loads and stores count towards the globals: `unused` takes no slot
+    CHECK(compile("int x;\nint unused;\nx = 2;\nprint x + 1;\nprint \"s\";\n", &image));
+    const BytecodeHeader* header = (const BytecodeHeader*)image.data;
+    CHECK(header->global_count == 1);
+    bytecode_image_free(&image);
+    CHECK(compile("int x;\nint y;\ny = 2;\nprint y;\n", &image));
+    header = (const BytecodeHeader*)image.data;
+    CHECK(header->global_count == 2);
+    bytecode_image_free(&image);
+
+    // Damage one thing at a time
+    CHECK(compile("int x;\n"
+                  "x = 0;\n"
+                  "while (x < 3) {\n"
+                  "    x = x + 1;\n"
+                  "}\n"
+                  "print x;\n"
+                  "print \"done\";\n", &image));
+    header = (const BytecodeHeader*)image.data;
+    size_t size = image.size;
+    result = run(&image);
+    CHECK(result.ok);
+    CHECK_STRING(result.output, "3\ndone\n");
+    free(result.output);
+    free(result.report);
+    unsigned char* data;
+    BytecodeHeader* bad;
+
+    check_rejected(image.data, sizeof(BytecodeHeader) - 1, "not a bytecode file");
+    check_rejected(image.data, size - 1, "line table out of bounds");
+    data = malloc(size + 8);
+    memcpy(data + 4, image.data, size);
+    check_rejected(data + 4, size, "not 8-byte aligned");
+    free(data);
+
+#define DAMAGE(change, expected) \
+    do { \
+        data = copy_image(&image); \
+        bad = (BytecodeHeader*)data; \
+        (void)bad; \
+        change; \
+        check_rejected(data, size, expected); \
+        free(data); \
+    } while (0)
+
+    DAMAGE(bad->magic ^= 1, "not a bytecode file");
+    DAMAGE(bad->version++, "unsupported version");
+    DAMAGE(bad->reserved = 1, "unsupported version");
+    DAMAGE(bad->constants_offset += 4, "constant section out of bounds");
+    DAMAGE(bad->constant_count = 1u << 30, "constant section out of bounds");
+    DAMAGE(bad->strings_offset = (uint32_t)size + 8, "string section out of bounds");
+    DAMAGE(bad->code_count = UINT32_MAX, "code section out of bounds");
+    DAMAGE(bad->lines_offset = 0, "line table out of bounds");
+    DAMAGE(data[header->strings_offset + header->string_bytes - 1] = 'x', "unterminated string section");
+    DAMAGE(bad->code_count = 0, "no code");
+    DAMAGE(bad->max_stack = header->code_count + 1, "stack size out of range");
+    DAMAGE(bad->max_stack = 0, "stack deeper than declared");
+    // More globals than the code touches, up to the old INT32_MAX limit
+    DAMAGE(bad->global_count++, "too many variables");
+    DAMAGE(bad->global_count = 1000000, "too many variables");
+    DAMAGE(bad->global_count = INT32_MAX, "too many variables");
+    DAMAGE(bad->global_count = UINT32_MAX, "too many variables");
+    DAMAGE(bad->global_count = 0, "variable out of range");
+
+    int store = find_op(&image, OP_STORE, 0);
+    int jump = find_op(&image, OP_JUMP, 0);
+    int compare = find_op(&image, OP_COMPARE_INT, 0);
+    int constant = find_op(&image, OP_CONST, 0);
+    int string = find_op(&image, OP_PRINT_STRING, 0);
+    int print = find_op(&image, OP_PRINT_INT, 0);
+    int loop_store = find_op(&image, OP_STORE, 1);
+    CHECK(store >= 0 && jump >= 0 && compare >= 0 && constant >= 0 && string >= 0 && print >= 0);
+    DAMAGE(instruction_at(data, store)->arg = -1, "variable out of range");
+    DAMAGE(instruction_at(data, store)->arg = 1, "variable out of range");
+    DAMAGE(instruction_at(data, constant)->arg = (int32_t)header->constant_count, "constant out of range");
+    DAMAGE(instruction_at(data, compare)->arg = COMPARE_COUNT, "unknown comparison");
+    DAMAGE(instruction_at(data, jump)->arg = (int32_t)header->code_count, "jump out of range");
+    DAMAGE(instruction_at(data, string)->arg = (int32_t)header->string_bytes, "string out of range");
+    DAMAGE(instruction_at(data, print)->op = OP_COUNT, "unknown instruction");
+    // Well-formed operands, ill-formed stack use
+    DAMAGE(instruction_at(data, 0)->op = OP_PRINT_INT, "stack underflow");
+    DAMAGE(instruction_at(data, header->code_count - 1)->op = OP_PRINT_STRING, "code runs past its end");
+    // The loop body leaves a value behind, so the loop's head is reached at
+    // two depths
+    DAMAGE(instruction_at(data, loop_store)->op = OP_INT_TO_FLOAT, "stack depths disagree where paths meet");
+    DAMAGE(((LineEntry*)(data + header->lines_offset))[1].pc = 0, "line table out of order");
+    DAMAGE(((LineEntry*)(data + header->lines_offset))[0].pc = header->code_count, "line table out of order");
+#undef DAMAGE
+
+    bytecode_image_free(&image);
+    return test_result();
+}
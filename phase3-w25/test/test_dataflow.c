@@ -0,0 +1,171 @@
+/* test_dataflow.c */
+// Definite assignment: a read is reported when some path reaching it doesn't
+// assign the variable. Reports are warnings and don't fail the analysis.
+// Running out of memory fails it instead.
+#include "test.h"
+#include "allocator.h"
+
+// The default allocator's, except that the dataflow allocation after the
+// first `dataflow_allocations_left` fails
+static int dataflow_allocations_left = -1;
+
+static int dataflow_allocation_fails(MemSubsystem subsystem) {
+    if (subsystem != MEM_DATAFLOW || dataflow_allocations_left < 0) return 0;
+    return dataflow_allocations_left-- == 0;
+}
+
+static void* failing_allocate(void* context, MemSubsystem subsystem, size_t size) {
+    (void)context;
+    return dataflow_allocation_fails(subsystem) ? NULL : malloc(size);
+}
+
+static void* failing_reallocate(void* context, MemSubsystem subsystem, void* pointer, size_t size) {
+    (void)context;
+    return dataflow_allocation_fails(subsystem) ? NULL : realloc(pointer, size);
+}
+
+static void failing_release(void* context, MemSubsystem subsystem, void* pointer) {
+    (void)context;
+    (void)subsystem;
+    free(pointer);
+}
+
+static const Allocator failing_allocator = {failing_allocate, failing_reallocate, failing_release, NULL};
+
+// Whether the analysis of `source` fails with only an out-of-memory report
+// when the dataflow allocation after the first `allowed` fails. Returns 0
+// once the pass needs no more than `allowed`.
+static int fails_out_of_memory(const char* source, int allowed) {
+    DiagnosticSession session;
+    ASTNode* ast;
+    dataflow_allocations_left = allowed;
+    int ok = analyze_source(source, &session, &ast);
+    int failed = dataflow_allocations_left < 0;
+    dataflow_allocations_left = -1;
+    if (failed) {
+        CHECK(!ok);
+        CHECK(session.count == 1 && session.error_count == 1);
+        if (session.count == 1) {
+            CHECK(session.items[0].phase == DIAG_PHASE_SEMANTIC);
+            CHECK(session.items[0].code == SEM_ERROR_OUT_OF_MEMORY);
+        }
+    } else {
+        CHECK(ok);
+    }
+    free_ast(ast);
+    diag_session_free(&session);
+    return failed;
+}
+
+// "line:name" of every uninitialized-use report, space-separated
+static char* uninitialized_uses(const char* source) {
+    DiagnosticSession session;
+    ASTNode* ast;
+    int ok = analyze_source(source, &session, &ast);
+    CHECK(ok);
+
+    static char uses[1024];
+    uses[0] = '\0';
+    for (int i = 0; i < session.count; i++) {
+        const Diagnostic* diagnostic = &session.items[i];
+        if (diagnostic->phase != DIAG_PHASE_SEMANTIC ||
+            diagnostic->code != SEM_ERROR_UNINITIALIZED_VARIABLE) {
+            continue;
+        }
+        CHECK(diagnostic->severity == DIAG_WARNING);
+        char use[300];
+        snprintf(use, sizeof(use), "%s%d:%s", uses[0] ? " " : "", diagnostic->line, diagnostic->arg);
+        strncat(uses, use, sizeof(uses) - strlen(uses) - 1);
+    }
+    CHECK(session.error_count == 0);
+    free_ast(ast);
+    diag_session_free(&session);
+    return uses;
+}
+
+int main(void) {
+    // Before anything is allocated; it frees like the default one
+    mem_set_allocator(&failing_allocator);
+
+    CHECK_STRING(uninitialized_uses("int x;\n"
+                                    "int y;\n"
+                                    "y = x + 1;\n"
+                                    "x = 2;\n"
+                                    "y = x;\n"),
+                 "3:x");
+
+    // Assigned on one branch only
+    CHECK_STRING(uninitialized_uses("int x;\n"
+                                    "int c;\n"
+                                    "c = 1;\n"
+                                    "if (c > 0) {\n"
+                                    "    x = 1;\n"
+                                    "}\n"
+                                    "print x;\n"),
+                 "7:x");
+
+    // Assigned before the branch, so every path has it
+    CHECK_STRING(uninitialized_uses("int x;\n"
+                                    "int c;\n"
+                                    "c = 1;\n"
+                                    "x = 0;\n"
+                                    "if (c > 0) {\n"
+                                    "    x = 1;\n"
+                                    "}\n"
+                                    "print x;\n"),
+                 "");
+
+    // A while body may not run at all
+    CHECK_STRING(uninitialized_uses("int x;\n"
+                                    "int i;\n"
+                                    "i = 0;\n"
+                                    "while (i < 3) {\n"
+                                    "    x = i;\n"
+                                    "    i = i + 1;\n"
+                                    "}\n"
+                                    "print x;\n"),
+                 "8:x");
+
+    // A repeat body always runs once, and its condition comes after it
+    CHECK_STRING(uninitialized_uses("int x;\n"
+                                    "repeat {\n"
+                                    "    x = 5;\n"
+                                    "} until (x > 0);\n"
+                                    "print x;\n"),
+                 "");
+
+    // Read in the loop before the assignment that only a later iteration sees
+    CHECK_STRING(uninitialized_uses("int x;\n"
+                                    "int i;\n"
+                                    "i = 0;\n"
+                                    "while (i < 3) {\n"
+                                    "    print x;\n"
+                                    "    x = i;\n"
+                                    "    i = i + 1;\n"
+                                    "}\n"),
+                 "5:x");
+
+    // Each variable has its own bit; assigning one says nothing of another
+    CHECK_STRING(uninitialized_uses("int a;\n"
+                                    "int b;\n"
+                                    "a = 1;\n"
+                                    "print a;\n"
+                                    "print b;\n"),
+                 "5:b");
+
+    // Each of the pass's allocations failing in turn, down to the last one.
+    // Enough blocks and events to grow their arrays.
+    const char* large = "int x;\n"
+                        "int i;\n"
+                        "i = 0;\n"
+                        "while (i < 3) { if (i > 1) { x = i; } i = i + 1; }\n"
+                        "while (i < 3) { if (i > 1) { x = i; } i = i + 1; }\n"
+                        "while (i < 3) { if (i > 1) { x = i; } i = i + 1; }\n"
+                        "while (i < 3) { if (i > 1) { x = i; } i = i + 1; }\n"
+                        "while (i < 3) { print x; x = x + i + i + i + i + i + i + i + i; }\n";
+    int allowed = 0;
+    while (allowed < 100 && fails_out_of_memory(large, allowed)) allowed++;
+    CHECK(allowed > 5 && allowed < 100);
+
+    return test_result();
+}
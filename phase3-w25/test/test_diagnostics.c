@@ -0,0 +1,55 @@
+/* test_diagnostics.c */
+// Diagnostics are recorded as they're reported and formatted only when the
+// session is written: as "<Phase> Error/Warning at line ..." text or as JSON.
+#include "test.h"
+
+int main(void) {
+    DiagnosticSession session;
+    ASTNode* program;
+    CHECK(!analyze_source("int x;\n"
+                          "int y;\n"
+                          "y = x + 1;\n"
+                          "char c;\n"
+                          "c = \"a\";\n"
+                          "y = c * 2;\n", &session, &program));
+    CHECK(session.error_count == 1);
+    CHECK(session.warning_count == 1);
+    char* text = diagnostics_text(&session);
+    CHECK_STRING(text, "Semantic Error at line 6: Invalid operation involving '*'\n"
+                       "Semantic Warning at line 3: Variable 'x' may be used uninitialized\n");
+    free(text);
+    free_ast(program);
+    diag_session_free(&session);
+
+    // Columns, other phases, and a session that only counts
+    diag_session_init(&session, "input.txt");
+    DiagnosticSession* previous = diag_begin(&session);
+    diag_report(DIAG_PHASE_SEMANTIC, SEM_ERROR_UNINITIALIZED_VARIABLE, DIAG_WARNING, 2, 7, "n");
+    diag_report(DIAG_PHASE_LEXICAL, ERROR_INVALID_CHAR, DIAG_ERROR, 4, 1, "$");
+    session.enabled = 0;
+    diag_report(DIAG_PHASE_SEMANTIC, SEM_ERROR_UNINITIALIZED_VARIABLE, DIAG_WARNING, 9, 0, "m");
+    diag_end(previous);
+    CHECK(session.count == 2);
+    CHECK(session.warning_count == 2);
+    CHECK(session.error_count == 1);
+
+    text = diagnostics_text(&session);
+    CHECK(strstr(text, "Semantic Warning at line 2, column 7: Variable 'n' may be used uninitialized\n") == text);
+    CHECK(strstr(text, "\nLexical Error at line 4, column 1: ") != NULL);
+    free(text);
+
+    char* json = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&json, &length);
+    diag_write(&session, DIAG_FORMAT_JSON, out);
+    fclose(out);
+    CHECK(strncmp(json, "{\"errors\":1,\"warnings\":2,\"diagnostics\":[", 40) == 0);
+    CHECK(strstr(json, "{\"severity\":\"warning\",\"phase\":\"semantic\","
+                       "\"code\":\"SEM_ERROR_UNINITIALIZED_VARIABLE\",\"file\":\"input.txt\","
+                       "\"line\":2,\"column\":7,") != NULL);
+    CHECK(strstr(json, "{\"severity\":\"error\",\"phase\":\"lexical\"") != NULL);
+    free(json);
+    diag_session_free(&session);
+
+    return test_result();
+}
@@ -0,0 +1,91 @@
+/* test_float_literals.c */
+// Float literals: parse_float_literal() must round exactly like strtod(),
+// the lexer must hand whole literals to it, and the semantic pass promotes
+// int to float but never the other way.
+#include <math.h>
+#include "test.h"
+#include "float_literal.h"
+
+static void check_literal(const char* text) {
+    double value, expected = strtod(text, NULL);
+    int finite = parse_float_literal(text, &value);
+    CHECK(finite == !isinf(expected));
+    if (memcmp(&value, &expected, sizeof(double)) != 0) {
+        fprintf(stderr, "'%s' parsed as %.17g, strtod gives %.17g\n", text, value, expected);
+        test_failures++;
+    }
+}
+
+static Token lex_one(const char* text) {
+    lexer_reset();
+    int pos = 0;
+    return get_next_token(text, &pos);
+}
+
+// Type errors reported for `source`
+static int type_errors(const char* source) {
+    DiagnosticSession session;
+    ASTNode* program;
+    analyze_source(source, &session, &program);
+    int errors = session.error_count;
+    free_ast(program);
+    diag_session_free(&session);
+    return errors;
+}
+
+int main(void) {
+    const char* literals[] = {
+        "0.0", "1.0", "0.1", "2.5", "3.14159", "1e0", "1e10", "1E-5", "2.5e+3", "123.456e-7",
+        // Largest and smallest normal, subnormals, and past both ends
+        "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308", "1e309",
+        "2.2250738585072014e-308", "2.2250738585072011e-308", "4.9e-324", "2.4e-324", "1e-400",
+        // Halfway between two doubles: ties go to even
+        "9007199254740993.0", "9007199254740995.0", "4503599627370496.5", "4503599627370497.5",
+        // More digits than 64 bits hold
+        "3.141592653589793238462643383279502884197", "0.10000000000000000555111512312578270211815834",
+        "123456789012345678901234567890.0", "0.000000000000000000000000000001",
+        "1e-0", "000000000001.5", "7.0e022", "8.98846567431158e307",
+    };
+    for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); i++) check_literal(literals[i]);
+
+    // Random mantissas and exponents
+    unsigned seed = 99;
+    char text[64];
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int digits = 1 + (seed >> 8) % 25;
+        int point = (seed >> 4) % (digits + 1);
+        int length = 0;
+        for (int d = 0; d < digits; d++) {
+            seed = seed * 1103515245u + 12345u;
+            text[length++] = (char)('0' + (seed >> 16) % 10);
+            if (d + 1 == point) text[length++] = '.';
+        }
+        // Literals always have digits after the point
+        if (point == 0) text[length++] = '.';
+        if (text[length - 1] == '.') text[length++] = '5';
+        seed = seed * 1103515245u + 12345u;
+        sprintf(text + length, "e%d", (int)((seed >> 8) % 700) - 350);
+        check_literal(text);
+    }
+
+    Token token = lex_one("2.5e-3;");
+    CHECK(token.type == TOKEN_FLOAT_LITERAL && token.error == ERROR_NONE);
+    CHECK_STRING(token.lexeme, "2.5e-3");
+    CHECK(token.real == 2.5e-3);
+    token = lex_one("1e999");
+    CHECK(token.type == TOKEN_FLOAT_LITERAL && token.error == ERROR_FLOAT_OVERFLOW);
+    token = lex_one("1e+");
+    CHECK(token.type == TOKEN_ERROR && token.error == ERROR_INVALID_NUMBER);
+    token = lex_one("1.5x");
+    CHECK(token.type == TOKEN_ERROR && token.error == ERROR_INVALID_NUMBER);
+    token = lex_one("42");
+    CHECK(token.type == TOKEN_NUMBER);
+
+    CHECK(type_errors("float f;\nf = 1;\nf = f * 2 + 0.5;\n") == 0);
+    CHECK(type_errors("int x;\nx = 2.5;\n") == 1);
+    CHECK(type_errors("int x;\nfloat f;\nf = 1.0;\nx = f + 1;\n") == 1);
+    CHECK(type_errors("float f;\nf = 1e999;\n") == 1);
+
+    return test_result();
+}
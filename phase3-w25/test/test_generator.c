@@ -0,0 +1,47 @@
+/* test_generator.c */
+// The benchmarks time programs from bench/generator.c, which promises that
+// every shape lexes, parses and checks cleanly, and that a seed always
+// gives the same program.
+#include "test.h"
+#include "../bench/generator.h"
+
+int main(void) {
+    for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+        const char* name = generator_shape_name((GeneratorShape)shape);
+        CHECK(generator_shape_from_name(name) == (GeneratorShape)shape);
+
+        GeneratorOptions options;
+        generator_default_options(&options, (GeneratorShape)shape);
+        options.statements = 200;
+        size_t length = 0;
+        char* program = generate_program(&options, &length);
+        CHECK(program != NULL);
+        if (!program) continue;
+        CHECK(length == strlen(program));
+
+        DiagnosticSession session;
+        ASTNode* tree;
+        int passed = analyze_source(program, &session, &tree);
+        if (!passed || session.error_count || session.warning_count) {
+            char* text = diagnostics_text(&session);
+            fprintf(stderr, "shape %s:\n%s", name, text);
+            free(text);
+        }
+        CHECK(passed);
+        CHECK(session.warning_count == 0);
+        free_ast(tree);
+        diag_session_free(&session);
+
+        char* same = generate_program(&options, NULL);
+        CHECK(same && strcmp(program, same) == 0);
+        options.seed++;
+        char* other = generate_program(&options, NULL);
+        CHECK(other && strcmp(program, other) != 0);
+        free(program);
+        free(same);
+        free(other);
+    }
+    CHECK(generator_shape_from_name("no_such_shape") == SHAPE_COUNT);
+
+    return test_result();
+}
@@ -0,0 +1,108 @@
+/* test_incremental_check.c */
+// After every edit, a SemanticCache must report what checking the whole
+// program from scratch reports, and annotate the tree the same way, while
+// checking again only the statements the edit can affect.
+#include "test.h"
+#include "incremental.h"
+
+// Expression types, statement by statement (symbol ids are never reused, so
+// they can't be compared)
+static int same_types(const ASTNode* a, const ASTNode* b) {
+    for (; a && b; a = a->next, b = b->next) {
+        if (a->value_type != b->value_type) return 0;
+        if (!same_types(a->left, b->left) || !same_types(a->right, b->right)) return 0;
+    }
+    return a == b;
+}
+
+// What check_program() reports for `text`, as text; `*result` is its result
+static char* full_check(const char* text, int* result, ASTNode** program) {
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    DiagnosticSession* previous = diag_begin(&session);
+    parser_init(text);
+    *program = parse();
+    SymbolTable* table = init_symbol_table();
+    *result = *program ? check_program(*program, table) : 0;
+    free_symbol_table(table);
+    diag_end(previous);
+    char* report = diagnostics_text(&session);
+    diag_session_free(&session);
+    return report;
+}
+
+// Edit `tree`, bring `cache` up to date and compare with a full check.
+// Returns how many statements the cache checked.
+static int check_edit(ParseTree* tree, SemanticCache* cache, int offset, int removed, const char* inserted) {
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    DiagnosticSession* previous = diag_begin(&session);
+    CHECK(parse_tree_edit(tree, offset, removed, inserted) >= 0);
+    diag_session_free(&session);
+    diag_session_init(&session, NULL);
+    int result = semantic_cache_update(cache, tree);
+    diag_end(previous);
+    char* report = diagnostics_text(&session);
+    diag_session_free(&session);
+
+    int expected_result;
+    ASTNode* expected_program;
+    char* expected = full_check(tree->source, &expected_result, &expected_program);
+    CHECK(result == expected_result);
+    CHECK_STRING(report, expected);
+    CHECK(same_types(parse_tree_program(tree)->next, expected_program->next));
+    free_ast(expected_program);
+    free(expected);
+    free(report);
+    return cache->checked;
+}
+
+static int offset_of(const ParseTree* tree, const char* text) {
+    const char* found = strstr(tree->source, text);
+    CHECK(found != NULL);
+    return found ? (int)(found - tree->source) : 0;
+}
+
+int main(void) {
+    const char* source = "int x;\n"
+                         "float f;\n"
+                         "x = 1;\n"
+                         "f = x + 2.5;\n"
+                         "char c;\n"
+                         "c = \"a\";\n"
+                         "if (x > 0) {\n"
+                         "    int y;\n"
+                         "    y = x * 2;\n"
+                         "}\n"
+                         "print c;\n";
+    ParseTree tree;
+    SemanticCache cache;
+    CHECK(parse_tree_init(&tree, source));
+    semantic_cache_init(&cache);
+    CHECK(check_edit(&tree, &cache, 0, 0, "") == tree.count);
+
+    // A literal nobody declares anything by: only its statement
+    CHECK(check_edit(&tree, &cache, offset_of(&tree, "1;"), 1, "7") == 1);
+    // Changing x's type re-checks the three statements that read x, and
+    // makes `f = x + 2.5` and `y = x * 2` fail
+    CHECK(check_edit(&tree, &cache, 0, 3, "char") == 4);
+    // And back
+    CHECK(check_edit(&tree, &cache, 0, 4, "int") == 4);
+    // A use of an undeclared name (the parser takes the statement before an
+    // edit at its end again), then its declaration, which `z = 3` reads
+    CHECK(check_edit(&tree, &cache, tree.length, 0, "z = 3;\n") == 2);
+    CHECK(check_edit(&tree, &cache, offset_of(&tree, "print c;"), 0, "int z;\n") == 3);
+    // A redeclaration at the top, then gone again
+    CHECK(check_edit(&tree, &cache, 0, 0, "int c;\n") >= 1);
+    CHECK(check_edit(&tree, &cache, 0, 7, "") >= 1);
+    // An error in one statement
+    CHECK(check_edit(&tree, &cache, offset_of(&tree, "z = 3;"), 6, "z = c * 3;") == 1);
+    // Every line moves down; reused statements' diagnostics move with them.
+    // Reparsing `int x;` declares x again, so its readers are checked too.
+    CHECK(check_edit(&tree, &cache, 0, 0, "\n\n\n") == 4);
+
+    semantic_cache_free(&cache);
+    parse_tree_free(&tree);
+
+    return test_result();
+}
@@ -0,0 +1,147 @@
+/* test_incremental_parse.c */
+// After any edit, a ParseTree's program must be the tree a full parse of
+// the new text gives: same nodes, lexemes, lines and offsets. An edit the
+// full parse rejects must leave the tree as it was.
+#include "test.h"
+
+static int same_tree(const ASTNode* a, const ASTNode* b) {
+    // Statement lists are long; walk `next` without recursing
+    for (; a && b; a = a->next, b = b->next) {
+        if (a->type != b->type || a->token.type != b->token.type ||
+            strcmp(a->token.lexeme, b->token.lexeme) != 0 ||
+            a->token.line != b->token.line || a->token.offset != b->token.offset ||
+            a->token.value != b->token.value) {
+            fprintf(stderr, "'%s' line %d offset %d vs '%s' line %d offset %d\n",
+                    a->token.lexeme, a->token.line, a->token.offset,
+                    b->token.lexeme, b->token.line, b->token.offset);
+            return 0;
+        }
+        if (!same_tree(a->left, b->left) || !same_tree(a->right, b->right) ||
+            !same_tree(a->operand, b->operand)) {
+            return 0;
+        }
+    }
+    return a == b;
+}
+
+// The program nodes themselves differ: parse() gives its root the first token
+static int same_program(const ASTNode* a, const ASTNode* b) {
+    return a->type == AST_PROGRAM && b->type == AST_PROGRAM && same_tree(a->next, b->next);
+}
+
+// Parse `text` from scratch, quietly; NULL on a syntax error
+static ASTNode* full_parse(const char* text) {
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    session.enabled = 0;
+    DiagnosticSession* previous = diag_begin(&session);
+    parser_init(text);
+    ASTNode* program = parse();
+    diag_end(previous);
+    return program;
+}
+
+// `text` with `removed` bytes at `offset` replaced by `inserted`
+static char* edited(const char* text, int offset, int removed, const char* inserted) {
+    size_t length = strlen(text);
+    char* result = malloc(length - removed + strlen(inserted) + 1);
+    memcpy(result, text, offset);
+    strcpy(result + offset, inserted);
+    strcat(result, text + offset + removed);
+    return result;
+}
+
+// Apply an edit to `tree` and check it against a full parse. Returns what
+// parse_tree_edit() did.
+static int check_edit(ParseTree* tree, int offset, int removed, const char* inserted) {
+    char* before = strdup(tree->source);
+    char* after = edited(before, offset, removed, inserted);
+    ASTNode* expected = full_parse(after);
+
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    session.enabled = 0;
+    DiagnosticSession* previous = diag_begin(&session);
+    int reparsed = parse_tree_edit(tree, offset, removed, inserted);
+    diag_end(previous);
+
+    if (expected) {
+        CHECK(reparsed >= 0);
+        CHECK_STRING(tree->source, after);
+        CHECK(same_program(parse_tree_program(tree), expected));
+    } else {
+        CHECK(reparsed == -1);
+        CHECK_STRING(tree->source, before);
+        ASTNode* unchanged = full_parse(before);
+        CHECK(same_program(parse_tree_program(tree), unchanged));
+        free_ast(unchanged);
+    }
+    free_ast(expected);
+    free(before);
+    free(after);
+    return reparsed;
+}
+
+int main(void) {
+    const char* source = "int x;\n"
+                         "x = 1;\n"
+                         "if (x > 0) {\n"
+                         "    print x;\n"
+                         "}\n"
+                         "char c;\n"
+                         "c = \"abc\";\n"
+                         "while (x < 10) {\n"
+                         "    x = x + 1;\n"
+                         "}\n";
+    ParseTree tree;
+    CHECK(parse_tree_init(&tree, source));
+    CHECK(tree.count == 6);
+    ASTNode* expected = full_parse(source);
+    CHECK(same_program(parse_tree_program(&tree), expected));
+    free_ast(expected);
+
+    // Inside one statement: only it is parsed again; later ones move down
+    const char* one = strstr(tree.source, "1;");
+    CHECK(check_edit(&tree, (int)(one - tree.source), 1, "1234\n\n") == 1);
+    unsigned last_id = tree.spans[5].id;
+    // A new statement at the front: it and the one it touches are parsed,
+    // everything after them is reused
+    CHECK(check_edit(&tree, 0, 0, "float f;\n") == 2);
+    CHECK(tree.count == 7 && tree.spans[6].id == last_id);
+    // Joining two statements into one
+    const char* brace = strstr(tree.source, "}\nchar");
+    CHECK(check_edit(&tree, (int)(brace - tree.source) + 1, 1, " ") >= 1);
+    // Syntax errors and bad ranges change nothing
+    CHECK(check_edit(&tree, 3, 0, "= ;") == -1);
+    CHECK(parse_tree_edit(&tree, tree.length, 1, "") == -1);
+    CHECK(parse_tree_edit(&tree, -1, 0, "x") == -1);
+
+    // Down to no statements and back
+    CHECK(check_edit(&tree, 0, tree.length, "") == 0);
+    CHECK(tree.count == 0);
+    CHECK(check_edit(&tree, 0, 0, "int y;\ny = 2;\n") == 2);
+    CHECK(check_edit(&tree, tree.length, 0, "print y;\n") == 2);
+    CHECK(tree.count == 3);
+    parse_tree_free(&tree);
+
+    // Starting from nothing at all
+    CHECK(parse_tree_init(&tree, ""));
+    CHECK(tree.count == 0);
+    CHECK(check_edit(&tree, 0, 0, "int z;\n") == 1);
+    parse_tree_free(&tree);
+
+    // Random single-character edits, most of which don't parse
+    const char* alphabet = "xy1 ;=+{}()\n";
+    CHECK(parse_tree_init(&tree, source));
+    unsigned seed = 12345;
+    for (int i = 0; i < 400 && !test_failures; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int offset = (int)((seed >> 8) % (unsigned)(tree.length + 1));
+        int removed = offset < tree.length ? (int)((seed >> 4) % 2) : 0;
+        char inserted[2] = { alphabet[(seed >> 16) % strlen(alphabet)], '\0' };
+        check_edit(&tree, offset, removed, (seed >> 24) % 3 ? inserted : "");
+    }
+    parse_tree_free(&tree);
+
+    return test_result();
+}
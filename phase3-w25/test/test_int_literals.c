@@ -0,0 +1,76 @@
+/* test_int_literals.c */
+// The lexer decodes integer literals as it scans them. A literal past
+// INT_MAX still lexes as a number, saturated and flagged, and the parser
+// reports it where it starts.
+#include <limits.h>
+#include "test.h"
+
+static Token lex_one(const char* text) {
+    lexer_reset();
+    int pos = 0;
+    return get_next_token(text, &pos);
+}
+
+static void check_value(const char* text, int value) {
+    Token token = lex_one(text);
+    CHECK(token.type == TOKEN_NUMBER);
+    CHECK(token.error == ERROR_NONE);
+    if (token.value != value) {
+        fprintf(stderr, "'%s' decoded as %d, expected %d\n", text, token.value, value);
+        test_failures++;
+    }
+}
+
+static void check_overflow(const char* text) {
+    Token token = lex_one(text);
+    CHECK(token.type == TOKEN_NUMBER);
+    CHECK(token.error == ERROR_NUMBER_OVERFLOW);
+    CHECK(token.value == INT_MAX);
+    CHECK_STRING(token.lexeme, text);
+}
+
+int main(void) {
+    check_value("0", 0);
+    check_value("7;", 7);
+    check_value("0042", 42);
+    check_value("65536", 65536);
+    check_value("2147483647", INT_MAX);
+    check_value("0000000000002147483647", INT_MAX);
+    check_overflow("2147483648");
+    check_overflow("2147483650");
+    check_overflow("9999999999");
+    check_overflow("123456789012345678901234567890");
+
+    Token bad = lex_one("12ab");
+    CHECK(bad.type == TOKEN_ERROR && bad.error == ERROR_INVALID_NUMBER);
+
+    // Every literal of a statement is decoded, not just the first
+    lexer_reset();
+    int pos = 0;
+    int values[4];
+    int count = 0;
+    const char* text = "x = 10 + 2147483647 * 3;";
+    for (Token token = get_next_token(text, &pos); token.type != TOKEN_EOF;
+         token = get_next_token(text, &pos)) {
+        if (token.type == TOKEN_NUMBER && count < 4) values[count++] = token.value;
+    }
+    CHECK(count == 3 && values[0] == 10 && values[1] == INT_MAX && values[2] == 3);
+
+    // Parsing goes on past an overflow; the error points at the literal
+    DiagnosticSession session;
+    ASTNode* program;
+    CHECK(!analyze_source("int x;\n"
+                          "x = 2147483647;\n"
+                          "x = 1 + 99999999999;\n"
+                          "y = 1;\n", &session, &program));
+    CHECK(program != NULL);
+    CHECK(program->next->next->next->right->right->token.value == INT_MAX);
+    char* report = diagnostics_text(&session);
+    CHECK_STRING(report, "Lexical Error at line 3: Integer literal '99999999999' does not fit in int\n"
+                         "Semantic Error at line 4: Undeclared variable 'y'\n");
+    free(report);
+    free_ast(program);
+    diag_session_free(&session);
+
+    return test_result();
+}
@@ -0,0 +1,76 @@
+/* test_line_index.c */
+// Line and column lookups through a LineIndex must match counting newlines
+// from the start, for every offset; diagnostics reported at an offset are
+// located through the session's index.
+#include "test.h"
+
+static void check_every_offset(const char* text) {
+    int length = (int)strlen(text);
+    LineIndex index;
+    CHECK(line_index_build(&index, text, length));
+    int line = 1, column = 1;
+    for (int offset = 0; offset <= length; offset++) {
+        int found_line, found_column;
+        line_index_position(&index, offset, &found_line, &found_column);
+        if (found_line != line || found_column != column) {
+            fprintf(stderr, "offset %d: line %d column %d, expected line %d column %d\n",
+                    offset, found_line, found_column, line, column);
+            test_failures++;
+            break;
+        }
+        if (offset < length && text[offset] == '\n') {
+            line++;
+            column = 1;
+        } else {
+            column++;
+        }
+    }
+    // Offsets outside the text clamp to it
+    int first_line, first_column, end_line, end_column, last_line, last_column;
+    line_index_position(&index, -5, &first_line, &first_column);
+    line_index_position(&index, length, &end_line, &end_column);
+    line_index_position(&index, length + 10, &last_line, &last_column);
+    CHECK(first_line == 1 && first_column == 1);
+    CHECK(last_line == end_line && last_column == end_column);
+    line_index_free(&index);
+}
+
+int main(void) {
+    check_every_offset("");
+    check_every_offset("int x;");
+    check_every_offset("int x;\n");
+    check_every_offset("\n\n\nx\n\n");
+    check_every_offset("int x;\r\nx = 1;\r\n");
+
+    // More lines than the index starts with room for
+    char* many = malloc(5000);
+    int length = 0;
+    for (int i = 0; i < 500; i++) length += sprintf(many + length, "%.*s\n", i % 7, "abcdefg");
+    check_every_offset(many);
+    free(many);
+
+    const char* source = "int x;\n"
+                         "x = 1;\n"
+                         "  y = 2;\n";
+    LineIndex index;
+    CHECK(line_index_build(&index, source, (int)strlen(source)));
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    session.lines = &index;
+    DiagnosticSession* previous = diag_begin(&session);
+    diag_report_at(DIAG_PHASE_SEMANTIC, SEM_ERROR_UNDECLARED_VARIABLE, DIAG_ERROR,
+                   3, (int)(strstr(source, "y =") - source), "y");
+    diag_end(previous);
+    char* text = diagnostics_text(&session);
+    CHECK_STRING(text, "Semantic Error at line 3, column 3: Undeclared variable 'y'\n");
+    free(text);
+    // Without the index only the line is known
+    session.lines = NULL;
+    text = diagnostics_text(&session);
+    CHECK_STRING(text, "Semantic Error at line 3: Undeclared variable 'y'\n");
+    free(text);
+    diag_session_free(&session);
+    line_index_free(&index);
+
+    return test_result();
+}
@@ -0,0 +1,242 @@
+/* test_optimizer.c */
+// Loop-invariant code motion must not change what a program does: every
+// program is compiled and run as checked, and again after optimize_loops(),
+// and the output and runtime errors must be the same.
+#include "test.h"
+#include "optimizer.h"
+#include "bytecode.h"
+#include "runtime.h"
+
+// Output and diagnostics of running `source`, optimized or not
+static char* run_program(const char* source, int optimize, int* hoisted) {
+    DiagnosticSession session;
+    ASTNode* ast;
+    int ok = analyze_source(source, &session, &ast);
+    if (!ok) {
+        char* messages = diagnostics_text(&session);
+        fprintf(stderr, "analysis failed:\n%s", messages);
+        free(messages);
+        test_failures++;
+        free_ast(ast);
+        diag_session_free(&session);
+        return strdup("");
+    }
+    if (optimize) *hoisted = optimize_loops(ast);
+
+    char* text = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&text, &length);
+    BytecodeImage image;
+    BytecodeProgram program;
+    const char* error = NULL;
+    CHECK(bytecode_compile(ast, NULL, &image));
+    CHECK(bytecode_load_memory(&program, image.data, image.size, &error));
+
+    DiagnosticSession runtime;
+    diag_session_init(&runtime, NULL);
+    DiagnosticSession* previous = diag_begin(&runtime);
+    if (!error) bytecode_run(&program, out);
+    diag_end(previous);
+    diag_write(&runtime, DIAG_FORMAT_TEXT, out);
+    fclose(out);
+
+    diag_session_free(&runtime);
+    bytecode_image_free(&image);
+    free_ast(ast);
+    diag_session_free(&session);
+    return text;
+}
+
+// `expected_hoisted` is -1 when only the output matters
+static void check_same_output(const char* name, const char* source, int expected_hoisted) {
+    int hoisted = 0;
+    char* plain = run_program(source, 0, &hoisted);
+    char* optimized = run_program(source, 1, &hoisted);
+    if (strcmp(plain, optimized) != 0) {
+        fprintf(stderr, "%s: output differs\nunoptimized:\n%s\noptimized:\n%s\n", name, plain, optimized);
+        test_failures++;
+    }
+    if (expected_hoisted >= 0 && hoisted != expected_hoisted) {
+        fprintf(stderr, "%s: hoisted %d expression(s), expected %d\n", name, hoisted, expected_hoisted);
+        test_failures++;
+    }
+    free(plain);
+    free(optimized);
+}
+
+int main(void) {
+    check_same_output("float arithmetic",
+                  "int i;\n"
+                  "float f;\n"
+                  "float g;\n"
+                  "i = 0;\n"
+                  "f = 1.5;\n"
+                  "g = 0.0;\n"
+                  "while (i < 4) {\n"
+                  "    g = f * 2.0 + g;\n"
+                  "    print g;\n"
+                  "    i = i + 1;\n"
+                  "}\n",
+                  1);
+
+    check_same_output("division by non-zero literals",
+                  "int i;\n"
+                  "int k;\n"
+                  "int y;\n"
+                  "i = 0;\n"
+                  "k = 17;\n"
+                  "while (i < 3) {\n"
+                  "    y = k / 4 + i;\n"
+                  "    print y;\n"
+                  "    i = i + 1;\n"
+                  "}\n",
+                  1);
+
+    // k / 0 and k / -1 can fail, k / d isn't known not to, and they come
+    // after a print; only 0 - 1 moves
+    check_same_output("division that can fail",
+                  "int i;\n"
+                  "int k;\n"
+                  "int d;\n"
+                  "int y;\n"
+                  "i = 1;\n"
+                  "k = 9;\n"
+                  "d = 0;\n"
+                  "while (i > 0) {\n"
+                  "    print i;\n"
+                  "    y = k / 0;\n"
+                  "    y = k / d;\n"
+                  "    y = k / (0 - 1);\n"
+                  "    i = i - 1;\n"
+                  "}\n"
+                  "print i;\n",
+                  1);
+
+    // The loop never runs, so its overflowing product, hoisted behind the
+    // rotated loop's guard along with the condition, never gets computed
+    check_same_output("zero-trip while",
+                  "int n;\n"
+                  "int k;\n"
+                  "int y;\n"
+                  "float f;\n"
+                  "n = 0;\n"
+                  "k = 2147483647;\n"
+                  "f = 1.0;\n"
+                  "while (n > 0) {\n"
+                  "    y = k * 2;\n"
+                  "    f = f * 3.0;\n"
+                  "    print y;\n"
+                  "}\n"
+                  "print n;\n",
+                  2);
+
+    check_same_output("int arithmetic",
+                  "int i;\n"
+                  "int x;\n"
+                  "int y;\n"
+                  "i = 0;\n"
+                  "x = 5;\n"
+                  "while (i < 3) {\n"
+                  "    y = x * 2 + i;\n"
+                  "    print y;\n"
+                  "    i = i + 1;\n"
+                  "}\n",
+                  1);
+
+    // k * 2 overflows on the first iteration, before anything is printed, so
+    // computing it in the preheader reports the same error at the same line
+    check_same_output("int overflow before the first print",
+                  "int i;\n"
+                  "int k;\n"
+                  "int y;\n"
+                  "i = 0;\n"
+                  "k = 2147483647;\n"
+                  "print i;\n"
+                  "while (i < 3) {\n"
+                  "    y = i;\n"
+                  "    y = k * 2 + y;\n"
+                  "    print y;\n"
+                  "    i = i + 1;\n"
+                  "}\n",
+                  1);
+
+    // After a print, or behind an if, the overflow has to stay in the loop;
+    // i + 1 can fail before k * 2 is reached
+    check_same_output("int overflow after the prefix",
+                  "int i;\n"
+                  "int k;\n"
+                  "int y;\n"
+                  "i = 0;\n"
+                  "k = 2147483647;\n"
+                  "while (i < 3) {\n"
+                  "    print i;\n"
+                  "    y = k * 2;\n"
+                  "    i = i + 1;\n"
+                  "}\n"
+                  "while (i < 6) {\n"
+                  "    if (i > 4) {\n"
+                  "        y = k * 3;\n"
+                  "    }\n"
+                  "    y = (i + 1) + k * 4;\n"
+                  "    i = i + 1;\n"
+                  "}\n",
+                  0);
+
+    check_same_output("repeat-until",
+                  "int i;\n"
+                  "int a;\n"
+                  "int b;\n"
+                  "i = 0;\n"
+                  "a = 3;\n"
+                  "b = 4;\n"
+                  "repeat {\n"
+                  "    i = i + (2 * 3);\n"
+                  "    print i;\n"
+                  "} until (i > a * b);\n",
+                  -1);
+
+    // The inner blocks' declarations end with them: the loops see the outer
+    // variables, whatever type the inner ones had
+    check_same_output("nested scopes",
+                  "int x;\n"
+                  "int i;\n"
+                  "int j;\n"
+                  "float y;\n"
+                  "x = 3;\n"
+                  "i = 0;\n"
+                  "y = 0.5;\n"
+                  "if (x > 0) {\n"
+                  "    float x;\n"
+                  "    x = 2.5;\n"
+                  "    print x;\n"
+                  "}\n"
+                  "while (i < 3) {\n"
+                  "    j = 0;\n"
+                  "    while (j < 2) {\n"
+                  "        if (j > 0) {\n"
+                  "            float z;\n"
+                  "            z = y * 4.0 + 1.0;\n"
+                  "            print z;\n"
+                  "        }\n"
+                  "        print x / 2;\n"
+                  "        j = j + 1;\n"
+                  "    }\n"
+                  "    i = i + 1;\n"
+                  "}\n",
+                  -1);
+
+    check_same_output("brace-less loop body of an if",
+                  "int i;\n"
+                  "float f;\n"
+                  "i = 0;\n"
+                  "f = 2.0;\n"
+                  "if (i < 1)\n"
+                  "    while (i < 3) {\n"
+                  "        print f * f;\n"
+                  "        i = i + 1;\n"
+                  "    }\n",
+                  -1);
+
+    runtime_free_factorial_cache();
+    return test_result();
+}
@@ -0,0 +1,122 @@
+/* test_parallel.c */
+// Checking on several threads must be indistinguishable from checking
+// serially: same result, diagnostics in the same order, same annotations
+// and symbol ids, same symbols left in the table.
+#include "test.h"
+#include "parallel.h"
+#include "../bench/generator.h"
+
+typedef struct {
+    int result;
+    char* report;
+    ASTNode* program;
+    int symbols;
+    NodeTable nodes;    // hash-consed nodes, when sharing
+} Check;
+
+static int sharing = 0;
+
+static Check check(const char* source, int jobs) {
+    Check run;
+    node_table_init(&run.nodes);
+    if (sharing) parser_set_node_table(&run.nodes);
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    DiagnosticSession* previous = diag_begin(&session);
+    parser_init(source);
+    run.program = parse();
+    parser_set_node_table(NULL);
+    SymbolTable* table = init_symbol_table();
+    run.result = jobs > 1 ? check_program_parallel(run.program, table, jobs)
+                          : check_program(run.program, table);
+    run.symbols = table->symbol_count;
+    free_symbol_table(table);
+    diag_end(previous);
+    run.report = diagnostics_text(&session);
+    diag_session_free(&session);
+    return run;
+}
+
+static int same_annotations(const ASTNode* a, const ASTNode* b) {
+    for (; a && b; a = a->next, b = b->next) {
+        if (a->value_type != b->value_type || a->symbol_id != b->symbol_id) {
+            fprintf(stderr, "'%s' on line %d: type %d id %d vs type %d id %d\n",
+                    a->token.lexeme, a->token.line, a->value_type, a->symbol_id,
+                    b->value_type, b->symbol_id);
+            return 0;
+        }
+        if (!same_annotations(a->left, b->left) || !same_annotations(a->right, b->right)) return 0;
+    }
+    return a == b;
+}
+
+static void check_same(const char* source) {
+    Check serial = check(source, 1);
+    for (int jobs = 2; jobs <= 8; jobs *= 2) {
+        Check parallel = check(source, jobs);
+        CHECK(parallel.result == serial.result);
+        CHECK_STRING(parallel.report, serial.report);
+        CHECK(parallel.symbols == serial.symbols);
+        CHECK(same_annotations(parallel.program, serial.program));
+        free_ast(parallel.program);
+        node_table_free(&parallel.nodes);
+        free(parallel.report);
+    }
+    free_ast(serial.program);
+    node_table_free(&serial.nodes);
+    free(serial.report);
+}
+
+int main(void) {
+    for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+        GeneratorOptions options;
+        generator_default_options(&options, (GeneratorShape)shape);
+        options.statements = 300;
+        char* program = generate_program(&options, NULL);
+        CHECK(program != NULL);
+        if (program) check_same(program);
+        free(program);
+    }
+
+    // Errors in and around compound statements, declarations the later
+    // statements depend on, and shadowing inside bodies
+    check_same("int x;\n"
+               "int x;\n"
+               "x = 1;\n"
+               "if (x > 0) {\n"
+               "    int y;\n"
+               "    y = z;\n"
+               "    char x;\n"
+               "    x = \"a\" * 2;\n"
+               "}\n"
+               "while (x < 10) {\n"
+               "    int w;\n"
+               "    w = x + 1;\n"
+               "    x = w;\n"
+               "    repeat {\n"
+               "        print q;\n"
+               "    } until (w > 3);\n"
+               "}\n"
+               "int y;\n"
+               "y = x * 2;\n"
+               "if (\"s\") {\n"
+               "    y = 1;\n"
+               "}\n"
+               "repeat {\n"
+               "    y = y + 1;\n"
+               "} until (y < \"t\");\n"
+               "print factorial(y);\n");
+    // Shared expressions stay in the sequential pass
+    sharing = 1;
+    check_same("int x;\n"
+               "x = 0;\n"
+               "while (x < 1 + 2) {\n"
+               "    x = x + 2 * \"a\";\n"
+               "}\n"
+               "if (x > 1 + 2) {\n"
+               "    x = 2 * \"a\";\n"
+               "}\n");
+    sharing = 0;
+
+    return test_result();
+}
@@ -0,0 +1,98 @@
+/* test_relex.c */
+// After any edit, a TokenList must hold exactly the tokens that lexing the
+// new text from scratch gives, including the lexer state after each one,
+// while scanning only the tokens near the edit.
+#include "test.h"
+
+static int same_tokens(const TokenList* a, const TokenList* b) {
+    if (a->count != b->count) {
+        fprintf(stderr, "%d tokens vs %d\n", a->count, b->count);
+        return 0;
+    }
+    for (int i = 0; i < a->count; i++) {
+        const LexedToken* x = &a->tokens[i];
+        const LexedToken* y = &b->tokens[i];
+        if (x->type != y->type || x->error != y->error || x->start != y->start ||
+            x->end != y->end || x->line != y->line ||
+            x->after.line != y->after.line || x->after.mode != y->after.mode) {
+            fprintf(stderr, "token %d differs: [%d, %d) line %d vs [%d, %d) line %d\n",
+                    i, x->start, x->end, x->line, y->start, y->end, y->line);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Edit `list` and compare it with a list made from the new text
+static int check_edit(TokenList* list, int offset, int removed, const char* inserted) {
+    int scanned = token_list_edit(list, offset, removed, inserted);
+    CHECK(scanned >= 0);
+    TokenList expected;
+    CHECK(token_list_init(&expected, list->source));
+    CHECK(same_tokens(list, &expected));
+    token_list_free(&expected);
+    return scanned;
+}
+
+int main(void) {
+    const char* source = "int x;\n"
+                         "x = 12 + 3;\n"
+                         "/* a comment */\n"
+                         "char c;\n"
+                         "c = \"str\";\n"
+                         "// to the end of the line\n"
+                         "print x;\n";
+    TokenList list;
+    CHECK(token_list_init(&list, source));
+    CHECK(list.count == 19);
+    CHECK(list.tokens[list.count - 1].line == 7);
+
+    // One token changes; everything after it moves
+    CHECK(check_edit(&list, strstr(list.source, "12") - list.source, 2, "1234") == 1);
+    // Splitting a token in two
+    CHECK(check_edit(&list, strstr(list.source, "1234") - list.source + 2, 0, " ") == 2);
+    // Opening a comment swallows what follows until the old comment's end;
+    // closing it again brings the tokens back
+    int open = (int)(strstr(list.source, "+") - list.source);
+    check_edit(&list, open, 0, "/*");
+    CHECK(list.tokens[6].type == TOKEN_NUMBER && list.tokens[7].type == TOKEN_CHAR);
+    check_edit(&list, open, 2, "");
+    CHECK(list.count == 20);
+    // New lines shift every later line number
+    check_edit(&list, 0, 0, "\n\n");
+    CHECK(list.tokens[0].line == 3);
+    // A string left open, then closed
+    int quote = (int)(strstr(list.source, "\"str\"") - list.source);
+    check_edit(&list, quote + 4, 1, "");
+    check_edit(&list, quote + 4, 0, "\"");
+    // Bad ranges change nothing
+    CHECK(token_list_edit(&list, list.length + 1, 0, "x") == -1);
+    CHECK(token_list_edit(&list, 0, list.length + 1, "") == -1);
+    CHECK(token_list_edit(&list, -1, 0, "x") == -1);
+
+    // Down to nothing and back
+    CHECK(check_edit(&list, 0, list.length, "") == 0);
+    CHECK(list.count == 0);
+    CHECK(check_edit(&list, 0, 0, "int y;") == 3);
+    token_list_free(&list);
+
+    CHECK(token_list_init(&list, ""));
+    CHECK(check_edit(&list, 0, 0, "x") == 1);
+    token_list_free(&list);
+
+    // Random edits, heavy on comment and string delimiters
+    const char* pieces[] = { "x", "1", " ", "\n", ";", "/*", "*/", "//", "\"", "=", "1.5e3", "" };
+    int piece_count = (int)(sizeof(pieces) / sizeof(pieces[0]));
+    CHECK(token_list_init(&list, source));
+    unsigned seed = 2024;
+    for (int i = 0; i < 1000 && !test_failures; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int offset = (int)((seed >> 8) % (unsigned)(list.length + 1));
+        int removed = (int)((seed >> 4) % 3);
+        if (removed > list.length - offset) removed = list.length - offset;
+        check_edit(&list, offset, removed, pieces[(seed >> 16) % piece_count]);
+    }
+    token_list_free(&list);
+
+    return test_result();
+}
@@ -0,0 +1,72 @@
+/* test_runtime.c */
+// Factorials: the int version refuses to overflow, the table is exact to
+// 20!, and big factorials match known values whether they're built from
+// scratch, from a cached smaller one, or built again after eviction.
+#include "test.h"
+#include "runtime.h"
+
+// n! as a decimal string, malloc'd; NULL if it couldn't be computed
+static char* big_factorial(int n) {
+    const BigInt* value = runtime_factorial_big(n);
+    return value ? bigint_to_string(value) : NULL;
+}
+
+static void check_big(int n, const char* expected) {
+    char* text = big_factorial(n);
+    CHECK(text != NULL);
+    if (text) CHECK_STRING(text, expected);
+    free(text);
+}
+
+int main(void) {
+    int result = -1;
+    CHECK(runtime_factorial_int(0, &result) == RUNTIME_OK && result == 1);
+    CHECK(runtime_factorial_int(12, &result) == RUNTIME_OK && result == 479001600);
+    // 13! = 6227020800 doesn't fit; result keeps its last value
+    CHECK(runtime_factorial_int(13, &result) == RUNTIME_ERROR_INT_OVERFLOW);
+    CHECK(result == 479001600);
+    CHECK(runtime_factorial_int(100, &result) == RUNTIME_ERROR_INT_OVERFLOW);
+    CHECK(runtime_factorial_int(-1, &result) == RUNTIME_ERROR_NEGATIVE_ARGUMENT);
+
+    CHECK(runtime_factorial_u64(20) == 2432902008176640000ULL);
+    CHECK(runtime_factorial_u64(21) == 0);
+    CHECK(runtime_factorial_u64(-1) == 0);
+
+    CHECK(runtime_factorial_big(-1) == NULL);
+    check_big(0, "1");
+    check_big(20, "2432902008176640000");
+    // Just past the table, then from a cached smaller factorial
+    check_big(21, "51090942171709440000");
+    check_big(34, "295232799039604140847618609643520000000");
+    check_big(100, "93326215443944152681699238856266700490715968264381621468592963"
+                   "89521759999322991560894146397615651828625369792082722375825118"
+                   "5210916864000000000000000000000000");
+
+    // 1000! is long enough for Karatsuba multiplication: 2568 digits, 249
+    // of them trailing zeros
+    char* large = big_factorial(1000);
+    CHECK(large != NULL);
+    if (large) {
+        size_t length = strlen(large);
+        size_t zeros = 0;
+        while (zeros < length && large[length - 1 - zeros] == '0') zeros++;
+        CHECK(length == 2568);
+        CHECK(zeros == 249);
+        CHECK(strncmp(large, "40238726007709377354", 20) == 0);
+    }
+
+    // Fill the cache so 1000! is evicted, then build it again
+    for (int n = 1001; n < 1040; n++) CHECK(runtime_factorial_big(n) != NULL);
+    char* again = big_factorial(1000);
+    CHECK(again != NULL);
+    if (large && again) CHECK(strcmp(large, again) == 0);
+    free(large);
+    free(again);
+
+    // Nothing cached is needed to start over
+    runtime_free_factorial_cache();
+    check_big(25, "15511210043330985984000000");
+    runtime_free_factorial_cache();
+
+    return test_result();
+}
@@ -0,0 +1,171 @@
+/* test_server.c */
+// The JSON-RPC server, driven over its Unix socket: analyze requests get the
+// same diagnostics a direct analysis records, protocol errors get JSON-RPC
+// errors, notifications get nothing, and "shutdown" stops it. It runs with
+// several jobs and sharing on, and what it keeps between requests doesn't
+// change the next one's answer.
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "test.h"
+#include "server.h"
+#include "json.h"
+
+static char socket_path[64];
+static int server_result = -1;
+// One connection, read and written through separate streams
+static FILE* to_server;
+static FILE* from_server;
+
+static void* run_server(void* unused) {
+    (void)unused;
+    AnalysisOptions options;
+    analysis_default_options(&options);
+    options.jobs = 3;
+    options.hash_consing = 1;
+    server_result = server_run_socket(socket_path, &options);
+    return NULL;
+}
+
+static int connect_to_server(void) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    // The server thread may not be listening yet
+    for (int attempt = 0; attempt < 500; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return 0;
+        if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+            to_server = fdopen(dup(fd), "w");
+            from_server = fdopen(fd, "r");
+            return to_server && from_server;
+        }
+        close(fd);
+        usleep(10000);
+    }
+    return 0;
+}
+
+// Send one request line and parse the response line
+static JsonValue* call(const char* request) {
+    fprintf(to_server, "%s\n", request);
+    fflush(to_server);
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length = getline(&line, &capacity, from_server);
+    JsonValue* response = length > 0 ? json_parse(line, (size_t)length) : NULL;
+    free(line);
+    return response;
+}
+
+static double error_code(const JsonValue* response) {
+    const JsonValue* code = json_get(json_get(response, "error"), "code");
+    return code && code->type == JSON_NUMBER ? code->number : 0;
+}
+
+int main(void) {
+    snprintf(socket_path, sizeof(socket_path), "/tmp/test_server_%d.sock", (int)getpid());
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_server, NULL);
+    int connected = connect_to_server();
+    CHECK(connected);
+    if (!connected) return test_result();
+
+    JsonValue* response = call("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"analyze\","
+                        "\"params\":{\"text\":\"int x;\\nx = y;\\n\",\"name\":\"buf\"}}");
+    CHECK(response != NULL);
+    const JsonValue* result = json_get(response, "result");
+    CHECK(json_get(response, "id") && json_get(response, "id")->number == 1);
+    CHECK_STRING(json_get_string(result, "name"), "buf");
+    CHECK(json_get(result, "success") && !json_get(result, "success")->boolean);
+    const JsonValue* diagnostics = json_get(json_get(result, "diagnostics"), "diagnostics");
+    CHECK(diagnostics && diagnostics->count == 1);
+    if (diagnostics && diagnostics->count == 1) {
+        const JsonValue* d = &diagnostics->items[0];
+        CHECK_STRING(json_get_string(d, "message"), "Undeclared variable 'y'");
+        CHECK(json_get(d, "line")->number == 2 && json_get(d, "column")->number == 5);
+    }
+    json_free(response);
+
+    response = call("{\"jsonrpc\":\"2.0\",\"id\":\"two\",\"method\":\"analyze\","
+                    "\"params\":{\"text\":\"int x;\\nx = 1;\\n\"}}");
+    result = json_get(response, "result");
+    CHECK_STRING(json_get_string(response, "id"), "two");
+    CHECK_STRING(json_get_string(result, "name"), "<text>");
+    CHECK(json_get(result, "success") && json_get(result, "success")->boolean);
+    json_free(response);
+
+    // Statements checked on the worker threads (they have no literals, which
+    // would be shared), and shared expressions the first request leaves in
+    // the node table: the same answer twice
+    const char* loops = "{\"jsonrpc\":\"2.0\",\"id\":6,\"method\":\"analyze\",\"params\":{\"text\":"
+                        "\"int x;\\nint one;\\none = 1;\\nx = 1 + 2;\\n"
+                        "if (x > one) {\\n    x = y;\\n}\\n"
+                        "while (x < one) {\\n    x = x + one;\\n}\\n"
+                        "if (x > one) {\\n    print z;\\n}\\n\"}}";
+    for (int round = 0; round < 2; round++) {
+        response = call(loops);
+        result = json_get(response, "result");
+        CHECK(json_get(result, "success") && !json_get(result, "success")->boolean);
+        diagnostics = json_get(json_get(result, "diagnostics"), "diagnostics");
+        CHECK(diagnostics && diagnostics->count == 3);
+        if (diagnostics && diagnostics->count == 3) {
+            CHECK_STRING(json_get_string(&diagnostics->items[0], "message"), "Undeclared variable 'y'");
+            CHECK(json_get(&diagnostics->items[0], "line")->number == 6);
+            CHECK_STRING(json_get_string(&diagnostics->items[1], "message"), "Undeclared variable 'z'");
+            CHECK(json_get(&diagnostics->items[1], "line")->number == 12);
+            CHECK(json_get(&diagnostics->items[2], "line")->number == 12);
+        }
+        json_free(response);
+    }
+
+    // 200,000 terms would overflow the stack while being typed; the default
+    // depth limit stops the parser first
+    char* deep = malloc(400100);
+    int length = sprintf(deep, "{\"jsonrpc\":\"2.0\",\"id\":7,\"method\":\"analyze\","
+                               "\"params\":{\"text\":\"int x;\\nx = 1");
+    for (int i = 1; i < 200000; i++) length += sprintf(deep + length, "+1");
+    strcpy(deep + length, ";\\n\"}}");
+    response = call(deep);
+    free(deep);
+    result = json_get(response, "result");
+    CHECK(json_get(result, "success") && !json_get(result, "success")->boolean);
+    diagnostics = json_get(json_get(result, "diagnostics"), "diagnostics");
+    CHECK(diagnostics && diagnostics->count == 1);
+    if (diagnostics && diagnostics->count == 1) {
+        CHECK_STRING(json_get_string(&diagnostics->items[0], "phase"), "limit");
+        CHECK_STRING(json_get_string(&diagnostics->items[0], "message"), "Input nests deeper than 10000 levels");
+    }
+    json_free(response);
+
+    // A notification is answered by nothing, so the next line is the error
+    response = call("{\"jsonrpc\":\"2.0\",\"method\":\"analyze\",\"params\":{\"text\":\"int x;\"}}\n"
+                    "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"analyze\",\"params\":{}}");
+    CHECK(error_code(response) == -32602);
+    json_free(response);
+    response = call("{\"jsonrpc\":\"2.0\",\"id\":4,\"method\":\"format\"}");
+    CHECK(error_code(response) == -32601);
+    json_free(response);
+    response = call("{\"jsonrpc\":");
+    CHECK(error_code(response) == -32700);
+    json_free(response);
+
+    response = call("{\"jsonrpc\":\"2.0\",\"id\":5,\"method\":\"shutdown\"}");
+    CHECK(json_get(response, "result") && json_get(response, "result")->type == JSON_NULL);
+    json_free(response);
+    fclose(to_server);
+    fclose(from_server);
+    pthread_join(thread, NULL);
+    CHECK(server_result == 1);
+    CHECK(access(socket_path, F_OK) != 0);
+
+    // Socket paths must fit a sockaddr_un
+    char long_path[200];
+    memset(long_path, 'a', sizeof(long_path) - 1);
+    long_path[sizeof(long_path) - 1] = '\0';
+    CHECK(!server_run_socket(long_path, NULL));
+
+    return test_result();
+}
@@ -0,0 +1,102 @@
+/* test_sharing.c */
+// Hash-consing: repeats of a closed expression are one node, and checking
+// the DAG reports what checking the tree does. An ill-typed shared
+// expression is reported at every use, on the line of that use.
+#include "test.h"
+
+typedef struct {
+    int result;
+    int errors;
+    char* lines;        // the line of each diagnostic, comma-separated
+} Analysis;
+
+static Analysis analyze(const char* source, NodeTable* table) {
+    Analysis analysis;
+    DiagnosticSession session;
+    ASTNode* program;
+    parser_set_node_table(table);
+    analysis.result = analyze_source(source, &session, &program);
+    parser_set_node_table(NULL);
+    analysis.errors = session.error_count;
+    analysis.lines = calloc(1, 16 * (size_t)session.count + 1);
+    for (int i = 0; i < session.count; i++) {
+        sprintf(analysis.lines + strlen(analysis.lines), "%s%d", i ? "," : "", session.items[i].line);
+    }
+    free_ast(program);
+    diag_session_free(&session);
+    return analysis;
+}
+
+// Same result and errors, on the same lines, with and without sharing.
+// Returns how many nodes sharing reused.
+static long check_same(const char* source) {
+    NodeTable table;
+    node_table_init(&table);
+    Analysis shared = analyze(source, &table);
+    Analysis plain = analyze(source, NULL);
+    CHECK(shared.result == plain.result);
+    CHECK(shared.errors == plain.errors);
+    CHECK_STRING(shared.lines, plain.lines);
+    long reused = table.reused;
+    node_table_free(&table);
+    free(shared.lines);
+    free(plain.lines);
+    return reused;
+}
+
+int main(void) {
+    // The same ill-typed expression, used three times
+    CHECK(check_same("int x;\n"
+                     "x = 2 * \"a\";\n"
+                     "x = 2 * \"a\";\n"
+                     "if (x > 0) {\n"
+                     "    x = 2 * \"a\";\n"
+                     "}\n") == 6);
+    // Inside larger expressions, shared and not, and in conditions
+    CHECK(check_same("int x;\n"
+                     "float f;\n"
+                     "x = 1;\n"
+                     "x = x + 2 * \"a\";\n"
+                     "f = 2.5 * \"a\" + 1;\n"
+                     "f = 2.5 * \"a\" + 1;\n"
+                     "while (\"b\" < 2 * \"a\") {\n"
+                     "    x = x + 1;\n"
+                     "}\n"
+                     "print factorial(2.5 * \"a\");\n") > 0);
+    // Well-typed repeats still check once and pass
+    CHECK(check_same("int x;\n"
+                     "float f;\n"
+                     "x = 1 + 2 * 3;\n"
+                     "x = 1 + 2 * 3;\n"
+                     "f = 1 + 2 * 3.5;\n"
+                     "f = 1 + 2 * 3.5;\n") > 0);
+
+    // Each use is reported on its own line
+    NodeTable table;
+    node_table_init(&table);
+    Analysis analysis = analyze("int x;\n"
+                                "x = 2 * \"a\";\n"
+                                "x = 2 * \"a\";\n", &table);
+    CHECK(analysis.errors == 2);
+    CHECK_STRING(analysis.lines, "2,3");
+    free(analysis.lines);
+    node_table_free(&table);
+
+    // A valid shared node is annotated once, for every use
+    node_table_init(&table);
+    parser_set_node_table(&table);
+    DiagnosticSession session;
+    ASTNode* program;
+    CHECK(analyze_source("float f;\n"
+                         "f = 1 + 2.5;\n"
+                         "f = 1 + 2.5;\n", &session, &program));
+    parser_set_node_table(NULL);
+    ASTNode* first = program->next->next;
+    CHECK(first->right == first->next->right);
+    CHECK(first->right->shared && first->right->value_type == TOKEN_FLOAT);
+    free_ast(program);
+    diag_session_free(&session);
+    node_table_free(&table);
+
+    return test_result();
+}
@@ -0,0 +1,62 @@
+/* test_stats.c */
+// Instrumentation counters (built with -DANALYZER_STATS, see
+// test_stats.flags): what one small program adds to each of them.
+#include "test.h"
+#include "stats.h"
+
+int main(void) {
+    CHECK(stats_enabled());
+    stats_reset();
+
+    DiagnosticSession session;
+    ASTNode* program;
+    CHECK(analyze_source("int x;\n"
+                         "x = 1 + 2;\n"
+                         "if (x > 2) {\n"
+                         "    int y;\n"
+                         "    y = x;\n"
+                         "}\n", &session, &program));
+    free_ast(program);
+    diag_session_free(&session);
+
+    AnalyzerStats* stats = stats_current();
+    CHECK(stats->tokens[TOKEN_INT] == 2);
+    CHECK(stats->tokens[TOKEN_IDENTIFIER] == 6);
+    CHECK(stats->tokens[TOKEN_NUMBER] == 3);
+    CHECK(stats->tokens[TOKEN_SEMICOLON] == 4);
+    CHECK(stats->tokens[TOKEN_IF] == 1);
+    CHECK(stats->tokens[TOKEN_LBRACE] == 1 && stats->tokens[TOKEN_RBRACE] == 1);
+    CHECK(stats->tokens[TOKEN_ERROR] == 0);
+    CHECK(stats->nodes_created > 0);
+    CHECK(stats->node_bytes >= stats->nodes_created * sizeof(ASTNode));
+    CHECK(stats->nodes_shared == 0);
+    CHECK(stats->scopes_entered == 1);
+    // Every use and assignment of x and y resolves a name; the checks that
+    // a declaration is new compare nothing
+    CHECK(stats->symbol_lookups >= 4);
+    CHECK(stats->lookup_steps > 0 && stats->lookup_steps <= stats->symbol_lookups);
+
+    // Totals across workers
+    AnalyzerStats total = *stats;
+    stats_merge(&total, stats);
+    CHECK(total.tokens[TOKEN_IDENTIFIER] == 12);
+    CHECK(total.nodes_created == 2 * stats->nodes_created);
+    CHECK(total.scopes_entered == 2);
+
+    char* json = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&json, &length);
+    stats_write(stats, STATS_FORMAT_JSON, out);
+    fclose(out);
+    CHECK(strncmp(json, "{\"enabled\":true,\"tokens\":{", 26) == 0);
+    CHECK(strstr(json, "\"IDENTIFIER\":6") != NULL);
+    CHECK(strstr(json, "\"scopes_entered\":1,") != NULL);
+    // Every phase is listed, run or not
+    CHECK(strstr(json, "\"optimize\":0.000000000,\"codegen\":0.000000000}") != NULL);
+    free(json);
+
+    stats_reset();
+    CHECK(stats->nodes_created == 0 && stats->tokens[TOKEN_INT] == 0);
+
+    return test_result();
+}
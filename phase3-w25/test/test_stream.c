@@ -0,0 +1,113 @@
+/* test_stream.c */
+// The streaming lexer, reading through a small buffer, must give the tokens
+// lexing the whole text at once gives: tokens and comments that straddle a
+// refill are scanned again, not split. parse_stream() must accept what
+// parse() accepts and count the same statements.
+#include <unistd.h>
+#include "test.h"
+#include "../bench/generator.h"
+
+// A file holding `text`, opened for reading and already unlinked
+static int file_with(const char* text) {
+    char path[] = "/tmp/test_stream_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return -1;
+    unlink(path);
+    size_t length = strlen(text);
+    if (write(fd, text, length) != (ssize_t)length) {
+        close(fd);
+        return -1;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+static void check_tokens(const char* text, int chunk_size) {
+    int fd = file_with(text);
+    CHECK(fd >= 0);
+    LexerStream stream;
+    CHECK(lexer_stream_open(&stream, fd, chunk_size));
+
+    lexer_reset();
+    int pos = 0;
+    long count = 0;
+    for (;;) {
+        Token expected = get_next_token(text, &pos);
+        Token token = lexer_stream_next(&stream);
+        if (token.type != expected.type || token.line != expected.line ||
+            token.offset != expected.offset || token.error != expected.error ||
+            strcmp(token.lexeme, expected.lexeme) != 0) {
+            fprintf(stderr, "token %ld: '%s' line %d offset %d, expected '%s' line %d offset %d\n",
+                    count, token.lexeme, token.line, token.offset,
+                    expected.lexeme, expected.line, expected.offset);
+            test_failures++;
+            break;
+        }
+        if (token.type == TOKEN_EOF) break;
+        count++;
+    }
+    CHECK(!stream.read_error);
+    lexer_stream_close(&stream);
+    close(fd);
+}
+
+// parse_stream() on `text`, quietly
+static long stream_statements(const char* text) {
+    int fd = file_with(text);
+    LexerStream stream;
+    CHECK(fd >= 0 && lexer_stream_open(&stream, fd, 1024));
+    DiagnosticSession session;
+    diag_session_init(&session, NULL);
+    session.enabled = 0;
+    DiagnosticSession* previous = diag_begin(&session);
+    long statements = parse_stream(&stream);
+    diag_end(previous);
+    lexer_stream_close(&stream);
+    close(fd);
+    return statements;
+}
+
+int main(void) {
+    // Big enough for dozens of refills at the smallest chunk size
+    for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+        GeneratorOptions options;
+        generator_default_options(&options, (GeneratorShape)shape);
+        options.statements = 300;
+        char* program = generate_program(&options, NULL);
+        CHECK(program != NULL);
+        if (!program) continue;
+        check_tokens(program, 1024);
+
+        ASTNode* tree = NULL;
+        DiagnosticSession session;
+        CHECK(analyze_source(program, &session, &tree));
+        long statements = 0;
+        for (ASTNode* statement = tree ? tree->next : NULL; statement; statement = statement->next) {
+            statements++;
+        }
+        CHECK(stream_statements(program) == statements);
+        free_ast(tree);
+        diag_session_free(&session);
+        free(program);
+    }
+
+    // A string that straddles the first refill, and a comment longer than
+    // the buffer
+    char* text = malloc(8000);
+    memset(text, ' ', 900);
+    strcpy(text + 900, "x = \"");
+    memset(text + 905, 'a', 250);
+    strcpy(text + 1155, "\";\n/*");
+    memset(text + 1160, '\n', 3000);
+    strcpy(text + 4160, "*/ print x; // the end");
+    check_tokens(text, 1024);
+    CHECK(stream_statements(text) == 2);
+    free(text);
+
+    // Lexical errors come through the same way; a syntax error stops parsing
+    check_tokens("int x; x = 1 @ 2;\n\"open\nx = 12345678901234;", 1024);
+    CHECK(stream_statements("int x;\nx = ;\n") == -1);
+    CHECK(stream_statements("") == 0);
+
+    return test_result();
+}
@@ -0,0 +1,67 @@
+/* test_string_pool.c */
+// Interning: equal literals share one id, ids are dense in order of first
+// appearance, and the data block holds each literal once, NUL-terminated,
+// across any number of table and block resizes.
+#include "test.h"
+
+int main(void) {
+    StringPool pool;
+    string_pool_init(&pool);
+    CHECK(pool.count == 0);
+
+    int hello = string_pool_intern(&pool, "hello", 5);
+    int world = string_pool_intern(&pool, "world", 5);
+    CHECK(hello == 0 && world == 1);
+    CHECK(string_pool_intern(&pool, "hello", 5) == hello);
+    // Only `length` bytes count
+    CHECK(string_pool_intern(&pool, "hello there", 5) == hello);
+    int empty = string_pool_intern(&pool, "", 0);
+    CHECK(empty == 2 && string_pool_intern(&pool, "", 0) == empty);
+    CHECK_STRING(string_pool_get(&pool, empty), "");
+    // A literal with an embedded NUL is its own entry
+    int embedded = string_pool_intern(&pool, "a\0b", 3);
+    CHECK(embedded == 3 && string_pool_length(&pool, embedded) == 3);
+    CHECK(memcmp(string_pool_get(&pool, embedded), "a\0b", 4) == 0);
+    CHECK(pool.size == 6 + 6 + 1 + 4);
+
+    // Enough literals to grow everything several times
+    char text[32];
+    for (int i = 0; i < 5000; i++) {
+        int length = sprintf(text, "literal %d", i);
+        CHECK(string_pool_intern(&pool, text, length) == 4 + i);
+    }
+    CHECK(pool.count == 5004);
+    CHECK(pool.slot_count >= 2 * pool.count);
+    for (int i = 0; i < 5000; i += 7) {
+        int length = sprintf(text, "literal %d", i);
+        CHECK(string_pool_intern(&pool, text, length) == 4 + i);
+        CHECK_STRING(string_pool_get(&pool, 4 + i), text);
+        CHECK(string_pool_length(&pool, 4 + i) == length);
+        CHECK(pool.data + pool.offsets[4 + i] == string_pool_get(&pool, 4 + i));
+    }
+    CHECK(pool.count == 5004);
+    CHECK_STRING(string_pool_get(&pool, hello), "hello");
+    string_pool_free(&pool);
+
+    // The parser interns every literal of a program, once each
+    string_pool_init(&pool);
+    parser_set_string_pool(&pool);
+    DiagnosticSession session;
+    ASTNode* program;
+    CHECK(analyze_source("char a;\n"
+                         "char b;\n"
+                         "a = \"x\";\n"
+                         "b = \"y\";\n"
+                         "a = \"x\";\n", &session, &program));
+    parser_set_string_pool(NULL);
+    CHECK(pool.count == 2);
+    ASTNode* first = program->next->next->next;
+    CHECK(first->right->string_id == 0);
+    CHECK(first->next->right->string_id == 1);
+    CHECK(first->next->next->right->string_id == 0);
+    free_ast(program);
+    diag_session_free(&session);
+    string_pool_free(&pool);
+
+    return test_result();
+}
@@ -0,0 +1,188 @@
+/* test_symbol_table.c */
+// The persistent symbol table: lookups find the newest symbol of a name,
+// snapshots are independent of the table they were taken from, and every
+// map node is released once the last version holding it is.
+#include <pthread.h>
+#include "test.h"
+#include "allocator.h"
+
+#define SYMBOLS 5000
+#define THREADS 4
+
+static int visited;
+
+static void count_entry(void* context, const SymbolMapNode* entry) {
+    (void)context;
+    (void)entry;
+    visited++;
+}
+
+// Symbols added to `copy` since it was taken from a table whose newest
+// symbol was `base`. They belong to the snapshot's owner.
+static void free_added(SymbolTable* copy, Symbol* base) {
+    while (copy->head != base) {
+        Symbol* next = copy->head->next;
+        mem_free(MEM_SYMBOLS, copy->head);
+        copy->head = next;
+    }
+    symbol_table_release(copy);
+}
+
+// Each thread declares and assigns its own names into a snapshot of the
+// shared table, and reads the shared ones
+static SymbolTable* shared_table;
+
+static void* declare_in_snapshot(void* arg) {
+    int thread = *(int*)arg;
+    SymbolTable copy;
+    symbol_table_snapshot(&copy, shared_table);
+    Symbol* base = copy.head;
+    char name[32];
+    int failures = 0;
+    for (int i = 0; i < 500; i++) {
+        sprintf(name, "t%d_%d", thread, i);
+        add_symbol(&copy, name, TOKEN_INT, i);
+        initialize_symbol(&copy, name);
+        sprintf(name, "s%d", i * 7 % 1000);
+        Symbol* symbol = lookup_symbol(&copy, name);
+        if (!symbol || symbol->id != i * 7 % 1000) failures++;
+    }
+    for (int i = 0; i < 500; i++) {
+        sprintf(name, "t%d_%d", thread, i);
+        if (!is_initialized(&copy, name)) failures++;
+    }
+    free_added(&copy, base);
+    return failures ? arg : NULL;
+}
+
+int main(void) {
+    mem_set_allocator(mem_tracking_allocator());
+
+    // Lookups, shadowing and removal
+    SymbolTable* table = init_symbol_table();
+    add_symbol(table, "x", TOKEN_INT, 1);
+    enter_scope(table);
+    add_symbol(table, "x", TOKEN_CHAR, 2);
+    add_symbol(table, "y", TOKEN_INT, 3);
+    Symbol* inner = lookup_symbol(table, "x");
+    CHECK(inner && inner->type == TOKEN_CHAR && inner->scope_level == 1 && inner->id == 1);
+    CHECK(lookup_symbol(table, "z") == NULL);
+    initialize_symbol(table, "x");
+    CHECK(is_initialized(table, "x") && !is_initialized(table, "y"));
+    remove_symbols_in_current_scope(table);
+    CHECK(lookup_symbol(table, "y") != NULL);
+    exit_scope(table);
+    remove_symbols_in_current_scope(table);
+    Symbol* outer = lookup_symbol(table, "x");
+    CHECK(outer && outer->type == TOKEN_INT && outer->id == 0);
+    CHECK(lookup_symbol(table, "y") == NULL);
+    // Initialization belongs to a symbol, not to its name
+    CHECK(!is_initialized(table, "x"));
+    remove_symbol(table, "x");
+    CHECK(lookup_symbol(table, "x") == NULL && table->head == NULL);
+    CHECK(table->symbol_count == 3);
+    free_symbol_table(table);
+    CHECK(mem_usage(MEM_SYMBOLS).live_blocks == 0);
+
+    // Enough names to fill several levels of the map
+    table = init_symbol_table();
+    char name[32];
+    for (int i = 0; i < SYMBOLS; i++) {
+        sprintf(name, "s%d", i);
+        add_symbol(table, name, TOKEN_INT, i);
+    }
+    for (int i = 0; i < SYMBOLS; i++) {
+        sprintf(name, "s%d", i);
+        Symbol* symbol = lookup_symbol(table, name);
+        CHECK(symbol && symbol->id == i && symbol->line_declared == i);
+    }
+    initialize_symbol(table, "s10");
+
+    // A snapshot and the table move on separately
+    SymbolTable copy;
+    symbol_table_snapshot(&copy, table);
+    Symbol* base = copy.head;
+    add_symbol(&copy, "only_copy", TOKEN_INT, 0);
+    add_symbol(&copy, "s20", TOKEN_CHAR, 0);
+    initialize_symbol(&copy, "s30");
+    add_symbol(table, "only_table", TOKEN_INT, 0);
+    initialize_symbol(table, "s40");
+    CHECK(lookup_symbol(&copy, "only_copy") && !lookup_symbol(table, "only_copy"));
+    CHECK(lookup_symbol(table, "only_table") && !lookup_symbol(&copy, "only_table"));
+    CHECK(lookup_symbol(&copy, "s20")->type == TOKEN_CHAR);
+    CHECK(lookup_symbol(table, "s20")->type == TOKEN_INT);
+    CHECK(is_initialized(&copy, "s10") && is_initialized(table, "s10"));
+    CHECK(is_initialized(&copy, "s30") && !is_initialized(table, "s30"));
+    CHECK(is_initialized(table, "s40") && !is_initialized(&copy, "s40"));
+    // Ids go on from where the snapshot was taken, on both sides
+    CHECK(lookup_symbol(&copy, "only_copy")->id == lookup_symbol(table, "only_table")->id);
+    CHECK(copy.symbol_count == SYMBOLS + 2 && table->symbol_count == SYMBOLS + 1);
+
+    // The diff of two versions is what was added in between
+    visited = 0;
+    SymbolTable later;
+    symbol_table_snapshot(&later, &copy);
+    add_symbol(&later, "a", TOKEN_INT, 0);
+    add_symbol(&later, "b", TOKEN_INT, 0);
+    symbol_map_diff(later.names, copy.names, count_entry, NULL);
+    CHECK(visited == 2);
+    visited = 0;
+    symbol_map_diff(copy.names, copy.names, count_entry, NULL);
+    CHECK(visited == 0);
+    free_added(&later, copy.head);
+    free_added(&copy, base);
+
+    // Snapshots taken and added to on several threads at once
+    shared_table = table;
+    pthread_t threads[THREADS];
+    int ids[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+        ids[i] = i;
+        pthread_create(&threads[i], NULL, declare_in_snapshot, &ids[i]);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        void* failed;
+        pthread_join(threads[i], &failed);
+        CHECK(failed == NULL);
+    }
+    CHECK(lookup_symbol(table, "t0_0") == NULL);
+    free_symbol_table(table);
+    CHECK(mem_usage(MEM_SYMBOLS).live_blocks == 0);
+
+    // The map itself: entries under one key stack up, newest first, and
+    // older versions keep what they had
+    int symbols[4];
+    SymbolMapNode* versions[4];
+    SymbolMapNode* map = NULL;
+    for (int i = 0; i < 4; i++) {
+        versions[i] = symbol_map_add(map, 42, (Symbol*)&symbols[i]);
+        symbol_map_release(map);
+        map = symbol_map_retain(versions[i]);
+    }
+    const SymbolMapNode* entry = symbol_map_find(map, 42);
+    for (int i = 3; i >= 0; i--, entry = entry ? entry->older : NULL) {
+        CHECK(entry && entry->symbol == (Symbol*)&symbols[i]);
+    }
+    CHECK(entry == NULL);
+    CHECK(symbol_map_find(versions[0], 42)->older == NULL);
+    CHECK(symbol_map_find(map, 43) == NULL && symbol_map_find(NULL, 42) == NULL);
+    // Keys that agree in their low bits end up in the same branches
+    SymbolMapNode* wide = symbol_map_retain(map);
+    for (unsigned i = 1; i <= 64; i++) {
+        SymbolMapNode* next = symbol_map_add(wide, 42 + (i << 20), (Symbol*)&symbols[i % 4]);
+        symbol_map_release(wide);
+        wide = next;
+    }
+    for (unsigned i = 1; i <= 64; i++) {
+        entry = symbol_map_find(wide, 42 + (i << 20));
+        CHECK(entry && entry->symbol == (Symbol*)&symbols[i % 4] && entry->older == NULL);
+        CHECK(symbol_map_find(map, 42 + (i << 20)) == NULL);
+    }
+    CHECK(symbol_map_find(wide, 42)->symbol == (Symbol*)&symbols[3]);
+    symbol_map_release(wide);
+    for (int i = 0; i < 4; i++) symbol_map_release(versions[i]);
+    symbol_map_release(map);
+    CHECK(mem_usage(MEM_SYMBOLS).live_blocks == 0);
+
+    return test_result();
+}
@@ -0,0 +1,185 @@
+/* test_token_dump.c */
+// Token dumps: reading one back gives exactly the tokens the lexer produced,
+// with their spans and lines, and the reader rejects malformed headers and
+// records with the reason.
+#include <unistd.h>
+#include "test.h"
+#include "token_dump.h"
+#include "../bench/generator.h"
+
+// Whether the dump of `source` decodes to what get_next_token() returns
+static void check_round_trip(const char* source) {
+    TokenDump dump;
+    CHECK(token_dump_build(&dump, source));
+    TokenDumpReader reader;
+    const char* error = NULL;
+    CHECK(token_dump_open_memory(&reader, dump.data, dump.size, &error));
+    CHECK(reader.count == dump.count);
+    CHECK(reader.source_length == strlen(source));
+    CHECK(reader.source_hash == token_dump_hash(source, strlen(source)));
+
+    lexer_reset();
+    int pos = 0;
+    uint32_t count = 0;
+    DumpedToken dumped;
+    for (Token token = get_next_token(source, &pos); token.type != TOKEN_EOF;
+         token = get_next_token(source, &pos)) {
+        if (!token_dump_next(&reader, &dumped)) {
+            fprintf(stderr, "token %u missing: %s\n", count, reader.error ? reader.error : "end");
+            test_failures++;
+            break;
+        }
+        if (dumped.type != token.type || dumped.error != token.error || dumped.start != token.offset ||
+            dumped.end != pos || dumped.line != token.line) {
+            fprintf(stderr, "token %u '%s' at %d-%d line %d, dump says %d-%d line %d\n", count,
+                    token.lexeme, token.offset, pos, token.line, dumped.start, dumped.end, dumped.line);
+            test_failures++;
+            break;
+        }
+        count++;
+    }
+    CHECK(count == dump.count);
+    CHECK(!token_dump_next(&reader, &dumped) && reader.error == NULL);
+    // About 4 bytes a token
+    CHECK(dump.size <= TOKEN_DUMP_HEADER_SIZE + 5 * (size_t)dump.count);
+    token_dump_close(&reader);
+    token_dump_free(&dump);
+}
+
+static void put_u32(unsigned char* at, uint32_t value) {
+    for (int i = 0; i < 4; i++) at[i] = (unsigned char)(value >> (8 * i));
+}
+
+// A dump with the given header fields around `records`. 8 bytes aligned,
+// like a mapping.
+static unsigned char* make_dump(uint32_t count, uint32_t source_length,
+                                const unsigned char* records, size_t size) {
+    static uint64_t buffer[64];
+    unsigned char* data = (unsigned char*)buffer;
+    put_u32(data, TOKEN_DUMP_MAGIC);
+    put_u32(data + 4, TOKEN_DUMP_VERSION);
+    put_u32(data + 8, count);
+    put_u32(data + 12, source_length);
+    put_u32(data + 16, 0);
+    put_u32(data + 20, (uint32_t)size);
+    memcpy(data + TOKEN_DUMP_HEADER_SIZE, records, size);
+    return data;
+}
+
+static void check_header_rejected(const unsigned char* data, size_t size, const char* expected) {
+    TokenDumpReader reader;
+    const char* error = NULL;
+    CHECK(!token_dump_open_memory(&reader, data, size, &error));
+    CHECK_STRING(error ? error : "(opened)", expected);
+}
+
+// Opens, then fails on record `bad` (counting from 0) with `expected`
+static void check_record_rejected(uint32_t count, uint32_t source_length, const unsigned char* records,
+                                  size_t size, uint32_t bad, const char* expected) {
+    unsigned char* data = make_dump(count, source_length, records, size);
+    TokenDumpReader reader;
+    const char* error = NULL;
+    CHECK(token_dump_open_memory(&reader, data, TOKEN_DUMP_HEADER_SIZE + size, &error));
+    DumpedToken token;
+    uint32_t decoded = 0;
+    while (token_dump_next(&reader, &token)) decoded++;
+    CHECK(decoded == bad);
+    CHECK_STRING(reader.error ? reader.error : "(read)", expected);
+    // It stays failed
+    CHECK(!token_dump_next(&reader, &token));
+    token_dump_close(&reader);
+}
+
+int main(void) {
+    check_round_trip("");
+    check_round_trip("int x;\nx = 42;\nprint x;\n");
+    // Lexical errors, comments, strings and blank lines between tokens
+    check_round_trip("int x; // comment\n"
+                     "/* block\n"
+                     "   comment */ x = 99999999999 + 12ab;\n"
+                     "\n\n"
+                     "char c; c = \"two\\nlines\";\n"
+                     "float f; f = 1e999 * 2.5;\n"
+                     "x = 1 @ 2; \"unterminated\n");
+    for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+        GeneratorOptions options;
+        generator_default_options(&options, (GeneratorShape)shape);
+        options.statements = 500;
+        char* program = generate_program(&options, NULL);
+        CHECK(program != NULL);
+        if (program) check_round_trip(program);
+        free(program);
+    }
+
+    // Written out and mapped back in
+    const char* source = "int x;\nx = 1 + 2;\n";
+    TokenDump dump;
+    CHECK(token_dump_build(&dump, source));
+    CHECK(dump.count == 9);
+    char path[] = "/tmp/test_token_dumpXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    CHECK(token_dump_write_file(&dump, path));
+    TokenDumpReader reader;
+    const char* error = NULL;
+    CHECK(token_dump_open_file(&reader, path, &error));
+    CHECK(reader.mapping != NULL && reader.count == 9);
+    DumpedToken token;
+    int count = 0;
+    while (token_dump_next(&reader, &token)) {
+        if (count == 0) CHECK(token.type == TOKEN_INT && token.start == 0 && token.end == 3);
+        if (count == 8) CHECK(token.type == TOKEN_SEMICOLON && token.line == 2 && token.end == 17);
+        count++;
+    }
+    CHECK(count == 9 && reader.error == NULL);
+    token_dump_close(&reader);
+    unlink(path);
+    CHECK(!token_dump_open_file(&reader, path, &error));
+    CHECK_STRING(error, "could not open the file");
+
+    // Malformed headers
+    unsigned char* data = malloc(dump.size);
+    memcpy(data, dump.data, dump.size);
+    check_header_rejected(data, TOKEN_DUMP_HEADER_SIZE - 1, "not a token dump");
+    data[0] ^= 1;
+    check_header_rejected(data, dump.size, "not a token dump");
+    data[0] ^= 1;
+    data[4]++;
+    check_header_rejected(data, dump.size, "unsupported version");
+    data[4]--;
+    check_header_rejected(data, dump.size - 1, "record section out of bounds");
+    put_u32(data + 12, 0x80000000u);
+    check_header_rejected(data, dump.size, "source too long");
+    put_u32(data + 12, (uint32_t)strlen(source));
+    put_u32(data + 8, (uint32_t)(dump.size - TOKEN_DUMP_HEADER_SIZE) / 4 + 1);
+    check_header_rejected(data, dump.size, "token count out of range");
+    free(data);
+    token_dump_free(&dump);
+
+    // Malformed records. Each is kind, gap, length, lines.
+    const unsigned char good[] = {TOKEN_INT, 0, 3, 0, TOKEN_IDENTIFIER, 1, 1, 0};
+    check_record_rejected(2, 5, good, sizeof(good), 2, "(read)");
+    check_record_rejected(1, 5, good, sizeof(good), 1, "trailing bytes after the last token");
+    // The last varint goes on past the end
+    const unsigned char cut[] = {TOKEN_INT, 0, 3, 0, TOKEN_IDENTIFIER, 1, 1, 0x80};
+    check_record_rejected(2, 5, cut, sizeof(cut), 1, "truncated record");
+    // A varint that doesn't fit 32 bits
+    const unsigned char wide[] = {TOKEN_INT, 0, 0xff, 0xff, 0xff, 0xff, 0x7f, 0};
+    check_record_rejected(1, 5, wide, sizeof(wide), 0, "truncated record");
+    const unsigned char eof[] = {TOKEN_EOF, 0, 0, 0};
+    check_record_rejected(1, 5, eof, sizeof(eof), 0, "unknown token kind");
+    const unsigned char type[] = {TOKEN_ERROR + 1, 0, 1, 0};
+    check_record_rejected(1, 5, type, sizeof(type), 0, "unknown token kind");
+    const unsigned char kind_error[] = {0x80 | TOKEN_NUMBER, 0x7f, 0, 1, 0};
+    check_record_rejected(1, 5, kind_error, sizeof(kind_error), 0, "unknown token kind");
+    // Spans past the source: 3 + 1 + 2 > 5
+    const unsigned char span[] = {TOKEN_INT, 0, 3, 0, TOKEN_IDENTIFIER, 1, 2, 0};
+    check_record_rejected(2, 5, span, sizeof(span), 1, "token span out of bounds");
+    const unsigned char gap[] = {TOKEN_INT, 6, 0, 0};
+    check_record_rejected(1, 5, gap, sizeof(gap), 0, "token span out of bounds");
+    const unsigned char lines[] = {TOKEN_INT, 0, 1, 0xff, 0xff, 0xff, 0xff, 0x07};
+    check_record_rejected(1, 5, lines, sizeof(lines), 0, "line out of range");
+
+    return test_result();
+}
@@ -0,0 +1,150 @@
+/* test_trace.c */
+// Trace files are Chrome trace-event JSON: nested spans nest in time, every
+// thread gets its own track, and nothing is recorded without an open trace.
+// A parallel check shows each deferred statement on the worker that checked it.
+#include <pthread.h>
+#include <unistd.h>
+#include "test.h"
+#include "trace.h"
+#include "json.h"
+#include "parallel.h"
+
+static void* worker(void* unused) {
+    (void)unused;
+    trace_thread_name("worker \"1\"");
+    TraceSpan span;
+    trace_span_begin(&span, "work", "phase");
+    trace_span_end(&span, NULL);
+    return NULL;
+}
+
+// The event named `name`, NULL if there isn't exactly one
+static const JsonValue* event_named(const JsonValue* events, const char* name) {
+    const JsonValue* found = NULL;
+    for (int i = 0; i < events->count; i++) {
+        const char* event_name = json_get_string(&events->items[i], "name");
+        if (!event_name || strcmp(event_name, name) != 0) continue;
+        if (found) return NULL;
+        found = &events->items[i];
+    }
+    return found;
+}
+
+static double number(const JsonValue* event, const char* key) {
+    const JsonValue* value = json_get(event, key);
+    return value && value->type == JSON_NUMBER ? value->number : -1;
+}
+
+int main(void) {
+    char path[] = "/tmp/test_trace_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return test_result();
+    close(fd);
+
+    // Not recording yet
+    TraceSpan ignored;
+    trace_span_begin(&ignored, "ignored", "phase");
+    trace_span_end(&ignored, "nothing");
+    CHECK(!trace_enabled());
+
+    CHECK(trace_open(path));
+    CHECK(trace_enabled());
+    TraceSpan outer, inner;
+    trace_span_begin(&outer, "file", "file");
+    trace_span_begin(&inner, "parse", "phase");
+    DiagnosticSession session;
+    ASTNode* program;
+    analyze_source("int x;\nx = 1;\n", &session, &program);
+    free_ast(program);
+    diag_session_free(&session);
+    trace_span_end(&inner, NULL);
+    trace_span_end(&outer, "input \"a\".txt");
+    pthread_t thread;
+    pthread_create(&thread, NULL, worker, NULL);
+    pthread_join(thread, NULL);
+    CHECK(trace_close());
+    CHECK(!trace_enabled());
+
+    FILE* file = fopen(path, "r");
+    char text[8192];
+    size_t length = file ? fread(text, 1, sizeof(text), file) : 0;
+    if (file) fclose(file);
+    unlink(path);
+    JsonValue* trace = json_parse(text, length);
+    CHECK(trace != NULL);
+    if (!trace) return test_result();
+    const JsonValue* events = json_get(trace, "traceEvents");
+    CHECK(events && events->type == JSON_ARRAY && events->count == 4);
+    CHECK(event_named(events, "ignored") == NULL);
+
+    const JsonValue* file_event = event_named(events, "file");
+    const JsonValue* parse_event = event_named(events, "parse");
+    const JsonValue* work_event = event_named(events, "work");
+    const JsonValue* thread_event = event_named(events, "thread_name");
+    CHECK(file_event && parse_event && work_event && thread_event);
+    if (file_event && parse_event && work_event && thread_event) {
+        CHECK_STRING(json_get_string(file_event, "ph"), "X");
+        CHECK_STRING(json_get_string(file_event, "cat"), "file");
+        CHECK_STRING(json_get_string(json_get(file_event, "args"), "detail"), "input \"a\".txt");
+        CHECK(json_get(parse_event, "args") == NULL);
+        // The parse span lies inside the file span
+        CHECK(number(parse_event, "ts") >= number(file_event, "ts"));
+        CHECK(number(parse_event, "ts") + number(parse_event, "dur") <=
+              number(file_event, "ts") + number(file_event, "dur"));
+
+        // The worker thread has a track of its own, with its name
+        CHECK(number(work_event, "tid") != number(file_event, "tid"));
+        CHECK(number(thread_event, "tid") == number(work_event, "tid"));
+        CHECK_STRING(json_get_string(thread_event, "ph"), "M");
+        CHECK_STRING(json_get_string(json_get(thread_event, "args"), "name"), "worker \"1\"");
+        CHECK(number(file_event, "pid") == (double)getpid());
+    }
+    json_free(trace);
+
+    // Eight if statements checked on three threads
+    char program_text[1024] = "int x;\nx = 1;\n";
+    for (int i = 0; i < 8; i++) strcat(program_text, "if (x > x) {\n    x = x + 1;\n}\n");
+    CHECK(trace_open(path));
+    parser_init(program_text);
+    program = parse();
+    CHECK(program != NULL);
+    SymbolTable* table = init_symbol_table();
+    diag_session_init(&session, NULL);
+    DiagnosticSession* previous = diag_begin(&session);
+    CHECK(check_program_parallel(program, table, 3));
+    diag_end(previous);
+    diag_session_free(&session);
+    free_symbol_table(table);
+    free_ast(program);
+    CHECK(trace_close());
+
+    file = fopen(path, "r");
+    char* big = malloc(1 << 16);
+    length = file ? fread(big, 1, 1 << 16, file) : 0;
+    if (file) fclose(file);
+    unlink(path);
+    trace = json_parse(big, length);
+    free(big);
+    CHECK(trace != NULL);
+    if (!trace) return test_result();
+    events = json_get(trace, "traceEvents");
+    int checks = 0, named = 0;
+    for (int i = 0; events && i < events->count; i++) {
+        const JsonValue* event = &events->items[i];
+        if (strcmp(json_get_string(event, "name"), "thread_name") == 0) {
+            CHECK(strncmp(json_get_string(json_get(event, "args"), "name"), "worker ", 7) == 0);
+            named++;
+            continue;
+        }
+        CHECK_STRING(json_get_string(event, "name"), "check");
+        CHECK_STRING(json_get_string(event, "cat"), "statement");
+        CHECK(strncmp(json_get_string(json_get(event, "args"), "detail"), "line ", 5) == 0);
+        checks++;
+    }
+    CHECK(checks == 8);
+    CHECK(named == 2);
+    json_free(trace);
+
+    return test_result();
+}
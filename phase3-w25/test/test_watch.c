@@ -0,0 +1,123 @@
+/* test_watch.c */
+// Watch mode: every file is analyzed at startup and again after a save, and
+// in text format each file's diagnostics come after the line naming it, in
+// name order even though the files are checked on two threads. An input
+// too deep to check is a diagnostic, not a crash.
+#include <pthread.h>
+#include <unistd.h>
+#include "test.h"
+#include "watch.h"
+
+static char directory[] = "/tmp/test_watchXXXXXX";
+static int watch_result;
+
+static void* watch(void* arg) {
+    (void)arg;
+    AnalysisOptions options;
+    analysis_default_options(&options);
+    options.jobs = 2;
+    watch_result = watch_run(directory, DIAG_FORMAT_TEXT, &options);
+    return NULL;
+}
+
+static void write_file(const char* name, const char* text) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    FILE* file = fopen(path, "w");
+    fputs(text, file);
+    fclose(file);
+}
+
+static void remove_file(const char* name) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    unlink(path);
+}
+
+// Line `n` of `text`, copied into `line`
+static const char* nth_line(const char* text, int n, char* line, size_t size) {
+    for (; n > 0 && text; n--) {
+        text = strchr(text, '\n');
+        if (text) text++;
+    }
+    if (!text) return "";
+    size_t length = strcspn(text, "\n");
+    if (length >= size) length = size - 1;
+    memcpy(line, text, length);
+    line[length] = '\0';
+    return line;
+}
+
+// `terms` ones added up, deeper than the default depth limit allows
+static char* chain(int terms) {
+    char* source = malloc(2 * (size_t)terms + 32);
+    int length = sprintf(source, "int x;\nx = 1");
+    for (int i = 1; i < terms; i++) length += sprintf(source + length, "+1");
+    strcpy(source + length, ";\n");
+    return source;
+}
+
+static int starts_with(const char* text, const char* prefix) {
+    return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+int main(void) {
+    CHECK(mkdtemp(directory) != NULL);
+    write_file("a.txt", "int x;\nx = y;\n");
+    write_file("b.txt", "int z;\nz = 1;\n");
+    char* deep = chain(200000);
+    write_file("deep.txt", deep);
+    free(deep);
+
+    char output_path[] = "/tmp/test_watch_outXXXXXX";
+    int fd = mkstemp(output_path);
+    CHECK(fd >= 0);
+    close(fd);
+    CHECK(freopen(output_path, "w", stdout) != NULL);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, watch, NULL);
+    usleep(200 * 1000);
+    // A save that fixes a.txt and one that breaks b.txt
+    write_file("a.txt", "int x;\nx = 2;\n");
+    write_file("b.txt", "int z;\nz = \"s\" * 2;\nprint w;\n");
+    usleep(800 * 1000);
+    remove_file("a.txt");
+    remove_file("b.txt");
+    remove_file("deep.txt");
+    rmdir(directory);
+    pthread_join(thread, NULL);
+    CHECK(watch_result == 1);
+    fflush(stdout);
+
+    FILE* file = fopen(output_path, "r");
+    char output[4096];
+    size_t length = fread(output, 1, sizeof(output) - 1, file);
+    output[length] = '\0';
+    fclose(file);
+    unlink(output_path);
+
+    char a[256], b[256], d[256], line[256];
+    snprintf(a, sizeof(a), "%s/a.txt: ", directory);
+    snprintf(b, sizeof(b), "%s/b.txt: ", directory);
+    snprintf(d, sizeof(d), "%s/deep.txt: ", directory);
+    // Startup, in name order
+    CHECK(starts_with(nth_line(output, 0, line, sizeof(line)), a));
+    CHECK(strstr(line, ": errors, checked 2 of 2") != NULL);
+    CHECK_STRING(nth_line(output, 1, line, sizeof(line)), "Semantic Error at line 2, column 5: Undeclared variable 'y'");
+    CHECK(starts_with(nth_line(output, 2, line, sizeof(line)), b));
+    CHECK(strstr(line, ": OK, checked 2 of 2") != NULL);
+    CHECK(starts_with(nth_line(output, 3, line, sizeof(line)), d));
+    CHECK(strstr(line, ": syntax error") != NULL);
+    CHECK(starts_with(nth_line(output, 4, line, sizeof(line)), "Limit Error at line 2"));
+    CHECK(strstr(line, "Input nests deeper than 10000 levels") != NULL);
+    // After the saves
+    CHECK(starts_with(nth_line(output, 5, line, sizeof(line)), a));
+    CHECK(strstr(line, ": OK") != NULL);
+    CHECK(starts_with(nth_line(output, 6, line, sizeof(line)), b));
+    CHECK(strstr(line, ": errors") != NULL);
+    CHECK(starts_with(nth_line(output, 7, line, sizeof(line)), "Semantic Error at line 2"));
+    CHECK(starts_with(nth_line(output, 8, line, sizeof(line)), "Semantic Error at line 3"));
+
+    return test_result();
+}